@@ -0,0 +1,316 @@
+#include "AntiAliasing.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace wgpu;
+
+// FXAA as originally published by Timothy Lottes, in its simplest form:
+// the edge direction is estimated from the lumas of the 4 diagonal
+// neighbors, and the pixel is replaced by an average of samples along the
+// edge, unless that average leaves the luma range of the neighborhood.
+static const char* fxaaShaderSource = R"(
+@group(0) @binding(0) var inputTexture: texture_2d<f32>;
+@group(0) @binding(1) var inputSampler: sampler;
+
+const REDUCE_MIN = 1.0 / 128.0;
+const REDUCE_MUL = 1.0 / 8.0;
+// In pixels
+const SPAN_MAX = 8.0;
+
+struct VertexOutput {
+    @builtin(position) position: vec4f,
+    @location(0) uv: vec2f,
+}
+
+// A single triangle covers the whole screen
+@vertex
+fn vs_main(@builtin(vertex_index) vertexIndex: u32) -> VertexOutput {
+    var out: VertexOutput;
+    let uv = vec2f(f32((vertexIndex << 1u) & 2u), f32(vertexIndex & 2u));
+    out.position = vec4f(uv * vec2f(2.0, -2.0) + vec2f(-1.0, 1.0), 0.0, 1.0);
+    out.uv = uv;
+    return out;
+}
+
+fn luma(color: vec3f) -> f32 {
+    return dot(color, vec3f(0.299, 0.587, 0.114));
+}
+
+fn fetch(uv: vec2f) -> vec3f {
+    return textureSampleLevel(inputTexture, inputSampler, uv, 0.0).rgb;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    let texelSize = 1.0 / vec2f(textureDimensions(inputTexture));
+    let center = fetch(in.uv);
+    let lumaNW = luma(fetch(in.uv + vec2f(-1.0, -1.0) * texelSize));
+    let lumaNE = luma(fetch(in.uv + vec2f(1.0, -1.0) * texelSize));
+    let lumaSW = luma(fetch(in.uv + vec2f(-1.0, 1.0) * texelSize));
+    let lumaSE = luma(fetch(in.uv + vec2f(1.0, 1.0) * texelSize));
+    let lumaM = luma(center);
+    let lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));
+    let lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));
+
+    // Perpendicular to the luma gradient, so along the edge
+    var direction = vec2f(
+        -((lumaNW + lumaNE) - (lumaSW + lumaSE)),
+        (lumaNW + lumaSW) - (lumaNE + lumaSE),
+    );
+    let directionReduce = max(0.25 * (lumaNW + lumaNE + lumaSW + lumaSE) * REDUCE_MUL, REDUCE_MIN);
+    let scale = 1.0 / (min(abs(direction.x), abs(direction.y)) + directionReduce);
+    direction = clamp(direction * scale, vec2f(-SPAN_MAX), vec2f(SPAN_MAX)) * texelSize;
+
+    let colorA = 0.5 * (
+        fetch(in.uv + direction * (1.0 / 3.0 - 0.5)) +
+        fetch(in.uv + direction * (2.0 / 3.0 - 0.5))
+    );
+    let colorB = 0.5 * colorA + 0.25 * (
+        fetch(in.uv - 0.5 * direction) +
+        fetch(in.uv + 0.5 * direction)
+    );
+    let lumaB = luma(colorB);
+    if (lumaB < lumaMin || lumaB > lumaMax) {
+        return vec4f(colorA, 1.0);
+    }
+    return vec4f(colorB, 1.0);
+}
+)";
+
+static uint32_t bytesPerTexel(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::RGBA16Float: return 8;
+	case TextureFormat::RGBA32Float: return 16;
+	// The formats of swap chains
+	default: return 4;
+	}
+}
+
+MultisampleTarget::MultisampleTarget(Device device, TextureFormat format, uint32_t sampleCount)
+	: m_device(device)
+	, m_format(format)
+	, m_sampleCount(sampleCount)
+{
+	assert(isSampleCountSupported(sampleCount));
+}
+
+MultisampleTarget::~MultisampleTarget() {
+	if (m_texture) {
+		m_view.release();
+		m_texture.destroy();
+		m_texture.release();
+	}
+}
+
+void MultisampleTarget::resize(uint32_t width, uint32_t height) {
+	if (width == m_width && height == m_height) return;
+	m_width = width;
+	m_height = height;
+	if (m_sampleCount == 1) return;
+
+	if (m_texture) {
+		m_view.release();
+		m_texture.destroy();
+		m_texture.release();
+	}
+	TextureDescriptor textureDesc;
+	textureDesc.label = "Multisampled color target";
+	textureDesc.usage = TextureUsage::RenderAttachment;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { width, height, 1 };
+	textureDesc.format = m_format;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = m_sampleCount;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	m_texture = m_device.createTexture(textureDesc);
+	m_view = m_texture.createView();
+}
+
+RenderPassColorAttachment MultisampleTarget::colorAttachment(TextureView view, Color clearValue) const {
+	RenderPassColorAttachment attachment = {};
+	attachment.loadOp = LoadOp::Clear;
+	attachment.clearValue = clearValue;
+	if (m_sampleCount == 1) {
+		attachment.view = view;
+		attachment.resolveTarget = nullptr;
+		attachment.storeOp = StoreOp::Store;
+	} else {
+		assert(m_texture && "resize() must be called before the first pass");
+		attachment.view = m_view;
+		attachment.resolveTarget = view;
+		// Only the resolved pixels outlive the pass
+		attachment.storeOp = StoreOp::Discard;
+	}
+	return attachment;
+}
+
+uint64_t MultisampleTarget::memoryBytes() const {
+	if (m_sampleCount == 1) return 0;
+	return uint64_t(m_width) * m_height * m_sampleCount * bytesPerTexel(m_format);
+}
+
+void FxaaPass::requireLimits(WGPULimits& limits) {
+	limits.maxBindGroups = std::max(limits.maxBindGroups, 1u);
+	limits.maxSampledTexturesPerShaderStage = std::max(limits.maxSampledTexturesPerShaderStage, 1u);
+	limits.maxSamplersPerShaderStage = std::max(limits.maxSamplersPerShaderStage, 1u);
+	// The texture coordinates
+	limits.maxInterStageShaderComponents = std::max(limits.maxInterStageShaderComponents, 2u);
+}
+
+FxaaPass::FxaaPass(Device device, TextureFormat format)
+	: m_device(device)
+	, m_format(format)
+{
+	SamplerDescriptor samplerDesc;
+	samplerDesc.addressModeU = AddressMode::ClampToEdge;
+	samplerDesc.addressModeV = AddressMode::ClampToEdge;
+	samplerDesc.addressModeW = AddressMode::ClampToEdge;
+	samplerDesc.magFilter = FilterMode::Linear;
+	samplerDesc.minFilter = FilterMode::Linear;
+	samplerDesc.mipmapFilter = MipmapFilterMode::Nearest;
+	samplerDesc.lodMinClamp = 0.0f;
+	samplerDesc.lodMaxClamp = 1.0f;
+	samplerDesc.compare = CompareFunction::Undefined;
+	samplerDesc.maxAnisotropy = 1;
+	m_sampler = m_device.createSampler(samplerDesc);
+
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = fxaaShaderSource;
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = m_device.createShaderModule(shaderDesc);
+
+	BindGroupLayoutEntry bindingLayouts[2] = { Default, Default };
+	bindingLayouts[0].binding = 0;
+	bindingLayouts[0].visibility = ShaderStage::Fragment;
+	bindingLayouts[0].texture.sampleType = TextureSampleType::Float;
+	bindingLayouts[0].texture.viewDimension = TextureViewDimension::_2D;
+	bindingLayouts[1].binding = 1;
+	bindingLayouts[1].visibility = ShaderStage::Fragment;
+	bindingLayouts[1].sampler.type = SamplerBindingType::Filtering;
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = 2;
+	bindGroupLayoutDesc.entries = bindingLayouts;
+	m_bindGroupLayout = m_device.createBindGroupLayout(bindGroupLayoutDesc);
+
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.bindGroupLayoutCount = 1;
+	pipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&m_bindGroupLayout;
+	m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutDesc);
+
+	RenderPipelineDescriptor pipelineDesc{};
+	pipelineDesc.layout = m_pipelineLayout;
+	pipelineDesc.vertex.bufferCount = 0;
+	pipelineDesc.vertex.buffers = nullptr;
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.constantCount = 0;
+	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	pipelineDesc.primitive.frontFace = FrontFace::CCW;
+	pipelineDesc.primitive.cullMode = CullMode::None;
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	ColorTargetState colorTarget;
+	colorTarget.format = m_format;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+	pipelineDesc.depthStencil = nullptr;
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+	m_pipeline = m_device.createRenderPipeline(pipelineDesc);
+	shaderModule.release();
+}
+
+FxaaPass::~FxaaPass() {
+	if (m_input) {
+		m_bindGroup.release();
+		m_inputView.release();
+		m_input.destroy();
+		m_input.release();
+	}
+	m_pipeline.release();
+	m_pipelineLayout.release();
+	m_bindGroupLayout.release();
+	m_sampler.release();
+}
+
+void FxaaPass::resize(uint32_t width, uint32_t height) {
+	if (width == m_width && height == m_height) return;
+	m_width = width;
+	m_height = height;
+
+	if (m_input) {
+		m_bindGroup.release();
+		m_inputView.release();
+		m_input.destroy();
+		m_input.release();
+	}
+	TextureDescriptor textureDesc;
+	textureDesc.label = "FXAA input";
+	textureDesc.usage = TextureUsage::RenderAttachment | TextureUsage::TextureBinding;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { width, height, 1 };
+	textureDesc.format = m_format;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	m_input = m_device.createTexture(textureDesc);
+	m_inputView = m_input.createView();
+
+	BindGroupEntry bindings[2];
+	bindings[0].binding = 0;
+	bindings[0].textureView = m_inputView;
+	bindings[1].binding = 1;
+	bindings[1].sampler = m_sampler;
+	BindGroupDescriptor bindGroupDesc{};
+	bindGroupDesc.layout = m_bindGroupLayout;
+	bindGroupDesc.entryCount = 2;
+	bindGroupDesc.entries = bindings;
+	m_bindGroup = m_device.createBindGroup(bindGroupDesc);
+}
+
+void FxaaPass::apply(CommandEncoder encoder, TextureView output) {
+	assert(m_input && "resize() must be called before the first pass");
+	RenderPassColorAttachment colorAttachment = {};
+	colorAttachment.view = output;
+	colorAttachment.resolveTarget = nullptr;
+	// Every pixel is overwritten
+	colorAttachment.loadOp = LoadOp::Clear;
+	colorAttachment.storeOp = StoreOp::Store;
+	colorAttachment.clearValue = Color{ 0.0, 0.0, 0.0, 1.0 };
+	RenderPassDescriptor renderPassDesc{};
+	renderPassDesc.label = "FXAA";
+	renderPassDesc.colorAttachmentCount = 1;
+	renderPassDesc.colorAttachments = &colorAttachment;
+	renderPassDesc.depthStencilAttachment = nullptr;
+	renderPassDesc.timestampWriteCount = 0;
+	renderPassDesc.timestampWrites = nullptr;
+	RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+	renderPass.setPipeline(m_pipeline);
+	renderPass.setBindGroup(0, m_bindGroup, 0, nullptr);
+	renderPass.draw(3, 1, 0, 0);
+	renderPass.end();
+	renderPass.release();
+}
+
+uint64_t FxaaPass::memoryBytes() const {
+	return uint64_t(m_width) * m_height * bytesPerTexel(m_format);
+}
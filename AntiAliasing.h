@@ -0,0 +1,119 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+
+/**
+ * Color target of the main render pass, multisampled or not.
+ *
+ * With more than one sample per pixel, the pass draws into a multisampled
+ * texture that is resolved into the final view (typically the swap chain's)
+ * when the pass ends. The samples are not needed after that, so they are
+ * not stored: tiled GPUs resolve straight from tile memory and the samples
+ * never reach video memory. With one sample, the pass draws into the final
+ * view directly.
+ */
+class MultisampleTarget {
+public:
+	/**
+	 * WebGPU only guarantees 1 and 4 samples per pixel.
+	 */
+	static bool isSampleCountSupported(uint32_t sampleCount) { return sampleCount == 1 || sampleCount == 4; }
+
+	MultisampleTarget(wgpu::Device device, wgpu::TextureFormat format, uint32_t sampleCount);
+	~MultisampleTarget();
+
+	MultisampleTarget(const MultisampleTarget&) = delete;
+	MultisampleTarget& operator=(const MultisampleTarget&) = delete;
+
+	/**
+	 * Match the size of the views passed to colorAttachment(), recreating
+	 * the multisampled texture if it changed.
+	 */
+	void resize(uint32_t width, uint32_t height);
+
+	/**
+	 * Attachment that clears the target, and leaves the rendered image in
+	 * `view` at the end of the pass.
+	 */
+	wgpu::RenderPassColorAttachment colorAttachment(wgpu::TextureView view, wgpu::Color clearValue) const;
+
+	uint32_t sampleCount() const { return m_sampleCount; }
+
+	/**
+	 * Size of the multisampled texture, if any.
+	 */
+	uint64_t memoryBytes() const;
+
+private:
+	wgpu::Device m_device;
+	wgpu::TextureFormat m_format;
+	uint32_t m_sampleCount;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	wgpu::Texture m_texture = nullptr;
+	wgpu::TextureView m_view = nullptr;
+};
+
+/**
+ * Post-process anti-aliasing (FXAA), the alternative to multisampling.
+ *
+ * The scene is rendered with one sample per pixel into an intermediate
+ * texture, then a full screen pass blends the pixels across the edges it
+ * detects from the luma contrast between neighbors. It costs one extra
+ * texture and a pass over every pixel instead of 4 samples per pixel, but
+ * softens textures a little and cannot recover details thinner than a
+ * pixel.
+ */
+class FxaaPass {
+public:
+	/**
+	 * Raise the device limits needed by the post-process pass.
+	 */
+	static void requireLimits(WGPULimits& limits);
+
+	/**
+	 * Output views must have `format`, which is also the format of the
+	 * intermediate texture.
+	 */
+	FxaaPass(wgpu::Device device, wgpu::TextureFormat format);
+	~FxaaPass();
+
+	FxaaPass(const FxaaPass&) = delete;
+	FxaaPass& operator=(const FxaaPass&) = delete;
+
+	/**
+	 * Match the size of the output views, recreating the intermediate
+	 * texture if it changed.
+	 */
+	void resize(uint32_t width, uint32_t height);
+
+	/**
+	 * The view to render the scene into, valid until the next resize().
+	 */
+	wgpu::TextureView inputView() const { return m_inputView; }
+
+	/**
+	 * Record the pass that writes the anti-aliased input into `output`.
+	 */
+	void apply(wgpu::CommandEncoder encoder, wgpu::TextureView output);
+
+	/**
+	 * Size of the intermediate texture.
+	 */
+	uint64_t memoryBytes() const;
+
+private:
+	wgpu::Device m_device;
+	wgpu::TextureFormat m_format;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	wgpu::Sampler m_sampler = nullptr;
+	wgpu::BindGroupLayout m_bindGroupLayout = nullptr;
+	wgpu::PipelineLayout m_pipelineLayout = nullptr;
+	wgpu::RenderPipeline m_pipeline = nullptr;
+	wgpu::Texture m_input = nullptr;
+	wgpu::TextureView m_inputView = nullptr;
+	wgpu::BindGroup m_bindGroup = nullptr;
+};
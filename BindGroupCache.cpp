@@ -0,0 +1,117 @@
+#include "BindGroupCache.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace wgpu;
+
+static uint64_t handleWord(const void* handle) {
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(handle));
+}
+
+size_t BindGroupCache::KeyHash::operator()(const Key& key) const {
+	// 64-bit FNV-1a over whole words, followed by a final avalanche
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (uint64_t word : key) {
+		hash = (hash ^ word) * 0x100000001b3ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	return static_cast<size_t>(hash);
+}
+
+BindGroupCache::BindGroupCache(Device device)
+	: m_device(device)
+{}
+
+BindGroupCache::~BindGroupCache() {
+	for (auto& it : m_bindGroups) {
+		it.second.release();
+	}
+	for (auto& it : m_layouts) {
+		it.second.release();
+	}
+}
+
+BindGroupLayout BindGroupCache::getLayout(const BindGroupLayoutDescriptor& descriptor) {
+	// Sort entries by binding so that the order they are listed in does not matter
+	std::vector<const WGPUBindGroupLayoutEntry*> entries(descriptor.entryCount);
+	for (uint32_t i = 0; i < descriptor.entryCount; ++i) {
+		entries[i] = &descriptor.entries[i];
+	}
+	std::sort(entries.begin(), entries.end(), [](auto a, auto b) { return a->binding < b->binding; });
+
+	Key key;
+	key.reserve(8 * entries.size());
+	for (const WGPUBindGroupLayoutEntry* entry : entries) {
+		assert(entry->nextInChain == nullptr);
+		key.push_back((uint64_t)entry->binding << 32 | entry->visibility);
+		key.push_back((uint64_t)entry->buffer.type << 32 | entry->buffer.hasDynamicOffset);
+		key.push_back(entry->buffer.minBindingSize);
+		key.push_back(entry->sampler.type);
+		key.push_back((uint64_t)entry->texture.sampleType << 32 | entry->texture.viewDimension);
+		key.push_back(entry->texture.multisampled);
+		key.push_back((uint64_t)entry->storageTexture.access << 32 | entry->storageTexture.format);
+		key.push_back(entry->storageTexture.viewDimension);
+	}
+
+	auto it = m_layouts.find(key);
+	if (it != m_layouts.end()) {
+		++m_stats.layoutHits;
+		return it->second;
+	}
+	++m_stats.layoutMisses;
+	BindGroupLayout layout = m_device.createBindGroupLayout(descriptor);
+	m_layouts.emplace(std::move(key), layout);
+	return layout;
+}
+
+BindGroup BindGroupCache::getBindGroup(const BindGroupDescriptor& descriptor) {
+	std::vector<const WGPUBindGroupEntry*> entries(descriptor.entryCount);
+	for (uint32_t i = 0; i < descriptor.entryCount; ++i) {
+		entries[i] = &descriptor.entries[i];
+	}
+	std::sort(entries.begin(), entries.end(), [](auto a, auto b) { return a->binding < b->binding; });
+
+	Key key;
+	key.reserve(1 + 6 * entries.size());
+	key.push_back(handleWord(descriptor.layout));
+	for (const WGPUBindGroupEntry* entry : entries) {
+		assert(entry->nextInChain == nullptr);
+		key.push_back(entry->binding);
+		key.push_back(handleWord(entry->buffer));
+		key.push_back(entry->offset);
+		key.push_back(entry->size);
+		key.push_back(handleWord(entry->sampler));
+		key.push_back(handleWord(entry->textureView));
+	}
+
+	auto it = m_bindGroups.find(key);
+	if (it != m_bindGroups.end()) {
+		++m_stats.bindGroupHits;
+		return it->second;
+	}
+	++m_stats.bindGroupMisses;
+	BindGroup bindGroup = m_device.createBindGroup(descriptor);
+	for (const WGPUBindGroupEntry* entry : entries) {
+		for (const void* resource : { (const void*)entry->buffer, (const void*)entry->sampler, (const void*)entry->textureView }) {
+			if (resource) m_bindGroupsByResource[resource].push_back(key);
+		}
+	}
+	m_bindGroups.emplace(std::move(key), bindGroup);
+	return bindGroup;
+}
+
+void BindGroupCache::evictResource(const void* resource) {
+	auto it = m_bindGroupsByResource.find(resource);
+	if (it == m_bindGroupsByResource.end()) return;
+	for (const Key& key : it->second) {
+		auto bindGroup = m_bindGroups.find(key);
+		if (bindGroup == m_bindGroups.end()) continue;
+		bindGroup->second.release();
+		m_bindGroups.erase(bindGroup);
+		++m_stats.evictions;
+	}
+	m_bindGroupsByResource.erase(it);
+}
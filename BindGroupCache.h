@@ -0,0 +1,85 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Cache of bind group layouts and bind groups, indexed by a hash of their
+ * descriptor contents (layout entries, and bound buffer ranges, texture
+ * views and samplers), so that asking for the same bindings twice returns
+ * the same object rather than creating a new one.
+ *
+ * The cache owns the objects it returns: do not release them. WebGPU does
+ * not notify when a resource is destroyed, so call evict() before
+ * releasing a buffer, texture view or sampler that may be bound by cached
+ * bind groups.
+ */
+class BindGroupCache {
+public:
+	struct Stats {
+		uint64_t layoutHits = 0;
+		uint64_t layoutMisses = 0;
+		uint64_t bindGroupHits = 0;
+		uint64_t bindGroupMisses = 0;
+		uint64_t evictions = 0;
+	};
+
+	explicit BindGroupCache(wgpu::Device device);
+	~BindGroupCache();
+
+	BindGroupCache(const BindGroupCache&) = delete;
+	BindGroupCache& operator=(const BindGroupCache&) = delete;
+
+	/**
+	 * Equivalent to Device::createBindGroupLayout(), but returns the
+	 * existing layout if one was created with the same entries, in any
+	 * order. Labels are ignored.
+	 */
+	wgpu::BindGroupLayout getLayout(const wgpu::BindGroupLayoutDescriptor& descriptor);
+
+	/**
+	 * Equivalent to Device::createBindGroup(), but returns the existing bind
+	 * group if one was created with the same layout and bindings.
+	 */
+	wgpu::BindGroup getBindGroup(const wgpu::BindGroupDescriptor& descriptor);
+
+	/**
+	 * Release the cached bind groups that reference `resource`, which is
+	 * about to be destroyed.
+	 */
+	void evict(wgpu::Buffer resource) { evictResource((WGPUBuffer)resource); }
+	void evict(wgpu::TextureView resource) { evictResource((WGPUTextureView)resource); }
+	void evict(wgpu::Sampler resource) { evictResource((WGPUSampler)resource); }
+
+	/**
+	 * Counters, e.g. to check that no bind group gets created in the frame
+	 * loop (i.e. that bindGroupMisses stays constant there).
+	 */
+	const Stats& stats() const { return m_stats; }
+	void resetStats() { m_stats = Stats{}; }
+
+	size_t layoutCount() const { return m_layouts.size(); }
+	size_t bindGroupCount() const { return m_bindGroups.size(); }
+
+private:
+	// Descriptor contents, flattened into words
+	using Key = std::vector<uint64_t>;
+	struct KeyHash {
+		size_t operator()(const Key& key) const;
+	};
+
+	void evictResource(const void* resource);
+
+private:
+	wgpu::Device m_device;
+	std::unordered_map<Key, wgpu::BindGroupLayout, KeyHash> m_layouts;
+	std::unordered_map<Key, wgpu::BindGroup, KeyHash> m_bindGroups;
+	// Keys of the bind groups that bind each resource. Keys of bind groups
+	// already evicted through another of their resources may linger here
+	// until this resource gets evicted too.
+	std::unordered_map<const void*, std::vector<Key>> m_bindGroupsByResource;
+	Stats m_stats;
+};
@@ -0,0 +1,369 @@
+#include "ComputeKernel.h"
+#include "BindGroupCache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <regex>
+
+using namespace wgpu;
+
+// Minimum value of maxComputeWorkgroupsPerDimension guaranteed by WebGPU
+constexpr uint32_t MAX_WORKGROUPS_PER_DIMENSION = 65535;
+
+namespace {
+
+// Remove comments, which may contain declarations that are not
+std::string stripComments(const std::string& source) {
+	std::string stripped;
+	stripped.reserve(source.size());
+	for (size_t i = 0; i < source.size(); ++i) {
+		if (source.compare(i, 2, "//") == 0) {
+			i = source.find('\n', i);
+			if (i == std::string::npos) break;
+			stripped += '\n';
+		} else if (source.compare(i, 2, "/*") == 0) {
+			i = source.find("*/", i + 2);
+			if (i == std::string::npos) break;
+			++i;
+			stripped += ' ';
+		} else {
+			stripped += source[i];
+		}
+	}
+	return stripped;
+}
+
+std::string trim(const std::string& s) {
+	size_t first = s.find_first_not_of(" \t\r\n");
+	if (first == std::string::npos) return "";
+	size_t last = s.find_last_not_of(" \t\r\n");
+	return s.substr(first, last - first + 1);
+}
+
+// Dimension suffix of a texture type, e.g. "2d_array" in texture_2d_array<f32>
+TextureViewDimension parseViewDimension(const std::string& suffix) {
+	if (suffix.compare(0, 8, "2d_array") == 0) return TextureViewDimension::_2DArray;
+	if (suffix.compare(0, 10, "cube_array") == 0) return TextureViewDimension::CubeArray;
+	if (suffix.compare(0, 2, "1d") == 0) return TextureViewDimension::_1D;
+	if (suffix.compare(0, 2, "2d") == 0) return TextureViewDimension::_2D;
+	if (suffix.compare(0, 2, "3d") == 0) return TextureViewDimension::_3D;
+	if (suffix.compare(0, 4, "cube") == 0) return TextureViewDimension::Cube;
+	return TextureViewDimension::Undefined;
+}
+
+// Texel formats that WGSL allows for storage textures
+TextureFormat parseStorageFormat(const std::string& name) {
+	static const std::pair<const char*, TextureFormat> formats[] = {
+		{ "rgba8unorm", TextureFormat::RGBA8Unorm },
+		{ "rgba8snorm", TextureFormat::RGBA8Snorm },
+		{ "rgba8uint", TextureFormat::RGBA8Uint },
+		{ "rgba8sint", TextureFormat::RGBA8Sint },
+		{ "rgba16uint", TextureFormat::RGBA16Uint },
+		{ "rgba16sint", TextureFormat::RGBA16Sint },
+		{ "rgba16float", TextureFormat::RGBA16Float },
+		{ "r32uint", TextureFormat::R32Uint },
+		{ "r32sint", TextureFormat::R32Sint },
+		{ "r32float", TextureFormat::R32Float },
+		{ "rg32uint", TextureFormat::RG32Uint },
+		{ "rg32sint", TextureFormat::RG32Sint },
+		{ "rg32float", TextureFormat::RG32Float },
+		{ "rgba32uint", TextureFormat::RGBA32Uint },
+		{ "rgba32sint", TextureFormat::RGBA32Sint },
+		{ "rgba32float", TextureFormat::RGBA32Float },
+		{ "bgra8unorm", TextureFormat::BGRA8Unorm },
+	};
+	for (const auto& format : formats) {
+		if (name == format.first) return format.second;
+	}
+	return TextureFormat::Undefined;
+}
+
+// Fill the layout of a resource declared with `addressSpace` (what is
+// between the angle brackets of var<...>, if any) and `type`. Returns
+// false for declarations that are not bound, e.g. var<workgroup>.
+bool parseBinding(const std::string& addressSpace, const std::string& type, bool filteringSampler, BindGroupLayoutEntry& entry) {
+	if (!addressSpace.empty()) {
+		std::string space = addressSpace.substr(0, addressSpace.find(','));
+		std::string access = addressSpace.find(',') == std::string::npos ? "" : trim(addressSpace.substr(addressSpace.find(',') + 1));
+		space = trim(space);
+		if (space == "uniform") {
+			entry.buffer.type = BufferBindingType::Uniform;
+		} else if (space == "storage") {
+			entry.buffer.type = access == "read_write" ? BufferBindingType::Storage : BufferBindingType::ReadOnlyStorage;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	if (type.compare(0, 18, "sampler_comparison") == 0) {
+		entry.sampler.type = SamplerBindingType::Comparison;
+	} else if (type.compare(0, 7, "sampler") == 0) {
+		entry.sampler.type = SamplerBindingType::Filtering;
+	} else if (type.compare(0, 16, "texture_storage_") == 0) {
+		size_t open = type.find('<');
+		size_t comma = type.find(',', open);
+		assert(open != std::string::npos && comma != std::string::npos);
+		entry.storageTexture.access = StorageTextureAccess::WriteOnly;
+		entry.storageTexture.format = parseStorageFormat(trim(type.substr(open + 1, comma - open - 1)));
+		entry.storageTexture.viewDimension = parseViewDimension(type.substr(16));
+		assert(entry.storageTexture.format != TextureFormat::Undefined && "Unsupported storage texture format");
+	} else if (type.compare(0, 14, "texture_depth_") == 0) {
+		entry.texture.sampleType = TextureSampleType::Depth;
+		entry.texture.multisampled = type.compare(14, 12, "multisampled") == 0;
+		entry.texture.viewDimension = parseViewDimension(entry.texture.multisampled ? "2d" : type.substr(14));
+	} else if (type.compare(0, 8, "texture_") == 0) {
+		std::string sampled = type.substr(type.find('<') + 1);
+		entry.texture.multisampled = type.compare(8, 12, "multisampled") == 0;
+		entry.texture.viewDimension = parseViewDimension(entry.texture.multisampled ? "2d" : type.substr(8));
+		if (sampled.compare(0, 3, "i32") == 0) {
+			entry.texture.sampleType = TextureSampleType::Sint;
+		} else if (sampled.compare(0, 3, "u32") == 0) {
+			entry.texture.sampleType = TextureSampleType::Uint;
+		} else if (filteringSampler && !entry.texture.multisampled) {
+			entry.texture.sampleType = TextureSampleType::Float;
+		} else {
+			// Also accepts textures of formats that cannot be filtered
+			entry.texture.sampleType = TextureSampleType::UnfilterableFloat;
+		}
+		assert(entry.texture.viewDimension != TextureViewDimension::Undefined && "Unsupported texture type");
+	} else {
+		assert(false && "Unsupported resource type");
+		return false;
+	}
+	return true;
+}
+
+// Round down to a power of two
+uint32_t floorPowerOfTwo(uint32_t x) {
+	uint32_t p = 1;
+	while (p <= x / 2) p *= 2;
+	return p;
+}
+
+std::vector<BindGroupEntry> bindGroupEntries(const std::vector<ComputeKernel::Binding>& bindings) {
+	std::vector<BindGroupEntry> entries(bindings.size());
+	for (size_t i = 0; i < bindings.size(); ++i) {
+		Buffer buffer = bindings[i].buffer;
+		entries[i].binding = bindings[i].binding;
+		entries[i].buffer = buffer;
+		entries[i].offset = bindings[i].offset;
+		entries[i].size = 0;
+		if (buffer) {
+			entries[i].size = bindings[i].size == WGPU_WHOLE_SIZE ? buffer.getSize() - bindings[i].offset : bindings[i].size;
+		}
+		entries[i].textureView = bindings[i].textureView;
+		entries[i].sampler = bindings[i].sampler;
+	}
+	return entries;
+}
+
+} // namespace
+
+ComputeKernel::Binding::Binding(uint32_t binding, Buffer buffer, uint64_t offset, uint64_t size)
+	: binding(binding), buffer(buffer), offset(offset), size(size)
+{}
+
+ComputeKernel::Binding::Binding(uint32_t binding, TextureView textureView)
+	: binding(binding), textureView(textureView)
+{}
+
+ComputeKernel::Binding::Binding(uint32_t binding, Sampler sampler)
+	: binding(binding), sampler(sampler)
+{}
+
+void ComputeKernel::requireLimits(WGPULimits& limits, uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ, uint64_t invocationCount) {
+	uint32_t invocations = sizeX * sizeY * sizeZ;
+	uint64_t workgroupCount = (invocationCount + invocations - 1) / invocations;
+	limits.maxComputeWorkgroupSizeX = std::max(limits.maxComputeWorkgroupSizeX, sizeX);
+	limits.maxComputeWorkgroupSizeY = std::max(limits.maxComputeWorkgroupSizeY, sizeY);
+	limits.maxComputeWorkgroupSizeZ = std::max(limits.maxComputeWorkgroupSizeZ, sizeZ);
+	limits.maxComputeInvocationsPerWorkgroup = std::max(limits.maxComputeInvocationsPerWorkgroup, invocations);
+	limits.maxComputeWorkgroupsPerDimension = std::max(limits.maxComputeWorkgroupsPerDimension, (uint32_t)std::min<uint64_t>(workgroupCount, MAX_WORKGROUPS_PER_DIMENSION));
+}
+
+std::array<uint32_t, 3> ComputeKernel::chooseWorkgroupSize(const WGPULimits& limits, uint32_t dimensions, uint32_t preferredInvocations) {
+	assert(dimensions >= 1 && dimensions <= 3);
+	uint32_t invocations = std::max(1u, std::min(preferredInvocations, limits.maxComputeInvocationsPerWorkgroup));
+	const uint32_t maxSizes[3] = { limits.maxComputeWorkgroupSizeX, limits.maxComputeWorkgroupSizeY, limits.maxComputeWorkgroupSizeZ };
+
+	// As square or cubic as possible, so that neighboring invocations
+	// access neighboring texels along all dimensions. X gets what is left.
+	std::array<uint32_t, 3> size = { 1, 1, 1 };
+	uint32_t side = 1;
+	while (dimensions > 1 && std::pow(2.0 * side, dimensions) <= invocations) side *= 2;
+	uint32_t others = 1;
+	for (uint32_t d = 1; d < dimensions; ++d) {
+		size[d] = std::min(side, maxSizes[d]);
+		others *= size[d];
+	}
+	size[0] = std::max(1u, std::min(floorPowerOfTwo(invocations / others), maxSizes[0]));
+	return size;
+}
+
+std::vector<std::vector<BindGroupLayoutEntry>> ComputeKernel::reflectBindings(const std::string& source) {
+	std::string code = stripComments(source);
+	// One or more attributes, then the declaration up to its semicolon
+	static const std::regex declaration(R"(((?:@\s*\w+\s*\([^)]*\)\s*)+)var\s*(?:<([^>]*)>)?\s*\w+\s*:\s*([^;]+);)");
+	static const std::regex group(R"(@\s*group\s*\(\s*(\d+)\s*\))");
+	static const std::regex binding(R"(@\s*binding\s*\(\s*(\d+)\s*\))");
+	static const std::regex filteringSampler(R"(:\s*sampler\s*;)");
+	bool hasFilteringSampler = std::regex_search(code, filteringSampler);
+
+	std::vector<std::vector<BindGroupLayoutEntry>> groups;
+	for (std::sregex_iterator it(code.begin(), code.end(), declaration), end; it != end; ++it) {
+		std::string attributes = (*it)[1];
+		std::smatch groupMatch, bindingMatch;
+		if (!std::regex_search(attributes, groupMatch, group) || !std::regex_search(attributes, bindingMatch, binding)) {
+			continue;
+		}
+
+		BindGroupLayoutEntry entry = Default;
+		entry.binding = static_cast<uint32_t>(std::stoul(bindingMatch[1]));
+		entry.visibility = ShaderStage::Compute;
+		if (!parseBinding((*it)[2], trim((*it)[3]), hasFilteringSampler, entry)) {
+			continue;
+		}
+
+		uint32_t groupIndex = static_cast<uint32_t>(std::stoul(groupMatch[1]));
+		if (groups.size() <= groupIndex) {
+			groups.resize(groupIndex + 1);
+		}
+		groups[groupIndex].push_back(entry);
+	}
+	return groups;
+}
+
+ComputeKernel::ComputeKernel(Device device, const Descriptor& descriptor)
+	: m_device(device)
+	, m_maxWorkgroupsPerDimension(MAX_WORKGROUPS_PER_DIMENSION)
+{
+	assert(descriptor.source);
+	SupportedLimits supportedLimits;
+	if (m_device.getLimits(&supportedLimits)) {
+		m_workgroupSize = chooseWorkgroupSize(supportedLimits.limits, descriptor.dimensions, descriptor.preferredInvocations);
+		m_maxWorkgroupsPerDimension = supportedLimits.limits.maxComputeWorkgroupsPerDimension;
+	}
+
+	// The size is spelled out in the attribute, as not all WGSL compilers
+	// accept constants there, and defined as constants for the code
+	std::string source = descriptor.source;
+	const char* names[3] = { "WORKGROUP_SIZE_X", "WORKGROUP_SIZE_Y", "WORKGROUP_SIZE_Z" };
+	for (size_t attribute = source.find("@workgroup_size"); attribute != std::string::npos; attribute = source.find("@workgroup_size", attribute + 1)) {
+		size_t close = source.find(')', attribute);
+		for (int d = 0; d < 3; ++d) {
+			for (size_t pos = source.find(names[d], attribute); pos < close; pos = source.find(names[d], attribute)) {
+				std::string value = std::to_string(m_workgroupSize[d]);
+				source.replace(pos, std::string(names[d]).size(), value);
+				close = source.find(')', attribute);
+			}
+		}
+	}
+	// Appended so that line numbers in compilation errors are unchanged
+	source += "\nconst WORKGROUP_SIZE_X: u32 = " + std::to_string(m_workgroupSize[0]) + "u;";
+	source += "\nconst WORKGROUP_SIZE_Y: u32 = " + std::to_string(m_workgroupSize[1]) + "u;";
+	source += "\nconst WORKGROUP_SIZE_Z: u32 = " + std::to_string(m_workgroupSize[2]) + "u;";
+	source += "\nfn dispatchIndex(id: vec3u, groupCount: vec3u) -> u32 { return id.x + id.y * groupCount.x * WORKGROUP_SIZE_X; }\n";
+
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = source.c_str();
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	shaderDesc.label = descriptor.label;
+	ShaderModule shaderModule = m_device.createShaderModule(shaderDesc);
+
+	m_bindingLayouts = reflectBindings(descriptor.source);
+	for (const std::vector<BindGroupLayoutEntry>& entries : m_bindingLayouts) {
+		BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+		bindGroupLayoutDesc.label = descriptor.label;
+		bindGroupLayoutDesc.entryCount = (uint32_t)entries.size();
+		bindGroupLayoutDesc.entries = entries.data();
+		m_bindGroupLayouts.push_back(m_device.createBindGroupLayout(bindGroupLayoutDesc));
+	}
+
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.label = descriptor.label;
+	pipelineLayoutDesc.bindGroupLayoutCount = (uint32_t)m_bindGroupLayouts.size();
+	pipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)m_bindGroupLayouts.data();
+	m_pipelineLayout = m_device.createPipelineLayout(pipelineLayoutDesc);
+
+	ComputePipelineDescriptor pipelineDesc{};
+	pipelineDesc.label = descriptor.label;
+	pipelineDesc.layout = m_pipelineLayout;
+	pipelineDesc.compute.module = shaderModule;
+	pipelineDesc.compute.entryPoint = descriptor.entryPoint;
+	pipelineDesc.compute.constantCount = 0;
+	pipelineDesc.compute.constants = nullptr;
+	m_pipeline = m_device.createComputePipeline(pipelineDesc);
+	shaderModule.release();
+}
+
+ComputeKernel::~ComputeKernel() {
+	m_pipeline.release();
+	m_pipelineLayout.release();
+	for (BindGroupLayout layout : m_bindGroupLayouts) {
+		layout.release();
+	}
+}
+
+BindGroup ComputeKernel::createBindGroup(uint32_t group, const std::vector<Binding>& bindings) const {
+	assert(group < m_bindGroupLayouts.size());
+	std::vector<BindGroupEntry> entries = bindGroupEntries(bindings);
+	BindGroupDescriptor bindGroupDesc{};
+	bindGroupDesc.layout = m_bindGroupLayouts[group];
+	bindGroupDesc.entryCount = (uint32_t)entries.size();
+	bindGroupDesc.entries = entries.data();
+	Device device = m_device;
+	return device.createBindGroup(bindGroupDesc);
+}
+
+BindGroup ComputeKernel::getBindGroup(BindGroupCache& cache, uint32_t group, const std::vector<Binding>& bindings) const {
+	assert(group < m_bindGroupLayouts.size());
+	std::vector<BindGroupEntry> entries = bindGroupEntries(bindings);
+	BindGroupDescriptor bindGroupDesc{};
+	bindGroupDesc.layout = m_bindGroupLayouts[group];
+	bindGroupDesc.entryCount = (uint32_t)entries.size();
+	bindGroupDesc.entries = entries.data();
+	return cache.getBindGroup(bindGroupDesc);
+}
+
+std::array<uint32_t, 3> ComputeKernel::workgroupCount(uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ) const {
+	std::array<uint32_t, 3> count = {
+		(sizeX + m_workgroupSize[0] - 1) / m_workgroupSize[0],
+		(sizeY + m_workgroupSize[1] - 1) / m_workgroupSize[1],
+		(sizeZ + m_workgroupSize[2] - 1) / m_workgroupSize[2],
+	};
+	// Too many workgroups for one dimension, fold them into a 2D grid
+	if (count[0] > m_maxWorkgroupsPerDimension && count[1] == 1 && count[2] == 1) {
+		uint32_t total = count[0];
+		count[0] = m_maxWorkgroupsPerDimension;
+		count[1] = (total + count[0] - 1) / count[0];
+	}
+	assert(count[0] <= m_maxWorkgroupsPerDimension && count[1] <= m_maxWorkgroupsPerDimension && count[2] <= m_maxWorkgroupsPerDimension);
+	return count;
+}
+
+void ComputeKernel::dispatch(ComputePassEncoder computePass, uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ) const {
+	std::array<uint32_t, 3> count = workgroupCount(sizeX, sizeY, sizeZ);
+	if (count[0] == 0 || count[1] == 0 || count[2] == 0) return;
+	computePass.setPipeline(m_pipeline);
+	computePass.dispatchWorkgroups(count[0], count[1], count[2]);
+}
+
+void ComputeKernel::dispatch(ComputePassEncoder computePass, BindGroup bindGroup, uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ) const {
+	computePass.setBindGroup(0, bindGroup, 0, nullptr);
+	dispatch(computePass, sizeX, sizeY, sizeZ);
+}
+
+void ComputeKernel::dispatchIndirect(ComputePassEncoder computePass, BindGroup bindGroup, Buffer indirectBuffer, uint64_t offset) const {
+	computePass.setBindGroup(0, bindGroup, 0, nullptr);
+	computePass.setPipeline(m_pipeline);
+	computePass.dispatchWorkgroupsIndirect(indirectBuffer, offset);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BindGroupCache;
+
+/**
+ * A compute pipeline built from a WGSL kernel, along with what it takes to
+ * bind its resources and dispatch it.
+ *
+ * Bind group layouts are derived from the resource declarations of the
+ * source, so that kernels do not have to describe their bindings twice:
+ *   var<uniform>                uniform buffer
+ *   var<storage> / <storage, read>  read-only storage buffer
+ *   var<storage, read_write>    storage buffer
+ *   texture_*<T>                sampled texture, filterable only when the
+ *                               module also declares a filtering sampler
+ *   texture_depth_*             depth texture
+ *   texture_storage_*<F, write> write-only storage texture
+ *   sampler / sampler_comparison
+ * All the resources of the module are part of the layout, whichever entry
+ * point uses them.
+ *
+ * The workgroup size is chosen against the limits of the device, from the
+ * number of invocations the kernel would like per workgroup. The kernel
+ * reads it from the WORKGROUP_SIZE_X, WORKGROUP_SIZE_Y and WORKGROUP_SIZE_Z
+ * constants, which it also uses in its attribute:
+ *   @compute @workgroup_size(WORKGROUP_SIZE_X, WORKGROUP_SIZE_Y, WORKGROUP_SIZE_Z)
+ *
+ * dispatch() rounds the number of invocations up to whole workgroups, so
+ * the kernel must return early from the invocations past the end of its
+ * data. One dimensional dispatches too large for a single dimension are
+ * folded into two, and the kernel then gets its index from
+ * dispatchIndex(global_invocation_id, num_workgroups), which is defined
+ * along with the constants.
+ */
+class ComputeKernel {
+public:
+	struct Descriptor {
+		const char* label = "Compute kernel";
+		const char* source = nullptr;
+		const char* entryPoint = "cs_main";
+		// 1 for kernels over arrays, 2 over images and 3 over volumes
+		uint32_t dimensions = 1;
+		// Invocations per workgroup aimed at, lowered to fit the limits
+		uint32_t preferredInvocations = 64;
+	};
+
+	// A resource bound to one of the bindings of the kernel
+	struct Binding {
+		Binding(uint32_t binding, wgpu::Buffer buffer, uint64_t offset = 0, uint64_t size = WGPU_WHOLE_SIZE);
+		Binding(uint32_t binding, wgpu::TextureView textureView);
+		Binding(uint32_t binding, wgpu::Sampler sampler);
+
+		uint32_t binding;
+		wgpu::Buffer buffer = nullptr;
+		uint64_t offset = 0;
+		uint64_t size = WGPU_WHOLE_SIZE;
+		wgpu::TextureView textureView = nullptr;
+		wgpu::Sampler sampler = nullptr;
+	};
+
+	/**
+	 * Raise the device limits needed to dispatch `invocationCount`
+	 * invocations of one dimensional kernels with workgroups of the given
+	 * size, or of kernels of more dimensions with `invocationCount` 0.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t sizeX, uint32_t sizeY, uint32_t sizeZ, uint64_t invocationCount = 0);
+
+	/**
+	 * Workgroup size a kernel of the given dimensions gets with `limits`.
+	 */
+	static std::array<uint32_t, 3> chooseWorkgroupSize(const WGPULimits& limits, uint32_t dimensions, uint32_t preferredInvocations);
+
+	/**
+	 * Bind group layout entries of the resources declared by `source`, for
+	 * each group up to the last one used.
+	 */
+	static std::vector<std::vector<wgpu::BindGroupLayoutEntry>> reflectBindings(const std::string& source);
+
+	ComputeKernel(wgpu::Device device, const Descriptor& descriptor);
+	~ComputeKernel();
+
+	ComputeKernel(const ComputeKernel&) = delete;
+	ComputeKernel& operator=(const ComputeKernel&) = delete;
+
+	wgpu::ComputePipeline pipeline() const { return m_pipeline; }
+	uint32_t bindGroupCount() const { return static_cast<uint32_t>(m_bindGroupLayouts.size()); }
+	wgpu::BindGroupLayout bindGroupLayout(uint32_t group) const { return m_bindGroupLayouts[group]; }
+	const std::array<uint32_t, 3>& workgroupSize() const { return m_workgroupSize; }
+
+	/**
+	 * Create a bind group of the layout of `group`. The caller owns it.
+	 */
+	wgpu::BindGroup createBindGroup(uint32_t group, const std::vector<Binding>& bindings) const;
+
+	/**
+	 * Same, but returned from `cache`, which owns it.
+	 */
+	wgpu::BindGroup getBindGroup(BindGroupCache& cache, uint32_t group, const std::vector<Binding>& bindings) const;
+
+	/**
+	 * Workgroups to dispatch for a grid of invocations of this size.
+	 */
+	std::array<uint32_t, 3> workgroupCount(uint32_t sizeX, uint32_t sizeY = 1, uint32_t sizeZ = 1) const;
+
+	/**
+	 * Set the pipeline and dispatch a grid of invocations of this size. The
+	 * bind groups must be set on the pass, before or after.
+	 */
+	void dispatch(wgpu::ComputePassEncoder computePass, uint32_t sizeX, uint32_t sizeY = 1, uint32_t sizeZ = 1) const;
+
+	/**
+	 * Same, for kernels whose resources are all in group 0.
+	 */
+	void dispatch(wgpu::ComputePassEncoder computePass, wgpu::BindGroup bindGroup, uint32_t sizeX, uint32_t sizeY = 1, uint32_t sizeZ = 1) const;
+
+	/**
+	 * Set the pipeline and the bind group of group 0, and dispatch the
+	 * number of workgroups (not invocations) written by an earlier pass at
+	 * `offset` in `indirectBuffer`.
+	 */
+	void dispatchIndirect(wgpu::ComputePassEncoder computePass, wgpu::BindGroup bindGroup, wgpu::Buffer indirectBuffer, uint64_t offset = 0) const;
+
+private:
+	wgpu::Device m_device;
+	std::array<uint32_t, 3> m_workgroupSize = { 1, 1, 1 };
+	uint32_t m_maxWorkgroupsPerDimension;
+	std::vector<std::vector<wgpu::BindGroupLayoutEntry>> m_bindingLayouts;
+	std::vector<wgpu::BindGroupLayout> m_bindGroupLayouts;
+	wgpu::PipelineLayout m_pipelineLayout = nullptr;
+	wgpu::ComputePipeline m_pipeline = nullptr;
+};
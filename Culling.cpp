@@ -0,0 +1,373 @@
+#include "Culling.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define CULLING_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define CULLING_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define CULLING_NEON 1
+#endif
+
+// Below this many objects per thread, culling is faster than waking up workers
+constexpr uint32_t MIN_OBJECTS_PER_THREAD = 16384;
+
+void BoundsSoA::resize(uint32_t count) {
+	centerX.resize(count);
+	centerY.resize(count);
+	centerZ.resize(count);
+	radius.resize(count);
+	extentX.resize(count);
+	extentY.resize(count);
+	extentZ.resize(count);
+}
+
+void BoundsSoA::set(uint32_t index, float cx, float cy, float cz, float ex, float ey, float ez) {
+	centerX[index] = cx;
+	centerY[index] = cy;
+	centerZ[index] = cz;
+	extentX[index] = ex;
+	extentY[index] = ey;
+	extentZ[index] = ez;
+	radius[index] = std::sqrt(ex * ex + ey * ey + ez * ez);
+}
+
+Frustum Frustum::fromViewProjection(const float m[16]) {
+	// Row r of a column-major matrix
+	auto row = [&](int r, float out[4]) {
+		for (int c = 0; c < 4; ++c) out[c] = m[4 * c + r];
+	};
+	float r0[4], r1[4], r2[4], r3[4];
+	row(0, r0);
+	row(1, r1);
+	row(2, r2);
+	row(3, r3);
+
+	Frustum f;
+	for (int c = 0; c < 4; ++c) {
+		f.planes[0][c] = r3[c] + r0[c]; // left
+		f.planes[1][c] = r3[c] - r0[c]; // right
+		f.planes[2][c] = r3[c] + r1[c]; // bottom
+		f.planes[3][c] = r3[c] - r1[c]; // top
+		f.planes[4][c] = r2[c];         // near (0 <= z in WebGPU, not -w <= z)
+		f.planes[5][c] = r3[c] - r2[c]; // far
+	}
+
+	// Normalize planes so that the plane equation gives a signed distance
+	// that can be compared to the sphere radius.
+	for (auto& p : f.planes) {
+		float len = std::sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]);
+		if (len > 0.0f) {
+			for (float& x : p) x /= len;
+		}
+	}
+	return f;
+}
+
+const char* cullingSimdName() {
+#if defined(CULLING_AVX2)
+	return "AVX2";
+#elif defined(CULLING_SSE2)
+	return "SSE2";
+#elif defined(CULLING_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
+
+static uint32_t cullSpheresScalar(
+	const Frustum& frustum,
+	const BoundsSoA& bounds,
+	uint32_t begin,
+	uint32_t end,
+	uint32_t* visible
+) {
+	uint32_t count = 0;
+	for (uint32_t i = begin; i < end; ++i) {
+		float x = bounds.centerX[i];
+		float y = bounds.centerY[i];
+		float z = bounds.centerZ[i];
+		float r = bounds.radius[i];
+		bool inside = true;
+		for (const auto& p : frustum.planes) {
+			if (p[0] * x + p[1] * y + p[2] * z + p[3] < -r) {
+				inside = false;
+				break;
+			}
+		}
+		if (inside) {
+			visible[count++] = i;
+		}
+	}
+	return count;
+}
+
+// Append the indices of the lanes set in `mask` without branching. This may
+// write one index past the returned count, which is fine because `visible`
+// has room for all the tested objects.
+static inline uint32_t appendLanes(uint32_t* visible, uint32_t count, uint32_t first, int mask, int laneCount) {
+	for (int k = 0; k < laneCount; ++k) {
+		visible[count] = first + k;
+		count += (mask >> k) & 1;
+	}
+	return count;
+}
+
+#if defined(CULLING_AVX2)
+static uint32_t cullSpheresSimd(const Frustum& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) {
+	__m256 planes[6][4];
+	for (int p = 0; p < 6; ++p) {
+		for (int c = 0; c < 4; ++c) planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+	}
+	const __m256 zero = _mm256_setzero_ps();
+
+	uint32_t count = 0;
+	uint32_t i = begin;
+	for (; i + 8 <= end; i += 8) {
+		__m256 x = _mm256_loadu_ps(&bounds.centerX[i]);
+		__m256 y = _mm256_loadu_ps(&bounds.centerY[i]);
+		__m256 z = _mm256_loadu_ps(&bounds.centerZ[i]);
+		__m256 negR = _mm256_sub_ps(zero, _mm256_loadu_ps(&bounds.radius[i]));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			__m256 d = _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(planes[p][0], x), _mm256_mul_ps(planes[p][1], y)),
+				_mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3])
+			);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, negR, _CMP_GE_OQ));
+		}
+		count = appendLanes(visible, count, i, _mm256_movemask_ps(inside), 8);
+	}
+	return count + cullSpheresScalar(frustum, bounds, i, end, visible + count);
+}
+#elif defined(CULLING_SSE2)
+static uint32_t cullSpheresSimd(const Frustum& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) {
+	__m128 planes[6][4];
+	for (int p = 0; p < 6; ++p) {
+		for (int c = 0; c < 4; ++c) planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+	}
+	const __m128 zero = _mm_setzero_ps();
+
+	uint32_t count = 0;
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		__m128 x = _mm_loadu_ps(&bounds.centerX[i]);
+		__m128 y = _mm_loadu_ps(&bounds.centerY[i]);
+		__m128 z = _mm_loadu_ps(&bounds.centerZ[i]);
+		__m128 negR = _mm_sub_ps(zero, _mm_loadu_ps(&bounds.radius[i]));
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; ++p) {
+			__m128 d = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(planes[p][0], x), _mm_mul_ps(planes[p][1], y)),
+				_mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3])
+			);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+		}
+		count = appendLanes(visible, count, i, _mm_movemask_ps(inside), 4);
+	}
+	return count + cullSpheresScalar(frustum, bounds, i, end, visible + count);
+}
+#elif defined(CULLING_NEON)
+static uint32_t cullSpheresSimd(const Frustum& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) {
+	float32x4_t planes[6][4];
+	for (int p = 0; p < 6; ++p) {
+		for (int c = 0; c < 4; ++c) planes[p][c] = vdupq_n_f32(frustum.planes[p][c]);
+	}
+	// Weight of each lane when turning the comparison result into a bit mask
+	const uint32_t laneBitsData[4] = { 1, 2, 4, 8 };
+	const uint32x4_t laneBits = vld1q_u32(laneBitsData);
+
+	uint32_t count = 0;
+	uint32_t i = begin;
+	for (; i + 4 <= end; i += 4) {
+		float32x4_t x = vld1q_f32(&bounds.centerX[i]);
+		float32x4_t y = vld1q_f32(&bounds.centerY[i]);
+		float32x4_t z = vld1q_f32(&bounds.centerZ[i]);
+		float32x4_t negR = vnegq_f32(vld1q_f32(&bounds.radius[i]));
+		uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+		for (int p = 0; p < 6; ++p) {
+			float32x4_t d = vmlaq_f32(planes[p][3], planes[p][0], x);
+			d = vmlaq_f32(d, planes[p][1], y);
+			d = vmlaq_f32(d, planes[p][2], z);
+			inside = vandq_u32(inside, vcgeq_f32(d, negR));
+		}
+		uint32x4_t bits = vandq_u32(inside, laneBits);
+		uint32x2_t sum = vadd_u32(vget_low_u32(bits), vget_high_u32(bits));
+		int mask = static_cast<int>(vget_lane_u32(vpadd_u32(sum, sum), 0));
+		count = appendLanes(visible, count, i, mask, 4);
+	}
+	return count + cullSpheresScalar(frustum, bounds, i, end, visible + count);
+}
+#else
+static uint32_t cullSpheresSimd(const Frustum& frustum, const BoundsSoA& bounds, uint32_t begin, uint32_t end, uint32_t* visible) {
+	return cullSpheresScalar(frustum, bounds, begin, end, visible);
+}
+#endif
+
+uint32_t cullSpheres(
+	const Frustum& frustum,
+	const BoundsSoA& bounds,
+	uint32_t begin,
+	uint32_t end,
+	uint32_t* visible,
+	CullingImpl impl
+) {
+	switch (impl) {
+	case CullingImpl::Scalar:
+		return cullSpheresScalar(frustum, bounds, begin, end, visible);
+	case CullingImpl::Simd:
+	default:
+		return cullSpheresSimd(frustum, bounds, begin, end, visible);
+	}
+}
+
+FrustumCuller::FrustumCuller(ThreadPool* pool, CullingImpl impl)
+	: m_pool(pool)
+	, m_impl(impl)
+{}
+
+const std::vector<uint32_t>& FrustumCuller::cull(const Frustum& frustum, const BoundsSoA& bounds) {
+	uint32_t objectCount = bounds.size();
+	// Each worker writes the visible indices of its range at the beginning
+	// of this very range, so there is no contention nor extra allocation.
+	m_visible.resize(objectCount);
+
+	if (m_pool == nullptr) {
+		m_visible.resize(cullSpheres(frustum, bounds, 0, objectCount, m_visible.data(), m_impl));
+		return m_visible;
+	}
+
+	m_ranges.assign(m_pool->threadCount(), WorkerRange{ 0, 0 });
+	m_pool->parallelFor(objectCount, MIN_OBJECTS_PER_THREAD, [&](uint32_t begin, uint32_t end, uint32_t workerIndex) {
+		m_ranges[workerIndex].begin = begin;
+		m_ranges[workerIndex].count = cullSpheres(frustum, bounds, begin, end, m_visible.data() + begin, m_impl);
+	});
+
+	// Ranges are ordered by worker index, so compacting them in this order
+	// keeps the visible list sorted.
+	uint32_t visibleCount = 0;
+	for (const WorkerRange& range : m_ranges) {
+		std::copy_n(m_visible.begin() + range.begin, range.count, m_visible.begin() + visibleCount);
+		visibleCount += range.count;
+	}
+	m_visible.resize(visibleCount);
+	return m_visible;
+}
+
+void HiZBuffer::build(const float* depth, uint32_t width, uint32_t height) {
+	m_levels.clear();
+	if (width == 0 || height == 0) return;
+
+	m_levels.push_back(Level{ width, height, std::vector<float>(depth, depth + width * height) });
+	while (width > 1 || height > 1) {
+		const Level& src = m_levels.back();
+		// Rounding up guarantees that the last row/column of odd sizes is
+		// still covered by the coarser level.
+		Level dst{ (width + 1) / 2, (height + 1) / 2, {} };
+		dst.depth.resize(dst.width * dst.height);
+		for (uint32_t y = 0; y < dst.height; ++y) {
+			uint32_t y0 = 2 * y;
+			uint32_t y1 = std::min(2 * y + 1, src.height - 1);
+			for (uint32_t x = 0; x < dst.width; ++x) {
+				uint32_t x0 = 2 * x;
+				uint32_t x1 = std::min(2 * x + 1, src.width - 1);
+				dst.depth[y * dst.width + x] = std::max(
+					std::max(src.depth[y0 * src.width + x0], src.depth[y0 * src.width + x1]),
+					std::max(src.depth[y1 * src.width + x0], src.depth[y1 * src.width + x1])
+				);
+			}
+		}
+		width = dst.width;
+		height = dst.height;
+		m_levels.push_back(std::move(dst));
+	}
+}
+
+bool HiZBuffer::isOccluded(float minX, float minY, float maxX, float maxY, float nearestDepth) const {
+	if (m_levels.empty()) return false;
+	const Level& base = m_levels[0];
+
+	// NDC to pixels of level 0, where y goes down
+	auto clamp01 = [](float v) { return std::min(std::max(v, 0.0f), 1.0f); };
+	float px0 = clamp01(minX * 0.5f + 0.5f) * base.width;
+	float px1 = clamp01(maxX * 0.5f + 0.5f) * base.width;
+	float py0 = clamp01(0.5f - maxY * 0.5f) * base.height;
+	float py1 = clamp01(0.5f - minY * 0.5f) * base.height;
+
+	// Pick the level in which the rectangle spans at most 2 texels, so that
+	// it overlaps at most 3x3 texels once misaligned.
+	float size = std::max(px1 - px0, py1 - py0);
+	uint32_t level = 0;
+	while (level + 1 < levelCount() && static_cast<float>(2u << level) < size) {
+		++level;
+	}
+	const Level& l = m_levels[level];
+
+	float scale = 1.0f / static_cast<float>(1u << level);
+	uint32_t x0 = std::min(static_cast<uint32_t>(px0 * scale), l.width - 1);
+	uint32_t x1 = std::min(static_cast<uint32_t>(px1 * scale), l.width - 1);
+	uint32_t y0 = std::min(static_cast<uint32_t>(py0 * scale), l.height - 1);
+	uint32_t y1 = std::min(static_cast<uint32_t>(py1 * scale), l.height - 1);
+
+	float farthest = 0.0f;
+	for (uint32_t y = y0; y <= y1; ++y) {
+		for (uint32_t x = x0; x <= x1; ++x) {
+			farthest = std::max(farthest, l.depth[y * l.width + x]);
+		}
+	}
+	return nearestDepth > farthest;
+}
+
+void cullOcclusion(
+	const HiZBuffer& hiz,
+	const float m[16],
+	const BoundsSoA& bounds,
+	std::vector<uint32_t>& visible
+) {
+	if (hiz.empty()) return;
+
+	uint32_t kept = 0;
+	for (uint32_t index : visible) {
+		float cx = bounds.centerX[index];
+		float cy = bounds.centerY[index];
+		float cz = bounds.centerZ[index];
+		float ex = bounds.extentX[index];
+		float ey = bounds.extentY[index];
+		float ez = bounds.extentZ[index];
+
+		// Project the 8 corners of the box and compute their screen bounds
+		bool crossesCameraPlane = false;
+		float minX = 1.0f, minY = 1.0f, maxX = -1.0f, maxY = -1.0f, minZ = 1.0f;
+		for (int corner = 0; corner < 8; ++corner) {
+			float x = cx + (corner & 1 ? ex : -ex);
+			float y = cy + (corner & 2 ? ey : -ey);
+			float z = cz + (corner & 4 ? ez : -ez);
+			float clipX = m[0] * x + m[4] * y + m[8] * z + m[12];
+			float clipY = m[1] * x + m[5] * y + m[9] * z + m[13];
+			float clipZ = m[2] * x + m[6] * y + m[10] * z + m[14];
+			float clipW = m[3] * x + m[7] * y + m[11] * z + m[15];
+			if (clipW <= 1e-6f) {
+				crossesCameraPlane = true;
+				break;
+			}
+			float invW = 1.0f / clipW;
+			minX = std::min(minX, clipX * invW);
+			maxX = std::max(maxX, clipX * invW);
+			minY = std::min(minY, clipY * invW);
+			maxY = std::max(maxY, clipY * invW);
+			minZ = std::min(minZ, clipZ * invW);
+		}
+
+		if (crossesCameraPlane || !hiz.isOccluded(minX, minY, maxX, maxY, std::max(minZ, 0.0f))) {
+			visible[kept++] = index;
+		}
+	}
+	visible.resize(kept);
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Bounding volumes of the objects of a scene, stored as a structure of
+ * arrays so that the SIMD tests load 4 (SSE2, NEON) or 8 (AVX2) consecutive
+ * objects with a single instruction.
+ * Each object is bounded by an axis-aligned box and by the sphere that
+ * encloses this box. The frustum test uses the sphere, the occlusion test
+ * uses the box.
+ */
+struct BoundsSoA {
+	std::vector<float> centerX;
+	std::vector<float> centerY;
+	std::vector<float> centerZ;
+	std::vector<float> radius;
+	// Half sizes of the box along each axis
+	std::vector<float> extentX;
+	std::vector<float> extentY;
+	std::vector<float> extentZ;
+
+	uint32_t size() const { return static_cast<uint32_t>(centerX.size()); }
+	void resize(uint32_t count);
+	void set(uint32_t index, float cx, float cy, float cz, float ex, float ey, float ez);
+};
+
+/**
+ * The 6 planes of a view frustum, as (a, b, c, d) such that a point p is on
+ * the inner side of a plane when a * p.x + b * p.y + c * p.z + d >= 0.
+ */
+struct Frustum {
+	float planes[6][4];
+
+	/**
+	 * Extract the planes from a column-major view-projection matrix, using
+	 * the WebGPU clip space convention (depth in [0, 1]).
+	 */
+	static Frustum fromViewProjection(const float viewProj[16]);
+};
+
+enum class CullingImpl {
+	Scalar,
+	// Uses AVX2, SSE2 or NEON depending on what the compiler targets, and
+	// falls back to Scalar if none of them is available.
+	Simd,
+};
+
+/**
+ * Name of the instruction set used by CullingImpl::Simd.
+ */
+const char* cullingSimdName();
+
+/**
+ * Test the bounding spheres of objects [begin, end) against the frustum and
+ * write the indices of the ones that are (at least partially) inside into
+ * `visible`, in increasing order. `visible` must have room for end - begin
+ * indices. Returns the number of visible objects.
+ */
+uint32_t cullSpheres(
+	const Frustum& frustum,
+	const BoundsSoA& bounds,
+	uint32_t begin,
+	uint32_t end,
+	uint32_t* visible,
+	CullingImpl impl = CullingImpl::Simd
+);
+
+/**
+ * Frustum culling of a whole scene, optionally split across a thread pool.
+ * The resulting visible list is compact and sorted, so that it can directly
+ * be used to gather the per-instance data of the objects to draw.
+ */
+class FrustumCuller {
+public:
+	explicit FrustumCuller(ThreadPool* pool = nullptr, CullingImpl impl = CullingImpl::Simd);
+
+	void setThreadPool(ThreadPool* pool) { m_pool = pool; }
+	void setImplementation(CullingImpl impl) { m_impl = impl; }
+
+	/**
+	 * Returns the indices of the visible objects. The reference is valid
+	 * until the next call to cull().
+	 */
+	const std::vector<uint32_t>& cull(const Frustum& frustum, const BoundsSoA& bounds);
+
+private:
+	struct WorkerRange {
+		uint32_t begin;
+		uint32_t count;
+	};
+
+	ThreadPool* m_pool;
+	CullingImpl m_impl;
+	std::vector<uint32_t> m_visible;
+	std::vector<WorkerRange> m_ranges;
+};
+
+/**
+ * A hierarchical depth buffer (Hi-Z), i.e. a mip chain of a depth image in
+ * which each texel stores the farthest depth of the texels it covers in the
+ * level below. Testing a screen rectangle then costs at most a 3x3 texel
+ * lookup in the level whose texels are about the size of the rectangle.
+ */
+class HiZBuffer {
+public:
+	/**
+	 * Build the mip chain from a depth image in [0, 1] (0 being the near
+	 * plane, as in WebGPU), stored row by row starting from the top of the
+	 * screen. The depth typically comes from occluders rendered in the
+	 * previous frame or rasterized on the CPU.
+	 */
+	void build(const float* depth, uint32_t width, uint32_t height);
+
+	bool empty() const { return m_levels.empty(); }
+	uint32_t levelCount() const { return static_cast<uint32_t>(m_levels.size()); }
+
+	/**
+	 * Returns true if the rectangle given in normalized device coordinates
+	 * is entirely behind the stored depth, given the depth of its nearest
+	 * point.
+	 */
+	bool isOccluded(float minX, float minY, float maxX, float maxY, float nearestDepth) const;
+
+private:
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> depth;
+	};
+
+	std::vector<Level> m_levels;
+};
+
+/**
+ * Remove from a visible list (typically the output of FrustumCuller) the
+ * objects whose bounding box is hidden according to the Hi-Z buffer.
+ * Objects that cross the camera plane are always kept.
+ */
+void cullOcclusion(
+	const HiZBuffer& hiz,
+	const float viewProj[16],
+	const BoundsSoA& bounds,
+	std::vector<uint32_t>& visible
+);
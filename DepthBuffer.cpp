@@ -0,0 +1,129 @@
+#include "DepthBuffer.h"
+
+#include <cassert>
+
+using namespace wgpu;
+
+DepthBuffer::DepthBuffer(Device device, uint32_t sampleCount, bool prepass)
+	: m_device(device)
+	, m_format(TextureFormat::Depth24Plus)
+	, m_sampleCount(sampleCount)
+	, m_prepass(prepass)
+{}
+
+DepthBuffer::~DepthBuffer() {
+	if (m_texture) {
+		m_view.release();
+		m_texture.destroy();
+		m_texture.release();
+	}
+}
+
+void DepthBuffer::resize(uint32_t width, uint32_t height) {
+	if (width == m_width && height == m_height) return;
+	m_width = width;
+	m_height = height;
+
+	if (m_texture) {
+		m_view.release();
+		m_texture.destroy();
+		m_texture.release();
+	}
+	TextureDescriptor textureDesc;
+	textureDesc.label = "Depth buffer";
+	textureDesc.usage = TextureUsage::RenderAttachment;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { width, height, 1 };
+	textureDesc.format = m_format;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = m_sampleCount;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	m_texture = m_device.createTexture(textureDesc);
+
+	TextureViewDescriptor viewDesc;
+	viewDesc.format = m_format;
+	viewDesc.dimension = TextureViewDimension::_2D;
+	viewDesc.baseMipLevel = 0;
+	viewDesc.mipLevelCount = 1;
+	viewDesc.baseArrayLayer = 0;
+	viewDesc.arrayLayerCount = 1;
+	viewDesc.aspect = TextureAspect::DepthOnly;
+	m_view = m_texture.createView(viewDesc);
+}
+
+DepthStencilState DepthBuffer::prepassDepthState() const {
+	DepthStencilState depthState = Default;
+	depthState.format = m_format;
+	depthState.depthCompare = CompareFunction::Less;
+	depthState.depthWriteEnabled = true;
+	// The format has no stencil
+	depthState.stencilReadMask = 0;
+	depthState.stencilWriteMask = 0;
+	return depthState;
+}
+
+DepthStencilState DepthBuffer::mainPassDepthState() const {
+	DepthStencilState depthState = Default;
+	depthState.format = m_format;
+	if (m_prepass) {
+		// Only the nearest fragment of each pixel, which the prepass
+		// already wrote, passes
+		depthState.depthCompare = CompareFunction::Equal;
+		depthState.depthWriteEnabled = false;
+	} else {
+		depthState.depthCompare = CompareFunction::LessEqual;
+		depthState.depthWriteEnabled = true;
+	}
+	depthState.stencilReadMask = 0;
+	depthState.stencilWriteMask = 0;
+	return depthState;
+}
+
+RenderPassDepthStencilAttachment DepthBuffer::prepassAttachment() const {
+	assert(m_prepass);
+	assert(m_texture && "resize() must be called before the first pass");
+	return attachment(LoadOp::Clear, StoreOp::Store);
+}
+
+RenderPassEncoder DepthBuffer::beginPrepass(CommandEncoder encoder) const {
+	RenderPassDepthStencilAttachment depthAttachment = prepassAttachment();
+	RenderPassDescriptor renderPassDesc{};
+	renderPassDesc.label = "Depth prepass";
+	renderPassDesc.colorAttachmentCount = 0;
+	renderPassDesc.colorAttachments = nullptr;
+	renderPassDesc.depthStencilAttachment = &depthAttachment;
+	renderPassDesc.timestampWriteCount = 0;
+	renderPassDesc.timestampWrites = nullptr;
+	return encoder.beginRenderPass(renderPassDesc);
+}
+
+RenderPassDepthStencilAttachment DepthBuffer::mainPassAttachment() const {
+	assert(m_texture && "resize() must be called before the first pass");
+	return attachment(m_prepass ? LoadOp::Load : LoadOp::Clear, StoreOp::Discard);
+}
+
+uint64_t DepthBuffer::memoryBytes() const {
+	// Depth24Plus takes 4 bytes on all current GPUs
+	return uint64_t(m_width) * m_height * m_sampleCount * 4;
+}
+
+RenderPassDepthStencilAttachment DepthBuffer::attachment(LoadOp loadOp, StoreOp storeOp) const {
+	RenderPassDepthStencilAttachment depthAttachment;
+	depthAttachment.view = m_view;
+	depthAttachment.depthClearValue = 1.0f;
+	depthAttachment.depthLoadOp = loadOp;
+	depthAttachment.depthStoreOp = storeOp;
+	depthAttachment.depthReadOnly = false;
+	// The format has no stencil, but wgpu-native still wants operations
+	depthAttachment.stencilClearValue = 0;
+#ifdef WEBGPU_BACKEND_WGPU
+	depthAttachment.stencilLoadOp = LoadOp::Clear;
+	depthAttachment.stencilStoreOp = StoreOp::Store;
+#else
+	depthAttachment.stencilLoadOp = LoadOp::Undefined;
+	depthAttachment.stencilStoreOp = StoreOp::Undefined;
+#endif
+	depthAttachment.stencilReadOnly = true;
+	return depthAttachment;
+}
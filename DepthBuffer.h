@@ -0,0 +1,84 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+
+/**
+ * Depth buffer of the main pass, with an optional depth prepass.
+ *
+ * Without a prepass, the main pass tests and writes depth as it draws, so
+ * opaque objects should be drawn front to back for early depth testing to
+ * skip the fragments hidden by the ones already drawn.
+ *
+ * With a prepass, a first pass renders the depth of the opaque objects
+ * alone, from position-only vertex streams and without any fragment
+ * shader. The main pass then only shades the fragments whose depth equals
+ * the one left by the prepass, without writing depth: every pixel gets
+ * shaded once whatever the draw order, at the cost of transforming the
+ * geometry twice.
+ *
+ * The depth is not needed once the main pass ends, so it is not stored.
+ */
+class DepthBuffer {
+public:
+	DepthBuffer(wgpu::Device device, uint32_t sampleCount, bool prepass);
+	~DepthBuffer();
+
+	DepthBuffer(const DepthBuffer&) = delete;
+	DepthBuffer& operator=(const DepthBuffer&) = delete;
+
+	/**
+	 * Match the size of the color target, recreating the depth texture if
+	 * it changed.
+	 */
+	void resize(uint32_t width, uint32_t height);
+
+	bool hasPrepass() const { return m_prepass; }
+	wgpu::TextureFormat format() const { return m_format; }
+	uint32_t sampleCount() const { return m_sampleCount; }
+
+	/**
+	 * Depth state of the pipelines of the prepass, which write depth.
+	 */
+	wgpu::DepthStencilState prepassDepthState() const;
+
+	/**
+	 * Depth state of the pipelines that draw opaque objects in the main
+	 * pass. Objects drawn at the same depth keep the order in which they
+	 * are drawn, as without a depth buffer.
+	 */
+	wgpu::DepthStencilState mainPassDepthState() const;
+
+	/**
+	 * Depth attachment of the prepass, which clears the depth buffer and
+	 * stores it for the main pass.
+	 */
+	wgpu::RenderPassDepthStencilAttachment prepassAttachment() const;
+
+	/**
+	 * Begin the prepass, whose only attachment is the depth buffer.
+	 */
+	wgpu::RenderPassEncoder beginPrepass(wgpu::CommandEncoder encoder) const;
+
+	/**
+	 * Depth attachment of the main pass, which clears the depth buffer
+	 * unless the prepass filled it.
+	 */
+	wgpu::RenderPassDepthStencilAttachment mainPassAttachment() const;
+
+	uint64_t memoryBytes() const;
+
+private:
+	wgpu::RenderPassDepthStencilAttachment attachment(wgpu::LoadOp loadOp, wgpu::StoreOp storeOp) const;
+
+private:
+	wgpu::Device m_device;
+	wgpu::TextureFormat m_format;
+	uint32_t m_sampleCount;
+	bool m_prepass;
+	uint32_t m_width = 0;
+	uint32_t m_height = 0;
+	wgpu::Texture m_texture = nullptr;
+	wgpu::TextureView m_view = nullptr;
+};
@@ -0,0 +1,135 @@
+#include "DrawConstants.h"
+#include "BindGroupCache.h"
+#include "UniformAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+using namespace wgpu;
+
+// Uniform structs are padded to a multiple of 16 bytes in WGSL
+static uint32_t uniformBindingSize(uint32_t size) {
+	return (size + 15) & ~15u;
+}
+
+bool DrawConstants::pushConstantsSupported([[maybe_unused]] Adapter adapter) {
+#ifdef WEBGPU_BACKEND_WGPU
+	return adapter.hasFeature((WGPUFeatureName)NativeFeature::PushConstants);
+#else
+	return false;
+#endif
+}
+
+std::vector<FeatureName> DrawConstants::requiredFeatures([[maybe_unused]] bool usePushConstants) {
+	std::vector<FeatureName> features;
+#ifdef WEBGPU_BACKEND_WGPU
+	if (usePushConstants) {
+		features.push_back((WGPUFeatureName)NativeFeature::PushConstants);
+	}
+#endif
+	return features;
+}
+
+void DrawConstants::requireLimits(
+	RequiredLimits& requiredLimits,
+	[[maybe_unused]] LimitsExtras& extras,
+	bool usePushConstants,
+	uint32_t size,
+	uint32_t group
+) {
+	if (usePushConstants) {
+#ifdef WEBGPU_BACKEND_WGPU
+		extras = Default;
+		extras.maxPushConstantSize = size;
+		requiredLimits.nextInChain = &extras.chain;
+#endif
+		return;
+	}
+	WGPULimits& limits = requiredLimits.limits;
+	limits.maxBindGroups = std::max(limits.maxBindGroups, group + 1);
+	limits.maxUniformBuffersPerShaderStage = std::max(limits.maxUniformBuffersPerShaderStage, 1u);
+	limits.maxDynamicUniformBuffersPerPipelineLayout = std::max(limits.maxDynamicUniformBuffersPerPipelineLayout, 1u);
+	limits.maxUniformBufferBindingSize = std::max<uint64_t>(limits.maxUniformBufferBindingSize, uniformBindingSize(size));
+}
+
+DrawConstants::DrawConstants(
+	Device device,
+	bool usePushConstants,
+	uint32_t size,
+	WGPUShaderStageFlags visibility,
+	uint32_t group,
+	UniformAllocator& uniforms,
+	BindGroupCache& bindGroupCache
+)
+	: m_device(device)
+	, m_usePushConstants(usePushConstants)
+	, m_size(size)
+	, m_visibility(visibility)
+	, m_group(group)
+	, m_uniforms(uniforms)
+{
+	assert(size % 4 == 0);
+	if (m_usePushConstants) return;
+
+	BindGroupLayoutEntry layoutEntry = UniformAllocator::layoutEntry(0, visibility, uniformBindingSize(size));
+	BindGroupLayoutDescriptor layoutDesc{};
+	layoutDesc.entryCount = 1;
+	layoutDesc.entries = &layoutEntry;
+	m_bindGroupLayout = bindGroupCache.getLayout(layoutDesc);
+
+	BindGroupEntry entry = uniforms.bindGroupEntry(0, uniformBindingSize(size));
+	BindGroupDescriptor bindGroupDesc{};
+	bindGroupDesc.layout = m_bindGroupLayout;
+	bindGroupDesc.entryCount = 1;
+	bindGroupDesc.entries = &entry;
+	m_bindGroup = bindGroupCache.getBindGroup(bindGroupDesc);
+}
+
+std::string DrawConstants::wgslDeclaration(const char* name, const char* type) const {
+	if (m_usePushConstants) {
+		return std::string("var<push_constant> ") + name + ": " + type + ";\n";
+	}
+	return "@group(" + std::to_string(m_group) + ") @binding(0) var<uniform> " + name + ": " + type + ";\n";
+}
+
+PipelineLayout DrawConstants::createPipelineLayout(std::vector<BindGroupLayout> bindGroupLayouts) {
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+#ifdef WEBGPU_BACKEND_WGPU
+	PushConstantRange range = Default;
+	range.stages = m_visibility;
+	range.start = 0;
+	range.end = m_size;
+	PipelineLayoutExtras extras = Default;
+	extras.pushConstantRangeCount = 1;
+	extras.pushConstantRanges = &range;
+	if (m_usePushConstants) {
+		pipelineLayoutDesc.nextInChain = &extras.chain;
+	}
+#endif
+	if (!m_usePushConstants) {
+		assert(bindGroupLayouts.size() == m_group);
+		bindGroupLayouts.push_back(m_bindGroupLayout);
+	}
+	pipelineLayoutDesc.bindGroupLayoutCount = (uint32_t)bindGroupLayouts.size();
+	pipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)bindGroupLayouts.data();
+	return m_device.createPipelineLayout(pipelineLayoutDesc);
+}
+
+bool DrawConstants::set(RenderPassEncoder renderPass, const void* data) {
+	if (m_usePushConstants) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuRenderPassEncoderSetPushConstants(renderPass, m_visibility, 0, m_size, const_cast<void*>(data));
+#endif
+		return true;
+	}
+	uint32_t offset = m_uniforms.allocate(data, m_size);
+	if (offset == UniformAllocator::OutOfSpace) {
+		return false;
+	}
+	renderPass.setBindGroup(m_group, m_bindGroup, 1, &offset);
+	return true;
+}
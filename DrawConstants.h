@@ -0,0 +1,113 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class BindGroupCache;
+class UniformAllocator;
+
+/**
+ * Small per-draw parameters (object index, material id, tint...), set
+ * before each draw call. On wgpu-native, when the adapter supports push
+ * constants, they are recorded directly in the render pass. Otherwise they
+ * are copied in the per-frame uniform buffer and read through a bind group
+ * with a dynamic offset, which only costs a setBindGroup per draw.
+ *
+ * Shaders declare the parameters with wgslDeclaration(), which picks the
+ * address space matching the path in use.
+ */
+class DrawConstants {
+public:
+#ifdef WEBGPU_BACKEND_WGPU
+	using LimitsExtras = wgpu::RequiredLimitsExtras;
+#else
+	struct LimitsExtras {};
+#endif
+
+	/**
+	 * Whether push constants can be used with this adapter.
+	 */
+	static bool pushConstantsSupported(wgpu::Adapter adapter);
+
+	/**
+	 * Features to request when creating the device for the chosen path.
+	 */
+	static std::vector<wgpu::FeatureName> requiredFeatures(bool usePushConstants);
+
+	/**
+	 * Raise the device limits for `size` bytes of per-draw parameters. With
+	 * push constants, `extras` is chained to `requiredLimits` and must live
+	 * until the device is created. Otherwise this needs a uniform buffer with
+	 * a dynamic offset, bound at `group`; like other modules, limits are only
+	 * raised to what this buffer alone needs, so callers that also bind other
+	 * uniform buffers raise the counts to their total.
+	 */
+	static void requireLimits(
+		wgpu::RequiredLimits& requiredLimits,
+		LimitsExtras& extras,
+		bool usePushConstants,
+		uint32_t size,
+		uint32_t group
+	);
+
+	/**
+	 * `size` bytes (a multiple of 4) of parameters visible to `visibility`
+	 * stages. Without push constants, they are bound at `group` and
+	 * allocated in `uniforms`.
+	 */
+	DrawConstants(
+		wgpu::Device device,
+		bool usePushConstants,
+		uint32_t size,
+		WGPUShaderStageFlags visibility,
+		uint32_t group,
+		UniformAllocator& uniforms,
+		BindGroupCache& bindGroupCache
+	);
+
+	DrawConstants(const DrawConstants&) = delete;
+	DrawConstants& operator=(const DrawConstants&) = delete;
+
+	bool usesPushConstants() const { return m_usePushConstants; }
+
+	/**
+	 * WGSL declaration of the variable `name` of type `type` holding the
+	 * parameters, to paste in the shader source.
+	 */
+	std::string wgslDeclaration(const char* name, const char* type) const;
+
+	/**
+	 * Create a pipeline layout made of `bindGroupLayouts`, plus what the
+	 * parameters need: a push constant range, or their bind group layout
+	 * at index `group`, right after `bindGroupLayouts`.
+	 */
+	wgpu::PipelineLayout createPipelineLayout(std::vector<wgpu::BindGroupLayout> bindGroupLayouts);
+
+	/**
+	 * Set the parameters of the next draws of `renderPass`. Without push
+	 * constants, the uniform allocator must be uploaded before submitting.
+	 * Returns false when the uniform allocator is full, in which case the
+	 * parameters are not set and the draws must be skipped.
+	 */
+	bool set(wgpu::RenderPassEncoder renderPass, const void* data);
+
+	template <typename T>
+	bool set(wgpu::RenderPassEncoder renderPass, const T& value) {
+		static_assert(sizeof(T) % 4 == 0, "Draw constants must be made of 32-bit words");
+		return set(renderPass, static_cast<const void*>(&value));
+	}
+
+private:
+	wgpu::Device m_device;
+	bool m_usePushConstants;
+	uint32_t m_size;
+	WGPUShaderStageFlags m_visibility;
+	uint32_t m_group;
+	UniformAllocator& m_uniforms;
+	// Fallback path, owned by the bind group cache
+	wgpu::BindGroupLayout m_bindGroupLayout = nullptr;
+	wgpu::BindGroup m_bindGroup = nullptr;
+};
@@ -0,0 +1,228 @@
+#include "DrawQueue.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace wgpu;
+
+// Below this, std::sort beats setting up the radix passes
+constexpr size_t MIN_RADIX_SORT_SIZE = 256;
+// Below this many items per thread, sorting is not split across threads
+constexpr uint32_t MIN_ITEMS_PER_THREAD = 8192;
+
+RenderPassState::Stats& RenderPassState::Stats::operator+=(const Stats& other) {
+	draws += other.draws;
+	pipelineChanges += other.pipelineChanges;
+	pipelineChangesElided += other.pipelineChangesElided;
+	bindGroupChanges += other.bindGroupChanges;
+	bindGroupChangesElided += other.bindGroupChangesElided;
+	vertexBufferChanges += other.vertexBufferChanges;
+	vertexBufferChangesElided += other.vertexBufferChangesElided;
+	return *this;
+}
+
+void RenderPassState::setPipeline(RenderPipeline pipeline) {
+	if ((WGPURenderPipeline)pipeline == m_pipeline) {
+		++m_stats.pipelineChangesElided;
+		return;
+	}
+	m_pipeline = pipeline;
+	m_renderPass.setPipeline(pipeline);
+	++m_stats.pipelineChanges;
+}
+
+void RenderPassState::setBindGroup(uint32_t groupIndex, BindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+	assert(groupIndex < MAX_BIND_GROUPS);
+	assert(dynamicOffsetCount <= MAX_DYNAMIC_OFFSETS);
+	BoundGroup& bound = m_bindGroups[groupIndex];
+	if ((WGPUBindGroup)group == bound.group
+		&& dynamicOffsetCount == bound.dynamicOffsetCount
+		&& std::equal(dynamicOffsets, dynamicOffsets + dynamicOffsetCount, bound.dynamicOffsets)) {
+		++m_stats.bindGroupChangesElided;
+		return;
+	}
+	bound.group = group;
+	bound.dynamicOffsetCount = dynamicOffsetCount;
+	std::copy_n(dynamicOffsets, dynamicOffsetCount, bound.dynamicOffsets);
+	m_renderPass.setBindGroup(groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+	++m_stats.bindGroupChanges;
+}
+
+void RenderPassState::setVertexBuffer(uint32_t slot, Buffer buffer, uint64_t offset, uint64_t size) {
+	assert(slot < MAX_VERTEX_BUFFERS);
+	BoundVertexBuffer& bound = m_vertexBuffers[slot];
+	if ((WGPUBuffer)buffer == bound.buffer && offset == bound.offset && size == bound.size) {
+		++m_stats.vertexBufferChangesElided;
+		return;
+	}
+	bound.buffer = buffer;
+	bound.offset = offset;
+	bound.size = size;
+	m_renderPass.setVertexBuffer(slot, buffer, offset, size);
+	++m_stats.vertexBufferChanges;
+}
+
+void RenderPassState::draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance) {
+	m_renderPass.draw(vertexCount, instanceCount, firstVertex, firstInstance);
+	++m_stats.draws;
+}
+
+uint64_t DrawQueue::makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, DepthOrder order) {
+	assert(pass < (1u << PASS_BITS));
+	assert(pipeline < (1u << PIPELINE_BITS));
+	assert(material < (1u << MATERIAL_BITS));
+
+	// Map the float to an unsigned integer that sorts the same way:
+	// negative floats have their order reversed by flipping all bits, and
+	// positive ones go above them by setting the sign bit.
+	uint32_t depthBits;
+	std::memcpy(&depthBits, &depth, sizeof(depth));
+	depthBits = (depthBits & 0x80000000u) ? ~depthBits : depthBits | 0x80000000u;
+	if (order == DepthOrder::BackToFront) {
+		depthBits = ~depthBits;
+	}
+
+	return (uint64_t(pass) << (64 - PASS_BITS))
+		| (uint64_t(pipeline) << (64 - PASS_BITS - PIPELINE_BITS))
+		| (uint64_t(material) << 32)
+		| depthBits;
+}
+
+DrawQueue::DrawQueue(ThreadPool* pool)
+	: m_pool(pool)
+{}
+
+void DrawQueue::clear() {
+	m_draws.clear();
+	m_items.clear();
+	m_sorted = true;
+	m_stats = RenderPassState::Stats{};
+}
+
+void DrawQueue::add(uint64_t key, const Draw& draw) {
+	m_items.push_back(SortItem{ key, static_cast<uint32_t>(m_draws.size()) });
+	m_draws.push_back(draw);
+	m_sorted = false;
+}
+
+void DrawQueue::sort() {
+	if (m_items.size() < MIN_RADIX_SORT_SIZE) {
+		std::stable_sort(m_items.begin(), m_items.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+	} else {
+		radixSort();
+	}
+	m_sorted = true;
+}
+
+void DrawQueue::radixSort() {
+	const uint32_t count = static_cast<uint32_t>(m_items.size());
+	const uint32_t threadCount = m_pool ? m_pool->threadCount() : 1;
+	m_scratch.resize(count);
+	m_histograms.resize(threadCount);
+	auto parallelFor = [&](const ThreadPool::Task& task) {
+		if (m_pool) {
+			m_pool->parallelFor(count, MIN_ITEMS_PER_THREAD, task);
+		} else {
+			task(0, count, 0);
+		}
+	};
+
+	// Count all bytes at once, to find the ones that are the same in all
+	// keys. These histograms also serve the first pass that is not
+	// skipped, since no item has moved yet.
+	for (std::array<Histogram, 8>& histograms : m_histograms) {
+		for (Histogram& histogram : histograms) histogram.fill(0);
+	}
+	parallelFor([&](uint32_t begin, uint32_t end, uint32_t workerIndex) {
+		std::array<Histogram, 8>& histograms = m_histograms[workerIndex];
+		for (uint32_t i = begin; i < end; ++i) {
+			uint64_t key = m_items[i].key;
+			for (int byte = 0; byte < 8; ++byte) {
+				++histograms[byte][(key >> (8 * byte)) & 0xFF];
+			}
+		}
+	});
+
+	SortItem* src = m_items.data();
+	SortItem* dst = m_scratch.data();
+	bool countsAreCurrent = true;
+	for (int byte = 0; byte < 8; ++byte) {
+		const uint32_t shift = 8 * byte;
+		// A byte of the first key that all keys share
+		uint32_t firstDigit = (src[0].key >> shift) & 0xFF;
+		uint32_t firstDigitCount = 0;
+		for (const std::array<Histogram, 8>& histograms : m_histograms) {
+			firstDigitCount += histograms[byte][firstDigit];
+		}
+		if (firstDigitCount == count) continue;
+
+		if (!countsAreCurrent) {
+			for (std::array<Histogram, 8>& histograms : m_histograms) {
+				histograms[byte].fill(0);
+			}
+			parallelFor([&](uint32_t begin, uint32_t end, uint32_t workerIndex) {
+				Histogram& histogram = m_histograms[workerIndex][byte];
+				for (uint32_t i = begin; i < end; ++i) {
+					++histogram[(src[i].key >> shift) & 0xFF];
+				}
+			});
+		}
+		countsAreCurrent = false;
+
+		// Turn the counts into the offsets where each thread writes its
+		// items of each digit. Threads process contiguous ranges ordered by
+		// worker index, so the sort stays stable.
+		uint32_t offset = 0;
+		for (uint32_t digit = 0; digit < 256; ++digit) {
+			for (uint32_t worker = 0; worker < threadCount; ++worker) {
+				uint32_t digitCount = m_histograms[worker][byte][digit];
+				m_histograms[worker][byte][digit] = offset;
+				offset += digitCount;
+			}
+		}
+
+		parallelFor([&](uint32_t begin, uint32_t end, uint32_t workerIndex) {
+			Histogram& offsets = m_histograms[workerIndex][byte];
+			for (uint32_t i = begin; i < end; ++i) {
+				dst[offsets[(src[i].key >> shift) & 0xFF]++] = src[i];
+			}
+		});
+		std::swap(src, dst);
+	}
+
+	if (src != m_items.data()) {
+		m_items.swap(m_scratch);
+	}
+}
+
+void DrawQueue::submit(RenderPassEncoder renderPass, uint32_t pass) {
+	assert(m_sorted && "sort() must be called after adding draws");
+	assert(pass < (1u << PASS_BITS));
+
+	// Draws of a pass are contiguous once sorted
+	const uint64_t passBegin = uint64_t(pass) << (64 - PASS_BITS);
+	auto first = std::lower_bound(m_items.begin(), m_items.end(), passBegin,
+		[](const SortItem& item, uint64_t key) { return item.key < key; });
+
+	RenderPassState state(renderPass);
+	for (auto it = first; it != m_items.end() && (it->key >> (64 - PASS_BITS)) == pass; ++it) {
+		const Draw& draw = m_draws[it->draw];
+		state.setPipeline(draw.pipeline);
+		for (uint32_t group = 0; group < RenderPassState::MAX_BIND_GROUPS; ++group) {
+			const Draw::BindGroup& binding = draw.bindGroups[group];
+			if (binding.group) {
+				state.setBindGroup(group, binding.group, binding.dynamicOffsetCount, binding.dynamicOffsets);
+			}
+		}
+		for (uint32_t slot = 0; slot < RenderPassState::MAX_VERTEX_BUFFERS; ++slot) {
+			const Draw::VertexBuffer& binding = draw.vertexBuffers[slot];
+			if (binding.buffer) {
+				state.setVertexBuffer(slot, binding.buffer, binding.offset, binding.size);
+			}
+		}
+		state.draw(draw.vertexCount, draw.instanceCount, draw.firstVertex, draw.firstInstance);
+	}
+	m_stats += state.stats();
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Wraps a render pass encoder and skips the setPipeline(), setBindGroup()
+ * and setVertexBuffer() calls that would set the state that is already
+ * set. Bind groups stay bound across pipeline changes, as WebGPU keeps
+ * them, so drawing the same material with another pipeline does not bind
+ * its groups again.
+ */
+class RenderPassState {
+public:
+	/**
+	 * Numbers of state changes encoded, and skipped because they were
+	 * redundant.
+	 */
+	struct Stats {
+		uint32_t draws = 0;
+		uint32_t pipelineChanges = 0;
+		uint32_t pipelineChangesElided = 0;
+		uint32_t bindGroupChanges = 0;
+		uint32_t bindGroupChangesElided = 0;
+		uint32_t vertexBufferChanges = 0;
+		uint32_t vertexBufferChangesElided = 0;
+
+		Stats& operator+=(const Stats& other);
+	};
+
+	static constexpr uint32_t MAX_BIND_GROUPS = 4;
+	static constexpr uint32_t MAX_VERTEX_BUFFERS = 4;
+	static constexpr uint32_t MAX_DYNAMIC_OFFSETS = 2;
+
+	explicit RenderPassState(wgpu::RenderPassEncoder renderPass) : m_renderPass(renderPass) {}
+
+	void setPipeline(wgpu::RenderPipeline pipeline);
+	void setBindGroup(uint32_t groupIndex, wgpu::BindGroup group, uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets);
+	void setVertexBuffer(uint32_t slot, wgpu::Buffer buffer, uint64_t offset, uint64_t size);
+	void draw(uint32_t vertexCount, uint32_t instanceCount, uint32_t firstVertex, uint32_t firstInstance);
+
+	wgpu::RenderPassEncoder renderPass() const { return m_renderPass; }
+	const Stats& stats() const { return m_stats; }
+
+private:
+	struct BoundGroup {
+		WGPUBindGroup group = nullptr;
+		uint32_t dynamicOffsetCount = 0;
+		uint32_t dynamicOffsets[MAX_DYNAMIC_OFFSETS] = {};
+	};
+	struct BoundVertexBuffer {
+		WGPUBuffer buffer = nullptr;
+		uint64_t offset = 0;
+		uint64_t size = 0;
+	};
+
+private:
+	wgpu::RenderPassEncoder m_renderPass;
+	WGPURenderPipeline m_pipeline = nullptr;
+	BoundGroup m_bindGroups[MAX_BIND_GROUPS];
+	BoundVertexBuffer m_vertexBuffers[MAX_VERTEX_BUFFERS];
+	Stats m_stats;
+};
+
+/**
+ * Draw submission layer. Draws are added in any order, each with a 64-bit
+ * sort key, then sorted by key and encoded through a RenderPassState.
+ *
+ * Keys made by makeKey() sort draws by pass, then pipeline, then material,
+ * then depth, so that pipeline changes are the fewest, bind groups change
+ * only between materials, and the draws sharing a pipeline and a material
+ * go front to back (opaque) or back to front (transparent).
+ *
+ * Keys are sorted with an LSD radix sort, 8 bits per pass, split across
+ * the threads of the pool. The passes over bytes that are the same in all
+ * keys, typically the pass and pipeline bytes, are skipped.
+ */
+class DrawQueue {
+public:
+	static constexpr uint32_t PASS_BITS = 4;
+	static constexpr uint32_t PIPELINE_BITS = 12;
+	static constexpr uint32_t MATERIAL_BITS = 16;
+
+	enum class DepthOrder {
+		FrontToBack,
+		BackToFront,
+	};
+
+	/**
+	 * State set before a draw. Null bind groups and vertex buffers are left
+	 * as they were.
+	 */
+	struct Draw {
+		struct BindGroup {
+			wgpu::BindGroup group = nullptr;
+			uint32_t dynamicOffsetCount = 0;
+			uint32_t dynamicOffsets[RenderPassState::MAX_DYNAMIC_OFFSETS] = {};
+		};
+		struct VertexBuffer {
+			wgpu::Buffer buffer = nullptr;
+			uint64_t offset = 0;
+			uint64_t size = 0;
+		};
+
+		wgpu::RenderPipeline pipeline = nullptr;
+		BindGroup bindGroups[RenderPassState::MAX_BIND_GROUPS];
+		VertexBuffer vertexBuffers[RenderPassState::MAX_VERTEX_BUFFERS];
+		uint32_t vertexCount = 0;
+		uint32_t instanceCount = 1;
+		uint32_t firstVertex = 0;
+		uint32_t firstInstance = 0;
+	};
+
+	/**
+	 * Pass, pipeline and material are small integers chosen by the caller,
+	 * below 2^PASS_BITS, 2^PIPELINE_BITS and 2^MATERIAL_BITS. Depth is
+	 * typically the clip space depth of the object's center, smaller being
+	 * closer.
+	 */
+	static uint64_t makeKey(uint32_t pass, uint32_t pipeline, uint32_t material, float depth, DepthOrder order = DepthOrder::FrontToBack);
+
+	/**
+	 * Sort on the threads of `pool`, or on the calling thread alone if null.
+	 */
+	explicit DrawQueue(ThreadPool* pool = nullptr);
+
+	/**
+	 * Remove all draws and reset the stats, typically at the start of a
+	 * frame.
+	 */
+	void clear();
+
+	void add(uint64_t key, const Draw& draw);
+
+	/**
+	 * Sort the draws by key. Draws with equal keys keep the order in which
+	 * they were added.
+	 */
+	void sort();
+
+	/**
+	 * Encode the draws of `pass` in key order, which must have been sorted
+	 * since the last add().
+	 */
+	void submit(wgpu::RenderPassEncoder renderPass, uint32_t pass);
+
+	size_t size() const { return m_draws.size(); }
+
+	/**
+	 * State changes of the draws submitted since the last clear().
+	 */
+	const RenderPassState::Stats& stats() const { return m_stats; }
+
+private:
+	struct SortItem {
+		uint64_t key;
+		uint32_t draw;
+	};
+	using Histogram = std::array<uint32_t, 256>;
+
+	void radixSort();
+
+private:
+	ThreadPool* m_pool;
+	std::vector<Draw> m_draws;
+	std::vector<SortItem> m_items;
+	std::vector<SortItem> m_scratch;
+	// Per thread, one histogram per key byte
+	std::vector<std::array<Histogram, 8>> m_histograms;
+	bool m_sorted = true;
+	RenderPassState::Stats m_stats;
+};
@@ -0,0 +1,534 @@
+#include "FrameCapture.h"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#ifdef _WIN32
+#  include <cstdio>
+#else
+#  include <cerrno>
+#  include <climits>
+#  include <fcntl.h>
+#  include <sys/uio.h>
+#  include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define FRAME_CAPTURE_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define FRAME_CAPTURE_NEON 1
+#endif
+
+using namespace wgpu;
+
+// Copies into buffers need rows aligned on this many bytes
+constexpr uint32_t COPY_BYTES_PER_ROW_ALIGNMENT = 256;
+
+namespace {
+
+struct Slice {
+	const uint8_t* data;
+	size_t size;
+};
+
+#ifndef IOV_MAX
+constexpr int IOV_MAX = 1024;
+#endif
+
+#ifdef _WIN32
+bool writeSlices(std::FILE* file, const std::vector<Slice>& slices) {
+	for (const Slice& slice : slices) {
+		if (std::fwrite(slice.data, 1, slice.size, file) != slice.size) return false;
+	}
+	return true;
+}
+#else
+// The kernel gathers the slices directly from the mapped buffer, with one
+// system call for up to IOV_MAX of them
+bool writeSlices(int file, const std::vector<Slice>& slices) {
+	std::vector<iovec> vectors;
+	vectors.reserve(slices.size());
+	for (const Slice& slice : slices) {
+		if (slice.size == 0) continue;
+		vectors.push_back({ const_cast<uint8_t*>(slice.data), slice.size });
+	}
+	size_t first = 0;
+	while (first < vectors.size()) {
+		int count = static_cast<int>(std::min<size_t>(vectors.size() - first, IOV_MAX));
+		ssize_t written = ::writev(file, &vectors[first], count);
+		if (written < 0) {
+			if (errno == EINTR) continue;
+			return false;
+		}
+		// Skip what was written, which may end in the middle of a slice
+		size_t remaining = static_cast<size_t>(written);
+		while (first < vectors.size() && remaining >= vectors[first].iov_len) {
+			remaining -= vectors[first].iov_len;
+			++first;
+		}
+		if (remaining > 0) {
+			vectors[first].iov_base = static_cast<uint8_t*>(vectors[first].iov_base) + remaining;
+			vectors[first].iov_len -= remaining;
+		}
+	}
+	return true;
+}
+#endif
+
+bool isBgra(TextureFormat format) {
+	return format == TextureFormat::BGRA8Unorm || format == TextureFormat::BGRA8UnormSrgb;
+}
+
+uint8_t clampByte(int32_t value) {
+	return static_cast<uint8_t>(std::min(std::max(value, 0), 255));
+}
+
+// Full range BT.601, as in JPEG, in 14-bit fixed point so that products
+// fit the 16-bit multiplies of SSE2. Chroma is computed from the sum of
+// each 2x2 block of pixels, hence the 2 extra bits of shift.
+constexpr int32_t Y_R = 4899, Y_G = 9617, Y_B = 1868;
+constexpr int32_t U_R = -2765, U_G = -5427, U_B = 8192;
+constexpr int32_t V_R = 8192, V_G = -6860, V_B = -1332;
+constexpr int32_t LUMA_ROUNDING = 1 << 13;
+constexpr int32_t CHROMA_OFFSET = (128 << 16) + (1 << 15);
+
+#if defined(FRAME_CAPTURE_SSE2)
+// Sum the two halves of each pair of 32-bit lanes of a and b, giving
+// a0 + a1, a2 + a3, b0 + b1, b2 + b3
+__m128i addPairs(__m128i a, __m128i b) {
+	__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(2, 0, 2, 0));
+	__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(a), _mm_castsi128_ps(b), _MM_SHUFFLE(3, 1, 3, 1));
+	return _mm_add_epi32(_mm_castps_si128(even), _mm_castps_si128(odd));
+}
+
+// Luma of the 2 pixels of each of the 4 vectors of 16-bit channels
+__m128i luma8(const __m128i pixels[4], __m128i weights) {
+	__m128i low = addPairs(_mm_madd_epi16(pixels[0], weights), _mm_madd_epi16(pixels[1], weights));
+	__m128i high = addPairs(_mm_madd_epi16(pixels[2], weights), _mm_madd_epi16(pixels[3], weights));
+	low = _mm_srai_epi32(_mm_add_epi32(low, _mm_set1_epi32(LUMA_ROUNDING)), 14);
+	high = _mm_srai_epi32(_mm_add_epi32(high, _mm_set1_epi32(LUMA_ROUNDING)), 14);
+	return _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128());
+}
+
+// One chroma value per 2x2 block, from the 16-bit channel sums of two
+// blocks per vector
+__m128i chroma4(__m128i blocks01, __m128i blocks23, __m128i weights) {
+	__m128i sums = addPairs(_mm_madd_epi16(blocks01, weights), _mm_madd_epi16(blocks23, weights));
+	sums = _mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(CHROMA_OFFSET)), 16);
+	return _mm_packus_epi16(_mm_packs_epi32(sums, sums), _mm_setzero_si128());
+}
+#endif
+
+void convertToI420(
+	const uint8_t* texels, uint32_t bytesPerRow, uint32_t width, uint32_t height, bool bgra,
+	uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane
+) {
+	const int r = bgra ? 2 : 0;
+	const int b = bgra ? 0 : 2;
+	uint32_t chromaWidth = (width + 1) / 2;
+#if defined(FRAME_CAPTURE_SSE2)
+	// Weights of the channels in memory order, the 4th one being alpha
+	const __m128i yWeights = bgra ? _mm_setr_epi16(Y_B, Y_G, Y_R, 0, Y_B, Y_G, Y_R, 0) : _mm_setr_epi16(Y_R, Y_G, Y_B, 0, Y_R, Y_G, Y_B, 0);
+	const __m128i uWeights = bgra ? _mm_setr_epi16(U_B, U_G, U_R, 0, U_B, U_G, U_R, 0) : _mm_setr_epi16(U_R, U_G, U_B, 0, U_R, U_G, U_B, 0);
+	const __m128i vWeights = bgra ? _mm_setr_epi16(V_B, V_G, V_R, 0, V_B, V_G, V_R, 0) : _mm_setr_epi16(V_R, V_G, V_B, 0, V_R, V_G, V_B, 0);
+#endif
+	for (uint32_t y = 0; y < height; y += 2) {
+		const uint8_t* rows[2] = { texels + y * bytesPerRow, texels + std::min(y + 1, height - 1) * bytesPerRow };
+		uint8_t* lumaRows[2] = { yPlane + y * width, yPlane + std::min(y + 1, height - 1) * width };
+		uint8_t* u = uPlane + (y / 2) * chromaWidth;
+		uint8_t* v = vPlane + (y / 2) * chromaWidth;
+		uint32_t x = 0;
+#if defined(FRAME_CAPTURE_SSE2)
+		const __m128i zero = _mm_setzero_si128();
+		for (; x + 8 <= width; x += 8) {
+			// 2 pixels per vector, one 16-bit lane per channel
+			__m128i pixels[2][4];
+			for (int row = 0; row < 2; ++row) {
+				__m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[row] + 4 * x));
+				__m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[row] + 4 * x + 16));
+				pixels[row][0] = _mm_unpacklo_epi8(first, zero);
+				pixels[row][1] = _mm_unpackhi_epi8(first, zero);
+				pixels[row][2] = _mm_unpacklo_epi8(second, zero);
+				pixels[row][3] = _mm_unpackhi_epi8(second, zero);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(lumaRows[row] + x), luma8(pixels[row], yWeights));
+			}
+			// Vertical sums, then the 2 pixels of a vector added together
+			__m128i blocks[4];
+			for (int i = 0; i < 4; ++i) {
+				__m128i sum = _mm_add_epi16(pixels[0][i], pixels[1][i]);
+				blocks[i] = _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+			}
+			__m128i blocks01 = _mm_unpacklo_epi64(blocks[0], blocks[1]);
+			__m128i blocks23 = _mm_unpacklo_epi64(blocks[2], blocks[3]);
+			int32_t uBytes = _mm_cvtsi128_si32(chroma4(blocks01, blocks23, uWeights));
+			int32_t vBytes = _mm_cvtsi128_si32(chroma4(blocks01, blocks23, vWeights));
+			std::memcpy(u + x / 2, &uBytes, 4);
+			std::memcpy(v + x / 2, &vBytes, 4);
+		}
+#elif defined(FRAME_CAPTURE_NEON)
+		for (; x + 8 <= width; x += 8) {
+			uint16x4_t rSum = vdup_n_u16(0), gSum = vdup_n_u16(0), bSum = vdup_n_u16(0);
+			for (int row = 0; row < 2; ++row) {
+				// Deinterleaves the channels of 8 pixels
+				uint8x8x4_t pixels = vld4_u8(rows[row] + 4 * x);
+				uint16x8_t red = vmovl_u8(pixels.val[r]);
+				uint16x8_t green = vmovl_u8(pixels.val[1]);
+				uint16x8_t blue = vmovl_u8(pixels.val[b]);
+				uint32x4_t low = vmull_n_u16(vget_low_u16(red), Y_R);
+				low = vmlal_n_u16(low, vget_low_u16(green), Y_G);
+				low = vmlal_n_u16(low, vget_low_u16(blue), Y_B);
+				uint32x4_t high = vmull_n_u16(vget_high_u16(red), Y_R);
+				high = vmlal_n_u16(high, vget_high_u16(green), Y_G);
+				high = vmlal_n_u16(high, vget_high_u16(blue), Y_B);
+				// Rounding shifts, as in the scalar path
+				vst1_u8(lumaRows[row] + x, vmovn_u16(vcombine_u16(vrshrn_n_u32(low, 14), vrshrn_n_u32(high, 14))));
+				rSum = vadd_u16(rSum, vpaddl_u8(pixels.val[r]));
+				gSum = vadd_u16(gSum, vpaddl_u8(pixels.val[1]));
+				bSum = vadd_u16(bSum, vpaddl_u8(pixels.val[b]));
+			}
+			int16x4_t reds = vreinterpret_s16_u16(rSum), greens = vreinterpret_s16_u16(gSum), blues = vreinterpret_s16_u16(bSum);
+			int32x4_t uSums = vdupq_n_s32(CHROMA_OFFSET);
+			uSums = vmlal_n_s16(uSums, reds, U_R);
+			uSums = vmlal_n_s16(uSums, greens, U_G);
+			uSums = vmlal_n_s16(uSums, blues, U_B);
+			int32x4_t vSums = vdupq_n_s32(CHROMA_OFFSET);
+			vSums = vmlal_n_s16(vSums, reds, V_R);
+			vSums = vmlal_n_s16(vSums, greens, V_G);
+			vSums = vmlal_n_s16(vSums, blues, V_B);
+			uint16x4_t uWords = vqmovun_s32(vshrq_n_s32(uSums, 16));
+			uint16x4_t vWords = vqmovun_s32(vshrq_n_s32(vSums, 16));
+			uint8x8_t bytes = vqmovn_u16(vcombine_u16(uWords, vWords));
+			uint32_t uBytes = vget_lane_u32(vreinterpret_u32_u8(bytes), 0);
+			uint32_t vBytes = vget_lane_u32(vreinterpret_u32_u8(bytes), 1);
+			std::memcpy(u + x / 2, &uBytes, 4);
+			std::memcpy(v + x / 2, &vBytes, 4);
+		}
+#endif
+		for (; x < width; x += 2) {
+			uint32_t xs[2] = { x, std::min(x + 1, width - 1) };
+			int32_t rSum = 0, gSum = 0, bSum = 0;
+			for (int row = 0; row < 2; ++row) {
+				for (uint32_t column : xs) {
+					const uint8_t* pixel = rows[row] + 4 * column;
+					int32_t red = pixel[r], green = pixel[1], blue = pixel[b];
+					lumaRows[row][column] = static_cast<uint8_t>((Y_R * red + Y_G * green + Y_B * blue + LUMA_ROUNDING) >> 14);
+					rSum += red;
+					gSum += green;
+					bSum += blue;
+				}
+			}
+			u[x / 2] = clampByte((U_R * rSum + U_G * gSum + U_B * bSum + CHROMA_OFFSET) >> 16);
+			v[x / 2] = clampByte((V_R * rSum + V_G * gSum + V_B * bSum + CHROMA_OFFSET) >> 16);
+		}
+	}
+}
+
+} // anonymous namespace
+
+bool FrameCapture::supportsFormat(TextureFormat format) {
+	return format == TextureFormat::RGBA8Unorm
+		|| format == TextureFormat::RGBA8UnormSrgb
+		|| isBgra(format);
+}
+
+const char* FrameCapture::pixelFormatName(TextureFormat format) {
+	return isBgra(format) ? "bgra" : "rgba";
+}
+
+void FrameCapture::requireLimits(WGPULimits& limits, uint32_t width, uint32_t height) {
+	uint64_t bytesPerRow = (4ull * width + COPY_BYTES_PER_ROW_ALIGNMENT - 1) / COPY_BYTES_PER_ROW_ALIGNMENT * COPY_BYTES_PER_ROW_ALIGNMENT;
+	limits.maxBufferSize = std::max<uint64_t>(limits.maxBufferSize, bytesPerRow * height);
+	limits.maxTextureDimension2D = std::max(limits.maxTextureDimension2D, std::max(width, height));
+}
+
+FrameCapture::FrameCapture(Device device, TextureFormat format, uint32_t width, uint32_t height, const Settings& settings)
+	: m_device(device)
+	, m_textureFormat(format)
+	, m_width(width)
+	, m_height(height)
+	, m_settings(settings)
+{
+	assert(supportsFormat(format));
+	assert(width > 0 && height > 0);
+	m_bytesPerRow = (4 * width + COPY_BYTES_PER_ROW_ALIGNMENT - 1) / COPY_BYTES_PER_ROW_ALIGNMENT * COPY_BYTES_PER_ROW_ALIGNMENT;
+
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Frame capture readback";
+	bufferDesc.size = uint64_t(m_bytesPerRow) * height;
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+	bufferDesc.mappedAtCreation = false;
+	m_slots.resize(std::max(settings.bufferCount, 1u));
+	for (uint32_t i = 0; i < m_slots.size(); ++i) {
+		m_slots[i].buffer = m_device.createBuffer(bufferDesc);
+		// Popped from the back, so that buffers are used in order
+		m_freeSlots.push_back(static_cast<uint32_t>(m_slots.size()) - 1 - i);
+	}
+}
+
+FrameCapture::~FrameCapture() {
+	close();
+	for (Slot& slot : m_slots) {
+		slot.buffer.destroy();
+		slot.buffer.release();
+	}
+}
+
+bool FrameCapture::open(const char* path) {
+	assert(!isOpen());
+#ifdef _WIN32
+	m_file = std::fopen(path, "wb");
+#else
+	m_file = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+	if (!isOpen()) return false;
+
+	m_stats = Stats{};
+	m_failed = false;
+	m_stopping = false;
+	if (m_settings.format == Format::Y4m) {
+		std::string header = "YUV4MPEG2 W" + std::to_string(m_width) + " H" + std::to_string(m_height)
+			+ " F" + std::to_string(m_settings.framesPerSecond) + ":1 Ip A1:1 C420jpeg\n";
+		if (!writeSlices(m_file, { { reinterpret_cast<const uint8_t*>(header.data()), header.size() } })) {
+#ifdef _WIN32
+			std::fclose(m_file);
+			m_file = nullptr;
+#else
+			::close(m_file);
+			m_file = -1;
+#endif
+			return false;
+		}
+		m_stats.bytesWritten = header.size();
+		uint32_t chromaSize = ((m_width + 1) / 2) * ((m_height + 1) / 2);
+		m_yuv.resize(m_width * m_height + 2 * chromaSize);
+	}
+	m_writer = std::thread(&FrameCapture::writeLoop, this);
+	return true;
+}
+
+bool FrameCapture::isOpen() const {
+#ifdef _WIN32
+	return m_file != nullptr;
+#else
+	return m_file >= 0;
+#endif
+}
+
+void FrameCapture::capture(CommandEncoder encoder, Texture texture) {
+	assert(isOpen());
+	if (m_freeSlots.empty()) {
+		auto stallStart = std::chrono::steady_clock::now();
+		while (m_freeSlots.empty()) {
+			if (pump()) continue;
+			// Frames are either still on the GPU, which the poll waits
+			// for, or all waiting for the writer
+			bool mapping = std::any_of(m_inFlight.begin(), m_inFlight.end(), [this](uint32_t i) { return m_slots[i].state == SlotState::Mapping; });
+			if (mapping) {
+				pollDevice(true);
+			} else {
+				// Capturing more frames than buffers between two calls to
+				// submitted() would wait forever
+				assert(m_inFlight.size() < m_slots.size());
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_writtenCondition.wait(lock, [this] { return !m_writtenSlots.empty(); });
+			}
+		}
+		double stallMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - stallStart).count();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stats.stallMs += stallMs;
+	}
+
+	uint32_t index = m_freeSlots.back();
+	m_freeSlots.pop_back();
+	Slot& slot = m_slots[index];
+	slot.state = SlotState::Copying;
+	m_inFlight.push_back(index);
+
+	ImageCopyTexture source;
+	source.texture = texture;
+	source.mipLevel = 0;
+	source.origin = { 0, 0, 0 };
+	source.aspect = TextureAspect::All;
+	ImageCopyBuffer destination;
+	destination.buffer = slot.buffer;
+	destination.layout.offset = 0;
+	destination.layout.bytesPerRow = m_bytesPerRow;
+	destination.layout.rowsPerImage = m_height;
+	encoder.copyTextureToBuffer(source, destination, { m_width, m_height, 1 });
+}
+
+void FrameCapture::submitted() {
+	size_t size = size_t(m_bytesPerRow) * m_height;
+	for (uint32_t index : m_inFlight) {
+		Slot& slot = m_slots[index];
+		if (slot.state != SlotState::Copying) continue;
+		slot.state = SlotState::Mapping;
+		slot.mapped = false;
+		slot.mapFailed = false;
+		slot.mapCallback = slot.buffer.mapAsync(MapMode::Read, 0, size, [&slot](BufferMapAsyncStatus status) {
+			slot.mapped = true;
+			slot.mapFailed = status != BufferMapAsyncStatus::Success;
+		});
+	}
+	// Lets the callbacks of frames that are already copied run without
+	// waiting for the rest of the GPU work
+	pollDevice(false);
+	pump();
+}
+
+bool FrameCapture::pump() {
+	bool changed = false;
+	uint64_t dropped = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (uint32_t index : m_writtenSlots) {
+			Slot& slot = m_slots[index];
+			slot.buffer.unmap();
+			slot.data = nullptr;
+			slot.state = SlotState::Free;
+			m_freeSlots.push_back(index);
+			changed = true;
+		}
+		m_writtenSlots.clear();
+
+		// In order, so that a frame mapped early waits for the previous ones
+		while (!m_inFlight.empty()) {
+			uint32_t index = m_inFlight.front();
+			Slot& slot = m_slots[index];
+			if (slot.state != SlotState::Mapping || !slot.mapped) break;
+			m_inFlight.pop_front();
+			slot.mapCallback.reset();
+			changed = true;
+			if (slot.mapFailed || m_failed) {
+				if (!slot.mapFailed) slot.buffer.unmap();
+				slot.state = SlotState::Free;
+				m_freeSlots.push_back(index);
+				++dropped;
+				continue;
+			}
+			slot.data = static_cast<const uint8_t*>(slot.buffer.getConstMappedRange(0, size_t(m_bytesPerRow) * m_height));
+			slot.state = SlotState::Writing;
+			m_writeQueue.push_back(index);
+		}
+		m_stats.framesDropped += dropped;
+	}
+	if (changed) m_writeCondition.notify_one();
+	return changed;
+}
+
+void FrameCapture::pollDevice(bool wait) {
+#ifdef WEBGPU_BACKEND_WGPU
+	wgpuDevicePoll(m_device, wait, nullptr);
+#else
+	(void)wait;
+	m_device.tick();
+#endif
+}
+
+void FrameCapture::close() {
+	if (!isOpen()) return;
+	// Frames still being recorded are never submitted
+	for (uint32_t index : m_inFlight) {
+		assert(m_slots[index].state != SlotState::Copying);
+		(void)index;
+	}
+	while (!m_inFlight.empty()) {
+		if (!pump()) pollDevice(true);
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_writeCondition.notify_one();
+	m_writer.join();
+	pump();
+
+#ifdef _WIN32
+	std::fclose(m_file);
+	m_file = nullptr;
+#else
+	::close(m_file);
+	m_file = -1;
+#endif
+	m_yuv.clear();
+	m_yuv.shrink_to_fit();
+}
+
+bool FrameCapture::good() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return !m_failed;
+}
+
+FrameCapture::Stats FrameCapture::stats() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void FrameCapture::writeLoop() {
+	for (;;) {
+		uint32_t index;
+		const uint8_t* data;
+		bool failed;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_writeCondition.wait(lock, [this] { return m_stopping || !m_writeQueue.empty(); });
+			// Stopping only once every queued frame is written
+			if (m_writeQueue.empty()) return;
+			index = m_writeQueue.front();
+			m_writeQueue.pop_front();
+			data = m_slots[index].data;
+			failed = m_failed;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		failed = failed || !writeFrame(data);
+		double writeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_writtenSlots.push_back(index);
+			m_stats.writeMs += writeMs;
+			if (failed) {
+				m_failed = true;
+				++m_stats.framesDropped;
+			} else {
+				++m_stats.framesWritten;
+				m_stats.bytesWritten += m_settings.format == Format::Y4m
+					? 6 + m_yuv.size()
+					: uint64_t(4) * m_width * m_height;
+			}
+		}
+		m_writtenCondition.notify_one();
+	}
+}
+
+bool FrameCapture::writeFrame(const uint8_t* data) {
+	std::vector<Slice> slices;
+	if (m_settings.format == Format::Y4m) {
+		uint8_t* yPlane = m_yuv.data();
+		uint8_t* uPlane = yPlane + m_width * m_height;
+		uint8_t* vPlane = uPlane + ((m_width + 1) / 2) * ((m_height + 1) / 2);
+		convertToI420(data, m_bytesPerRow, m_width, m_height, isBgra(m_textureFormat), yPlane, uPlane, vPlane);
+		static const char frameHeader[] = "FRAME\n";
+		slices.push_back({ reinterpret_cast<const uint8_t*>(frameHeader), sizeof(frameHeader) - 1 });
+		slices.push_back({ m_yuv.data(), m_yuv.size() });
+	} else if (m_bytesPerRow == 4 * m_width) {
+		slices.push_back({ data, size_t(m_bytesPerRow) * m_height });
+	} else {
+		// Rows are padded in the buffer, but not in the file
+		slices.reserve(m_height);
+		for (uint32_t y = 0; y < m_height; ++y) {
+			slices.push_back({ data + size_t(y) * m_bytesPerRow, size_t(4) * m_width });
+		}
+	}
+	return writeSlices(m_file, slices);
+}
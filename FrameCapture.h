@@ -0,0 +1,172 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Records rendered frames into an uncompressed video file, to be encoded
+ * offline.
+ *
+ * Each frame is copied into one of a ring of readback buffers, and a
+ * background thread writes it to the file straight from the mapped memory
+ * of the buffer, without copying it anywhere else first. The ring bounds
+ * the number of frames between the GPU and the disk, so that capture()
+ * only blocks the renderer when the disk cannot keep up.
+ *
+ * Frames are written either as they are in the texture, or converted to a
+ * YUV4MPEG2 stream that video tools read without being told its size:
+ *   ffplay -f rawvideo -pixel_format bgra -video_size 1920x1080 frames.raw
+ *   ffmpeg -i frames.y4m -c:v libx264 frames.mp4
+ */
+class FrameCapture {
+public:
+	enum class Format {
+		// Texels in the byte order of the texture, without any header
+		Raw,
+		// YUV 4:2:0 with full range BT.601 colors (C420jpeg), converted on
+		// the writer thread
+		Y4m,
+	};
+
+	struct Settings {
+		Format format = Format::Raw;
+		// Only written in the Y4M header
+		uint32_t framesPerSecond = 60;
+		// Frames in flight between the GPU and the disk
+		uint32_t bufferCount = 4;
+	};
+
+	struct Stats {
+		uint64_t framesWritten = 0;
+		uint64_t bytesWritten = 0;
+		// Frames whose readback buffer failed to map
+		uint64_t framesDropped = 0;
+		// Time spent in capture() waiting for a free readback buffer
+		double stallMs = 0.0;
+		// Time spent by the writer thread converting and writing frames
+		double writeMs = 0.0;
+	};
+
+	/**
+	 * Whether frames of this texture format can be captured, namely 8-bit
+	 * RGBA and BGRA.
+	 */
+	static bool supportsFormat(wgpu::TextureFormat format);
+
+	/**
+	 * Name of the pixel format of Raw captures of this texture format, as
+	 * understood by ffmpeg's -pixel_format.
+	 */
+	static const char* pixelFormatName(wgpu::TextureFormat format);
+
+	/**
+	 * Raise the device limits needed to read back frames of this size.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t width, uint32_t height);
+
+	FrameCapture(wgpu::Device device, wgpu::TextureFormat format, uint32_t width, uint32_t height, const Settings& settings);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	/**
+	 * Create the output file and write its header. Returns false on failure.
+	 */
+	bool open(const char* path);
+	bool isOpen() const;
+
+	/**
+	 * Record the copy of `texture`, which must have the size and format
+	 * given to the constructor and the CopySrc usage, into a readback
+	 * buffer. Blocks while all buffers hold frames not written yet.
+	 */
+	void capture(wgpu::CommandEncoder encoder, wgpu::Texture texture);
+
+	/**
+	 * Start reading back the frames captured since the last call. Call
+	 * once the command buffers recorded by capture() are submitted.
+	 */
+	void submitted();
+
+	/**
+	 * Wait for all submitted frames to be written, and close the file.
+	 */
+	void close();
+
+	/**
+	 * False once a write failed, after which frames are dropped.
+	 */
+	bool good() const;
+
+	Stats stats() const;
+
+private:
+	enum class SlotState {
+		Free,
+		// The copy is recorded but not submitted yet
+		Copying,
+		Mapping,
+		// Waiting for or being written by the writer thread
+		Writing,
+		// Written, waiting to be unmapped by the main thread
+		Written,
+	};
+
+	struct Slot {
+		wgpu::Buffer buffer = nullptr;
+		SlotState state = SlotState::Free;
+		bool mapped = false;
+		bool mapFailed = false;
+		std::unique_ptr<wgpu::BufferMapCallback> mapCallback;
+		const uint8_t* data = nullptr;
+	};
+
+	// Hand mapped frames over to the writer, in capture order, and recycle
+	// the written ones. Returns true if anything changed.
+	bool pump();
+	void pollDevice(bool wait);
+	void writeLoop();
+	// Called on the writer thread
+	bool writeFrame(const uint8_t* data);
+
+private:
+	wgpu::Device m_device;
+	wgpu::TextureFormat m_textureFormat;
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_bytesPerRow;
+	Settings m_settings;
+
+	std::vector<Slot> m_slots;
+	// Only touched by the main thread
+	std::vector<uint32_t> m_freeSlots;
+	std::deque<uint32_t> m_inFlight;
+
+#ifdef _WIN32
+	std::FILE* m_file = nullptr;
+#else
+	int m_file = -1;
+#endif
+	// Y4M planes of the frame being written, only touched by the writer
+	std::vector<uint8_t> m_yuv;
+
+	// Shared with the writer thread
+	std::thread m_writer;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_writeCondition;
+	std::condition_variable m_writtenCondition;
+	std::deque<uint32_t> m_writeQueue;
+	std::vector<uint32_t> m_writtenSlots;
+	Stats m_stats;
+	bool m_failed = false;
+	bool m_stopping = false;
+};
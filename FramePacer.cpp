@@ -0,0 +1,146 @@
+#include "FramePacer.h"
+
+#include <GLFW/glfw3.h>
+
+#ifdef _WIN32
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#else
+#  include <sys/resource.h>
+#endif
+
+#include <algorithm>
+
+using namespace wgpu;
+
+// Weight of the last measure in the estimate of the present interval
+constexpr double INTERVAL_SMOOTHING = 0.1;
+// How much of the work estimate is kept per frame once work gets shorter
+constexpr double WORK_DECAY = 0.95;
+
+double FramePacer::displayInterval() {
+	GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+	const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+	if (!mode || mode->refreshRate <= 0) {
+		return 1.0 / 60.0;
+	}
+	return 1.0 / mode->refreshRate;
+}
+
+const char* FramePacer::presentModeName(PresentMode mode) {
+	switch (mode) {
+	case PresentMode::Immediate: return "Immediate";
+	case PresentMode::Mailbox: return "Mailbox";
+	case PresentMode::Fifo: return "Fifo";
+	default: return "Unknown";
+	}
+}
+
+FramePacer::FramePacer(const Settings& settings)
+	: m_settings(settings)
+	, m_start(Clock::now())
+	, m_startCpuTime(processCpuTime())
+	, m_interval(settings.targetInterval)
+{}
+
+double FramePacer::now() const {
+	return std::chrono::duration<double>(Clock::now() - m_start).count();
+}
+
+double FramePacer::processCpuTime() {
+#ifdef _WIN32
+	FILETIME creation, exitTime, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exitTime, &kernel, &user)) {
+		return 0.0;
+	}
+	auto seconds = [](FILETIME time) {
+		ULARGE_INTEGER ticks;
+		ticks.LowPart = time.dwLowDateTime;
+		ticks.HighPart = time.dwHighDateTime;
+		// In units of 100 ns
+		return static_cast<double>(ticks.QuadPart) * 1e-7;
+	};
+	return seconds(kernel) + seconds(user);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0.0;
+	}
+	auto seconds = [](timeval time) {
+		return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_usec) * 1e-6;
+	};
+	return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+#endif
+}
+
+void FramePacer::waitForNextFrame() {
+	// Without a present to measure from, or without a target, start at once
+	if (m_settings.sleep && m_lastPresentTime >= 0.0 && m_interval > 0.0) {
+		double wakeTime = m_nextDeadline - m_workEstimate - m_settings.safetyMargin;
+		double waitStart = now();
+		// Returns early on each event, which is processed before sleeping on
+		for (double t = waitStart; t < wakeTime; t = now()) {
+			glfwWaitEventsTimeout(wakeTime - t);
+		}
+		m_waitTime += now() - waitStart;
+	}
+
+	// Pick up whatever came in since the last wake up
+	glfwPollEvents();
+	m_inputTime = now();
+}
+
+void FramePacer::present(SwapChain swapChain) {
+	double work = now() - m_inputTime;
+	m_workEstimate = std::max(work, m_workEstimate * WORK_DECAY);
+
+	swapChain.present();
+
+	double presentTime = now();
+	double latency = presentTime - m_inputTime;
+	m_latencySum += latency;
+	m_maxLatency = std::max(m_maxLatency, latency);
+	++m_frames;
+
+	if (m_lastPresentTime >= 0.0) {
+		double interval = presentTime - m_lastPresentTime;
+		m_intervalSum += interval;
+		++m_intervalCount;
+		// Only Fifo lets the display set the pace, other modes keep to
+		// their target
+		if (m_settings.presentMode == PresentMode::Fifo) {
+			m_interval += INTERVAL_SMOOTHING * (interval - m_interval);
+		}
+	}
+	m_lastPresentTime = presentTime;
+
+	// Fifo presents return on the refresh, which the next one follows.
+	// Otherwise deadlines stay on their own grid, unless we fell behind it.
+	if (m_settings.presentMode == PresentMode::Fifo) {
+		m_nextDeadline = presentTime + m_interval;
+	} else {
+		m_nextDeadline += m_interval;
+		if (m_nextDeadline < presentTime) {
+			m_nextDeadline = presentTime + m_interval;
+		}
+	}
+}
+
+FramePacer::Stats FramePacer::stats() const {
+	Stats stats;
+	stats.frames = m_frames;
+	if (m_intervalCount > 0) {
+		stats.averageIntervalMs = 1000.0 * m_intervalSum / m_intervalCount;
+	}
+	if (m_frames > 0) {
+		stats.averageLatencyMs = 1000.0 * m_latencySum / m_frames;
+		stats.maxLatencyMs = 1000.0 * m_maxLatency;
+	}
+	double wallTime = now();
+	if (wallTime > 0.0) {
+		stats.cpuBusyPercent = 100.0 * (processCpuTime() - m_startCpuTime) / wallTime;
+		stats.idlePercent = 100.0 * m_waitTime / wallTime;
+	}
+	return stats;
+}
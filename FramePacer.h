@@ -0,0 +1,109 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+struct GLFWwindow;
+
+/**
+ * Paces the main loop so that input is sampled as late as possible before
+ * each present, instead of spinning on glfwPollEvents.
+ *
+ * The pacer measures the interval between presents and the CPU time the
+ * application spends between sampling input and presenting, then sleeps in
+ * glfwWaitEventsTimeout until that time before the next deadline, minus a
+ * safety margin. Events that arrive while it sleeps are processed right away
+ * and the thread goes back to sleep, so a frame only starts once its
+ * deadline is near. The sleep is a poll on the display connection, so
+ * the process does not use CPU while it waits.
+ *
+ * With Fifo, presents are locked to the display refresh, and the deadline
+ * follows the measured present-to-present interval. With Mailbox and
+ * Immediate nothing blocks, and the deadline follows the target interval
+ * of the settings, usually the display refresh. A target interval of 0
+ * never sleeps, which gives the lowest latency Immediate can offer at the
+ * cost of a busy CPU.
+ */
+class FramePacer {
+public:
+	struct Settings {
+		wgpu::PresentMode presentMode = wgpu::PresentMode::Fifo;
+		// When false, the pacer only measures, and each frame starts as soon
+		// as the previous one is presented
+		bool sleep = true;
+		// Seconds between presents with Mailbox and Immediate, and initial
+		// estimate of the interval with Fifo
+		double targetInterval = 1.0 / 60.0;
+		// Seconds kept between the estimated end of the work and the
+		// deadline, for the scheduler to wake us up late
+		double safetyMargin = 0.002;
+	};
+
+	struct Stats {
+		uint64_t frames = 0;
+		double averageIntervalMs = 0.0;
+		// From the input sample to the return of present()
+		double averageLatencyMs = 0.0;
+		double maxLatencyMs = 0.0;
+		// Process CPU time over wall time since the pacer was created, all
+		// threads included, so it can exceed 100%
+		double cpuBusyPercent = 0.0;
+		// Share of the wall time spent sleeping in waitForNextFrame()
+		double idlePercent = 0.0;
+	};
+
+	/**
+	 * Refresh interval of the primary monitor, in seconds, or that of 60 Hz
+	 * if it is unknown.
+	 */
+	static double displayInterval();
+
+	static const char* presentModeName(wgpu::PresentMode mode);
+
+	explicit FramePacer(const Settings& settings);
+
+	/**
+	 * Sleep until the next frame has to start, if pacing, then poll events.
+	 * Replaces the call to glfwPollEvents at the start of the frame.
+	 */
+	void waitForNextFrame();
+
+	/**
+	 * Present the frame rendered since waitForNextFrame().
+	 */
+	void present(wgpu::SwapChain swapChain);
+
+	Stats stats() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	// Seconds since the pacer was created
+	double now() const;
+	static double processCpuTime();
+
+private:
+	Settings m_settings;
+	Clock::time_point m_start;
+	double m_startCpuTime;
+
+	// Estimate of the present-to-present interval
+	double m_interval;
+	// Work between the input sample and present, decaying from its peak so
+	// that a single long frame is not forgotten right away
+	double m_workEstimate = 0.0;
+	double m_inputTime = 0.0;
+	// Negative until the first present
+	double m_lastPresentTime = -1.0;
+	// When the next present is due
+	double m_nextDeadline = 0.0;
+
+	uint64_t m_frames = 0;
+	uint64_t m_intervalCount = 0;
+	double m_intervalSum = 0.0;
+	double m_latencySum = 0.0;
+	double m_maxLatency = 0.0;
+	double m_waitTime = 0.0;
+};
@@ -0,0 +1,272 @@
+#include "GpuCulling.h"
+#include "ComputeKernel.h"
+#include "Culling.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace wgpu;
+
+// Number of objects tested by a workgroup
+constexpr uint32_t WORKGROUP_SIZE = 64;
+
+// Matches the CullingParams struct of the shader
+struct CullingParams {
+	float planes[6][4];
+	uint32_t objectCount;
+	// Size of the instance data, in number of vec4f
+	uint32_t instanceStride;
+	uint32_t _pad[2];
+};
+
+static const char* cullingShaderSource = R"(
+struct CullingParams {
+    planes: array<vec4f, 6>,
+    objectCount: u32,
+    instanceStride: u32,
+}
+
+// Same layout as the arguments of drawIndirect
+struct DrawIndirectArgs {
+    vertexCount: u32,
+    instanceCount: atomic<u32>,
+    firstVertex: u32,
+    firstInstance: u32,
+}
+
+@group(0) @binding(0) var<uniform> uParams: CullingParams;
+// Bounding sphere of each object, as (center, radius)
+@group(0) @binding(1) var<storage, read> bounds: array<vec4f>;
+@group(0) @binding(2) var<storage, read> meshIds: array<u32>;
+// Index of the first output slot of each mesh
+@group(0) @binding(3) var<storage, read> meshBases: array<u32>;
+@group(0) @binding(4) var<storage, read> instancesIn: array<vec4f>;
+@group(0) @binding(5) var<storage, read_write> instancesOut: array<vec4f>;
+@group(0) @binding(6) var<storage, read_write> drawArgs: array<DrawIndirectArgs>;
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main(@builtin(global_invocation_id) id: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    // Large scenes are dispatched as a 2D grid of workgroups
+    let i = dispatchIndex(id, groupCount);
+    if (i >= uParams.objectCount) {
+        return;
+    }
+
+    let sphere = bounds[i];
+    for (var p = 0u; p < 6u; p++) {
+        let plane = uParams.planes[p];
+        if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w) {
+            return;
+        }
+    }
+
+    // Append to the visible instances of this object's mesh
+    let mesh = meshIds[i];
+    let slot = meshBases[mesh] + atomicAdd(&drawArgs[mesh].instanceCount, 1u);
+    let stride = uParams.instanceStride;
+    for (var k = 0u; k < stride; k++) {
+        instancesOut[slot * stride + k] = instancesIn[i * stride + k];
+    }
+}
+)";
+
+std::vector<FeatureName> GpuCuller::optionalFeatures() {
+	std::vector<FeatureName> features = { FeatureName::IndirectFirstInstance };
+#ifdef WEBGPU_BACKEND_WGPU
+	features.push_back((WGPUFeatureName)NativeFeature::MultiDrawIndirect);
+#endif
+	return features;
+}
+
+void GpuCuller::requireLimits(WGPULimits& limits, uint32_t objectCount, uint32_t instanceSize) {
+	uint64_t instanceBytes = (uint64_t)objectCount * instanceSize;
+	limits.maxBindGroups = std::max(limits.maxBindGroups, 1u);
+	limits.maxUniformBuffersPerShaderStage = std::max(limits.maxUniformBuffersPerShaderStage, 1u);
+	limits.maxUniformBufferBindingSize = std::max<uint64_t>(limits.maxUniformBufferBindingSize, sizeof(CullingParams));
+	limits.maxStorageBuffersPerShaderStage = std::max(limits.maxStorageBuffersPerShaderStage, 6u);
+	limits.maxStorageBufferBindingSize = std::max(limits.maxStorageBufferBindingSize, instanceBytes);
+	limits.maxBufferSize = std::max(limits.maxBufferSize, instanceBytes);
+	ComputeKernel::requireLimits(limits, WORKGROUP_SIZE, 1, 1, objectCount);
+}
+
+GpuCuller::GpuCuller(Device device, const std::vector<Mesh>& meshes)
+	: m_device(device)
+	, m_meshes(meshes)
+{
+	// Without this feature, the firstInstance member of indirect draw
+	// arguments must be 0, so we bind the instance buffer at a different
+	// offset for each mesh instead.
+	m_hasIndirectFirstInstance = m_device.hasFeature(FeatureName::IndirectFirstInstance);
+#ifdef WEBGPU_BACKEND_WGPU
+	m_useMultiDraw = m_hasIndirectFirstInstance && m_device.hasFeature((WGPUFeatureName)NativeFeature::MultiDrawIndirect);
+#endif
+
+	ComputeKernel::Descriptor kernelDesc;
+	kernelDesc.label = "Culling";
+	kernelDesc.source = cullingShaderSource;
+	kernelDesc.preferredInvocations = WORKGROUP_SIZE;
+	m_kernel = std::make_unique<ComputeKernel>(m_device, kernelDesc);
+
+	BufferDescriptor paramsBufferDesc;
+	paramsBufferDesc.size = sizeof(CullingParams);
+	paramsBufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+	paramsBufferDesc.mappedAtCreation = false;
+	m_paramsBuffer = m_device.createBuffer(paramsBufferDesc);
+}
+
+GpuCuller::~GpuCuller() {
+	releaseSceneBuffers();
+	m_paramsBuffer.release();
+}
+
+void GpuCuller::releaseSceneBuffers() {
+	for (Buffer* buffer : { &m_boundsBuffer, &m_meshIdBuffer, &m_meshBaseBuffer, &m_instanceInputBuffer, &m_instanceOutputBuffer, &m_drawArgsBuffer }) {
+		if (*buffer) {
+			buffer->destroy();
+			buffer->release();
+			*buffer = nullptr;
+		}
+	}
+	if (m_bindGroup) {
+		m_bindGroup.release();
+		m_bindGroup = nullptr;
+	}
+	m_objectCount = 0;
+}
+
+void GpuCuller::setScene(
+	Queue queue,
+	const void* instanceData,
+	uint32_t instanceSize,
+	const BoundsSoA& bounds,
+	const std::vector<uint32_t>& meshIds
+) {
+	assert(instanceSize % 16 == 0);
+	assert(meshIds.size() == bounds.size());
+	releaseSceneBuffers();
+	if (bounds.size() == 0) return;
+
+	m_objectCount = bounds.size();
+	m_instanceSize = instanceSize;
+
+	// Give each mesh a contiguous range of the output buffer, large enough
+	// to hold all of its objects.
+	uint32_t meshCount = static_cast<uint32_t>(m_meshes.size());
+	m_meshCapacities.assign(meshCount, 0);
+	for (uint32_t meshId : meshIds) {
+		assert(meshId < meshCount);
+		++m_meshCapacities[meshId];
+	}
+	m_meshBases.resize(meshCount);
+	m_resetDrawArgs.resize(4 * meshCount);
+	uint32_t base = 0;
+	for (uint32_t mesh = 0; mesh < meshCount; ++mesh) {
+		m_meshBases[mesh] = base;
+		m_resetDrawArgs[4 * mesh + 0] = m_meshes[mesh].vertexCount;
+		m_resetDrawArgs[4 * mesh + 1] = 0;
+		m_resetDrawArgs[4 * mesh + 2] = m_meshes[mesh].firstVertex;
+		m_resetDrawArgs[4 * mesh + 3] = m_hasIndirectFirstInstance ? base : 0;
+		base += m_meshCapacities[mesh];
+	}
+
+	// The shader reads spheres as vec4f rather than as separate arrays
+	std::vector<float> spheres(4 * m_objectCount);
+	for (uint32_t i = 0; i < m_objectCount; ++i) {
+		spheres[4 * i + 0] = bounds.centerX[i];
+		spheres[4 * i + 1] = bounds.centerY[i];
+		spheres[4 * i + 2] = bounds.centerZ[i];
+		spheres[4 * i + 3] = bounds.radius[i];
+	}
+
+	auto createBuffer = [&](uint64_t size, WGPUBufferUsageFlags usage, const void* data) {
+		BufferDescriptor desc;
+		desc.size = size;
+		desc.usage = usage;
+		desc.mappedAtCreation = false;
+		Buffer buffer = m_device.createBuffer(desc);
+		if (data) queue.writeBuffer(buffer, 0, data, size);
+		return buffer;
+	};
+	uint64_t instanceBytes = (uint64_t)m_objectCount * instanceSize;
+	m_boundsBuffer = createBuffer(spheres.size() * sizeof(float), BufferUsage::CopyDst | BufferUsage::Storage, spheres.data());
+	m_meshIdBuffer = createBuffer(meshIds.size() * sizeof(uint32_t), BufferUsage::CopyDst | BufferUsage::Storage, meshIds.data());
+	m_meshBaseBuffer = createBuffer(m_meshBases.size() * sizeof(uint32_t), BufferUsage::CopyDst | BufferUsage::Storage, m_meshBases.data());
+	m_instanceInputBuffer = createBuffer(instanceBytes, BufferUsage::CopyDst | BufferUsage::Storage, instanceData);
+	// The output is both written by the compute shader and read as a vertex buffer
+	m_instanceOutputBuffer = createBuffer(instanceBytes, BufferUsage::Storage | BufferUsage::Vertex, nullptr);
+	m_drawArgsBuffer = createBuffer(m_resetDrawArgs.size() * sizeof(uint32_t), BufferUsage::CopyDst | BufferUsage::Storage | BufferUsage::Indirect, nullptr);
+
+	// Binding 0 is the uniform parameters, 1 to 4 are read-only inputs and
+	// 5, 6 are the outputs.
+	m_bindGroup = m_kernel->createBindGroup(0, {
+		{ 0, m_paramsBuffer },
+		{ 1, m_boundsBuffer },
+		{ 2, m_meshIdBuffer },
+		{ 3, m_meshBaseBuffer },
+		{ 4, m_instanceInputBuffer },
+		{ 5, m_instanceOutputBuffer },
+		{ 6, m_drawArgsBuffer },
+	});
+}
+
+void GpuCuller::updateInstances(Queue queue, uint32_t firstInstance, uint32_t instanceCount, const void* instanceData) {
+	assert(firstInstance + instanceCount <= m_objectCount);
+	if (instanceCount == 0) return;
+	queue.writeBuffer(
+		m_instanceInputBuffer,
+		(uint64_t)firstInstance * m_instanceSize,
+		instanceData,
+		(uint64_t)instanceCount * m_instanceSize
+	);
+}
+
+void GpuCuller::cull(Queue queue, CommandEncoder encoder, const Frustum& frustum) {
+	if (m_objectCount == 0) return;
+
+	CullingParams params{};
+	for (int p = 0; p < 6; ++p) {
+		for (int c = 0; c < 4; ++c) params.planes[p][c] = frustum.planes[p][c];
+	}
+	params.objectCount = m_objectCount;
+	params.instanceStride = m_instanceSize / 16;
+	queue.writeBuffer(m_paramsBuffer, 0, &params, sizeof(CullingParams));
+
+	// Instance counts start from 0 every frame. Queue writes are executed
+	// before the commands submitted after them, so this happens before the
+	// compute pass runs.
+	queue.writeBuffer(m_drawArgsBuffer, 0, m_resetDrawArgs.data(), m_resetDrawArgs.size() * sizeof(uint32_t));
+
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	m_kernel->dispatch(computePass, m_bindGroup, m_objectCount);
+	computePass.end();
+	computePass.release();
+}
+
+void GpuCuller::draw(RenderPassEncoder renderPass, uint32_t instanceSlot) {
+	if (m_objectCount == 0) return;
+	uint32_t meshCount = static_cast<uint32_t>(m_meshes.size());
+
+	if (m_hasIndirectFirstInstance) {
+		renderPass.setVertexBuffer(instanceSlot, m_instanceOutputBuffer, 0, m_instanceOutputBuffer.getSize());
+#ifdef WEBGPU_BACKEND_WGPU
+		if (m_useMultiDraw) {
+			// The whole scene in a single call
+			wgpuRenderPassEncoderMultiDrawIndirect(renderPass, m_drawArgsBuffer, 0, meshCount);
+			return;
+		}
+#endif
+		for (uint32_t mesh = 0; mesh < meshCount; ++mesh) {
+			renderPass.drawIndirect(m_drawArgsBuffer, 4 * mesh * sizeof(uint32_t));
+		}
+		return;
+	}
+
+	for (uint32_t mesh = 0; mesh < meshCount; ++mesh) {
+		if (m_meshCapacities[mesh] == 0) continue;
+		uint64_t offset = (uint64_t)m_meshBases[mesh] * m_instanceSize;
+		uint64_t size = (uint64_t)m_meshCapacities[mesh] * m_instanceSize;
+		renderPass.setVertexBuffer(instanceSlot, m_instanceOutputBuffer, offset, size);
+		renderPass.drawIndirect(m_drawArgsBuffer, 4 * mesh * sizeof(uint32_t));
+	}
+}
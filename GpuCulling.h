@@ -0,0 +1,111 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ComputeKernel;
+struct BoundsSoA;
+struct Frustum;
+
+/**
+ * GPU-driven culling. A compute shader tests the bounding sphere of every
+ * object against the view frustum, copies the instance data of the
+ * survivors into a compacted instance buffer and counts them directly into
+ * indirect draw arguments, one per mesh. The whole scene is then drawn with
+ * one indirect draw per mesh, or a single multi-draw on wgpu-native, without
+ * the CPU ever looking at individual objects during the frame.
+ */
+class GpuCuller {
+public:
+	// A range of the vertex buffer, drawn once per visible instance
+	struct Mesh {
+		uint32_t vertexCount;
+		uint32_t firstVertex;
+	};
+
+	/**
+	 * Features that make the draw submission cheaper when the device has
+	 * them. Request the ones the adapter supports when creating the device.
+	 */
+	static std::vector<wgpu::FeatureName> optionalFeatures();
+
+	/**
+	 * Raise the device limits that culling `objectCount` objects with
+	 * `instanceSize` bytes of instance data requires.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t objectCount, uint32_t instanceSize);
+
+	GpuCuller(wgpu::Device device, const std::vector<Mesh>& meshes);
+	~GpuCuller();
+
+	GpuCuller(const GpuCuller&) = delete;
+	GpuCuller& operator=(const GpuCuller&) = delete;
+
+	/**
+	 * Upload the scene: `instanceSize` bytes of per-instance data (a multiple
+	 * of 16) for each object, the bounds of the objects and the index of the
+	 * mesh each of them uses. This is the only time the CPU touches
+	 * per-object data.
+	 */
+	void setScene(
+		wgpu::Queue queue,
+		const void* instanceData,
+		uint32_t instanceSize,
+		const BoundsSoA& bounds,
+		const std::vector<uint32_t>& meshIds
+	);
+
+	/**
+	 * Overwrite the instance data of objects [firstInstance, firstInstance +
+	 * instanceCount) with `instanceData`, laid out as in setScene(), e.g.
+	 * after their transforms changed. Bounds are left as they are.
+	 */
+	void updateInstances(wgpu::Queue queue, uint32_t firstInstance, uint32_t instanceCount, const void* instanceData);
+
+	/**
+	 * Record the culling compute pass. Must be called before the render
+	 * pass that calls draw() is encoded.
+	 */
+	void cull(wgpu::Queue queue, wgpu::CommandEncoder encoder, const Frustum& frustum);
+
+	/**
+	 * Draw the visible objects, binding their compacted instance data to
+	 * vertex buffer slot `instanceSlot`. The pipeline, bind groups and
+	 * vertex buffer of the meshes must already be set.
+	 */
+	void draw(wgpu::RenderPassEncoder renderPass, uint32_t instanceSlot);
+
+	bool usesMultiDrawIndirect() const { return m_useMultiDraw; }
+
+private:
+	void releaseSceneBuffers();
+
+private:
+	wgpu::Device m_device;
+	std::vector<Mesh> m_meshes;
+	bool m_hasIndirectFirstInstance = false;
+	bool m_useMultiDraw = false;
+
+	std::unique_ptr<ComputeKernel> m_kernel;
+	wgpu::Buffer m_paramsBuffer = nullptr;
+
+	// Scene buffers, (re)created by setScene()
+	uint32_t m_objectCount = 0;
+	uint32_t m_instanceSize = 0;
+	wgpu::Buffer m_boundsBuffer = nullptr;
+	wgpu::Buffer m_meshIdBuffer = nullptr;
+	wgpu::Buffer m_meshBaseBuffer = nullptr;
+	wgpu::Buffer m_instanceInputBuffer = nullptr;
+	wgpu::Buffer m_instanceOutputBuffer = nullptr;
+	wgpu::Buffer m_drawArgsBuffer = nullptr;
+	wgpu::BindGroup m_bindGroup = nullptr;
+
+	// Where the visible instances of each mesh start in the output buffer,
+	// and the draw arguments with instance counts reset to 0.
+	std::vector<uint32_t> m_meshBases;
+	std::vector<uint32_t> m_meshCapacities;
+	std::vector<uint32_t> m_resetDrawArgs;
+};
@@ -0,0 +1,583 @@
+#include "GpuPrimitives.h"
+#include "BindGroupCache.h"
+#include "ComputeKernel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <string>
+
+using namespace wgpu;
+
+// Invocations per workgroup, and elements per invocation. A workgroup
+// handles a block of their product.
+constexpr uint32_t WORKGROUP_SIZE = 256;
+constexpr uint32_t ITEMS_PER_THREAD = 4;
+// The sort handles 8 bits of the keys per pass
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX = 1 << RADIX_BITS;
+constexpr uint32_t SORT_PASSES = 32 / RADIX_BITS;
+// Distance between the uniform slots of the sort passes, which is a
+// multiple of any minUniformBufferOffsetAlignment
+constexpr uint32_t SORT_PARAMS_STRIDE = 256;
+// Size of the SortParams struct, uniforms are bound by 16 bytes
+constexpr uint32_t SORT_PARAMS_SIZE = 16;
+
+// Shared by the kernels that work on blocks of elements
+static const char* blockShaderSource = R"(
+// Matches ITEMS_PER_THREAD
+const ITEMS_PER_THREAD: u32 = 4u;
+const BLOCK_SIZE: u32 = WORKGROUP_SIZE_X * ITEMS_PER_THREAD;
+
+var<workgroup> scratch: array<u32, WORKGROUP_SIZE_X>;
+
+// Index of the block of a workgroup, whose grid may be folded in 2D
+fn blockIndex(group: vec3u, groupCount: vec3u) -> u32 {
+    return group.x + group.y * groupCount.x;
+}
+
+struct WorkgroupScan {
+    // Sum of the values of the invocations before this one
+    prefix: u32,
+    // Sum of the values of all the invocations
+    total: u32,
+}
+
+// Must be called by all the invocations of the workgroup
+fn workgroupScan(local: u32, value: u32) -> WorkgroupScan {
+    scratch[local] = value;
+    workgroupBarrier();
+    for (var offset = 1u; offset < WORKGROUP_SIZE_X; offset *= 2u) {
+        var other = 0u;
+        if (local >= offset) {
+            other = scratch[local - offset];
+        }
+        workgroupBarrier();
+        scratch[local] += other;
+        workgroupBarrier();
+    }
+    let result = WorkgroupScan(scratch[local] - value, scratch[WORKGROUP_SIZE_X - 1u]);
+    // So that the next call does not overwrite what others still read
+    workgroupBarrier();
+    return result;
+}
+)";
+
+// REDUCE_OP and REDUCE_IDENTITY are replaced for each operation
+static const char* reduceShaderSource = R"(
+@group(0) @binding(0) var<storage, read> input: array<u32>;
+// One result per block
+@group(0) @binding(1) var<storage, read_write> output: array<u32>;
+
+fn combine(a: u32, b: u32) -> u32 {
+    return REDUCE_OP;
+}
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main(@builtin(local_invocation_index) local: u32, @builtin(workgroup_id) group: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let block = blockIndex(group, groupCount);
+    let count = arrayLength(&input);
+    // Strided, so that neighboring invocations read neighboring elements
+    var value = REDUCE_IDENTITY;
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        let i = block * BLOCK_SIZE + k * WORKGROUP_SIZE_X + local;
+        if (i < count) {
+            value = combine(value, input[i]);
+        }
+    }
+
+    scratch[local] = value;
+    workgroupBarrier();
+    for (var stride = WORKGROUP_SIZE_X / 2u; stride > 0u; stride /= 2u) {
+        if (local < stride) {
+            scratch[local] = combine(scratch[local], scratch[local + stride]);
+        }
+        workgroupBarrier();
+    }
+    if (local == 0u && block < arrayLength(&output)) {
+        output[block] = scratch[0];
+    }
+}
+)";
+
+static const char* scanShaderSource = R"(
+@group(0) @binding(0) var<storage, read> input: array<u32>;
+@group(0) @binding(1) var<storage, read_write> output: array<u32>;
+// Exclusive prefix sum of the totals of the blocks
+@group(0) @binding(2) var<storage, read> blockOffsets: array<u32>;
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main(@builtin(local_invocation_index) local: u32, @builtin(workgroup_id) group: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let block = blockIndex(group, groupCount);
+    let count = arrayLength(&input);
+    // Each invocation scans consecutive elements, which are then offset by
+    // the total of the invocations and blocks before them
+    let first = block * BLOCK_SIZE + local * ITEMS_PER_THREAD;
+    var items: array<u32, ITEMS_PER_THREAD>;
+    var total = 0u;
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        items[k] = total;
+        if (first + k < count) {
+            total += input[first + k];
+        }
+    }
+
+    let offset = workgroupScan(local, total).prefix + blockOffsets[min(block, arrayLength(&blockOffsets) - 1u)];
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        if (first + k < count) {
+            output[first + k] = offset + items[k];
+        }
+    }
+}
+)";
+
+static const char* histogramShaderSource = R"(
+struct SortParams {
+    shift: u32,
+}
+
+const RADIX: u32 = 256u;
+
+@group(0) @binding(0) var<uniform> uParams: SortParams;
+@group(0) @binding(1) var<storage, read> keys: array<u32>;
+// Number of keys of each digit in each block, digit major, so that its
+// exclusive scan is where each block writes its keys of each digit
+@group(0) @binding(2) var<storage, read_write> histograms: array<u32>;
+
+var<workgroup> digitCounts: array<atomic<u32>, RADIX>;
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main(@builtin(local_invocation_index) local: u32, @builtin(workgroup_id) group: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let block = blockIndex(group, groupCount);
+    let count = arrayLength(&keys);
+    let blockCount = arrayLength(&histograms) / RADIX;
+    for (var d = local; d < RADIX; d += WORKGROUP_SIZE_X) {
+        atomicStore(&digitCounts[d], 0u);
+    }
+    workgroupBarrier();
+
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        let i = block * BLOCK_SIZE + k * WORKGROUP_SIZE_X + local;
+        if (i < count) {
+            atomicAdd(&digitCounts[(keys[i] >> uParams.shift) & (RADIX - 1u)], 1u);
+        }
+    }
+    workgroupBarrier();
+
+    if (block < blockCount) {
+        for (var d = local; d < RADIX; d += WORKGROUP_SIZE_X) {
+            histograms[d * blockCount + block] = atomicLoad(&digitCounts[d]);
+        }
+    }
+}
+)";
+
+// HAS_VALUES is defined for each variant
+static const char* scatterShaderSource = R"(
+struct SortParams {
+    shift: u32,
+}
+
+const RADIX: u32 = 256u;
+const RADIX_BITS: u32 = 8u;
+
+@group(0) @binding(0) var<uniform> uParams: SortParams;
+@group(0) @binding(1) var<storage, read> keysIn: array<u32>;
+@group(0) @binding(2) var<storage, read> valuesIn: array<u32>;
+@group(0) @binding(3) var<storage, read_write> keysOut: array<u32>;
+@group(0) @binding(4) var<storage, read_write> valuesOut: array<u32>;
+// Exclusive scan of the histograms
+@group(0) @binding(5) var<storage, read> digitOffsets: array<u32>;
+
+var<workgroup> blockKeys: array<u32, BLOCK_SIZE>;
+var<workgroup> blockValues: array<u32, BLOCK_SIZE>;
+// Position of the first key of each digit in the sorted block
+var<workgroup> digitStarts: array<u32, RADIX>;
+
+fn digitOf(key: u32) -> u32 {
+    return (key >> uParams.shift) & (RADIX - 1u);
+}
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main(@builtin(local_invocation_index) local: u32, @builtin(workgroup_id) group: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let block = blockIndex(group, groupCount);
+    let count = arrayLength(&keysIn);
+    let blockCount = arrayLength(&digitOffsets) / RADIX;
+
+    // Keys past the end get the last digit, so that the stable sort of the
+    // block leaves them after all the others
+    let first = block * BLOCK_SIZE + local * ITEMS_PER_THREAD;
+    var keys: array<u32, ITEMS_PER_THREAD>;
+    var values: array<u32, ITEMS_PER_THREAD>;
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        keys[k] = 0xffffffffu;
+        values[k] = 0u;
+        if (first + k < count) {
+            keys[k] = keysIn[first + k];
+            if (HAS_VALUES) {
+                values[k] = valuesIn[first + k];
+            }
+        }
+    }
+
+    // Sort the block by digit, one stable split on each of its bits: the
+    // keys with a 0 go first, in order, then those with a 1
+    for (var bit = 0u; bit < RADIX_BITS; bit++) {
+        var zeros = 0u;
+        for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+            zeros += 1u - ((digitOf(keys[k]) >> bit) & 1u);
+        }
+        let zeroScan = workgroupScan(local, zeros);
+        var zerosBefore = zeroScan.prefix;
+        for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+            let isOne = (digitOf(keys[k]) >> bit) & 1u;
+            let position = local * ITEMS_PER_THREAD + k;
+            var destination = zerosBefore;
+            if (isOne == 1u) {
+                // After all the zeros and the ones before it
+                destination = zeroScan.total + position - zerosBefore;
+            }
+            blockKeys[destination] = keys[k];
+            blockValues[destination] = values[k];
+            zerosBefore += 1u - isOne;
+        }
+        workgroupBarrier();
+        for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+            keys[k] = blockKeys[local * ITEMS_PER_THREAD + k];
+            values[k] = blockValues[local * ITEMS_PER_THREAD + k];
+        }
+        workgroupBarrier();
+    }
+
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        let position = local * ITEMS_PER_THREAD + k;
+        let digit = digitOf(keys[k]);
+        if (position == 0u || digitOf(blockKeys[position - 1u]) != digit) {
+            digitStarts[digit] = position;
+        }
+    }
+    workgroupBarrier();
+
+    // Keys keep their rank among the keys of their digit in the block
+    for (var k = 0u; k < ITEMS_PER_THREAD; k++) {
+        let position = local * ITEMS_PER_THREAD + k;
+        if (block * BLOCK_SIZE + position < count) {
+            let digit = digitOf(keys[k]);
+            let destination = digitOffsets[digit * blockCount + block] + position - digitStarts[digit];
+            keysOut[destination] = keys[k];
+            if (HAS_VALUES) {
+                valuesOut[destination] = values[k];
+            }
+        }
+    }
+}
+)";
+
+static const char* compactShaderSource = R"(
+@group(0) @binding(0) var<storage, read> values: array<u32>;
+@group(0) @binding(1) var<storage, read> flags: array<u32>;
+// Exclusive scan of the flags, i.e. where each kept value goes
+@group(0) @binding(2) var<storage, read> offsets: array<u32>;
+@group(0) @binding(3) var<storage, read_write> output: array<u32>;
+@group(0) @binding(4) var<storage, read_write> keptCount: u32;
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main(@builtin(global_invocation_id) id: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let i = dispatchIndex(id, groupCount);
+    let count = arrayLength(&values);
+    if (i >= count) {
+        return;
+    }
+    if (flags[i] != 0u) {
+        output[offsets[i]] = values[i];
+    }
+    if (i == count - 1u) {
+        keptCount = offsets[i] + flags[i];
+    }
+}
+)";
+
+namespace {
+
+std::string replaceAll(std::string source, const std::string& from, const std::string& to) {
+	for (size_t pos = source.find(from); pos != std::string::npos; pos = source.find(from, pos + to.size())) {
+		source.replace(pos, from.size(), to);
+	}
+	return source;
+}
+
+std::unique_ptr<ComputeKernel> createKernel(Device device, const char* label, const std::string& source) {
+	ComputeKernel::Descriptor kernelDesc;
+	kernelDesc.label = label;
+	kernelDesc.source = source.c_str();
+	kernelDesc.preferredInvocations = WORKGROUP_SIZE;
+	return std::make_unique<ComputeKernel>(device, kernelDesc);
+}
+
+Buffer createBuffer(Device device, const char* label, uint64_t size, WGPUBufferUsageFlags usage) {
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = label;
+	bufferDesc.size = size;
+	bufferDesc.usage = usage;
+	bufferDesc.mappedAtCreation = false;
+	return device.createBuffer(bufferDesc);
+}
+
+// Dispatch one workgroup per block
+void dispatchBlocks(ComputePassEncoder computePass, const ComputeKernel& kernel, BindGroup bindGroup, uint32_t blockCount) {
+	kernel.dispatch(computePass, bindGroup, blockCount * kernel.workgroupSize()[0]);
+}
+
+void endPass(ComputePassEncoder computePass) {
+	computePass.end();
+	computePass.release();
+}
+
+} // namespace
+
+void GpuPrimitives::requireLimits(WGPULimits& limits, uint64_t maxCount) {
+	uint64_t blockSize = WORKGROUP_SIZE * ITEMS_PER_THREAD;
+	uint64_t histogramBytes = (maxCount + blockSize - 1) / blockSize * RADIX * sizeof(uint32_t);
+	uint64_t bytes = std::max(maxCount * sizeof(uint32_t), histogramBytes);
+	// The scatter of the sort holds a block of keys and values
+	uint32_t workgroupStorage = (2 * WORKGROUP_SIZE * ITEMS_PER_THREAD + WORKGROUP_SIZE + RADIX) * sizeof(uint32_t);
+	limits.maxBindGroups = std::max(limits.maxBindGroups, 1u);
+	limits.maxUniformBuffersPerShaderStage = std::max(limits.maxUniformBuffersPerShaderStage, 1u);
+	limits.maxUniformBufferBindingSize = std::max<uint64_t>(limits.maxUniformBufferBindingSize, SORT_PARAMS_SIZE);
+	limits.maxStorageBuffersPerShaderStage = std::max(limits.maxStorageBuffersPerShaderStage, 5u);
+	limits.maxStorageBufferBindingSize = std::max(limits.maxStorageBufferBindingSize, bytes);
+	limits.maxBufferSize = std::max(limits.maxBufferSize, bytes);
+	limits.maxComputeWorkgroupStorageSize = std::max(limits.maxComputeWorkgroupStorageSize, workgroupStorage);
+	ComputeKernel::requireLimits(limits, WORKGROUP_SIZE, 1, 1, maxCount);
+}
+
+GpuPrimitives::GpuPrimitives(Device device)
+	: m_device(device)
+	, m_bindGroupCache(std::make_unique<BindGroupCache>(device))
+{
+	const char* reduceOps[3][2] = {
+		{ "a + b", "0u" },
+		{ "min(a, b)", "0xffffffffu" },
+		{ "max(a, b)", "0u" },
+	};
+	for (int op = 0; op < 3; ++op) {
+		std::string source = std::string(blockShaderSource) + reduceShaderSource;
+		source = replaceAll(source, "REDUCE_OP", reduceOps[op][0]);
+		source = replaceAll(source, "REDUCE_IDENTITY", reduceOps[op][1]);
+		m_reduceKernels[op] = createKernel(m_device, "Reduce", source);
+	}
+	m_scanKernel = createKernel(m_device, "Scan", std::string(blockShaderSource) + scanShaderSource);
+	m_histogramKernel = createKernel(m_device, "Radix sort histogram", std::string(blockShaderSource) + histogramShaderSource);
+	std::string scatterSource = std::string(blockShaderSource) + scatterShaderSource;
+	m_scatterKeysKernel = createKernel(m_device, "Radix sort scatter", scatterSource + "\nconst HAS_VALUES = false;\n");
+	m_scatterPairsKernel = createKernel(m_device, "Radix sort scatter", scatterSource + "\nconst HAS_VALUES = true;\n");
+	m_compactKernel = createKernel(m_device, "Compaction", compactShaderSource);
+	// All the block kernels get the same workgroup size, as they are built
+	// with the same limits
+	m_blockSize = m_scanKernel->workgroupSize()[0] * ITEMS_PER_THREAD;
+
+	m_zeroBuffer = createBuffer(m_device, "Zero", sizeof(uint32_t), BufferUsage::Storage);
+	m_unusedBuffer = createBuffer(m_device, "Unused values", sizeof(uint32_t), BufferUsage::Storage);
+	m_resultBuffer = createBuffer(m_device, "Primitive result", sizeof(uint32_t), BufferUsage::Storage | BufferUsage::CopySrc);
+
+	// Constant, so written once through a mapping rather than every sort
+	BufferDescriptor paramsDesc;
+	paramsDesc.label = "Sort params";
+	paramsDesc.size = SORT_PASSES * SORT_PARAMS_STRIDE;
+	paramsDesc.usage = BufferUsage::Uniform;
+	paramsDesc.mappedAtCreation = true;
+	m_sortParamsBuffer = m_device.createBuffer(paramsDesc);
+	uint8_t* params = static_cast<uint8_t*>(m_sortParamsBuffer.getMappedRange(0, paramsDesc.size));
+	std::memset(params, 0, paramsDesc.size);
+	for (uint32_t pass = 0; pass < SORT_PASSES; ++pass) {
+		uint32_t shift = pass * RADIX_BITS;
+		std::memcpy(params + pass * SORT_PARAMS_STRIDE, &shift, sizeof(shift));
+	}
+	m_sortParamsBuffer.unmap();
+}
+
+GpuPrimitives::~GpuPrimitives() {
+	// Bind groups first, they reference the buffers
+	m_bindGroupCache.reset();
+	std::vector<Buffer> buffers = {
+		m_sortParamsBuffer, m_zeroBuffer, m_unusedBuffer, m_resultBuffer,
+		m_sortKeys, m_sortValues, m_histograms, m_histogramOffsets, m_compactOffsets,
+	};
+	for (const Level& level : m_levels) {
+		buffers.push_back(level.blockSums);
+		buffers.push_back(level.blockOffsets);
+	}
+	for (Buffer buffer : buffers) {
+		if (buffer) {
+			buffer.destroy();
+			buffer.release();
+		}
+	}
+}
+
+void GpuPrimitives::evict(Buffer buffer) {
+	m_bindGroupCache->evict(buffer);
+}
+
+void GpuPrimitives::reserve(Buffer& buffer, uint64_t size, const char* label) {
+	if (buffer && buffer.getSize() >= size) return;
+	if (buffer) {
+		// Not destroyed, as commands recorded but not yet submitted may
+		// still use it. Releasing it lets it go once they are done.
+		m_bindGroupCache->evict(buffer);
+		buffer.release();
+	}
+	buffer = createBuffer(m_device, label, size, BufferUsage::Storage);
+}
+
+void GpuPrimitives::reserveScan(uint32_t count) {
+	// Reserved before recording, as buffers cannot be replaced while
+	// commands of the open pass use them
+	uint32_t level = 0;
+	for (uint32_t blocks = blockCount(count); blocks > 1; blocks = blockCount(blocks), ++level) {
+		if (m_levels.size() <= level) {
+			m_levels.push_back(Level{});
+		}
+		reserve(m_levels[level].blockSums, blocks * sizeof(uint32_t), "Scan block sums");
+		reserve(m_levels[level].blockOffsets, blocks * sizeof(uint32_t), "Scan block offsets");
+	}
+}
+
+void GpuPrimitives::scan(ComputePassEncoder computePass, Buffer input, Buffer output, uint32_t count, uint32_t level) {
+	uint32_t blocks = blockCount(count);
+	Buffer blockOffsets = m_zeroBuffer;
+	uint64_t blockOffsetsSize = sizeof(uint32_t);
+	if (blocks > 1) {
+		// Reduce the blocks, then scan their totals
+		const Level& scratch = m_levels[level];
+		BindGroup reduceBindGroup = m_reduceKernels[(int)ReduceOp::Sum]->getBindGroup(*m_bindGroupCache, 0, {
+			{ 0, input, 0, count * sizeof(uint32_t) },
+			{ 1, scratch.blockSums, 0, blocks * sizeof(uint32_t) },
+		});
+		dispatchBlocks(computePass, *m_reduceKernels[(int)ReduceOp::Sum], reduceBindGroup, blocks);
+		scan(computePass, scratch.blockSums, scratch.blockOffsets, blocks, level + 1);
+		blockOffsets = scratch.blockOffsets;
+		blockOffsetsSize = blocks * sizeof(uint32_t);
+	}
+
+	BindGroup scanBindGroup = m_scanKernel->getBindGroup(*m_bindGroupCache, 0, {
+		{ 0, input, 0, count * sizeof(uint32_t) },
+		{ 1, output, 0, count * sizeof(uint32_t) },
+		{ 2, blockOffsets, 0, blockOffsetsSize },
+	});
+	dispatchBlocks(computePass, *m_scanKernel, scanBindGroup, blocks);
+}
+
+void GpuPrimitives::exclusiveScan(CommandEncoder encoder, Buffer input, Buffer output, uint32_t count) {
+	assert((WGPUBuffer)input != (WGPUBuffer)output && "The scan is not done in place");
+	if (count == 0) return;
+	reserveScan(count);
+
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	scan(computePass, input, output, count, 0);
+	endPass(computePass);
+}
+
+void GpuPrimitives::reduce(CommandEncoder encoder, ReduceOp op, Buffer input, uint32_t count, Buffer result, uint64_t resultOffset) {
+	assert(count > 0);
+	reserveScan(count);
+
+	// Each level reduces the blocks of the previous one, down to one block
+	const ComputeKernel& kernel = *m_reduceKernels[(int)op];
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	Buffer levelInput = input;
+	for (uint32_t level = 0; ; ++level) {
+		uint32_t blocks = blockCount(count);
+		Buffer levelOutput = blocks == 1 ? m_resultBuffer : m_levels[level].blockSums;
+		BindGroup bindGroup = kernel.getBindGroup(*m_bindGroupCache, 0, {
+			{ 0, levelInput, 0, count * sizeof(uint32_t) },
+			{ 1, levelOutput, 0, blocks * sizeof(uint32_t) },
+		});
+		dispatchBlocks(computePass, kernel, bindGroup, blocks);
+		if (blocks == 1) break;
+		levelInput = levelOutput;
+		count = blocks;
+	}
+	endPass(computePass);
+	encoder.copyBufferToBuffer(m_resultBuffer, 0, result, resultOffset, sizeof(uint32_t));
+}
+
+void GpuPrimitives::sort(CommandEncoder encoder, Buffer keys, Buffer values, uint32_t count) {
+	if (count <= 1) return;
+	uint32_t blocks = blockCount(count);
+	uint32_t histogramCount = blocks * RADIX;
+	reserve(m_sortKeys, count * sizeof(uint32_t), "Sort keys");
+	if (values) {
+		reserve(m_sortValues, count * sizeof(uint32_t), "Sort values");
+	}
+	reserve(m_histograms, histogramCount * sizeof(uint32_t), "Sort histograms");
+	reserve(m_histogramOffsets, histogramCount * sizeof(uint32_t), "Sort histogram offsets");
+	reserveScan(histogramCount);
+
+	// Each pass is a counting sort on a digit: count the digits of each
+	// block, scan the counts to know where each block writes each digit,
+	// then move the keys there. An even number of passes leaves the
+	// result back in the buffers given.
+	const ComputeKernel& scatterKernel = values ? *m_scatterPairsKernel : *m_scatterKeysKernel;
+	uint64_t keysSize = count * sizeof(uint32_t);
+	uint64_t histogramSize = histogramCount * sizeof(uint32_t);
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	for (uint32_t pass = 0; pass < SORT_PASSES; ++pass) {
+		bool fromScratch = pass % 2 == 1;
+		Buffer keysIn = fromScratch ? m_sortKeys : keys;
+		Buffer keysOut = fromScratch ? keys : m_sortKeys;
+		Buffer valuesIn = m_zeroBuffer;
+		Buffer valuesOut = m_unusedBuffer;
+		uint64_t valuesSize = sizeof(uint32_t);
+		if (values) {
+			valuesIn = fromScratch ? m_sortValues : values;
+			valuesOut = fromScratch ? values : m_sortValues;
+			valuesSize = keysSize;
+		}
+
+		BindGroup histogramBindGroup = m_histogramKernel->getBindGroup(*m_bindGroupCache, 0, {
+			{ 0, m_sortParamsBuffer, pass * SORT_PARAMS_STRIDE, SORT_PARAMS_SIZE },
+			{ 1, keysIn, 0, keysSize },
+			{ 2, m_histograms, 0, histogramSize },
+		});
+		dispatchBlocks(computePass, *m_histogramKernel, histogramBindGroup, blocks);
+
+		scan(computePass, m_histograms, m_histogramOffsets, histogramCount, 0);
+
+		BindGroup scatterBindGroup = scatterKernel.getBindGroup(*m_bindGroupCache, 0, {
+			{ 0, m_sortParamsBuffer, pass * SORT_PARAMS_STRIDE, SORT_PARAMS_SIZE },
+			{ 1, keysIn, 0, keysSize },
+			{ 2, valuesIn, 0, valuesSize },
+			{ 3, keysOut, 0, keysSize },
+			{ 4, valuesOut, 0, valuesSize },
+			{ 5, m_histogramOffsets, 0, histogramSize },
+		});
+		dispatchBlocks(computePass, scatterKernel, scatterBindGroup, blocks);
+	}
+	endPass(computePass);
+}
+
+void GpuPrimitives::compact(CommandEncoder encoder, Buffer values, Buffer flags, uint32_t count, Buffer output, Buffer countBuffer, uint64_t countOffset) {
+	assert(count > 0);
+	reserve(m_compactOffsets, count * sizeof(uint32_t), "Compaction offsets");
+	reserveScan(count);
+
+	// Kept values go at the exclusive scan of the flags
+	uint64_t size = count * sizeof(uint32_t);
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	scan(computePass, flags, m_compactOffsets, count, 0);
+	BindGroup bindGroup = m_compactKernel->getBindGroup(*m_bindGroupCache, 0, {
+		{ 0, values, 0, size },
+		{ 1, flags, 0, size },
+		{ 2, m_compactOffsets, 0, size },
+		{ 3, output },
+		{ 4, m_resultBuffer },
+	});
+	m_compactKernel->dispatch(computePass, bindGroup, count);
+	endPass(computePass);
+	encoder.copyBufferToBuffer(m_resultBuffer, 0, countBuffer, countOffset, sizeof(uint32_t));
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class BindGroupCache;
+class ComputeKernel;
+
+/**
+ * Data parallel building blocks on u32 arrays, recorded into a command
+ * encoder: exclusive prefix sum, reductions, radix sort of keys or key/value
+ * pairs and stream compaction.
+ *
+ * Each workgroup handles a block of consecutive elements. Scans are done by
+ * reduce-then-scan: the totals of the blocks are reduced, scanned in turn
+ * (recursively, until they fit in one block) and added back while scanning
+ * the blocks. This reads the input twice, where a single pass scan with
+ * decoupled look-back would read it once, but the latter relies on
+ * workgroups waiting for each other, which WebGPU does not guarantee to
+ * ever make progress.
+ *
+ * Element arrays are bound exactly, from offset 0, so buffers may be
+ * larger than the `count` they are given. They need the Storage usage, and
+ * the buffers results are copied to need CopyDst. Bind groups are cached
+ * per buffer and count, so call evict() before releasing a buffer that was
+ * given to any of these functions. Scratch buffers are grown as needed and
+ * kept for the next calls.
+ */
+class GpuPrimitives {
+public:
+	enum class ReduceOp {
+		Sum,
+		Min,
+		Max,
+	};
+
+	/**
+	 * Raise the device limits needed to process up to `maxCount` elements.
+	 */
+	static void requireLimits(WGPULimits& limits, uint64_t maxCount);
+
+	GpuPrimitives(wgpu::Device device);
+	~GpuPrimitives();
+
+	GpuPrimitives(const GpuPrimitives&) = delete;
+	GpuPrimitives& operator=(const GpuPrimitives&) = delete;
+
+	/**
+	 * Write the exclusive prefix sum of the first `count` elements of
+	 * `input` to `output`, which must be a different buffer. Sums wrap
+	 * around at 2^32.
+	 */
+	void exclusiveScan(wgpu::CommandEncoder encoder, wgpu::Buffer input, wgpu::Buffer output, uint32_t count);
+
+	/**
+	 * Reduce the first `count` elements of `input` with `op` and write the
+	 * result to the u32 at `resultOffset` (a multiple of 4) in `result`.
+	 */
+	void reduce(wgpu::CommandEncoder encoder, ReduceOp op, wgpu::Buffer input, uint32_t count, wgpu::Buffer result, uint64_t resultOffset = 0);
+
+	/**
+	 * Sort the first `count` keys in ascending order, and move the values
+	 * along with them if `values` is not null. The sort is stable. It is
+	 * done in place, through scratch buffers as large as the data.
+	 */
+	void sort(wgpu::CommandEncoder encoder, wgpu::Buffer keys, wgpu::Buffer values, uint32_t count);
+
+	/**
+	 * Copy the values whose flag is 1 to the start of `output`, in order,
+	 * and write how many there are to the u32 at `countOffset` in
+	 * `countBuffer`. Flags must be 0 or 1.
+	 */
+	void compact(
+		wgpu::CommandEncoder encoder,
+		wgpu::Buffer values,
+		wgpu::Buffer flags,
+		uint32_t count,
+		wgpu::Buffer output,
+		wgpu::Buffer countBuffer,
+		uint64_t countOffset = 0
+	);
+
+	/**
+	 * Forget the bind groups that bind `buffer`, which is about to be
+	 * released.
+	 */
+	void evict(wgpu::Buffer buffer);
+
+	// Number of elements each workgroup processes
+	uint32_t blockSize() const { return m_blockSize; }
+
+private:
+	// Scratch of one level of the recursion of the scan
+	struct Level {
+		wgpu::Buffer blockSums = nullptr;
+		wgpu::Buffer blockOffsets = nullptr;
+	};
+
+	uint32_t blockCount(uint32_t count) const { return (count + m_blockSize - 1) / m_blockSize; }
+	void reserve(wgpu::Buffer& buffer, uint64_t size, const char* label);
+	void reserveScan(uint32_t count);
+	// Record a scan into an open compute pass, using the scratch of the
+	// levels from `level` on
+	void scan(wgpu::ComputePassEncoder computePass, wgpu::Buffer input, wgpu::Buffer output, uint32_t count, uint32_t level);
+
+private:
+	wgpu::Device m_device;
+	std::unique_ptr<BindGroupCache> m_bindGroupCache;
+	uint32_t m_blockSize = 0;
+
+	std::unique_ptr<ComputeKernel> m_reduceKernels[3];
+	std::unique_ptr<ComputeKernel> m_scanKernel;
+	std::unique_ptr<ComputeKernel> m_histogramKernel;
+	std::unique_ptr<ComputeKernel> m_scatterKeysKernel;
+	std::unique_ptr<ComputeKernel> m_scatterPairsKernel;
+	std::unique_ptr<ComputeKernel> m_compactKernel;
+
+	// The shift of each pass of the sort, one per uniform slot
+	wgpu::Buffer m_sortParamsBuffer = nullptr;
+	// A single 0, the offset of scans that fit in one block
+	wgpu::Buffer m_zeroBuffer = nullptr;
+	// Bound in place of values when sorting keys alone
+	wgpu::Buffer m_unusedBuffer = nullptr;
+	// Where reductions and counts are written before being copied out
+	wgpu::Buffer m_resultBuffer = nullptr;
+
+	std::vector<Level> m_levels;
+	wgpu::Buffer m_sortKeys = nullptr;
+	wgpu::Buffer m_sortValues = nullptr;
+	wgpu::Buffer m_histograms = nullptr;
+	wgpu::Buffer m_histogramOffsets = nullptr;
+	wgpu::Buffer m_compactOffsets = nullptr;
+};
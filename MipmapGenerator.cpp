@@ -0,0 +1,342 @@
+#include "MipmapGenerator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+// Texels of the first level written by a dispatch, per workgroup and per dimension
+constexpr uint32_t WORKGROUP_SIZE = 8;
+// Levels written by a single dispatch, the first one included
+constexpr uint32_t LEVELS_PER_DISPATCH = 4;
+// Largest minUniformBufferOffsetAlignment allowed by WebGPU
+constexpr uint32_t PARAMS_ALIGNMENT = 256;
+
+// Matches the MipParams struct of the shader
+struct MipParams {
+	uint32_t levelCount;
+	uint32_t srgb;
+	uint32_t _pad[2];
+};
+
+// FORMAT is replaced by the storage format of the texture
+static const char* mipmapShaderSource = R"(
+struct MipParams {
+    levelCount: u32,
+    srgb: u32,
+}
+
+@group(0) @binding(0) var<uniform> uParams: MipParams;
+@group(0) @binding(1) var source: texture_2d<f32>;
+@group(0) @binding(2) var level1: texture_storage_2d<FORMAT, write>;
+@group(0) @binding(3) var level2: texture_storage_2d<FORMAT, write>;
+@group(0) @binding(4) var level3: texture_storage_2d<FORMAT, write>;
+@group(0) @binding(5) var level4: texture_storage_2d<FORMAT, write>;
+
+// Texels of the last level computed by the workgroup
+var<workgroup> tile: array<vec4f, 64>;
+
+fn toLinear(c: vec4f) -> vec4f {
+    if (uParams.srgb == 0u) {
+        return c;
+    }
+    let rgb = select(pow((c.rgb + 0.055) / 1.055, vec3f(2.4)), c.rgb / 12.92, c.rgb <= vec3f(0.04045));
+    return vec4f(rgb, c.a);
+}
+
+fn fromLinear(c: vec4f) -> vec4f {
+    if (uParams.srgb == 0u) {
+        return c;
+    }
+    let rgb = select(1.055 * pow(c.rgb, vec3f(1.0 / 2.4)) - 0.055, c.rgb * 12.92, c.rgb <= vec3f(0.0031308));
+    return vec4f(rgb, c.a);
+}
+
+fn load(p: vec2i, size: vec2i) -> vec4f {
+    return toLinear(textureLoad(source, min(p, size - 1), 0));
+}
+
+fn levelSize(sourceSize: vec2i, level: u32) -> vec2i {
+    return max(sourceSize >> vec2u(level), vec2i(1));
+}
+
+@compute @workgroup_size(8, 8)
+fn cs_main(
+    @builtin(global_invocation_id) id: vec3u,
+    @builtin(local_invocation_id) local: vec3u,
+    @builtin(local_invocation_index) index: u32,
+) {
+    let sourceSize = vec2i(textureDimensions(source, 0));
+    var p = vec2i(id.xy);
+    var color = 0.25 * (
+        load(2 * p, sourceSize) + load(2 * p + vec2i(1, 0), sourceSize) +
+        load(2 * p + vec2i(0, 1), sourceSize) + load(2 * p + vec2i(1, 1), sourceSize)
+    );
+    if (all(p < levelSize(sourceSize, 1u))) {
+        textureStore(level1, p, fromLinear(color));
+    }
+    tile[index] = color;
+
+    // Each next level is computed by a quarter of the threads of the
+    // previous one, from the 2x2 texels of the tile around them
+    for (var level = 2u; level <= uParams.levelCount; level++) {
+        let step = 1u << (level - 2u);
+        let active = ((local.x | local.y) & (2u * step - 1u)) == 0u;
+        workgroupBarrier();
+        if (active) {
+            color = 0.25 * (color + tile[index + step] + tile[index + 8u * step] + tile[index + 9u * step]);
+        }
+        workgroupBarrier();
+        if (active) {
+            tile[index] = color;
+            p = p / 2;
+            if (all(p < levelSize(sourceSize, level))) {
+                switch level {
+                    case 2u: { textureStore(level2, p, fromLinear(color)); }
+                    case 3u: { textureStore(level3, p, fromLinear(color)); }
+                    default: { textureStore(level4, p, fromLinear(color)); }
+                }
+            }
+        }
+    }
+}
+)";
+
+static const char* storageFormatName(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::RGBA8Unorm: return "rgba8unorm";
+	case TextureFormat::RGBA16Float: return "rgba16float";
+	case TextureFormat::RGBA32Float: return "rgba32float";
+	default: return nullptr;
+	}
+}
+
+static uint32_t mipSize(uint32_t size, uint32_t level) {
+	return std::max(size >> level, 1u);
+}
+
+uint32_t MipmapGenerator::mipLevelCount(uint32_t width, uint32_t height) {
+	uint32_t count = 1;
+	while (mipSize(width, count - 1) > 1 || mipSize(height, count - 1) > 1) {
+		++count;
+	}
+	return count;
+}
+
+void MipmapGenerator::requireLimits(WGPULimits& limits, uint32_t maxTextureSize) {
+	uint32_t workgroupCount = (mipSize(maxTextureSize, 1) + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+	limits.maxBindGroups = std::max(limits.maxBindGroups, 1u);
+	limits.maxUniformBuffersPerShaderStage = std::max(limits.maxUniformBuffersPerShaderStage, 1u);
+	limits.maxDynamicUniformBuffersPerPipelineLayout = std::max(limits.maxDynamicUniformBuffersPerPipelineLayout, 1u);
+	limits.maxUniformBufferBindingSize = std::max<uint64_t>(limits.maxUniformBufferBindingSize, sizeof(MipParams));
+	limits.maxSampledTexturesPerShaderStage = std::max(limits.maxSampledTexturesPerShaderStage, 1u);
+	limits.maxStorageTexturesPerShaderStage = std::max(limits.maxStorageTexturesPerShaderStage, LEVELS_PER_DISPATCH);
+	limits.maxTextureDimension2D = std::max(limits.maxTextureDimension2D, maxTextureSize);
+	limits.maxTextureArrayLayers = std::max(limits.maxTextureArrayLayers, LEVELS_PER_DISPATCH - 1);
+	limits.maxComputeWorkgroupSizeX = std::max(limits.maxComputeWorkgroupSizeX, WORKGROUP_SIZE);
+	limits.maxComputeWorkgroupSizeY = std::max(limits.maxComputeWorkgroupSizeY, WORKGROUP_SIZE);
+	limits.maxComputeWorkgroupSizeZ = std::max(limits.maxComputeWorkgroupSizeZ, 1u);
+	limits.maxComputeInvocationsPerWorkgroup = std::max(limits.maxComputeInvocationsPerWorkgroup, WORKGROUP_SIZE * WORKGROUP_SIZE);
+	limits.maxComputeWorkgroupStorageSize = std::max<uint32_t>(limits.maxComputeWorkgroupStorageSize, WORKGROUP_SIZE * WORKGROUP_SIZE * 4 * sizeof(float));
+	limits.maxComputeWorkgroupsPerDimension = std::max(limits.maxComputeWorkgroupsPerDimension, workgroupCount);
+}
+
+MipmapGenerator::MipmapGenerator(Device device)
+	: m_device(device)
+{}
+
+MipmapGenerator::~MipmapGenerator() {
+	for (auto& it : m_pipelines) {
+		FormatPipeline& p = it.second;
+		for (TextureView view : p.dummyViews) {
+			view.release();
+		}
+		p.dummyTexture.destroy();
+		p.dummyTexture.release();
+		p.pipeline.release();
+		p.pipelineLayout.release();
+		p.bindGroupLayout.release();
+	}
+}
+
+MipmapGenerator::FormatPipeline& MipmapGenerator::formatPipeline(TextureFormat format) {
+	auto it = m_pipelines.find(format);
+	if (it != m_pipelines.end()) return it->second;
+
+	const char* formatName = storageFormatName(format);
+	assert(formatName != nullptr && "Unsupported texture format for mipmap generation");
+	std::string source = mipmapShaderSource;
+	for (size_t pos = source.find("FORMAT"); pos != std::string::npos; pos = source.find("FORMAT", pos)) {
+		source.replace(pos, 6, formatName);
+	}
+
+	FormatPipeline p;
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = source.c_str();
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = m_device.createShaderModule(shaderDesc);
+
+	// Binding 0 is the parameters, 1 the source level and 2 to 5 the
+	// levels written
+	std::vector<BindGroupLayoutEntry> bindingLayouts(2 + LEVELS_PER_DISPATCH, Default);
+	for (uint32_t i = 0; i < bindingLayouts.size(); ++i) {
+		bindingLayouts[i].binding = i;
+		bindingLayouts[i].visibility = ShaderStage::Compute;
+		if (i < 2) continue;
+		bindingLayouts[i].storageTexture.access = StorageTextureAccess::WriteOnly;
+		bindingLayouts[i].storageTexture.format = format;
+		bindingLayouts[i].storageTexture.viewDimension = TextureViewDimension::_2D;
+	}
+	bindingLayouts[0].buffer.type = BufferBindingType::Uniform;
+	bindingLayouts[0].buffer.hasDynamicOffset = true;
+	bindingLayouts[0].buffer.minBindingSize = sizeof(MipParams);
+	// Texels are read with textureLoad, so the format may be unfilterable
+	bindingLayouts[1].texture.sampleType = TextureSampleType::UnfilterableFloat;
+	bindingLayouts[1].texture.viewDimension = TextureViewDimension::_2D;
+
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = (uint32_t)bindingLayouts.size();
+	bindGroupLayoutDesc.entries = bindingLayouts.data();
+	p.bindGroupLayout = m_device.createBindGroupLayout(bindGroupLayoutDesc);
+
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.bindGroupLayoutCount = 1;
+	pipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&p.bindGroupLayout;
+	p.pipelineLayout = m_device.createPipelineLayout(pipelineLayoutDesc);
+
+	ComputePipelineDescriptor pipelineDesc{};
+	pipelineDesc.layout = p.pipelineLayout;
+	pipelineDesc.compute.module = shaderModule;
+	pipelineDesc.compute.entryPoint = "cs_main";
+	pipelineDesc.compute.constantCount = 0;
+	pipelineDesc.compute.constants = nullptr;
+	p.pipeline = m_device.createComputePipeline(pipelineDesc);
+	shaderModule.release();
+
+	TextureDescriptor dummyDesc;
+	dummyDesc.label = "Mipmap generator dummy output";
+	dummyDesc.usage = TextureUsage::StorageBinding;
+	dummyDesc.dimension = TextureDimension::_2D;
+	dummyDesc.size = { 1, 1, LEVELS_PER_DISPATCH - 1 };
+	dummyDesc.format = format;
+	dummyDesc.mipLevelCount = 1;
+	dummyDesc.sampleCount = 1;
+	dummyDesc.viewFormatCount = 0;
+	dummyDesc.viewFormats = nullptr;
+	p.dummyTexture = m_device.createTexture(dummyDesc);
+	for (uint32_t layer = 0; layer < LEVELS_PER_DISPATCH - 1; ++layer) {
+		TextureViewDescriptor viewDesc;
+		viewDesc.format = format;
+		viewDesc.dimension = TextureViewDimension::_2D;
+		viewDesc.baseMipLevel = 0;
+		viewDesc.mipLevelCount = 1;
+		viewDesc.baseArrayLayer = layer;
+		viewDesc.arrayLayerCount = 1;
+		viewDesc.aspect = TextureAspect::All;
+		p.dummyViews[layer] = p.dummyTexture.createView(viewDesc);
+	}
+
+	return m_pipelines.emplace(format, p).first->second;
+}
+
+void MipmapGenerator::generate(Queue queue, CommandEncoder encoder, wgpu::Texture texture, bool srgb, uint32_t baseLevel) {
+	uint32_t levelCount = texture.getMipLevelCount();
+	if (baseLevel + 1 >= levelCount) return;
+	TextureFormat format = texture.getFormat();
+	FormatPipeline& p = formatPipeline(format);
+	uint32_t width = texture.getWidth();
+	uint32_t height = texture.getHeight();
+
+	auto levelView = [&](uint32_t level) {
+		TextureViewDescriptor viewDesc;
+		viewDesc.format = format;
+		viewDesc.dimension = TextureViewDimension::_2D;
+		viewDesc.baseMipLevel = level;
+		viewDesc.mipLevelCount = 1;
+		viewDesc.baseArrayLayer = 0;
+		viewDesc.arrayLayerCount = 1;
+		viewDesc.aspect = TextureAspect::All;
+		return texture.createView(viewDesc);
+	};
+
+	// The parameters of all dispatches are uploaded at once, and each
+	// dispatch reads its own through a dynamic offset
+	uint32_t dispatchCount = (levelCount - baseLevel - 1 + LEVELS_PER_DISPATCH - 1) / LEVELS_PER_DISPATCH;
+	std::vector<uint8_t> params(dispatchCount * PARAMS_ALIGNMENT);
+	for (uint32_t i = 0; i < dispatchCount; ++i) {
+		MipParams* dispatchParams = reinterpret_cast<MipParams*>(&params[i * PARAMS_ALIGNMENT]);
+		dispatchParams->levelCount = std::min(LEVELS_PER_DISPATCH, levelCount - baseLevel - 1 - i * LEVELS_PER_DISPATCH);
+		dispatchParams->srgb = srgb ? 1 : 0;
+	}
+	BufferDescriptor paramsBufferDesc;
+	paramsBufferDesc.label = "Mipmap generation parameters";
+	paramsBufferDesc.size = params.size();
+	paramsBufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+	paramsBufferDesc.mappedAtCreation = false;
+	Buffer paramsBuffer = m_device.createBuffer(paramsBufferDesc);
+	queue.writeBuffer(paramsBuffer, 0, params.data(), params.size());
+
+	std::vector<TextureView> views;
+	std::vector<BindGroup> bindGroups;
+	ComputePassDescriptor computePassDesc{};
+	computePassDesc.label = "Mipmap generation";
+	computePassDesc.timestampWriteCount = 0;
+	computePassDesc.timestampWrites = nullptr;
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	computePass.setPipeline(p.pipeline);
+	for (uint32_t i = 0; i < dispatchCount; ++i) {
+		uint32_t sourceLevel = baseLevel + i * LEVELS_PER_DISPATCH;
+		const MipParams* dispatchParams = reinterpret_cast<const MipParams*>(&params[i * PARAMS_ALIGNMENT]);
+
+		std::vector<BindGroupEntry> bindings(2 + LEVELS_PER_DISPATCH);
+		for (uint32_t b = 0; b < bindings.size(); ++b) {
+			bindings[b].binding = b;
+		}
+		bindings[0].buffer = paramsBuffer;
+		bindings[0].offset = 0;
+		bindings[0].size = sizeof(MipParams);
+		views.push_back(levelView(sourceLevel));
+		bindings[1].textureView = views.back();
+		for (uint32_t level = 0; level < LEVELS_PER_DISPATCH; ++level) {
+			if (level < dispatchParams->levelCount) {
+				views.push_back(levelView(sourceLevel + 1 + level));
+				bindings[2 + level].textureView = views.back();
+			} else {
+				bindings[2 + level].textureView = p.dummyViews[level - 1];
+			}
+		}
+
+		BindGroupDescriptor bindGroupDesc{};
+		bindGroupDesc.layout = p.bindGroupLayout;
+		bindGroupDesc.entryCount = (uint32_t)bindings.size();
+		bindGroupDesc.entries = bindings.data();
+		bindGroups.push_back(m_device.createBindGroup(bindGroupDesc));
+
+		// One thread per texel of the first level written
+		uint32_t dynamicOffset = i * PARAMS_ALIGNMENT;
+		computePass.setBindGroup(0, bindGroups.back(), 1, &dynamicOffset);
+		uint32_t groupCountX = (mipSize(width, sourceLevel + 1) + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+		uint32_t groupCountY = (mipSize(height, sourceLevel + 1) + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+		computePass.dispatchWorkgroups(groupCountX, groupCountY, 1);
+	}
+	computePass.end();
+	computePass.release();
+
+	// Commands keep the objects they use alive until they are executed
+	for (BindGroup bindGroup : bindGroups) {
+		bindGroup.release();
+	}
+	for (TextureView view : views) {
+		view.release();
+	}
+	paramsBuffer.release();
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * Builds the mip chain of a texture on the GPU, from its level 0 (or any
+ * other base level) down to its last level, instead of downsampling each
+ * level on the CPU before uploading it.
+ *
+ * A compute shader averages 2x2 blocks of texels. Each 8x8 workgroup keeps
+ * the texels it produces in workgroup memory to build the next levels from
+ * them, so that one dispatch writes up to 4 levels and the whole chain of a
+ * 4096x4096 texture takes 3 dispatches.
+ *
+ * Textures must have the StorageBinding and TextureBinding usages and one
+ * of the formats RGBA8Unorm, RGBA16Float or RGBA32Float. Storage textures
+ * cannot have an sRGB format, so for sRGB images create the texture as
+ * RGBA8Unorm with RGBA8UnormSrgb as a view format, and ask for sRGB
+ * filtering: texels are then averaged in linear space.
+ */
+class MipmapGenerator {
+public:
+	/**
+	 * Number of levels of a full mip chain for a texture of this size.
+	 */
+	static uint32_t mipLevelCount(uint32_t width, uint32_t height);
+
+	/**
+	 * Raise the device limits needed to generate the mips of textures of up
+	 * to `maxTextureSize` texels wide and high.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t maxTextureSize);
+
+	explicit MipmapGenerator(wgpu::Device device);
+	~MipmapGenerator();
+
+	MipmapGenerator(const MipmapGenerator&) = delete;
+	MipmapGenerator& operator=(const MipmapGenerator&) = delete;
+
+	/**
+	 * Record the compute passes that fill the levels of `texture` after
+	 * `baseLevel` from its content. Their parameters are written to `queue`
+	 * right away, so `encoder` must be submitted to that queue.
+	 */
+	void generate(wgpu::Queue queue, wgpu::CommandEncoder encoder, wgpu::Texture texture, bool srgb, uint32_t baseLevel = 0);
+
+private:
+	// Objects specific to the storage format of the textures
+	struct FormatPipeline {
+		wgpu::BindGroupLayout bindGroupLayout = nullptr;
+		wgpu::PipelineLayout pipelineLayout = nullptr;
+		wgpu::ComputePipeline pipeline = nullptr;
+		// Bound in place of the levels a dispatch does not write, one layer
+		// per unused output
+		wgpu::Texture dummyTexture = nullptr;
+		wgpu::TextureView dummyViews[3] = { nullptr, nullptr, nullptr };
+	};
+
+	FormatPipeline& formatPipeline(wgpu::TextureFormat format);
+
+private:
+	wgpu::Device m_device;
+	std::unordered_map<uint32_t, FormatPipeline> m_pipelines;
+};
@@ -0,0 +1,531 @@
+#include "ParticleSystem.h"
+#include "ComputeKernel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+// Particles handled by a workgroup
+constexpr uint32_t WORKGROUP_SIZE = 64;
+
+// Matches the Particle struct of the shader
+constexpr uint32_t PARTICLE_SIZE = 32;
+
+// Matches the ParticleInstance struct of the shader, read by the vertex
+// shader as a vertex buffer
+struct ParticleInstance {
+	float positionSize[4];
+	float color[4];
+};
+
+// Matches the ParticleParams struct of the shader
+struct ParticleParams {
+	float emitterPosition[3];
+	float deltaTime;
+	float gravity[3];
+	uint32_t emitCount;
+	float velocity[3];
+	float lifetime;
+	float spread[3];
+	float size;
+	float startColor[4];
+	float endColor[4];
+	float drag;
+	uint32_t seed;
+	uint32_t _pad[2];
+};
+static_assert(sizeof(ParticleParams) == 112, "ParticleParams must match the layout of the shader");
+
+// Counters, then indirect draw arguments
+constexpr uint64_t COUNTER_BUFFER_SIZE = 2 * sizeof(uint32_t);
+constexpr uint64_t DRAW_ARGS_SIZE = 4 * sizeof(uint32_t);
+
+static const char* simulationShaderSource = R"(
+struct ParticleParams {
+    emitterPosition: vec3f,
+    deltaTime: f32,
+    gravity: vec3f,
+    emitCount: u32,
+    velocity: vec3f,
+    lifetime: f32,
+    spread: vec3f,
+    size: f32,
+    startColor: vec4f,
+    endColor: vec4f,
+    drag: f32,
+    seed: u32,
+}
+
+struct Particle {
+    position: vec3f,
+    age: f32,
+    velocity: vec3f,
+    lifetime: f32,
+}
+
+struct ParticleInstance {
+    positionSize: vec4f,
+    color: vec4f,
+}
+
+struct Counters {
+    // Size of the free stack. Signed, as emission may take it below 0 for
+    // a moment when the pool runs out.
+    freeCount: atomic<i32>,
+    // Size of the alive list read this frame
+    aliveCount: u32,
+}
+
+// Same layout as the arguments of drawIndirect
+struct DrawIndirectArgs {
+    vertexCount: u32,
+    instanceCount: atomic<u32>,
+    firstVertex: u32,
+    firstInstance: u32,
+}
+
+@group(0) @binding(0) var<uniform> uParams: ParticleParams;
+@group(0) @binding(1) var<storage, read_write> particles: array<Particle>;
+// Indices of the live particles, read from one list and written to the
+// other, in the order of the instances
+@group(0) @binding(2) var<storage, read> aliveIn: array<u32>;
+@group(0) @binding(3) var<storage, read_write> aliveOut: array<u32>;
+// Stack of the indices of the free particles
+@group(0) @binding(4) var<storage, read_write> freeList: array<u32>;
+@group(0) @binding(5) var<storage, read_write> counters: Counters;
+@group(0) @binding(6) var<storage, read_write> drawArgs: DrawIndirectArgs;
+@group(0) @binding(7) var<storage, read_write> instances: array<ParticleInstance>;
+
+fn hash(x: u32) -> u32 {
+    // PCG
+    let state = x * 747796405u + 2891336453u;
+    let word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// In [0, 1]
+fn random(seed: ptr<function, u32>) -> f32 {
+    *seed = hash(*seed);
+    return f32(*seed) / 4294967295.0;
+}
+
+// Append a live particle to the instances drawn this frame
+fn append(index: u32, p: Particle) {
+    let slot = atomicAdd(&drawArgs.instanceCount, 1u);
+    aliveOut[slot] = index;
+    let t = clamp(p.age / p.lifetime, 0.0, 1.0);
+    instances[slot] = ParticleInstance(vec4f(p.position, uParams.size), mix(uParams.startColor, uParams.endColor, t));
+}
+
+// Every particle starts free
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_init(@builtin(global_invocation_id) id: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let i = dispatchIndex(id, groupCount);
+    let capacity = arrayLength(&particles);
+    if (i >= capacity) {
+        return;
+    }
+    freeList[i] = i;
+    if (i == 0u) {
+        atomicStore(&counters.freeCount, i32(capacity));
+        counters.aliveCount = 0u;
+        // Two triangles per quad
+        drawArgs.vertexCount = 6u;
+        atomicStore(&drawArgs.instanceCount, 0u);
+        drawArgs.firstVertex = 0u;
+        drawArgs.firstInstance = 0u;
+    }
+}
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_simulate(@builtin(global_invocation_id) id: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let i = dispatchIndex(id, groupCount);
+    if (i >= counters.aliveCount) {
+        return;
+    }
+    let index = aliveIn[i];
+    var p = particles[index];
+    let dt = uParams.deltaTime;
+    p.age += dt;
+    if (p.age >= p.lifetime) {
+        let slot = atomicAdd(&counters.freeCount, 1);
+        freeList[slot] = index;
+        return;
+    }
+    p.velocity = (p.velocity + uParams.gravity * dt) * max(1.0 - uParams.drag * dt, 0.0);
+    p.position += p.velocity * dt;
+    particles[index] = p;
+    append(index, p);
+}
+
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_emit(@builtin(global_invocation_id) id: vec3u, @builtin(num_workgroups) groupCount: vec3u) {
+    let i = dispatchIndex(id, groupCount);
+    if (i >= uParams.emitCount) {
+        return;
+    }
+    // Pop a free particle, if there is one left. Only emission pops, and
+    // only simulation pushes, so the stack is never both at once.
+    let freeCount = atomicSub(&counters.freeCount, 1);
+    if (freeCount <= 0) {
+        atomicAdd(&counters.freeCount, 1);
+        return;
+    }
+    let index = freeList[freeCount - 1];
+
+    var seed = hash(i ^ hash(uParams.seed));
+    let jitter = vec3f(random(&seed), random(&seed), random(&seed)) * 2.0 - 1.0;
+    var p: Particle;
+    p.position = uParams.emitterPosition;
+    p.age = 0.0;
+    p.velocity = uParams.velocity + uParams.spread * jitter;
+    p.lifetime = uParams.lifetime * (0.5 + random(&seed));
+    particles[index] = p;
+    append(index, p);
+}
+)";
+
+// Runs alone before the simulation, which it sizes. SIMULATE_WORKGROUP_SIZE
+// and MAX_WORKGROUPS_PER_DIMENSION are replaced once they are known.
+static const char* prepareShaderSource = R"(
+struct Counters {
+    freeCount: i32,
+    aliveCount: u32,
+}
+
+struct DrawIndirectArgs {
+    vertexCount: u32,
+    instanceCount: u32,
+    firstVertex: u32,
+    firstInstance: u32,
+}
+
+@group(0) @binding(0) var<storage, read_write> counters: Counters;
+@group(0) @binding(1) var<storage, read_write> drawArgs: DrawIndirectArgs;
+@group(0) @binding(2) var<storage, read_write> dispatchArgs: array<u32, 3>;
+
+// The particles drawn last frame are the ones simulated this frame, and
+// the instances drawn this frame are counted again from 0
+@compute @workgroup_size(WORKGROUP_SIZE_X)
+fn cs_main() {
+    let count = drawArgs.instanceCount;
+    counters.aliveCount = count;
+    drawArgs.instanceCount = 0u;
+
+    // Folded in 2D when too large for one dimension, as ComputeKernel does
+    let groups = (count + SIMULATE_WORKGROUP_SIZE - 1u) / SIMULATE_WORKGROUP_SIZE;
+    let x = min(groups, MAX_WORKGROUPS_PER_DIMENSION);
+    dispatchArgs[0] = x;
+    dispatchArgs[1] = select(1u, (groups + x - 1u) / x, x > 0u);
+    dispatchArgs[2] = 1u;
+}
+)";
+
+static const char* renderShaderSource = R"(
+struct CameraUniforms {
+    viewProj: mat4x4f,
+}
+
+@group(0) @binding(0) var<uniform> uCamera: CameraUniforms;
+
+struct VertexOutput {
+    @builtin(position) position: vec4f,
+    @location(0) color: vec4f,
+    // In [-1, 1] across the quad
+    @location(1) corner: vec2f,
+}
+
+@vertex
+fn vs_main(@builtin(vertex_index) vertex: u32, @location(0) positionSize: vec4f, @location(1) color: vec4f) -> VertexOutput {
+    var corners = array<vec2f, 6>(
+        vec2f(-1.0, -1.0), vec2f(1.0, -1.0), vec2f(1.0, 1.0),
+        vec2f(-1.0, -1.0), vec2f(1.0, 1.0), vec2f(-1.0, 1.0),
+    );
+    let corner = corners[vertex];
+    var out: VertexOutput;
+    // Quads face the camera: their corners are offset in clip space, by
+    // the size the camera gives to their size in the world
+    out.position = uCamera.viewProj * vec4f(positionSize.xyz, 1.0);
+    let scale = vec2f(length(uCamera.viewProj[0].xyz), length(uCamera.viewProj[1].xyz));
+    out.position += vec4f(corner * positionSize.w * scale * out.position.w, 0.0, 0.0);
+    out.color = color;
+    out.corner = corner;
+    return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    // Round, fading out towards the edge
+    let falloff = clamp(1.0 - dot(in.corner, in.corner), 0.0, 1.0);
+    return vec4f(in.color.rgb * in.color.a * falloff, 0.0);
+}
+)";
+
+namespace {
+
+Buffer createBuffer(Device device, const char* label, uint64_t size, WGPUBufferUsageFlags usage) {
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = label;
+	bufferDesc.size = size;
+	bufferDesc.usage = usage;
+	bufferDesc.mappedAtCreation = false;
+	return device.createBuffer(bufferDesc);
+}
+
+std::unique_ptr<ComputeKernel> createKernel(Device device, const char* label, const char* source, const char* entryPoint, uint32_t invocations) {
+	ComputeKernel::Descriptor kernelDesc;
+	kernelDesc.label = label;
+	kernelDesc.source = source;
+	kernelDesc.entryPoint = entryPoint;
+	kernelDesc.preferredInvocations = invocations;
+	return std::make_unique<ComputeKernel>(device, kernelDesc);
+}
+
+std::string replaceAll(std::string source, const std::string& from, const std::string& to) {
+	for (size_t pos = source.find(from); pos != std::string::npos; pos = source.find(from, pos + to.size())) {
+		source.replace(pos, from.size(), to);
+	}
+	return source;
+}
+
+} // namespace
+
+void ParticleSystem::requireLimits(WGPULimits& limits, uint32_t capacity) {
+	uint64_t particleBytes = (uint64_t)capacity * PARTICLE_SIZE;
+	uint64_t instanceBytes = (uint64_t)capacity * sizeof(ParticleInstance);
+	limits.maxBindGroups = std::max(limits.maxBindGroups, 1u);
+	limits.maxUniformBuffersPerShaderStage = std::max(limits.maxUniformBuffersPerShaderStage, 1u);
+	limits.maxUniformBufferBindingSize = std::max<uint64_t>(limits.maxUniformBufferBindingSize, sizeof(ParticleParams));
+	limits.maxStorageBuffersPerShaderStage = std::max(limits.maxStorageBuffersPerShaderStage, 7u);
+	limits.maxStorageBufferBindingSize = std::max(limits.maxStorageBufferBindingSize, std::max(particleBytes, instanceBytes));
+	limits.maxBufferSize = std::max(limits.maxBufferSize, std::max(particleBytes, instanceBytes));
+	// Instances are one vertex buffer of 2 attributes, and the color and
+	// corner go to the fragment shader
+	limits.maxVertexBuffers = std::max(limits.maxVertexBuffers, 1u);
+	limits.maxVertexAttributes = std::max(limits.maxVertexAttributes, 2u);
+	limits.maxVertexBufferArrayStride = std::max<uint32_t>(limits.maxVertexBufferArrayStride, sizeof(ParticleInstance));
+	limits.maxInterStageShaderComponents = std::max(limits.maxInterStageShaderComponents, 6u);
+	ComputeKernel::requireLimits(limits, WORKGROUP_SIZE, 1, 1, capacity);
+}
+
+ParticleSystem::ParticleSystem(
+	Device device,
+	const Settings& settings,
+	TextureFormat colorFormat,
+	uint32_t sampleCount,
+	TextureFormat depthFormat,
+	BindGroupLayout cameraLayout
+)
+	: m_device(device)
+	, m_settings(settings)
+{
+	assert(m_settings.capacity > 0);
+	m_initKernel = createKernel(m_device, "Particle init", simulationShaderSource, "cs_init", WORKGROUP_SIZE);
+	m_simulateKernel = createKernel(m_device, "Particle simulation", simulationShaderSource, "cs_simulate", WORKGROUP_SIZE);
+	m_emitKernel = createKernel(m_device, "Particle emission", simulationShaderSource, "cs_emit", WORKGROUP_SIZE);
+
+	uint32_t maxWorkgroupsPerDimension = 65535;
+	SupportedLimits supportedLimits;
+	if (m_device.getLimits(&supportedLimits)) {
+		maxWorkgroupsPerDimension = supportedLimits.limits.maxComputeWorkgroupsPerDimension;
+	}
+	std::string prepareSource = prepareShaderSource;
+	prepareSource = replaceAll(prepareSource, "SIMULATE_WORKGROUP_SIZE", std::to_string(m_simulateKernel->workgroupSize()[0]) + "u");
+	prepareSource = replaceAll(prepareSource, "MAX_WORKGROUPS_PER_DIMENSION", std::to_string(maxWorkgroupsPerDimension) + "u");
+	m_prepareKernel = createKernel(m_device, "Particle dispatch", prepareSource.c_str(), "cs_main", 1);
+
+	uint64_t capacity = m_settings.capacity;
+	m_paramsBuffer = createBuffer(m_device, "Particle params", sizeof(ParticleParams), BufferUsage::CopyDst | BufferUsage::Uniform);
+	m_particleBuffer = createBuffer(m_device, "Particles", capacity * PARTICLE_SIZE, BufferUsage::Storage);
+	m_aliveBuffers[0] = createBuffer(m_device, "Live particles", capacity * sizeof(uint32_t), BufferUsage::Storage);
+	m_aliveBuffers[1] = createBuffer(m_device, "Live particles", capacity * sizeof(uint32_t), BufferUsage::Storage);
+	m_freeBuffer = createBuffer(m_device, "Free particles", capacity * sizeof(uint32_t), BufferUsage::Storage);
+	m_counterBuffer = createBuffer(m_device, "Particle counters", COUNTER_BUFFER_SIZE, BufferUsage::Storage | BufferUsage::CopySrc);
+	m_drawArgsBuffer = createBuffer(m_device, "Particle draw arguments", DRAW_ARGS_SIZE, BufferUsage::Storage | BufferUsage::Indirect | BufferUsage::CopySrc);
+	m_dispatchArgsBuffer = createBuffer(m_device, "Particle dispatch arguments", 3 * sizeof(uint32_t), BufferUsage::Storage | BufferUsage::Indirect);
+	m_instanceBuffer = createBuffer(m_device, "Particle instances", capacity * sizeof(ParticleInstance), BufferUsage::Storage | BufferUsage::Vertex);
+
+	// The kernels of the simulation share their layout, so any of them can
+	// create the bind groups
+	for (int direction = 0; direction < 2; ++direction) {
+		m_bindGroups[direction] = m_simulateKernel->createBindGroup(0, {
+			{ 0, m_paramsBuffer },
+			{ 1, m_particleBuffer },
+			{ 2, m_aliveBuffers[direction] },
+			{ 3, m_aliveBuffers[1 - direction] },
+			{ 4, m_freeBuffer },
+			{ 5, m_counterBuffer },
+			{ 6, m_drawArgsBuffer },
+			{ 7, m_instanceBuffer },
+		});
+	}
+	m_prepareBindGroup = m_prepareKernel->createBindGroup(0, {
+		{ 0, m_counterBuffer },
+		{ 1, m_drawArgsBuffer },
+		{ 2, m_dispatchArgsBuffer },
+	});
+
+	// Fill the free list, which only the GPU ever touches
+	Queue queue = m_device.getQueue();
+	CommandEncoderDescriptor encoderDesc{};
+	encoderDesc.label = "Particle init";
+	CommandEncoder encoder = m_device.createCommandEncoder(encoderDesc);
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	m_initKernel->dispatch(computePass, m_bindGroups[0], m_settings.capacity);
+	computePass.end();
+	computePass.release();
+	CommandBufferDescriptor commandBufferDesc{};
+	CommandBuffer command = encoder.finish(commandBufferDesc);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+	queue.release();
+
+	// Drawn with instanced quads, whose corners come from the vertex index
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = renderShaderSource;
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = m_device.createShaderModule(shaderDesc);
+
+	std::vector<VertexAttribute> instanceAttribs(2);
+	for (uint32_t i = 0; i < 2; ++i) {
+		instanceAttribs[i].shaderLocation = i;
+		instanceAttribs[i].format = VertexFormat::Float32x4;
+		instanceAttribs[i].offset = 4 * i * sizeof(float);
+	}
+	VertexBufferLayout instanceBufferLayout;
+	instanceBufferLayout.attributeCount = (uint32_t)instanceAttribs.size();
+	instanceBufferLayout.attributes = instanceAttribs.data();
+	instanceBufferLayout.arrayStride = sizeof(ParticleInstance);
+	instanceBufferLayout.stepMode = VertexStepMode::Instance;
+
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.bindGroupLayoutCount = 1;
+	pipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&cameraLayout;
+	m_renderPipelineLayout = m_device.createPipelineLayout(pipelineLayoutDesc);
+
+	RenderPipelineDescriptor pipelineDesc{};
+	pipelineDesc.label = "Particles";
+	pipelineDesc.layout = m_renderPipelineLayout;
+	pipelineDesc.vertex.bufferCount = 1;
+	pipelineDesc.vertex.buffers = &instanceBufferLayout;
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.constantCount = 0;
+	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	pipelineDesc.primitive.frontFace = FrontFace::CCW;
+	pipelineDesc.primitive.cullMode = CullMode::None;
+
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	// Added up, so that the order in which particles are drawn does not
+	// matter. The target alpha is left untouched.
+	BlendState blendState;
+	blendState.color.srcFactor = BlendFactor::One;
+	blendState.color.dstFactor = BlendFactor::One;
+	blendState.color.operation = BlendOperation::Add;
+	blendState.alpha.srcFactor = BlendFactor::Zero;
+	blendState.alpha.dstFactor = BlendFactor::One;
+	blendState.alpha.operation = BlendOperation::Add;
+	ColorTargetState colorTarget;
+	colorTarget.format = colorFormat;
+	colorTarget.blend = &blendState;
+	colorTarget.writeMask = ColorWriteMask::All;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+
+	// Hidden by the opaque objects in front of them, without hiding each
+	// other
+	DepthStencilState depthStencilState = Default;
+	depthStencilState.format = depthFormat;
+	depthStencilState.depthCompare = CompareFunction::LessEqual;
+	depthStencilState.depthWriteEnabled = false;
+	depthStencilState.stencilReadMask = 0;
+	depthStencilState.stencilWriteMask = 0;
+	pipelineDesc.depthStencil = &depthStencilState;
+
+	pipelineDesc.multisample.count = sampleCount;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+	m_renderPipeline = m_device.createRenderPipeline(pipelineDesc);
+	shaderModule.release();
+}
+
+ParticleSystem::~ParticleSystem() {
+	m_renderPipeline.release();
+	m_renderPipelineLayout.release();
+	m_prepareBindGroup.release();
+	m_bindGroups[0].release();
+	m_bindGroups[1].release();
+	for (Buffer buffer : { m_paramsBuffer, m_particleBuffer, m_aliveBuffers[0], m_aliveBuffers[1], m_freeBuffer,
+		m_counterBuffer, m_drawArgsBuffer, m_dispatchArgsBuffer, m_instanceBuffer }) {
+		buffer.destroy();
+		buffer.release();
+	}
+}
+
+void ParticleSystem::setEmitterPosition(float x, float y, float z) {
+	m_emitterPosition[0] = x;
+	m_emitterPosition[1] = y;
+	m_emitterPosition[2] = z;
+}
+
+void ParticleSystem::update(Queue queue, CommandEncoder encoder, float deltaTime) {
+	// Emission keeps its rate whatever the frame rate, and never asks for
+	// more particles than the pool holds
+	m_emitRemainder += m_settings.emitRate * deltaTime;
+	float emitCount = std::min(std::floor(m_emitRemainder), static_cast<float>(m_settings.capacity));
+	m_emitRemainder = std::min(m_emitRemainder - emitCount, 1.0f);
+
+	ParticleParams params{};
+	std::memcpy(params.emitterPosition, m_emitterPosition, sizeof(params.emitterPosition));
+	params.deltaTime = deltaTime;
+	std::memcpy(params.gravity, m_settings.gravity, sizeof(params.gravity));
+	params.emitCount = static_cast<uint32_t>(emitCount);
+	std::memcpy(params.velocity, m_settings.velocity, sizeof(params.velocity));
+	params.lifetime = m_settings.lifetime;
+	std::memcpy(params.spread, m_settings.spread, sizeof(params.spread));
+	params.size = m_settings.size;
+	std::memcpy(params.startColor, m_settings.startColor, sizeof(params.startColor));
+	std::memcpy(params.endColor, m_settings.endColor, sizeof(params.endColor));
+	params.drag = m_settings.drag;
+	params.seed = m_frame;
+	queue.writeBuffer(m_paramsBuffer, 0, &params, sizeof(ParticleParams));
+
+	// The particles emitted this frame go after the survivors, in the list
+	// the next frame reads
+	BindGroup bindGroup = m_bindGroups[m_frame % 2];
+	ComputePassDescriptor computePassDesc{};
+	ComputePassEncoder computePass = encoder.beginComputePass(computePassDesc);
+	m_prepareKernel->dispatch(computePass, m_prepareBindGroup, 1);
+	m_simulateKernel->dispatchIndirect(computePass, bindGroup, m_dispatchArgsBuffer);
+	m_emitKernel->dispatch(computePass, bindGroup, params.emitCount);
+	computePass.end();
+	computePass.release();
+	++m_frame;
+}
+
+void ParticleSystem::draw(RenderPassEncoder renderPass) {
+	renderPass.setPipeline(m_renderPipeline);
+	renderPass.setVertexBuffer(0, m_instanceBuffer, 0, m_instanceBuffer.getSize());
+	renderPass.drawIndirect(m_drawArgsBuffer, 0);
+}
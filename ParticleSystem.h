@@ -0,0 +1,119 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <memory>
+
+class ComputeKernel;
+
+/**
+ * Particles simulated and drawn entirely on the GPU. Each frame, compute
+ * passes age and move the live particles, return the dead ones to a free
+ * list and emit new ones from it. The survivors and the new particles are
+ * appended to a compacted list of instances, whose count lands directly in
+ * the arguments of an indirect draw of one quad per particle. The CPU only
+ * sends the emitter settings and the number of particles to emit.
+ *
+ * Live particles are kept in two index lists, read and written in turn,
+ * and freed ones in a stack. The order of the instances changes from frame
+ * to frame, which does not matter as particles are blended additively.
+ */
+class ParticleSystem {
+public:
+	struct Settings {
+		// Maximum number of live particles
+		uint32_t capacity = 1 << 20;
+		// Particles emitted per second, as long as the pool has free ones
+		float emitRate = 500000.0f;
+		// Seconds particles live, on average
+		float lifetime = 2.0f;
+		// Half of the side of the quads, in world units
+		float size = 0.02f;
+		float gravity[3] = { 0.0f, -2.0f, 0.0f };
+		// Initial velocity, plus a random one up to `spread` along each axis
+		float velocity[3] = { 0.0f, 2.0f, 0.0f };
+		float spread[3] = { 1.5f, 1.0f, 0.0f };
+		// Fraction of the velocity lost per second
+		float drag = 0.2f;
+		// Colors at birth and death, interpolated along the life
+		float startColor[4] = { 1.0f, 0.8f, 0.3f, 1.0f };
+		float endColor[4] = { 0.8f, 0.1f, 0.05f, 0.0f };
+	};
+
+	/**
+	 * Raise the device limits needed to simulate and draw `capacity`
+	 * particles.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t capacity);
+
+	/**
+	 * Particles are drawn into targets of `colorFormat` with `sampleCount`
+	 * samples, testing without writing a depth attachment of `depthFormat`.
+	 * Their vertex shader reads the camera through `cameraLayout`, a uniform
+	 * buffer with a dynamic offset holding the view-projection matrix, which
+	 * the caller binds at group 0 before calling draw().
+	 */
+	ParticleSystem(
+		wgpu::Device device,
+		const Settings& settings,
+		wgpu::TextureFormat colorFormat,
+		uint32_t sampleCount,
+		wgpu::TextureFormat depthFormat,
+		wgpu::BindGroupLayout cameraLayout
+	);
+	~ParticleSystem();
+
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	void setEmitterPosition(float x, float y, float z);
+
+	/**
+	 * Record the compute pass that advances the simulation by `deltaTime`
+	 * seconds. Must be called before the render pass that calls draw() is
+	 * encoded.
+	 */
+	void update(wgpu::Queue queue, wgpu::CommandEncoder encoder, float deltaTime);
+
+	/**
+	 * Draw the live particles with their own pipeline.
+	 */
+	void draw(wgpu::RenderPassEncoder renderPass);
+
+	uint32_t capacity() const { return m_settings.capacity; }
+
+	// Indirect draw arguments, whose second u32 is the number of live
+	// particles, and counters whose first i32 is the number of free ones.
+	// Both can be copied from, e.g. to read them back.
+	wgpu::Buffer drawArgsBuffer() const { return m_drawArgsBuffer; }
+	wgpu::Buffer counterBuffer() const { return m_counterBuffer; }
+
+private:
+	wgpu::Device m_device;
+	Settings m_settings;
+	float m_emitterPosition[3] = { 0.0f, 0.0f, 0.0f };
+	// Fraction of a particle left to emit from the previous frames
+	float m_emitRemainder = 0.0f;
+	uint32_t m_frame = 0;
+
+	std::unique_ptr<ComputeKernel> m_initKernel;
+	std::unique_ptr<ComputeKernel> m_simulateKernel;
+	std::unique_ptr<ComputeKernel> m_emitKernel;
+	std::unique_ptr<ComputeKernel> m_prepareKernel;
+
+	wgpu::Buffer m_paramsBuffer = nullptr;
+	wgpu::Buffer m_particleBuffer = nullptr;
+	wgpu::Buffer m_aliveBuffers[2] = { nullptr, nullptr };
+	wgpu::Buffer m_freeBuffer = nullptr;
+	wgpu::Buffer m_counterBuffer = nullptr;
+	wgpu::Buffer m_drawArgsBuffer = nullptr;
+	wgpu::Buffer m_dispatchArgsBuffer = nullptr;
+	wgpu::Buffer m_instanceBuffer = nullptr;
+	// One per direction in which the alive lists are read and written
+	wgpu::BindGroup m_bindGroups[2] = { nullptr, nullptr };
+	wgpu::BindGroup m_prepareBindGroup = nullptr;
+
+	wgpu::PipelineLayout m_renderPipelineLayout = nullptr;
+	wgpu::RenderPipeline m_renderPipeline = nullptr;
+};
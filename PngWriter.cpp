@@ -0,0 +1,769 @@
+#include "PngWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define PNG_WRITER_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define PNG_WRITER_NEON 1
+#endif
+
+// Below this many bytes per chunk, splitting an image loses more
+// compression than it saves time
+constexpr size_t MIN_CHUNK_BYTES = 256 * 1024;
+
+constexpr uint32_t WINDOW_SIZE = 32768;
+constexpr uint32_t HASH_BITS = 15;
+constexpr uint32_t MIN_MATCH = 3;
+constexpr uint32_t MAX_MATCH = 258;
+// Each block of this many symbols gets its own Huffman codes
+constexpr size_t BLOCK_SYMBOLS = 32768;
+constexpr size_t MAX_STORED_BLOCK = 65535;
+
+enum PngFilter : uint8_t {
+	FilterNone = 0,
+	FilterSub,
+	FilterUp,
+	FilterAverage,
+	FilterPaeth,
+	FilterCount,
+};
+
+static uint8_t paethPredictor(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = std::abs(p - a);
+	int pb = std::abs(p - b);
+	int pc = std::abs(p - c);
+	if (pa <= pb && pa <= pc) return static_cast<uint8_t>(a);
+	if (pb <= pc) return static_cast<uint8_t>(b);
+	return static_cast<uint8_t>(c);
+}
+
+#if defined(PNG_WRITER_SSE2)
+// Sums of the absolute values of the bytes taken as signed, in 2 64-bit lanes
+static __m128i sumAbsSigned(__m128i bytes) {
+	__m128i negated = _mm_sub_epi8(_mm_setzero_si128(), bytes);
+	return _mm_sad_epu8(_mm_min_epu8(bytes, negated), _mm_setzero_si128());
+}
+
+static __m128i abs16(__m128i x) {
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+// Paeth predictor of 8 pixels bytes widened to 16 bits
+static __m128i paeth16(__m128i a, __m128i b, __m128i c) {
+	__m128i pa = abs16(_mm_sub_epi16(b, c));
+	__m128i pb = abs16(_mm_sub_epi16(a, c));
+	__m128i pc = abs16(_mm_add_epi16(_mm_sub_epi16(b, c), _mm_sub_epi16(a, c)));
+	__m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+	__m128i notB = _mm_cmpgt_epi16(pb, pc);
+	__m128i bOrC = _mm_or_si128(_mm_and_si128(notB, c), _mm_andnot_si128(notB, b));
+	return _mm_or_si128(_mm_and_si128(notA, bOrC), _mm_andnot_si128(notA, a));
+}
+#endif
+
+// Write the row filtered with each of the 5 filters into `filtered`, and
+// return the filter whose output has the smallest sum of absolute values
+// (taken as signed bytes), which usually compresses best.
+static PngFilter filterRow(const uint8_t* row, const uint8_t* prior, uint32_t size, uint32_t bytesPerPixel, uint8_t* const filtered[FilterCount]) {
+	uint32_t costs[FilterCount] = { 0, 0, 0, 0, 0 };
+	auto filterByte = [&](uint32_t i, int a, int b, int c) {
+		uint8_t x = row[i];
+		uint8_t values[FilterCount] = {
+			x,
+			static_cast<uint8_t>(x - a),
+			static_cast<uint8_t>(x - b),
+			static_cast<uint8_t>(x - ((a + b) >> 1)),
+			static_cast<uint8_t>(x - paethPredictor(a, b, c)),
+		};
+		for (int f = 0; f < FilterCount; ++f) {
+			filtered[f][i] = values[f];
+			costs[f] += values[f] < 128 ? values[f] : 256 - values[f];
+		}
+	};
+
+	// The first pixel has no left neighbor
+	uint32_t i = 0;
+	for (; i < std::min(bytesPerPixel, size); ++i) {
+		filterByte(i, 0, prior[i], 0);
+	}
+
+#if defined(PNG_WRITER_SSE2)
+	__m128i sums[FilterCount];
+	for (__m128i& sum : sums) sum = _mm_setzero_si128();
+	for (; i + 16 <= size; i += 16) {
+		__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - bytesPerPixel));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prior + i - bytesPerPixel));
+		// _mm_avg_epu8 rounds up where the Average filter rounds down
+		__m128i average = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+		__m128i zero = _mm_setzero_si128();
+		__m128i paeth = _mm_packus_epi16(
+			paeth16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero)),
+			paeth16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero))
+		);
+		__m128i values[FilterCount] = {
+			x,
+			_mm_sub_epi8(x, a),
+			_mm_sub_epi8(x, b),
+			_mm_sub_epi8(x, average),
+			_mm_sub_epi8(x, paeth),
+		};
+		for (int f = 0; f < FilterCount; ++f) {
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(filtered[f] + i), values[f]);
+			sums[f] = _mm_add_epi64(sums[f], sumAbsSigned(values[f]));
+		}
+	}
+	for (int f = 0; f < FilterCount; ++f) {
+		costs[f] += static_cast<uint32_t>(_mm_cvtsi128_si32(sums[f]) + _mm_cvtsi128_si32(_mm_srli_si128(sums[f], 8)));
+	}
+#elif defined(PNG_WRITER_NEON)
+	uint32x4_t sums[FilterCount];
+	for (uint32x4_t& sum : sums) sum = vdupq_n_u32(0);
+	for (; i + 16 <= size; i += 16) {
+		uint8x16_t x = vld1q_u8(row + i);
+		uint8x16_t a = vld1q_u8(row + i - bytesPerPixel);
+		uint8x16_t b = vld1q_u8(prior + i);
+		uint8x16_t c = vld1q_u8(prior + i - bytesPerPixel);
+		uint8x16_t pa = vabdq_u8(b, c);
+		uint8x16_t pb = vabdq_u8(a, c);
+		// |a + b - 2c| can exceed 255, saturating it does not change the
+		// comparisons with pa and pb
+		uint16x8_t pcLow = vabdq_u16(vaddl_u8(vget_low_u8(a), vget_low_u8(b)), vshll_n_u8(vget_low_u8(c), 1));
+		uint16x8_t pcHigh = vabdq_u16(vaddl_u8(vget_high_u8(a), vget_high_u8(b)), vshll_n_u8(vget_high_u8(c), 1));
+		uint8x16_t pc = vcombine_u8(vqmovn_u16(pcLow), vqmovn_u16(pcHigh));
+		uint8x16_t notA = vorrq_u8(vcgtq_u8(pa, pb), vcgtq_u8(pa, pc));
+		uint8x16_t notB = vcgtq_u8(pb, pc);
+		uint8x16_t paeth = vbslq_u8(notA, vbslq_u8(notB, c, b), a);
+		uint8x16_t values[FilterCount] = {
+			x,
+			vsubq_u8(x, a),
+			vsubq_u8(x, b),
+			vsubq_u8(x, vhaddq_u8(a, b)),
+			vsubq_u8(x, paeth),
+		};
+		for (int f = 0; f < FilterCount; ++f) {
+			vst1q_u8(filtered[f] + i, values[f]);
+			uint8x16_t absolute = vminq_u8(values[f], vsubq_u8(vdupq_n_u8(0), values[f]));
+			sums[f] = vpadalq_u16(sums[f], vpaddlq_u8(absolute));
+		}
+	}
+	for (int f = 0; f < FilterCount; ++f) {
+		costs[f] += vgetq_lane_u32(sums[f], 0) + vgetq_lane_u32(sums[f], 1) + vgetq_lane_u32(sums[f], 2) + vgetq_lane_u32(sums[f], 3);
+	}
+#endif
+
+	for (; i < size; ++i) {
+		filterByte(i, row[i - bytesPerPixel], prior[i], prior[i - bytesPerPixel]);
+	}
+	return static_cast<PngFilter>(std::min_element(costs, costs + FilterCount) - costs);
+}
+
+// Deflate bits, packed from the least significant bit of each byte
+struct BitWriter {
+	std::vector<uint8_t>& out;
+	uint64_t bits = 0;
+	uint32_t count = 0;
+
+	void put(uint32_t value, uint32_t bitCount) {
+		bits |= static_cast<uint64_t>(value) << count;
+		count += bitCount;
+		if (count >= 32) {
+			const uint8_t bytes[4] = {
+				static_cast<uint8_t>(bits),
+				static_cast<uint8_t>(bits >> 8),
+				static_cast<uint8_t>(bits >> 16),
+				static_cast<uint8_t>(bits >> 24),
+			};
+			out.insert(out.end(), bytes, bytes + 4);
+			bits >>= 32;
+			count -= 32;
+		}
+	}
+
+	void alignToByte() {
+		while (count > 0) {
+			out.push_back(static_cast<uint8_t>(bits));
+			bits >>= 8;
+			count = count > 8 ? count - 8 : 0;
+		}
+	}
+};
+
+// A literal when length is 0, otherwise a match
+struct Symbol {
+	uint16_t length;
+	// Literal byte or match distance
+	uint16_t value;
+};
+
+static const uint16_t lengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8_t lengthExtraBits[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16_t distanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8_t distanceExtraBits[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+// Order in which the lengths of the code length code are stored
+static const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Index of the length and distance codes of every length and distance
+struct CodeTables {
+	uint8_t lengthCode[MAX_MATCH + 1];
+	uint8_t distanceCode[WINDOW_SIZE + 1];
+};
+
+static const CodeTables& codeTables() {
+	static const auto tables = []() {
+		auto t = std::make_unique<CodeTables>();
+		for (int code = 0; code < 29; ++code) {
+			int end = code + 1 < 29 ? lengthBase[code + 1] : MAX_MATCH + 1;
+			for (int length = lengthBase[code]; length < end; ++length) {
+				t->lengthCode[length] = static_cast<uint8_t>(code);
+			}
+		}
+		// 258 has its own code rather than being 227 + 31
+		t->lengthCode[MAX_MATCH] = 28;
+		for (int code = 0; code < 30; ++code) {
+			uint32_t end = code + 1 < 30 ? distanceBase[code + 1] : WINDOW_SIZE + 1;
+			for (uint32_t distance = distanceBase[code]; distance < end; ++distance) {
+				t->distanceCode[distance] = static_cast<uint8_t>(code);
+			}
+		}
+		return t;
+	}();
+	return *tables;
+}
+
+// Lengths of a Huffman code for these symbol frequencies, none longer than
+// `maxBits`. Frequencies get flattened until the code fits.
+static void huffmanLengths(const uint32_t* frequencies, int symbolCount, int maxBits, uint8_t* lengths) {
+	std::fill(lengths, lengths + symbolCount, 0);
+	std::vector<uint32_t> weights(frequencies, frequencies + symbolCount);
+	int usedCount = 0;
+	int lastUsed = 0;
+	for (int i = 0; i < symbolCount; ++i) {
+		if (weights[i] > 0) {
+			++usedCount;
+			lastUsed = i;
+		}
+	}
+	if (usedCount == 0) return;
+	if (usedCount == 1) {
+		lengths[lastUsed] = 1;
+		return;
+	}
+
+	using Node = std::pair<uint64_t, int>;
+	std::vector<int> parent(2 * symbolCount);
+	std::vector<int> depth(2 * symbolCount);
+	while (true) {
+		std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+		for (int i = 0; i < symbolCount; ++i) {
+			if (weights[i] > 0) heap.push({ weights[i], i });
+		}
+		// Internal nodes are numbered after the leaves, each one after its children
+		int nextNode = symbolCount;
+		while (heap.size() > 1) {
+			Node first = heap.top();
+			heap.pop();
+			Node second = heap.top();
+			heap.pop();
+			parent[first.second] = nextNode;
+			parent[second.second] = nextNode;
+			heap.push({ first.first + second.first, nextNode++ });
+		}
+		int root = nextNode - 1;
+		depth[root] = 0;
+		for (int node = root - 1; node >= symbolCount; --node) {
+			depth[node] = depth[parent[node]] + 1;
+		}
+		int maxLength = 0;
+		for (int i = 0; i < symbolCount; ++i) {
+			if (weights[i] > 0) {
+				lengths[i] = static_cast<uint8_t>(depth[parent[i]] + 1);
+				maxLength = std::max(maxLength, static_cast<int>(lengths[i]));
+			}
+		}
+		if (maxLength <= maxBits) return;
+		for (uint32_t& weight : weights) {
+			if (weight > 0) weight = (weight >> 1) | 1;
+		}
+	}
+}
+
+// Canonical codes for these lengths, bit-reversed since deflate writes
+// them from their most significant bit
+static void canonicalCodes(const uint8_t* lengths, int symbolCount, uint16_t* codes) {
+	uint32_t lengthCounts[16] = {};
+	for (int i = 0; i < symbolCount; ++i) {
+		if (lengths[i] > 0) ++lengthCounts[lengths[i]];
+	}
+	uint32_t nextCode[16] = {};
+	uint32_t code = 0;
+	for (int bits = 1; bits < 16; ++bits) {
+		code = (code + lengthCounts[bits - 1]) << 1;
+		nextCode[bits] = code;
+	}
+	for (int i = 0; i < symbolCount; ++i) {
+		if (lengths[i] == 0) continue;
+		uint32_t value = nextCode[lengths[i]]++;
+		uint32_t reversed = 0;
+		for (int bit = 0; bit < lengths[i]; ++bit) {
+			reversed |= ((value >> bit) & 1) << (lengths[i] - 1 - bit);
+		}
+		codes[i] = static_cast<uint16_t>(reversed);
+	}
+}
+
+// Stored blocks, split at the maximum size of a block. With no data, this
+// is an empty block that just brings the stream to a byte boundary.
+static void writeStoredBlocks(BitWriter& writer, const uint8_t* data, size_t size, bool final) {
+	do {
+		size_t blockSize = std::min(size, MAX_STORED_BLOCK);
+		writer.put(final && blockSize == size ? 1 : 0, 1);
+		writer.put(0, 2);
+		writer.alignToByte();
+		writer.put(static_cast<uint32_t>(blockSize), 16);
+		writer.put(static_cast<uint32_t>(~blockSize & 0xffff), 16);
+		writer.out.insert(writer.out.end(), data, data + blockSize);
+		data += blockSize;
+		size -= blockSize;
+	} while (size > 0);
+}
+
+// A block with dynamic Huffman codes, or stored blocks if they are smaller.
+// `raw` holds the bytes the symbols encode.
+static void writeBlock(BitWriter& writer, const std::vector<Symbol>& symbols, const uint8_t* raw, size_t rawSize, bool final) {
+	if (symbols.empty()) {
+		writeStoredBlocks(writer, raw, 0, final);
+		return;
+	}
+	const CodeTables& tables = codeTables();
+	uint32_t literalFrequencies[286] = {};
+	uint32_t distanceFrequencies[30] = {};
+	for (const Symbol& symbol : symbols) {
+		if (symbol.length == 0) {
+			++literalFrequencies[symbol.value];
+		}
+		else {
+			++literalFrequencies[257 + tables.lengthCode[symbol.length]];
+			++distanceFrequencies[tables.distanceCode[symbol.value]];
+		}
+	}
+	// End of block
+	literalFrequencies[256] = 1;
+
+	uint8_t literalLengths[286];
+	uint8_t distanceLengths[30];
+	huffmanLengths(literalFrequencies, 286, 15, literalLengths);
+	huffmanLengths(distanceFrequencies, 30, 15, distanceLengths);
+	if (std::all_of(distanceLengths, distanceLengths + 30, [](uint8_t length) { return length == 0; })) {
+		// A block without matches still needs one distance code
+		distanceLengths[0] = 1;
+	}
+	int literalCount = 286;
+	while (literalCount > 257 && literalLengths[literalCount - 1] == 0) --literalCount;
+	int distanceCount = 30;
+	while (distanceCount > 1 && distanceLengths[distanceCount - 1] == 0) --distanceCount;
+
+	// Both sets of lengths are run-length encoded together
+	uint8_t allLengths[286 + 30];
+	std::copy(literalLengths, literalLengths + literalCount, allLengths);
+	std::copy(distanceLengths, distanceLengths + distanceCount, allLengths + literalCount);
+	int lengthCount = literalCount + distanceCount;
+	std::vector<std::pair<uint8_t, uint8_t>> runs; // code length symbol, extra bits value
+	for (int i = 0; i < lengthCount;) {
+		uint8_t length = allLengths[i];
+		int run = 1;
+		while (i + run < lengthCount && allLengths[i + run] == length) ++run;
+		i += run;
+		if (length == 0) {
+			while (run >= 11) {
+				int n = std::min(run, 138);
+				runs.push_back({ 18, static_cast<uint8_t>(n - 11) });
+				run -= n;
+			}
+			if (run >= 3) {
+				runs.push_back({ 17, static_cast<uint8_t>(run - 3) });
+				run = 0;
+			}
+		}
+		else {
+			runs.push_back({ length, 0 });
+			--run;
+			while (run >= 3) {
+				int n = std::min(run, 6);
+				runs.push_back({ 16, static_cast<uint8_t>(n - 3) });
+				run -= n;
+			}
+		}
+		for (; run > 0; --run) runs.push_back({ length, 0 });
+	}
+	auto runExtraBits = [](uint8_t symbol) -> uint32_t {
+		return symbol == 16 ? 2 : symbol == 17 ? 3 : symbol == 18 ? 7 : 0;
+	};
+	uint32_t codeLengthFrequencies[19] = {};
+	for (const auto& run : runs) ++codeLengthFrequencies[run.first];
+	uint8_t codeLengthLengths[19];
+	huffmanLengths(codeLengthFrequencies, 19, 7, codeLengthLengths);
+	int codeLengthCount = 19;
+	while (codeLengthCount > 4 && codeLengthLengths[codeLengthOrder[codeLengthCount - 1]] == 0) --codeLengthCount;
+
+	uint64_t dynamicBits = 3 + 5 + 5 + 4 + 3 * codeLengthCount;
+	for (const auto& run : runs) dynamicBits += codeLengthLengths[run.first] + runExtraBits(run.first);
+	for (int i = 0; i < 286; ++i) {
+		dynamicBits += static_cast<uint64_t>(literalFrequencies[i]) * (literalLengths[i] + (i > 256 ? lengthExtraBits[i - 257] : 0));
+	}
+	for (int i = 0; i < 30; ++i) {
+		dynamicBits += static_cast<uint64_t>(distanceFrequencies[i]) * (distanceLengths[i] + distanceExtraBits[i]);
+	}
+	uint64_t storedBits = 8 * (rawSize + 5 * ((rawSize + MAX_STORED_BLOCK - 1) / MAX_STORED_BLOCK));
+	if (dynamicBits >= storedBits) {
+		writeStoredBlocks(writer, raw, rawSize, final);
+		return;
+	}
+
+	uint16_t literalCodes[286];
+	uint16_t distanceCodes[30];
+	uint16_t codeLengthCodes[19];
+	canonicalCodes(literalLengths, 286, literalCodes);
+	canonicalCodes(distanceLengths, 30, distanceCodes);
+	canonicalCodes(codeLengthLengths, 19, codeLengthCodes);
+
+	writer.put(final ? 1 : 0, 1);
+	writer.put(2, 2);
+	writer.put(literalCount - 257, 5);
+	writer.put(distanceCount - 1, 5);
+	writer.put(codeLengthCount - 4, 4);
+	for (int i = 0; i < codeLengthCount; ++i) {
+		writer.put(codeLengthLengths[codeLengthOrder[i]], 3);
+	}
+	for (const auto& run : runs) {
+		writer.put(codeLengthCodes[run.first], codeLengthLengths[run.first]);
+		writer.put(run.second, runExtraBits(run.first));
+	}
+	for (const Symbol& symbol : symbols) {
+		if (symbol.length == 0) {
+			writer.put(literalCodes[symbol.value], literalLengths[symbol.value]);
+			continue;
+		}
+		uint32_t lengthCode = tables.lengthCode[symbol.length];
+		writer.put(literalCodes[257 + lengthCode], literalLengths[257 + lengthCode]);
+		writer.put(symbol.length - lengthBase[lengthCode], lengthExtraBits[lengthCode]);
+		uint32_t distanceCode = tables.distanceCode[symbol.value];
+		writer.put(distanceCodes[distanceCode], distanceLengths[distanceCode]);
+		writer.put(symbol.value - distanceBase[distanceCode], distanceExtraBits[distanceCode]);
+	}
+	writer.put(literalCodes[256], literalLengths[256]);
+}
+
+static uint32_t matchLength(const uint8_t* a, const uint8_t* b, uint32_t maxLength) {
+	uint32_t length = 0;
+	while (length + 8 <= maxLength) {
+		uint64_t x, y;
+		std::memcpy(&x, a + length, 8);
+		std::memcpy(&y, b + length, 8);
+		if (x != y) break;
+		length += 8;
+	}
+	while (length < maxLength && a[length] == b[length]) ++length;
+	return length;
+}
+
+static uint32_t hash3(const uint8_t* p) {
+	uint32_t value = p[0] | p[1] << 8 | p[2] << 16;
+	return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Deflate a chunk of the image on its own. Unless it is the last one, the
+// chunk does not end the stream and ends on a byte boundary, so that the
+// next chunk can be appended to it.
+static void deflateChunk(const uint8_t* data, size_t size, PngWriter::Compression compression, bool last, std::vector<uint8_t>& out) {
+	BitWriter writer{ out };
+	if (compression == PngWriter::Compression::None) {
+		writeStoredBlocks(writer, data, size, last);
+		return;
+	}
+
+	uint32_t maxCandidates = compression == PngWriter::Compression::Fast ? 1 : 32;
+	// Stop searching once a match is this long
+	uint32_t goodLength = compression == PngWriter::Compression::Fast ? 32 : 128;
+	std::vector<int32_t> head(size_t(1) << HASH_BITS, -1);
+	std::vector<int32_t> previous(size);
+	std::vector<Symbol> symbols;
+	symbols.reserve(BLOCK_SYMBOLS);
+	size_t blockStart = 0;
+	auto insert = [&](size_t position) {
+		uint32_t hash = hash3(data + position);
+		previous[position] = head[hash];
+		head[hash] = static_cast<int32_t>(position);
+	};
+
+	size_t i = 0;
+	while (i < size) {
+		uint32_t bestLength = 0;
+		uint32_t bestDistance = 0;
+		if (i + MIN_MATCH <= size) {
+			int32_t candidate = head[hash3(data + i)];
+			insert(i);
+			uint32_t maxLength = static_cast<uint32_t>(std::min<size_t>(MAX_MATCH, size - i));
+			for (uint32_t n = 0; n < maxCandidates && candidate >= 0 && i - candidate <= WINDOW_SIZE; ++n) {
+				uint32_t length = matchLength(data + candidate, data + i, maxLength);
+				if (length > bestLength) {
+					bestLength = length;
+					bestDistance = static_cast<uint32_t>(i - candidate);
+					if (length >= goodLength) break;
+				}
+				candidate = previous[candidate];
+			}
+		}
+		if (bestLength >= MIN_MATCH) {
+			symbols.push_back({ static_cast<uint16_t>(bestLength), static_cast<uint16_t>(bestDistance) });
+			for (size_t p = i + 1; p < i + bestLength && p + MIN_MATCH <= size; ++p) {
+				insert(p);
+			}
+			i += bestLength;
+		}
+		else {
+			symbols.push_back({ 0, data[i] });
+			++i;
+		}
+		if (symbols.size() == BLOCK_SYMBOLS) {
+			writeBlock(writer, symbols, data + blockStart, i - blockStart, last && i == size);
+			symbols.clear();
+			blockStart = i;
+		}
+	}
+	if (!symbols.empty() || size == 0) {
+		writeBlock(writer, symbols, data + blockStart, size - blockStart, last);
+	}
+	if (!last) {
+		writeStoredBlocks(writer, nullptr, 0, false);
+	}
+	writer.alignToByte();
+}
+
+static uint32_t adler32(const uint8_t* data, size_t size) {
+	uint32_t a = 1, b = 0;
+	while (size > 0) {
+		// Largest run for which b cannot overflow before the modulo
+		size_t n = std::min<size_t>(size, 5552);
+		size -= n;
+		while (n-- > 0) {
+			a += *data++;
+			b += a;
+		}
+		a %= 65521;
+		b %= 65521;
+	}
+	return b << 16 | a;
+}
+
+// Checksum of the concatenation of two parts from theirs, as zlib's
+// adler32_combine
+static uint32_t adler32Combine(uint32_t adler1, uint32_t adler2, size_t size2) {
+	const uint32_t base = 65521;
+	uint32_t remainder = static_cast<uint32_t>(size2 % base);
+	uint32_t sum1 = adler1 & 0xffff;
+	uint32_t sum2 = (remainder * sum1) % base;
+	sum1 += (adler2 & 0xffff) + base - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+	if (sum1 >= base) sum1 -= base;
+	if (sum1 >= base) sum1 -= base;
+	if (sum2 >= 2 * base) sum2 -= 2 * base;
+	if (sum2 >= base) sum2 -= base;
+	return sum1 | sum2 << 16;
+}
+
+// Table-driven CRC, 4 bytes at a time
+static uint32_t crc32(const uint8_t* data, size_t size) {
+	static const auto tables = []() {
+		std::array<std::array<uint32_t, 256>, 4> t;
+		for (uint32_t n = 0; n < 256; ++n) {
+			uint32_t c = n;
+			for (int k = 0; k < 8; ++k) {
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			}
+			t[0][n] = c;
+		}
+		for (uint32_t n = 0; n < 256; ++n) {
+			for (int k = 1; k < 4; ++k) {
+				t[k][n] = (t[k - 1][n] >> 8) ^ t[0][t[k - 1][n] & 0xff];
+			}
+		}
+		return t;
+	}();
+	uint32_t crc = 0xffffffffu;
+	for (; size >= 4; size -= 4, data += 4) {
+		crc ^= data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
+		crc = tables[3][crc & 0xff] ^ tables[2][(crc >> 8) & 0xff] ^ tables[1][(crc >> 16) & 0xff] ^ tables[0][crc >> 24];
+	}
+	for (; size > 0; --size) {
+		crc = tables[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value) {
+	const uint8_t bytes[4] = {
+		static_cast<uint8_t>(value >> 24),
+		static_cast<uint8_t>(value >> 16),
+		static_cast<uint8_t>(value >> 8),
+		static_cast<uint8_t>(value),
+	};
+	out.insert(out.end(), bytes, bytes + 4);
+}
+
+// A PNG chunk is its data size, type, data and CRC. Start one with a
+// placeholder for the size, append its data, then end it.
+static void beginChunk(std::vector<uint8_t>& out, const char* type) {
+	appendBigEndian(out, 0);
+	out.insert(out.end(), type, type + 4);
+}
+
+static void endChunk(std::vector<uint8_t>& out, size_t chunkStart) {
+	uint32_t size = static_cast<uint32_t>(out.size() - chunkStart - 8);
+	for (int i = 0; i < 4; ++i) {
+		out[chunkStart + i] = static_cast<uint8_t>(size >> (24 - 8 * i));
+	}
+	appendBigEndian(out, crc32(out.data() + chunkStart + 4, out.size() - chunkStart - 4));
+}
+
+const char* PngWriter::simdName() {
+#if defined(PNG_WRITER_SSE2)
+	return "SSE2";
+#elif defined(PNG_WRITER_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
+
+PngWriter::PngWriter(ThreadPool* threadPool, Compression compression)
+	: m_threadPool(threadPool)
+	, m_compression(compression)
+{}
+
+std::vector<std::vector<uint8_t>> PngWriter::encodeParts(int width, int height, int comp, const void* data, int strideInBytes) const {
+	assert(width > 0 && height > 0 && comp >= 1 && comp <= 4);
+	const uint8_t* pixels = static_cast<const uint8_t*>(data);
+	uint32_t rowSize = static_cast<uint32_t>(width * comp);
+	size_t stride = strideInBytes != 0 ? strideInBytes : rowSize;
+	// Each row starts with its filter type
+	size_t filteredRowSize = rowSize + 1;
+
+	uint32_t threadCount = m_threadPool ? m_threadPool->threadCount() : 1;
+	uint32_t chunkCount = static_cast<uint32_t>(std::clamp<size_t>(filteredRowSize * height / MIN_CHUNK_BYTES, 1, threadCount));
+	uint32_t rowsPerChunk = (height + chunkCount - 1) / chunkCount;
+	chunkCount = (height + rowsPerChunk - 1) / rowsPerChunk;
+
+	std::vector<std::vector<uint8_t>> parts(chunkCount + 2);
+	std::vector<uint8_t>& header = parts.front();
+	const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	header.insert(header.end(), signature, signature + 8);
+	beginChunk(header, "IHDR");
+	appendBigEndian(header, width);
+	appendBigEndian(header, height);
+	// Bit depth, then color type: gray, gray and alpha, RGB or RGBA
+	const uint8_t colorTypes[5] = { 0, 0, 4, 2, 6 };
+	const uint8_t format[5] = { 8, colorTypes[comp], 0, 0, 0 };
+	header.insert(header.end(), format, format + 5);
+	endChunk(header, 8);
+
+	std::vector<uint32_t> checksums(chunkCount);
+	std::vector<size_t> chunkSizes(chunkCount);
+	auto encodeChunks = [&](uint32_t begin, uint32_t end, uint32_t) {
+		std::vector<uint8_t> filtered;
+		std::vector<uint8_t> scratch(FilterCount * rowSize);
+		uint8_t* const filterOutputs[FilterCount] = {
+			&scratch[0], &scratch[rowSize], &scratch[2 * rowSize], &scratch[3 * rowSize], &scratch[4 * rowSize],
+		};
+		const std::vector<uint8_t> zeroRow(rowSize, 0);
+		for (uint32_t chunk = begin; chunk < end; ++chunk) {
+			uint32_t firstRow = chunk * rowsPerChunk;
+			uint32_t endRow = std::min<uint32_t>(firstRow + rowsPerChunk, height);
+			filtered.resize((endRow - firstRow) * filteredRowSize);
+			for (uint32_t y = firstRow; y < endRow; ++y) {
+				const uint8_t* row = pixels + y * stride;
+				const uint8_t* prior = y > 0 ? row - stride : zeroRow.data();
+				uint8_t* out = &filtered[(y - firstRow) * filteredRowSize];
+				PngFilter filter = FilterNone;
+				if (m_compression != Compression::None) {
+					filter = filterRow(row, prior, rowSize, comp, filterOutputs);
+					row = filterOutputs[filter];
+				}
+				out[0] = filter;
+				std::memcpy(out + 1, row, rowSize);
+			}
+			checksums[chunk] = adler32(filtered.data(), filtered.size());
+			chunkSizes[chunk] = filtered.size();
+
+			std::vector<uint8_t>& part = parts[1 + chunk];
+			beginChunk(part, "IDAT");
+			if (chunk == 0) {
+				// zlib header: deflate with a 32 KiB window, and the level
+				part.push_back(0x78);
+				part.push_back(m_compression == Compression::Default ? 0x9c : 0x01);
+			}
+			deflateChunk(filtered.data(), filtered.size(), m_compression, chunk + 1 == chunkCount, part);
+			endChunk(part, 0);
+		}
+	};
+	if (m_threadPool) {
+		m_threadPool->parallelFor(chunkCount, 1, encodeChunks);
+	}
+	else {
+		encodeChunks(0, chunkCount, 0);
+	}
+
+	uint32_t checksum = checksums[0];
+	for (uint32_t chunk = 1; chunk < chunkCount; ++chunk) {
+		checksum = adler32Combine(checksum, checksums[chunk], chunkSizes[chunk]);
+	}
+	std::vector<uint8_t>& trailer = parts.back();
+	beginChunk(trailer, "IDAT");
+	appendBigEndian(trailer, checksum);
+	endChunk(trailer, 0);
+	size_t endStart = trailer.size();
+	beginChunk(trailer, "IEND");
+	endChunk(trailer, endStart);
+	return parts;
+}
+
+std::vector<uint8_t> PngWriter::encode(int width, int height, int comp, const void* data, int strideInBytes) const {
+	std::vector<std::vector<uint8_t>> parts = encodeParts(width, height, comp, data, strideInBytes);
+	std::vector<uint8_t> png;
+	for (const std::vector<uint8_t>& part : parts) {
+		png.insert(png.end(), part.begin(), part.end());
+	}
+	return png;
+}
+
+bool PngWriter::write(const char* filename, int width, int height, int comp, const void* data, int strideInBytes) const {
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open()) return false;
+	for (const std::vector<uint8_t>& part : encodeParts(width, height, comp, data, strideInBytes)) {
+		file.write(reinterpret_cast<const char*>(part.data()), static_cast<std::streamsize>(part.size()));
+	}
+	return static_cast<bool>(file);
+}
+
+int writePng(char const* filename, int w, int h, int comp, const void* data, int stride_in_bytes) {
+	if (w <= 0 || h <= 0 || comp < 1 || comp > 4 || !data) return 0;
+	// Calls from several threads take turns on the shared pool
+	static std::mutex mutex;
+	static ThreadPool threadPool;
+	std::lock_guard<std::mutex> lock(mutex);
+	PngWriter writer(&threadPool, PngWriter::Compression::Fast);
+	return writer.write(filename, w, h, comp, data, stride_in_bytes) ? 1 : 0;
+}
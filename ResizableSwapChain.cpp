@@ -0,0 +1,83 @@
+#include "ResizableSwapChain.h"
+
+#include <GLFW/glfw3.h>
+
+using namespace wgpu;
+
+ResizableSwapChain::ResizableSwapChain(GLFWwindow* window, Device device, Surface surface, const SwapChainDescriptor& descriptor, double debounceDelay)
+	: m_window(window)
+	, m_device(device)
+	, m_surface(surface)
+	, m_descriptor(descriptor)
+	, m_debounceDelay(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(debounceDelay)))
+{
+	int width, height;
+	glfwGetFramebufferSize(window, &width, &height);
+	m_pendingWidth = static_cast<uint32_t>(width);
+	m_pendingHeight = static_cast<uint32_t>(height);
+	// A window can be created minimized, the swap chain then keeps the size
+	// of the descriptor until update() creates it once it is not
+	if (!minimized()) {
+		m_descriptor.width = m_pendingWidth;
+		m_descriptor.height = m_pendingHeight;
+		create();
+	}
+
+	glfwSetWindowUserPointer(window, this);
+	glfwSetFramebufferSizeCallback(window, onFramebufferSize);
+}
+
+ResizableSwapChain::~ResizableSwapChain() {
+	glfwSetFramebufferSizeCallback(m_window, nullptr);
+	glfwSetWindowUserPointer(m_window, nullptr);
+	if (m_swapChain) {
+		m_swapChain.release();
+	}
+}
+
+void ResizableSwapChain::onFramebufferSize(GLFWwindow* window, int width, int height) {
+	auto that = static_cast<ResizableSwapChain*>(glfwGetWindowUserPointer(window));
+	that->m_pendingWidth = static_cast<uint32_t>(width);
+	that->m_pendingHeight = static_cast<uint32_t>(height);
+	that->m_lastSizeChange = Clock::now();
+}
+
+void ResizableSwapChain::create() {
+	// The surface only has one swap chain at a time
+	if (m_swapChain) {
+		m_swapChain.release();
+	}
+	m_swapChain = m_device.createSwapChain(m_surface, m_descriptor);
+	++m_creationCount;
+}
+
+bool ResizableSwapChain::update() {
+	bool resized = m_pendingWidth != m_descriptor.width || m_pendingHeight != m_descriptor.height;
+	if (minimized() || (!resized && !m_outdated && m_swapChain)) {
+		return false;
+	}
+	if (!m_outdated && m_swapChain && Clock::now() - m_lastSizeChange < m_debounceDelay) {
+		return false;
+	}
+
+	m_descriptor.width = m_pendingWidth;
+	m_descriptor.height = m_pendingHeight;
+	create();
+	m_outdated = false;
+	return resized;
+}
+
+bool ResizableSwapChain::minimized() const {
+	return m_pendingWidth == 0 || m_pendingHeight == 0;
+}
+
+TextureView ResizableSwapChain::nextTexture() {
+	if (!m_swapChain || m_outdated) {
+		return nullptr;
+	}
+	TextureView view = m_swapChain.getCurrentTextureView();
+	if (!view) {
+		m_outdated = true;
+	}
+	return view;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <chrono>
+#include <cstdint>
+
+struct GLFWwindow;
+
+/**
+ * Swap chain that follows the size of the framebuffer of a window.
+ *
+ * Dragging the border of a window sends a burst of size changes, and
+ * recreating the swap chain along with the render targets of the same size
+ * for each of them would stall every frame of the drag. Instead, the size
+ * changes are only recorded, and the swap chain keeps its size until the
+ * framebuffer size has not changed for the debounce delay. Frames keep
+ * being rendered at the old size meanwhile, stretched by the compositor.
+ *
+ * Some platforms refuse to present a swap chain that does not match its
+ * window, such as Vulkan on X11. There the next texture cannot be acquired,
+ * and the swap chain gets recreated on the next update() without waiting
+ * for the burst to end.
+ *
+ * The callback that records the size changes uses the user pointer of the
+ * window, which must not be used for anything else.
+ */
+class ResizableSwapChain {
+public:
+	/**
+	 * Create a swap chain of the size of the framebuffer of `window`, with
+	 * the other properties of `descriptor`.
+	 */
+	ResizableSwapChain(GLFWwindow* window, wgpu::Device device, wgpu::Surface surface, const wgpu::SwapChainDescriptor& descriptor, double debounceDelay = 0.1);
+	~ResizableSwapChain();
+
+	ResizableSwapChain(const ResizableSwapChain&) = delete;
+	ResizableSwapChain& operator=(const ResizableSwapChain&) = delete;
+
+	/**
+	 * Recreate the swap chain if the framebuffer size settled on a new
+	 * value, or right away if the current one cannot be presented anymore.
+	 * Returns true when the size changed, in which case the render targets
+	 * drawn along with the swap chain must be resized too.
+	 */
+	bool update();
+
+	/**
+	 * Whether the window is minimized, when there is nothing to render.
+	 */
+	bool minimized() const;
+
+	/**
+	 * View of the texture to render the next frame into, or null if the
+	 * frame must be skipped, after which update() recreates the swap chain.
+	 */
+	wgpu::TextureView nextTexture();
+
+	wgpu::SwapChain swapChain() const { return m_swapChain; }
+	uint32_t width() const { return m_descriptor.width; }
+	uint32_t height() const { return m_descriptor.height; }
+	// Times the swap chain was created, counting the first one
+	uint64_t creationCount() const { return m_creationCount; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	static void onFramebufferSize(GLFWwindow* window, int width, int height);
+	void create();
+
+private:
+	GLFWwindow* m_window;
+	wgpu::Device m_device;
+	wgpu::Surface m_surface;
+	wgpu::SwapChainDescriptor m_descriptor;
+	Clock::duration m_debounceDelay;
+	wgpu::SwapChain m_swapChain = nullptr;
+	uint64_t m_creationCount = 0;
+
+	// Last size reported by the window, and when
+	uint32_t m_pendingWidth = 0;
+	uint32_t m_pendingHeight = 0;
+	Clock::time_point m_lastSizeChange;
+	// Set when no texture could be acquired from the swap chain
+	bool m_outdated = false;
+};
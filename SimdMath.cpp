@@ -0,0 +1,252 @@
+#include "SimdMath.h"
+
+#include <cmath>
+#include <cstring>
+
+const char* simdMathName() {
+#if defined(SIMD_MATH_AVX)
+	return "AVX";
+#elif defined(SIMD_MATH_SSE)
+	return "SSE2";
+#elif defined(SIMD_MATH_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
+
+#if !defined(SIMD_MATH_SSE)
+// Cofactor expansion through 2x2 sub-determinants, as in linmath.h
+static bool mat4InverseScalar(float* r, const float* m) {
+	auto M = [m](int c, int i) { return m[4 * c + i]; };
+	float s[6], c[6];
+	s[0] = M(0, 0) * M(1, 1) - M(1, 0) * M(0, 1);
+	s[1] = M(0, 0) * M(1, 2) - M(1, 0) * M(0, 2);
+	s[2] = M(0, 0) * M(1, 3) - M(1, 0) * M(0, 3);
+	s[3] = M(0, 1) * M(1, 2) - M(1, 1) * M(0, 2);
+	s[4] = M(0, 1) * M(1, 3) - M(1, 1) * M(0, 3);
+	s[5] = M(0, 2) * M(1, 3) - M(1, 2) * M(0, 3);
+
+	c[0] = M(2, 0) * M(3, 1) - M(3, 0) * M(2, 1);
+	c[1] = M(2, 0) * M(3, 2) - M(3, 0) * M(2, 2);
+	c[2] = M(2, 0) * M(3, 3) - M(3, 0) * M(2, 3);
+	c[3] = M(2, 1) * M(3, 2) - M(3, 1) * M(2, 2);
+	c[4] = M(2, 1) * M(3, 3) - M(3, 1) * M(2, 3);
+	c[5] = M(2, 2) * M(3, 3) - M(3, 2) * M(2, 3);
+
+	float det = s[0] * c[5] - s[1] * c[4] + s[2] * c[3] + s[3] * c[2] - s[4] * c[1] + s[5] * c[0];
+	if (det == 0.0f) return false;
+	float idet = 1.0f / det;
+
+	float t[16];
+	t[0] = (M(1, 1) * c[5] - M(1, 2) * c[4] + M(1, 3) * c[3]) * idet;
+	t[1] = (-M(0, 1) * c[5] + M(0, 2) * c[4] - M(0, 3) * c[3]) * idet;
+	t[2] = (M(3, 1) * s[5] - M(3, 2) * s[4] + M(3, 3) * s[3]) * idet;
+	t[3] = (-M(2, 1) * s[5] + M(2, 2) * s[4] - M(2, 3) * s[3]) * idet;
+
+	t[4] = (-M(1, 0) * c[5] + M(1, 2) * c[2] - M(1, 3) * c[1]) * idet;
+	t[5] = (M(0, 0) * c[5] - M(0, 2) * c[2] + M(0, 3) * c[1]) * idet;
+	t[6] = (-M(3, 0) * s[5] + M(3, 2) * s[2] - M(3, 3) * s[1]) * idet;
+	t[7] = (M(2, 0) * s[5] - M(2, 2) * s[2] + M(2, 3) * s[1]) * idet;
+
+	t[8] = (M(1, 0) * c[4] - M(1, 1) * c[2] + M(1, 3) * c[0]) * idet;
+	t[9] = (-M(0, 0) * c[4] + M(0, 1) * c[2] - M(0, 3) * c[0]) * idet;
+	t[10] = (M(3, 0) * s[4] - M(3, 1) * s[2] + M(3, 3) * s[0]) * idet;
+	t[11] = (-M(2, 0) * s[4] + M(2, 1) * s[2] - M(2, 3) * s[0]) * idet;
+
+	t[12] = (-M(1, 0) * c[3] + M(1, 1) * c[1] - M(1, 2) * c[0]) * idet;
+	t[13] = (M(0, 0) * c[3] - M(0, 1) * c[1] + M(0, 2) * c[0]) * idet;
+	t[14] = (-M(3, 0) * s[3] + M(3, 1) * s[1] - M(3, 2) * s[0]) * idet;
+	t[15] = (M(2, 0) * s[3] - M(2, 1) * s[1] + M(2, 2) * s[0]) * idet;
+
+	std::memcpy(r, t, sizeof(t));
+	return true;
+}
+#endif
+
+#if defined(SIMD_MATH_SSE)
+// Products of 2x2 matrices stored row by row in one register:
+// A * B, adj(A) * B and A * adj(B).
+static inline __m128 mat2Mul(__m128 a, __m128 b) {
+	return _mm_add_ps(
+		_mm_mul_ps(a, SIMD_MATH_SWIZZLE(b, 0, 3, 0, 3)),
+		_mm_mul_ps(SIMD_MATH_SWIZZLE(a, 1, 0, 3, 2), SIMD_MATH_SWIZZLE(b, 2, 1, 2, 1))
+	);
+}
+
+static inline __m128 mat2AdjMul(__m128 a, __m128 b) {
+	return _mm_sub_ps(
+		_mm_mul_ps(SIMD_MATH_SWIZZLE(a, 3, 3, 0, 0), b),
+		_mm_mul_ps(SIMD_MATH_SWIZZLE(a, 1, 1, 2, 2), SIMD_MATH_SWIZZLE(b, 2, 3, 0, 1))
+	);
+}
+
+static inline __m128 mat2MulAdj(__m128 a, __m128 b) {
+	return _mm_sub_ps(
+		_mm_mul_ps(a, SIMD_MATH_SWIZZLE(b, 3, 0, 3, 0)),
+		_mm_mul_ps(SIMD_MATH_SWIZZLE(a, 1, 0, 3, 2), SIMD_MATH_SWIZZLE(b, 2, 1, 2, 1))
+	);
+}
+#endif
+
+bool mat4InverseRaw(float* r, const float* m) {
+#if defined(SIMD_MATH_SSE)
+	// Blockwise inversion of the 4x4 matrix seen as 2x2 blocks of 2x2
+	// matrices, so that the sub-determinants are shared between the 4 lanes.
+	// inverse(M) = inverse(transpose(M))^T, so the same code works on row and
+	// column-major storage.
+	__m128 m0 = _mm_loadu_ps(m);
+	__m128 m1 = _mm_loadu_ps(m + 4);
+	__m128 m2 = _mm_loadu_ps(m + 8);
+	__m128 m3 = _mm_loadu_ps(m + 12);
+
+	__m128 A = _mm_movelh_ps(m0, m1);
+	__m128 B = _mm_movehl_ps(m1, m0);
+	__m128 C = _mm_movelh_ps(m2, m3);
+	__m128 D = _mm_movehl_ps(m3, m2);
+
+	// (|A|, |B|, |C|, |D|)
+	__m128 detSub = _mm_sub_ps(
+		_mm_mul_ps(SIMD_MATH_SHUFFLE(m0, m2, 0, 2, 0, 2), SIMD_MATH_SHUFFLE(m1, m3, 1, 3, 1, 3)),
+		_mm_mul_ps(SIMD_MATH_SHUFFLE(m0, m2, 1, 3, 1, 3), SIMD_MATH_SHUFFLE(m1, m3, 0, 2, 0, 2))
+	);
+	__m128 detA = SIMD_MATH_SWIZZLE(detSub, 0, 0, 0, 0);
+	__m128 detB = SIMD_MATH_SWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = SIMD_MATH_SWIZZLE(detSub, 2, 2, 2, 2);
+	__m128 detD = SIMD_MATH_SWIZZLE(detSub, 3, 3, 3, 3);
+
+	__m128 adjDC = mat2AdjMul(D, C);
+	__m128 adjAB = mat2AdjMul(A, B);
+	// Adjugates of the blocks X, Y, Z, W of the inverse
+	__m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), mat2Mul(B, adjDC));
+	__m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), mat2Mul(C, adjAB));
+	__m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), mat2MulAdj(D, adjAB));
+	__m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), mat2MulAdj(A, adjDC));
+
+	// |M| = |A||D| + |B||C| - tr(adj(A)B adj(D)C), with the trace summed
+	// horizontally with shuffles since SSE2 has no hadd.
+	__m128 tr = _mm_mul_ps(adjAB, SIMD_MATH_SWIZZLE(adjDC, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, SIMD_MATH_SWIZZLE(tr, 1, 0, 3, 2));
+	tr = _mm_add_ps(tr, SIMD_MATH_SWIZZLE(tr, 2, 3, 0, 1));
+	__m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), tr);
+	if (_mm_cvtss_f32(detM) == 0.0f) return false;
+
+	__m128 rcpDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+	X = _mm_mul_ps(X, rcpDetM);
+	Y = _mm_mul_ps(Y, rcpDetM);
+	Z = _mm_mul_ps(Z, rcpDetM);
+	W = _mm_mul_ps(W, rcpDetM);
+
+	// Turn the adjugates back into the blocks while storing them
+	_mm_storeu_ps(r, SIMD_MATH_SHUFFLE(X, Y, 3, 1, 3, 1));
+	_mm_storeu_ps(r + 4, SIMD_MATH_SHUFFLE(X, Y, 2, 0, 2, 0));
+	_mm_storeu_ps(r + 8, SIMD_MATH_SHUFFLE(Z, W, 3, 1, 3, 1));
+	_mm_storeu_ps(r + 12, SIMD_MATH_SHUFFLE(Z, W, 2, 0, 2, 0));
+	return true;
+#else
+	return mat4InverseScalar(r, m);
+#endif
+}
+
+void mat4TransformBatch(const Mat4& m, const Vec4* points, Vec4* out, size_t count) {
+	const float* mp = m.data();
+	size_t i = 0;
+#if defined(SIMD_MATH_AVX)
+	__m256 c0 = simdLoadDuplicated(mp);
+	__m256 c1 = simdLoadDuplicated(mp + 4);
+	__m256 c2 = simdLoadDuplicated(mp + 8);
+	__m256 c3 = simdLoadDuplicated(mp + 12);
+	for (; i + 2 <= count; i += 2) {
+		__m256 v = _mm256_loadu_ps(&points[i].x);
+		_mm256_storeu_ps(&out[i].x, simdTransform2(c0, c1, c2, c3, v));
+	}
+#endif
+#if defined(SIMD_MATH_SSE)
+	__m128 d0 = _mm_load_ps(mp);
+	__m128 d1 = _mm_load_ps(mp + 4);
+	__m128 d2 = _mm_load_ps(mp + 8);
+	__m128 d3 = _mm_load_ps(mp + 12);
+	for (; i < count; ++i) {
+		_mm_store_ps(&out[i].x, simdTransform1(d0, d1, d2, d3, _mm_load_ps(&points[i].x)));
+	}
+#elif defined(SIMD_MATH_NEON)
+	float32x4_t d0 = vld1q_f32(mp);
+	float32x4_t d1 = vld1q_f32(mp + 4);
+	float32x4_t d2 = vld1q_f32(mp + 8);
+	float32x4_t d3 = vld1q_f32(mp + 12);
+	for (; i < count; ++i) {
+		vst1q_f32(&out[i].x, simdTransform1(d0, d1, d2, d3, vld1q_f32(&points[i].x)));
+	}
+#else
+	for (; i < count; ++i) {
+		Vec4 p = points[i];
+		mat4MulVec4Scalar(&out[i].x, mp, &p.x);
+	}
+#endif
+}
+
+Mat4 mat4Identity() {
+	return mat4Scale(1.0f, 1.0f, 1.0f);
+}
+
+Mat4 mat4Translation(float x, float y, float z) {
+	Mat4 m = mat4Identity();
+	m.columns[3] = Vec4{ x, y, z, 1.0f };
+	return m;
+}
+
+Mat4 mat4Scale(float x, float y, float z) {
+	Mat4 m;
+	m.columns[0] = Vec4{ x, 0.0f, 0.0f, 0.0f };
+	m.columns[1] = Vec4{ 0.0f, y, 0.0f, 0.0f };
+	m.columns[2] = Vec4{ 0.0f, 0.0f, z, 0.0f };
+	m.columns[3] = Vec4{ 0.0f, 0.0f, 0.0f, 1.0f };
+	return m;
+}
+
+Mat4 mat4Orthographic(float left, float right, float bottom, float top, float near, float far) {
+	Mat4 m = mat4Scale(2.0f / (right - left), 2.0f / (top - bottom), 1.0f / (near - far));
+	m.columns[3] = Vec4{
+		-(right + left) / (right - left),
+		-(top + bottom) / (top - bottom),
+		near / (near - far),
+		1.0f
+	};
+	return m;
+}
+
+Mat4 mat4Compose(const Vec4& translation, const Quat& rotation, const Vec4& scale) {
+	Mat4 m = quatToMat4(rotation);
+	const float s[3] = { scale.x, scale.y, scale.z };
+	for (int c = 0; c < 3; ++c) {
+		m.columns[c].x *= s[c];
+		m.columns[c].y *= s[c];
+		m.columns[c].z *= s[c];
+	}
+	m.columns[3] = Vec4{ translation.x, translation.y, translation.z, 1.0f };
+	return m;
+}
+
+Quat quatFromAxisAngle(float x, float y, float z, float angle) {
+	float len = std::sqrt(x * x + y * y + z * z);
+	float s = len > 0.0f ? std::sin(angle / 2) / len : 0.0f;
+	return Quat{ x * s, y * s, z * s, std::cos(angle / 2) };
+}
+
+Quat quatNormalize(const Quat& q) {
+	float len = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+	if (len == 0.0f) return quatIdentity();
+	float k = 1.0f / len;
+	return Quat{ q.x * k, q.y * k, q.z * k, q.w * k };
+}
+
+Mat4 quatToMat4(const Quat& q) {
+	float a = q.w, b = q.x, c = q.y, d = q.z;
+	float a2 = a * a, b2 = b * b, c2 = c * c, d2 = d * d;
+	Mat4 m;
+	m.columns[0] = Vec4{ a2 + b2 - c2 - d2, 2.0f * (b * c + a * d), 2.0f * (b * d - a * c), 0.0f };
+	m.columns[1] = Vec4{ 2.0f * (b * c - a * d), a2 - b2 + c2 - d2, 2.0f * (c * d + a * b), 0.0f };
+	m.columns[2] = Vec4{ 2.0f * (b * d + a * c), 2.0f * (c * d - a * b), a2 - b2 - c2 + d2, 0.0f };
+	m.columns[3] = Vec4{ 0.0f, 0.0f, 0.0f, 1.0f };
+	return m;
+}
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+
+#if defined(__AVX__)
+#  include <immintrin.h>
+#  define SIMD_MATH_AVX 1
+#  define SIMD_MATH_SSE 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define SIMD_MATH_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define SIMD_MATH_NEON 1
+#endif
+
+#if defined(SIMD_MATH_SSE)
+// _mm_shuffle_ps with the lanes listed in reading order, i.e. the result is
+// (a[x], a[y], b[z], b[w]).
+#  define SIMD_MATH_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE(w, z, y, x))
+#  define SIMD_MATH_SWIZZLE(a, x, y, z, w) SIMD_MATH_SHUFFLE(a, a, x, y, z, w)
+#endif
+
+/**
+ * Vector, quaternion and matrix types laid out exactly like linmath.h's
+ * vec4, quat and mat4x4 (and like WGSL's vec4f and mat4x4f), but aligned on
+ * 16 bytes so that each of them (or each matrix column) fits one SIMD
+ * register.
+ */
+struct alignas(16) Vec4 {
+	float x, y, z, w;
+};
+
+// Rotation quaternion, with the vector part in x, y, z like linmath.h
+struct alignas(16) Quat {
+	float x, y, z, w;
+};
+
+// Column-major 4x4 matrix
+struct alignas(16) Mat4 {
+	Vec4 columns[4];
+
+	float* data() { return &columns[0].x; }
+	const float* data() const { return &columns[0].x; }
+};
+
+/**
+ * Name of the instruction set the kernels below were compiled for.
+ */
+const char* simdMathName();
+
+Mat4 mat4Identity();
+Mat4 mat4Translation(float x, float y, float z);
+Mat4 mat4Scale(float x, float y, float z);
+// Column-major orthographic projection with WebGPU's [0, 1] depth range
+Mat4 mat4Orthographic(float left, float right, float bottom, float top, float near, float far);
+// Translation * Rotation * Scale
+Mat4 mat4Compose(const Vec4& translation, const Quat& rotation, const Vec4& scale);
+
+/**
+ * Raw kernels, working on column-major float arrays that need not be
+ * aligned. The result may alias any of the inputs. The small ones are
+ * defined inline so that calling them in a loop costs no function call.
+ */
+
+// Returns false (and leaves r untouched) if the matrix is not invertible
+bool mat4InverseRaw(float* r, const float* m);
+
+#if !defined(SIMD_MATH_SSE) && !defined(SIMD_MATH_NEON)
+inline void mat4MulVec4Scalar(float* r, const float* m, const float* v) {
+	float x = v[0], y = v[1], z = v[2], w = v[3];
+	for (int i = 0; i < 4; ++i) {
+		r[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i] * w;
+	}
+}
+#endif
+
+#if defined(SIMD_MATH_AVX)
+inline __m256 simdMadd256(__m256 a, __m256 b, __m256 c) {
+#  if defined(__FMA__)
+	return _mm256_fmadd_ps(a, b, c);
+#  else
+	return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#  endif
+}
+
+// The same 4 floats in both 128-bit halves
+inline __m256 simdLoadDuplicated(const float* p) {
+	__m128 v = _mm_loadu_ps(p);
+	return _mm256_insertf128_ps(_mm256_castps128_ps256(v), v, 1);
+}
+
+// Transform the two vectors packed in `v` by the matrix whose columns are
+// duplicated in c0..c3. Transforming the columns of a matrix this way is
+// also how two columns of a matrix product are computed at once.
+inline __m256 simdTransform2(__m256 c0, __m256 c1, __m256 c2, __m256 c3, __m256 v) {
+	__m256 r = _mm256_mul_ps(c0, _mm256_permute_ps(v, 0x00));
+	r = simdMadd256(c1, _mm256_permute_ps(v, 0x55), r);
+	r = simdMadd256(c2, _mm256_permute_ps(v, 0xAA), r);
+	return simdMadd256(c3, _mm256_permute_ps(v, 0xFF), r);
+}
+#endif
+
+#if defined(SIMD_MATH_SSE)
+inline __m128 simdTransform1(__m128 c0, __m128 c1, __m128 c2, __m128 c3, __m128 v) {
+	__m128 r = _mm_mul_ps(c0, SIMD_MATH_SWIZZLE(v, 0, 0, 0, 0));
+	r = _mm_add_ps(r, _mm_mul_ps(c1, SIMD_MATH_SWIZZLE(v, 1, 1, 1, 1)));
+	r = _mm_add_ps(r, _mm_mul_ps(c2, SIMD_MATH_SWIZZLE(v, 2, 2, 2, 2)));
+	return _mm_add_ps(r, _mm_mul_ps(c3, SIMD_MATH_SWIZZLE(v, 3, 3, 3, 3)));
+}
+
+// Cross product of the xyz parts, with 0 in w
+inline __m128 simdCross3(__m128 a, __m128 b) {
+	__m128 r = _mm_sub_ps(
+		_mm_mul_ps(SIMD_MATH_SWIZZLE(a, 1, 2, 0, 3), SIMD_MATH_SWIZZLE(b, 2, 0, 1, 3)),
+		_mm_mul_ps(SIMD_MATH_SWIZZLE(a, 2, 0, 1, 3), SIMD_MATH_SWIZZLE(b, 1, 2, 0, 3))
+	);
+	return r;
+}
+#elif defined(SIMD_MATH_NEON)
+inline float32x4_t simdTransform1(float32x4_t c0, float32x4_t c1, float32x4_t c2, float32x4_t c3, float32x4_t v) {
+	float32x4_t r = vmulq_n_f32(c0, vgetq_lane_f32(v, 0));
+	r = vmlaq_n_f32(r, c1, vgetq_lane_f32(v, 1));
+	r = vmlaq_n_f32(r, c2, vgetq_lane_f32(v, 2));
+	return vmlaq_n_f32(r, c3, vgetq_lane_f32(v, 3));
+}
+#endif
+
+inline void mat4MulRaw(float* r, const float* a, const float* b) {
+#if defined(SIMD_MATH_AVX)
+	__m256 a0 = simdLoadDuplicated(a);
+	__m256 a1 = simdLoadDuplicated(a + 4);
+	__m256 a2 = simdLoadDuplicated(a + 8);
+	__m256 a3 = simdLoadDuplicated(a + 12);
+	__m256 b01 = _mm256_loadu_ps(b);
+	__m256 b23 = _mm256_loadu_ps(b + 8);
+	_mm256_storeu_ps(r, simdTransform2(a0, a1, a2, a3, b01));
+	_mm256_storeu_ps(r + 8, simdTransform2(a0, a1, a2, a3, b23));
+#elif defined(SIMD_MATH_SSE)
+	__m128 a0 = _mm_loadu_ps(a);
+	__m128 a1 = _mm_loadu_ps(a + 4);
+	__m128 a2 = _mm_loadu_ps(a + 8);
+	__m128 a3 = _mm_loadu_ps(a + 12);
+	__m128 b0 = _mm_loadu_ps(b);
+	__m128 b1 = _mm_loadu_ps(b + 4);
+	__m128 b2 = _mm_loadu_ps(b + 8);
+	__m128 b3 = _mm_loadu_ps(b + 12);
+	_mm_storeu_ps(r, simdTransform1(a0, a1, a2, a3, b0));
+	_mm_storeu_ps(r + 4, simdTransform1(a0, a1, a2, a3, b1));
+	_mm_storeu_ps(r + 8, simdTransform1(a0, a1, a2, a3, b2));
+	_mm_storeu_ps(r + 12, simdTransform1(a0, a1, a2, a3, b3));
+#elif defined(SIMD_MATH_NEON)
+	float32x4_t a0 = vld1q_f32(a);
+	float32x4_t a1 = vld1q_f32(a + 4);
+	float32x4_t a2 = vld1q_f32(a + 8);
+	float32x4_t a3 = vld1q_f32(a + 12);
+	float32x4_t b0 = vld1q_f32(b);
+	float32x4_t b1 = vld1q_f32(b + 4);
+	float32x4_t b2 = vld1q_f32(b + 8);
+	float32x4_t b3 = vld1q_f32(b + 12);
+	vst1q_f32(r, simdTransform1(a0, a1, a2, a3, b0));
+	vst1q_f32(r + 4, simdTransform1(a0, a1, a2, a3, b1));
+	vst1q_f32(r + 8, simdTransform1(a0, a1, a2, a3, b2));
+	vst1q_f32(r + 12, simdTransform1(a0, a1, a2, a3, b3));
+#else
+	float t[16];
+	for (int c = 0; c < 4; ++c) {
+		mat4MulVec4Scalar(t + 4 * c, a, b + 4 * c);
+	}
+	std::memcpy(r, t, sizeof(t));
+#endif
+}
+
+inline void mat4MulVec4Raw(float* r, const float* m, const float* v) {
+#if defined(SIMD_MATH_SSE)
+	__m128 x = _mm_loadu_ps(v);
+	_mm_storeu_ps(r, simdTransform1(_mm_loadu_ps(m), _mm_loadu_ps(m + 4), _mm_loadu_ps(m + 8), _mm_loadu_ps(m + 12), x));
+#elif defined(SIMD_MATH_NEON)
+	float32x4_t x = vld1q_f32(v);
+	vst1q_f32(r, simdTransform1(vld1q_f32(m), vld1q_f32(m + 4), vld1q_f32(m + 8), vld1q_f32(m + 12), x));
+#else
+	float t[4];
+	mat4MulVec4Scalar(t, m, v);
+	std::memcpy(r, t, sizeof(t));
+#endif
+}
+
+inline void quatMulRaw(float* r, const float* p, const float* q) {
+#if defined(SIMD_MATH_SSE)
+	__m128 vp = _mm_loadu_ps(p);
+	__m128 vq = _mm_loadu_ps(q);
+	const __m128 flipW = _mm_setr_ps(1.0f, 1.0f, 1.0f, -1.0f);
+	// r = p.w * q + (p.xyz * q.w, -p.x * q.x) + (p.yzx * q.zxy, -p.y * q.y) - (p.zxy * q.yzx, p.z * q.z)
+	__m128 t0 = _mm_mul_ps(SIMD_MATH_SWIZZLE(vp, 3, 3, 3, 3), vq);
+	__m128 t1 = _mm_mul_ps(SIMD_MATH_SWIZZLE(vp, 0, 1, 2, 0), SIMD_MATH_SWIZZLE(vq, 3, 3, 3, 0));
+	__m128 t2 = _mm_mul_ps(SIMD_MATH_SWIZZLE(vp, 1, 2, 0, 1), SIMD_MATH_SWIZZLE(vq, 2, 0, 1, 1));
+	__m128 t3 = _mm_mul_ps(SIMD_MATH_SWIZZLE(vp, 2, 0, 1, 2), SIMD_MATH_SWIZZLE(vq, 1, 2, 0, 2));
+	__m128 res = _mm_add_ps(t0, _mm_mul_ps(_mm_add_ps(t1, t2), flipW));
+	_mm_storeu_ps(r, _mm_sub_ps(res, t3));
+#else
+	float t[4] = {
+		p[3] * q[0] + p[0] * q[3] + p[1] * q[2] - p[2] * q[1],
+		p[3] * q[1] + p[1] * q[3] + p[2] * q[0] - p[0] * q[2],
+		p[3] * q[2] + p[2] * q[3] + p[0] * q[1] - p[1] * q[0],
+		p[3] * q[3] - p[0] * q[0] - p[1] * q[1] - p[2] * q[2],
+	};
+	std::memcpy(r, t, sizeof(t));
+#endif
+}
+
+// Rotate the 3D vector v by the unit quaternion q
+inline void quatRotateRaw(float* r, const float* q, const float* v) {
+	// t = 2 * cross(q.xyz, v), v' = v + q.w * t + cross(q.xyz, t)
+#if defined(SIMD_MATH_SSE)
+	// v and r are vec3, so never read or write a 4th float there
+	__m128 vq = _mm_loadu_ps(q);
+	__m128 vv = _mm_setr_ps(v[0], v[1], v[2], 0.0f);
+	__m128 t = simdCross3(vq, vv);
+	t = _mm_add_ps(t, t);
+	__m128 res = _mm_add_ps(vv, _mm_mul_ps(SIMD_MATH_SWIZZLE(vq, 3, 3, 3, 3), t));
+	res = _mm_add_ps(res, simdCross3(vq, t));
+	_mm_storel_pi(reinterpret_cast<__m64*>(r), res);
+	_mm_store_ss(r + 2, _mm_movehl_ps(res, res));
+#else
+	float t[3] = {
+		2.0f * (q[1] * v[2] - q[2] * v[1]),
+		2.0f * (q[2] * v[0] - q[0] * v[2]),
+		2.0f * (q[0] * v[1] - q[1] * v[0]),
+	};
+	float res[3] = {
+		v[0] + q[3] * t[0] + q[1] * t[2] - q[2] * t[1],
+		v[1] + q[3] * t[1] + q[2] * t[0] - q[0] * t[2],
+		v[2] + q[3] * t[2] + q[0] * t[1] - q[1] * t[0],
+	};
+	std::memcpy(r, res, sizeof(res));
+#endif
+}
+
+/**
+ * Transform `count` points (or vectors, depending on their w) by the same
+ * matrix. This is the kernel that benefits the most from SIMD, since the
+ * matrix stays in registers for the whole batch.
+ */
+void mat4TransformBatch(const Mat4& m, const Vec4* points, Vec4* out, size_t count);
+
+inline Mat4 mat4Mul(const Mat4& a, const Mat4& b) {
+	Mat4 r;
+	mat4MulRaw(r.data(), a.data(), b.data());
+	return r;
+}
+
+inline Vec4 mat4MulVec4(const Mat4& m, const Vec4& v) {
+	Vec4 r;
+	mat4MulVec4Raw(&r.x, m.data(), &v.x);
+	return r;
+}
+
+inline bool mat4Inverse(const Mat4& m, Mat4& inverse) {
+	return mat4InverseRaw(inverse.data(), m.data());
+}
+
+inline Quat quatIdentity() {
+	return Quat{ 0.0f, 0.0f, 0.0f, 1.0f };
+}
+
+inline Quat quatMul(const Quat& p, const Quat& q) {
+	Quat r;
+	quatMulRaw(&r.x, &p.x, &q.x);
+	return r;
+}
+
+inline Vec4 quatRotate(const Quat& q, const Vec4& v) {
+	Vec4 r;
+	quatRotateRaw(&r.x, &q.x, &v.x);
+	r.w = v.w;
+	return r;
+}
+
+Quat quatFromAxisAngle(float x, float y, float z, float angle);
+Quat quatNormalize(const Quat& q);
+Mat4 quatToMat4(const Quat& q);
@@ -0,0 +1,1066 @@
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define TEXTURE_COMPRESSION_SSE2 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#  include <arm_neon.h>
+#  define TEXTURE_COMPRESSION_NEON 1
+#endif
+
+using namespace wgpu;
+
+// Below this many rows of blocks per thread, encoding a level is faster than
+// waking up workers
+constexpr uint32_t MIN_BLOCK_ROWS_PER_THREAD = 4;
+// Same for the rows of texels of a downsampled mip level
+constexpr uint32_t MIN_MIP_ROWS_PER_THREAD = 64;
+
+// Formats that compress() writes. Their position in this list identifies
+// them in saved files, so only append to it.
+static const TextureFormat encodableFormats[] = {
+	TextureFormat::BC1RGBAUnorm,
+	TextureFormat::BC1RGBAUnormSrgb,
+	TextureFormat::BC3RGBAUnorm,
+	TextureFormat::BC3RGBAUnormSrgb,
+	TextureFormat::BC4RUnorm,
+	TextureFormat::BC5RGUnorm,
+	TextureFormat::ETC2RGB8Unorm,
+	TextureFormat::ETC2RGB8UnormSrgb,
+	TextureFormat::ETC2RGBA8Unorm,
+	TextureFormat::ETC2RGBA8UnormSrgb,
+	TextureFormat::EACR11Unorm,
+	TextureFormat::EACRG11Unorm,
+};
+constexpr uint32_t ENCODABLE_FORMAT_COUNT = sizeof(encodableFormats) / sizeof(encodableFormats[0]);
+
+// How the blocks of a format are laid out
+enum class BlockEncoding {
+	None,
+	// BC1 color
+	BC1,
+	// BC4 alpha followed by BC1 color
+	BC3,
+	// BC4 red
+	BC4,
+	// BC4 red followed by BC4 green
+	BC5,
+	// ETC2 color
+	ETC2RGB,
+	// EAC alpha followed by ETC2 color
+	ETC2RGBA,
+	// EAC red
+	EACR,
+	// EAC red followed by EAC green
+	EACRG,
+};
+
+static BlockEncoding blockEncoding(TextureFormat format) {
+	switch (format) {
+	case TextureFormat::BC1RGBAUnorm:
+	case TextureFormat::BC1RGBAUnormSrgb:
+		return BlockEncoding::BC1;
+	case TextureFormat::BC3RGBAUnorm:
+	case TextureFormat::BC3RGBAUnormSrgb:
+		return BlockEncoding::BC3;
+	case TextureFormat::BC4RUnorm:
+		return BlockEncoding::BC4;
+	case TextureFormat::BC5RGUnorm:
+		return BlockEncoding::BC5;
+	case TextureFormat::ETC2RGB8Unorm:
+	case TextureFormat::ETC2RGB8UnormSrgb:
+		return BlockEncoding::ETC2RGB;
+	case TextureFormat::ETC2RGBA8Unorm:
+	case TextureFormat::ETC2RGBA8UnormSrgb:
+		return BlockEncoding::ETC2RGBA;
+	case TextureFormat::EACR11Unorm:
+		return BlockEncoding::EACR;
+	case TextureFormat::EACRG11Unorm:
+		return BlockEncoding::EACRG;
+	default:
+		return BlockEncoding::None;
+	}
+}
+
+static bool isSrgb(TextureFormat format) {
+	return format == TextureFormat::BC1RGBAUnormSrgb
+		|| format == TextureFormat::BC3RGBAUnormSrgb
+		|| format == TextureFormat::ETC2RGB8UnormSrgb
+		|| format == TextureFormat::ETC2RGBA8UnormSrgb;
+}
+
+// A 4x4 block of RGBA8 texels, row by row
+struct Block {
+	uint8_t texels[16][4];
+};
+
+// Index of the nearest of the 4 palette colors for each of the `count`
+// texels, given as planes of floats, with `count` a multiple of 4. Returns
+// the sum of the squared distances to the chosen colors.
+static float nearestColors(const float* r, const float* g, const float* b, uint32_t count, const float palette[4][3], uint8_t* indices) {
+#if defined(TEXTURE_COMPRESSION_SSE2)
+	__m128 total = _mm_setzero_ps();
+	for (uint32_t i = 0; i < count; i += 4) {
+		__m128 texelR = _mm_loadu_ps(r + i);
+		__m128 texelG = _mm_loadu_ps(g + i);
+		__m128 texelB = _mm_loadu_ps(b + i);
+		__m128 best = _mm_set1_ps(FLT_MAX);
+		__m128i bestIndex = _mm_setzero_si128();
+		for (int k = 0; k < 4; ++k) {
+			__m128 dr = _mm_sub_ps(texelR, _mm_set1_ps(palette[k][0]));
+			__m128 dg = _mm_sub_ps(texelG, _mm_set1_ps(palette[k][1]));
+			__m128 db = _mm_sub_ps(texelB, _mm_set1_ps(palette[k][2]));
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+			__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+			best = _mm_min_ps(distance, best);
+			bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(k)));
+		}
+		total = _mm_add_ps(total, best);
+		alignas(16) int32_t lanes[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(lanes), bestIndex);
+		for (int j = 0; j < 4; ++j) {
+			indices[i + j] = static_cast<uint8_t>(lanes[j]);
+		}
+	}
+	alignas(16) float sums[4];
+	_mm_store_ps(sums, total);
+	return sums[0] + sums[1] + sums[2] + sums[3];
+#elif defined(TEXTURE_COMPRESSION_NEON)
+	float32x4_t total = vdupq_n_f32(0.0f);
+	for (uint32_t i = 0; i < count; i += 4) {
+		float32x4_t texelR = vld1q_f32(r + i);
+		float32x4_t texelG = vld1q_f32(g + i);
+		float32x4_t texelB = vld1q_f32(b + i);
+		float32x4_t best = vdupq_n_f32(FLT_MAX);
+		uint32x4_t bestIndex = vdupq_n_u32(0);
+		for (uint32_t k = 0; k < 4; ++k) {
+			float32x4_t dr = vsubq_f32(texelR, vdupq_n_f32(palette[k][0]));
+			float32x4_t dg = vsubq_f32(texelG, vdupq_n_f32(palette[k][1]));
+			float32x4_t db = vsubq_f32(texelB, vdupq_n_f32(palette[k][2]));
+			float32x4_t distance = vmlaq_f32(vmlaq_f32(vmulq_f32(dr, dr), dg, dg), db, db);
+			uint32x4_t closer = vcltq_f32(distance, best);
+			best = vminq_f32(distance, best);
+			bestIndex = vbslq_u32(closer, vdupq_n_u32(k), bestIndex);
+		}
+		total = vaddq_f32(total, best);
+		uint32_t lanes[4];
+		vst1q_u32(lanes, bestIndex);
+		for (int j = 0; j < 4; ++j) {
+			indices[i + j] = static_cast<uint8_t>(lanes[j]);
+		}
+	}
+	return vgetq_lane_f32(total, 0) + vgetq_lane_f32(total, 1) + vgetq_lane_f32(total, 2) + vgetq_lane_f32(total, 3);
+#else
+	float total = 0.0f;
+	for (uint32_t i = 0; i < count; ++i) {
+		float best = FLT_MAX;
+		uint8_t bestIndex = 0;
+		for (uint8_t k = 0; k < 4; ++k) {
+			float dr = r[i] - palette[k][0];
+			float dg = g[i] - palette[k][1];
+			float db = b[i] - palette[k][2];
+			float distance = dr * dr + dg * dg + db * db;
+			if (distance < best) {
+				best = distance;
+				bestIndex = k;
+			}
+		}
+		indices[i] = bestIndex;
+		total += best;
+	}
+	return total;
+#endif
+}
+
+static uint16_t packRgb565(const float color[3]) {
+	auto quantize = [](float c, float maxValue) {
+		return static_cast<uint16_t>(std::lround(std::clamp(c, 0.0f, 255.0f) * maxValue / 255.0f));
+	};
+	return static_cast<uint16_t>(quantize(color[0], 31.0f) << 11 | quantize(color[1], 63.0f) << 5 | quantize(color[2], 31.0f));
+}
+
+static void unpackRgb565(uint16_t packed, int color[3]) {
+	int r = packed >> 11;
+	int g = (packed >> 5) & 63;
+	int b = packed & 31;
+	color[0] = (r << 3) | (r >> 2);
+	color[1] = (g << 2) | (g >> 4);
+	color[2] = (b << 3) | (b >> 2);
+}
+
+// Colors of a block in 4 color mode
+static void bc1Palette(uint16_t c0, uint16_t c1, float palette[4][3]) {
+	int color0[3], color1[3];
+	unpackRgb565(c0, color0);
+	unpackRgb565(c1, color1);
+	for (int c = 0; c < 3; ++c) {
+		palette[0][c] = static_cast<float>(color0[c]);
+		palette[1][c] = static_cast<float>(color1[c]);
+		palette[2][c] = (2.0f * color0[c] + color1[c]) / 3.0f;
+		palette[3][c] = (color0[c] + 2.0f * color1[c]) / 3.0f;
+	}
+}
+
+static void encodeBc1(const Block& block, uint8_t* out) {
+	float r[16], g[16], b[16];
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		r[i] = block.texels[i][0];
+		g[i] = block.texels[i][1];
+		b[i] = block.texels[i][2];
+		mean[0] += r[i];
+		mean[1] += g[i];
+		mean[2] += b[i];
+	}
+	for (float& m : mean) m /= 16.0f;
+
+	// The endpoints are the extremes of the texels along their principal
+	// axis, found by power iteration on the covariance matrix
+	float cov[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		float dr = r[i] - mean[0], dg = g[i] - mean[1], db = b[i] - mean[2];
+		cov[0] += dr * dr;
+		cov[1] += dr * dg;
+		cov[2] += dr * db;
+		cov[3] += dg * dg;
+		cov[4] += dg * db;
+		cov[5] += db * db;
+	}
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; ++iteration) {
+		float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+		float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+		float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+		float scale = std::max({ std::abs(x), std::abs(y), std::abs(z) });
+		if (scale < 1e-6f) break;
+		axis[0] = x / scale;
+		axis[1] = y / scale;
+		axis[2] = z / scale;
+	}
+	float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+	for (float& a : axis) a /= length;
+
+	float minT = 0.0f, maxT = 0.0f;
+	for (int i = 0; i < 16; ++i) {
+		float t = (r[i] - mean[0]) * axis[0] + (g[i] - mean[1]) * axis[1] + (b[i] - mean[2]) * axis[2];
+		minT = std::min(minT, t);
+		maxT = std::max(maxT, t);
+	}
+	float end0[3], end1[3];
+	for (int c = 0; c < 3; ++c) {
+		end0[c] = mean[c] + axis[c] * maxT;
+		end1[c] = mean[c] + axis[c] * minT;
+	}
+
+	uint16_t c0 = packRgb565(end0);
+	uint16_t c1 = packRgb565(end1);
+	float palette[4][3];
+	bc1Palette(c0, c1, palette);
+	uint8_t indices[16];
+	float error = nearestColors(r, g, b, 16, palette, indices);
+
+	// Refine the endpoints once by least squares, given the chosen indices
+	const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+	float aa = 0.0f, bb = 0.0f, ab = 0.0f;
+	float ax[3] = { 0.0f, 0.0f, 0.0f }, bx[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i) {
+		float w = weights[indices[i]];
+		aa += w * w;
+		bb += (1.0f - w) * (1.0f - w);
+		ab += w * (1.0f - w);
+		const float texel[3] = { r[i], g[i], b[i] };
+		for (int c = 0; c < 3; ++c) {
+			ax[c] += w * texel[c];
+			bx[c] += (1.0f - w) * texel[c];
+		}
+	}
+	float determinant = aa * bb - ab * ab;
+	if (std::abs(determinant) > 1e-6f) {
+		for (int c = 0; c < 3; ++c) {
+			end0[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+			end1[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+		}
+		uint16_t refined0 = packRgb565(end0);
+		uint16_t refined1 = packRgb565(end1);
+		float refinedPalette[4][3];
+		bc1Palette(refined0, refined1, refinedPalette);
+		uint8_t refinedIndices[16];
+		float refinedError = nearestColors(r, g, b, 16, refinedPalette, refinedIndices);
+		if (refinedError < error) {
+			c0 = refined0;
+			c1 = refined1;
+			std::memcpy(indices, refinedIndices, sizeof(indices));
+		}
+	}
+
+	// 4 color mode needs c0 > c1, and when they are equal the block is in 3
+	// color mode where index 3 is transparent black
+	if (c0 < c1) {
+		std::swap(c0, c1);
+		for (uint8_t& index : indices) index ^= 1;
+	}
+	else if (c0 == c1) {
+		std::memset(indices, 0, sizeof(indices));
+	}
+	uint32_t indexBits = 0;
+	for (int i = 0; i < 16; ++i) {
+		indexBits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+	}
+	out[0] = static_cast<uint8_t>(c0 & 0xff);
+	out[1] = static_cast<uint8_t>(c0 >> 8);
+	out[2] = static_cast<uint8_t>(c1 & 0xff);
+	out[3] = static_cast<uint8_t>(c1 >> 8);
+	for (int i = 0; i < 4; ++i) {
+		out[4 + i] = static_cast<uint8_t>(indexBits >> (8 * i));
+	}
+}
+
+// In BC3 the color block is always in 4 color mode
+static void decodeBc1(const uint8_t* in, Block& block, bool alwaysFourColors) {
+	uint16_t c0 = static_cast<uint16_t>(in[0] | in[1] << 8);
+	uint16_t c1 = static_cast<uint16_t>(in[2] | in[3] << 8);
+	int palette[4][4];
+	unpackRgb565(c0, palette[0]);
+	unpackRgb565(c1, palette[1]);
+	palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+	for (int c = 0; c < 3; ++c) {
+		if (c0 > c1 || alwaysFourColors) {
+			palette[2][c] = (2 * palette[0][c] + palette[1][c] + 1) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c] + 1) / 3;
+		}
+		else {
+			palette[2][c] = (palette[0][c] + palette[1][c] + 1) / 2;
+			palette[3][c] = 0;
+		}
+	}
+	if (c0 <= c1 && !alwaysFourColors) {
+		palette[3][3] = 0;
+	}
+	uint32_t indexBits = in[4] | in[5] << 8 | in[6] << 16 | static_cast<uint32_t>(in[7]) << 24;
+	for (int i = 0; i < 16; ++i) {
+		const int* color = palette[(indexBits >> (2 * i)) & 3];
+		for (int c = 0; c < 4; ++c) {
+			block.texels[i][c] = static_cast<uint8_t>(color[c]);
+		}
+	}
+}
+
+static void bc4Palette(int r0, int r1, int palette[8]) {
+	palette[0] = r0;
+	palette[1] = r1;
+	if (r0 > r1) {
+		for (int i = 2; i < 8; ++i) {
+			palette[i] = ((8 - i) * r0 + (i - 1) * r1 + 3) / 7;
+		}
+	}
+	else {
+		for (int i = 2; i < 6; ++i) {
+			palette[i] = ((6 - i) * r0 + (i - 1) * r1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static void encodeBc4(const Block& block, int channel, uint8_t* out) {
+	int minValue = 255, maxValue = 0;
+	for (int i = 0; i < 16; ++i) {
+		minValue = std::min<int>(minValue, block.texels[i][channel]);
+		maxValue = std::max<int>(maxValue, block.texels[i][channel]);
+	}
+	// With r0 > r1 the block interpolates 6 values between them, and with
+	// r0 == r1 all indices at 0 give that single value
+	int palette[8];
+	bc4Palette(maxValue, minValue, palette);
+	uint64_t indexBits = 0;
+	if (maxValue > minValue) {
+		for (int i = 0; i < 16; ++i) {
+			int value = block.texels[i][channel];
+			int bestIndex = 0;
+			for (int k = 1; k < 8; ++k) {
+				if (std::abs(palette[k] - value) < std::abs(palette[bestIndex] - value)) {
+					bestIndex = k;
+				}
+			}
+			indexBits |= static_cast<uint64_t>(bestIndex) << (3 * i);
+		}
+	}
+	out[0] = static_cast<uint8_t>(maxValue);
+	out[1] = static_cast<uint8_t>(minValue);
+	for (int i = 0; i < 6; ++i) {
+		out[2 + i] = static_cast<uint8_t>(indexBits >> (8 * i));
+	}
+}
+
+static void decodeBc4(const uint8_t* in, Block& block, int channel) {
+	int palette[8];
+	bc4Palette(in[0], in[1], palette);
+	uint64_t indexBits = 0;
+	for (int i = 0; i < 6; ++i) {
+		indexBits |= static_cast<uint64_t>(in[2 + i]) << (8 * i);
+	}
+	for (int i = 0; i < 16; ++i) {
+		block.texels[i][channel] = static_cast<uint8_t>(palette[(indexBits >> (3 * i)) & 7]);
+	}
+}
+
+// ETC2 color
+// Only the individual and differential modes, which ETC2 shares with ETC1,
+// are used. Each half of the block (left and right, or top and bottom when
+// flipped) has a base color, to which every texel adds one of the 4
+// luminance offsets of the half's table.
+
+static const int etcModifiers[8][2] = {
+	{ 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 }, { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+// Offset of the texels whose index is `index`: +a, +b, -a, -b
+static int etcModifier(int table, int index) {
+	int modifier = etcModifiers[table][index & 1];
+	return index & 2 ? -modifier : modifier;
+}
+
+// Best table for the 8 texels of a half block, given its base color.
+// Returns the squared error.
+static float etcHalfBlock(const float* r, const float* g, const float* b, const int base[3], int& bestTable, uint8_t bestIndices[8]) {
+	float bestError = FLT_MAX;
+	for (int table = 0; table < 8; ++table) {
+		float palette[4][3];
+		for (int k = 0; k < 4; ++k) {
+			for (int c = 0; c < 3; ++c) {
+				palette[k][c] = static_cast<float>(std::clamp(base[c] + etcModifier(table, k), 0, 255));
+			}
+		}
+		uint8_t indices[8];
+		float error = nearestColors(r, g, b, 8, palette, indices);
+		if (error < bestError) {
+			bestError = error;
+			bestTable = table;
+			std::memcpy(bestIndices, indices, sizeof(indices));
+		}
+	}
+	return bestError;
+}
+
+static void writeBigEndian(uint64_t bits, uint8_t* out) {
+	for (int i = 0; i < 8; ++i) {
+		out[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+	}
+}
+
+static uint64_t readBigEndian(const uint8_t* in) {
+	uint64_t bits = 0;
+	for (int i = 0; i < 8; ++i) {
+		bits = (bits << 8) | in[i];
+	}
+	return bits;
+}
+
+static void encodeEtc2Rgb(const Block& block, uint8_t* out) {
+	float bestError = FLT_MAX;
+	uint64_t bestBits = 0;
+	for (uint32_t flip = 0; flip < 2; ++flip) {
+		// Texels of each half, and their position in the index bits, which
+		// go column by column
+		float r[2][8], g[2][8], b[2][8];
+		int position[2][8];
+		int count[2] = { 0, 0 };
+		float mean[2][3] = { { 0.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 0.0f } };
+		for (int y = 0; y < 4; ++y) {
+			for (int x = 0; x < 4; ++x) {
+				int half = flip ? y / 2 : x / 2;
+				const uint8_t* texel = block.texels[4 * y + x];
+				int n = count[half]++;
+				r[half][n] = texel[0];
+				g[half][n] = texel[1];
+				b[half][n] = texel[2];
+				position[half][n] = 4 * x + y;
+				for (int c = 0; c < 3; ++c) mean[half][c] += texel[c] / 8.0f;
+			}
+		}
+
+		for (int differential = 0; differential < 2; ++differential) {
+			int quantized[2][3];
+			int base[2][3];
+			bool valid = true;
+			for (int half = 0; half < 2; ++half) {
+				for (int c = 0; c < 3; ++c) {
+					if (differential) {
+						quantized[half][c] = static_cast<int>(std::lround(mean[half][c] * 31.0f / 255.0f));
+						base[half][c] = (quantized[half][c] << 3) | (quantized[half][c] >> 2);
+					}
+					else {
+						quantized[half][c] = static_cast<int>(std::lround(mean[half][c] * 15.0f / 255.0f));
+						base[half][c] = quantized[half][c] * 17;
+					}
+				}
+			}
+			if (differential) {
+				// The second color is stored as a 3-bit signed offset
+				for (int c = 0; c < 3; ++c) {
+					int delta = quantized[1][c] - quantized[0][c];
+					valid = valid && delta >= -4 && delta <= 3;
+				}
+			}
+			if (!valid) continue;
+
+			int tables[2];
+			uint8_t indices[2][8];
+			float error = etcHalfBlock(r[0], g[0], b[0], base[0], tables[0], indices[0]);
+			if (error >= bestError) continue;
+			error += etcHalfBlock(r[1], g[1], b[1], base[1], tables[1], indices[1]);
+			if (error >= bestError) continue;
+
+			uint64_t bits = 0;
+			for (int c = 0; c < 3; ++c) {
+				int shift = 56 - 8 * c;
+				if (differential) {
+					bits |= static_cast<uint64_t>(quantized[0][c]) << (shift + 3);
+					bits |= static_cast<uint64_t>((quantized[1][c] - quantized[0][c]) & 7) << shift;
+				}
+				else {
+					bits |= static_cast<uint64_t>(quantized[0][c]) << (shift + 4);
+					bits |= static_cast<uint64_t>(quantized[1][c]) << shift;
+				}
+			}
+			bits |= static_cast<uint64_t>(tables[0]) << 37;
+			bits |= static_cast<uint64_t>(tables[1]) << 34;
+			bits |= static_cast<uint64_t>(differential) << 33;
+			bits |= static_cast<uint64_t>(flip) << 32;
+			for (int half = 0; half < 2; ++half) {
+				for (int n = 0; n < 8; ++n) {
+					uint64_t index = indices[half][n];
+					bits |= (index >> 1) << (16 + position[half][n]);
+					bits |= (index & 1) << position[half][n];
+				}
+			}
+			bestError = error;
+			bestBits = bits;
+		}
+	}
+	writeBigEndian(bestBits, out);
+}
+
+static void decodeEtc2Rgb(const uint8_t* in, Block& block) {
+	uint64_t bits = readBigEndian(in);
+	bool differential = (bits >> 33) & 1;
+	bool flip = (bits >> 32) & 1;
+	int tables[2] = { static_cast<int>((bits >> 37) & 7), static_cast<int>((bits >> 34) & 7) };
+	int base[2][3];
+	for (int c = 0; c < 3; ++c) {
+		int shift = 56 - 8 * c;
+		if (differential) {
+			int first = static_cast<int>((bits >> (shift + 3)) & 31);
+			int delta = static_cast<int>((bits >> shift) & 7);
+			if (delta >= 4) delta -= 8;
+			// Out of range sums select the ETC2 T, H and planar modes, which
+			// the encoder never writes
+			int second = std::clamp(first + delta, 0, 31);
+			base[0][c] = (first << 3) | (first >> 2);
+			base[1][c] = (second << 3) | (second >> 2);
+		}
+		else {
+			base[0][c] = static_cast<int>((bits >> (shift + 4)) & 15) * 17;
+			base[1][c] = static_cast<int>((bits >> shift) & 15) * 17;
+		}
+	}
+	for (int y = 0; y < 4; ++y) {
+		for (int x = 0; x < 4; ++x) {
+			int half = flip ? y / 2 : x / 2;
+			int position = 4 * x + y;
+			int index = static_cast<int>(((bits >> (16 + position)) & 1) << 1 | ((bits >> position) & 1));
+			uint8_t* texel = block.texels[4 * y + x];
+			for (int c = 0; c < 3; ++c) {
+				texel[c] = static_cast<uint8_t>(std::clamp(base[half][c] + etcModifier(tables[half], index), 0, 255));
+			}
+		}
+	}
+}
+
+// EAC, for ETC2 alpha and R11/RG11
+// Texels are a base value plus a multiple of one of 8 offsets of a table.
+// R11 decodes the same blocks with 3 more bits of precision, so encoding
+// them from 8-bit values uses the same search.
+
+static const int eacModifiers[16][8] = {
+	{ -3, -6, -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5, -8, -13, 1, 4, 7, 12 },
+	{ -2, -4, -6, -13, 1, 3, 5, 12 },
+	{ -3, -6, -8, -12, 2, 5, 7, 11 },
+	{ -3, -7, -9, -11, 2, 6, 8, 10 },
+	{ -4, -7, -8, -11, 3, 6, 7, 10 },
+	{ -3, -5, -8, -11, 2, 4, 7, 10 },
+	{ -2, -6, -8, -10, 1, 5, 7, 9 },
+	{ -2, -5, -8, -10, 1, 4, 7, 9 },
+	{ -2, -4, -8, -10, 1, 3, 7, 9 },
+	{ -2, -5, -7, -10, 1, 4, 6, 9 },
+	{ -3, -4, -7, -10, 2, 3, 6, 9 },
+	{ -1, -2, -3, -10, 0, 1, 2, 9 },
+	{ -4, -6, -8, -9, 3, 5, 7, 8 },
+	{ -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+static void encodeEac(const Block& block, int channel, uint8_t* out) {
+	// Values in the order of the index bits, column by column
+	int values[16];
+	int minValue = 255, maxValue = 0;
+	for (int position = 0; position < 16; ++position) {
+		values[position] = block.texels[4 * (position % 4) + position / 4][channel];
+		minValue = std::min(minValue, values[position]);
+		maxValue = std::max(maxValue, values[position]);
+	}
+
+	int bestError = INT32_MAX;
+	uint64_t bestBits = 0;
+	for (int table = 0; table < 16 && bestError > 0; ++table) {
+		// Offsets 3 and 7 are the extremes of each table
+		int low = eacModifiers[table][3];
+		int high = eacModifiers[table][7];
+		int fitted = static_cast<int>(std::lround(static_cast<float>(maxValue - minValue) / (high - low)));
+		for (int multiplier = std::max(fitted, 1); multiplier <= std::min(fitted + 1, 15); ++multiplier) {
+			int base = static_cast<int>(std::lround(0.5f * (maxValue + minValue) - 0.5f * multiplier * (high + low)));
+			base = std::clamp(base, 0, 255);
+			int palette[8];
+			for (int k = 0; k < 8; ++k) {
+				palette[k] = std::clamp(base + eacModifiers[table][k] * multiplier, 0, 255);
+			}
+			int error = 0;
+			uint64_t bits = static_cast<uint64_t>(base) << 56 | static_cast<uint64_t>(multiplier) << 52 | static_cast<uint64_t>(table) << 48;
+			for (int position = 0; position < 16; ++position) {
+				int bestIndex = 0;
+				for (int k = 1; k < 8; ++k) {
+					if (std::abs(palette[k] - values[position]) < std::abs(palette[bestIndex] - values[position])) {
+						bestIndex = k;
+					}
+				}
+				int difference = palette[bestIndex] - values[position];
+				error += difference * difference;
+				if (error >= bestError) break;
+				bits |= static_cast<uint64_t>(bestIndex) << (45 - 3 * position);
+			}
+			if (error < bestError) {
+				bestError = error;
+				bestBits = bits;
+			}
+		}
+	}
+	writeBigEndian(bestBits, out);
+}
+
+static void decodeEac(const uint8_t* in, Block& block, int channel, bool elevenBits) {
+	uint64_t bits = readBigEndian(in);
+	int base = static_cast<int>(bits >> 56);
+	int multiplier = static_cast<int>((bits >> 52) & 15);
+	int table = static_cast<int>((bits >> 48) & 15);
+	for (int position = 0; position < 16; ++position) {
+		int modifier = eacModifiers[table][(bits >> (45 - 3 * position)) & 7];
+		int value;
+		if (elevenBits) {
+			int value11 = multiplier ? base * 8 + 4 + modifier * multiplier * 8 : base * 8 + 4 + modifier;
+			value = (std::clamp(value11, 0, 2047) * 255 + 1023) / 2047;
+		}
+		else {
+			value = std::clamp(base + modifier * multiplier, 0, 255);
+		}
+		block.texels[4 * (position % 4) + position / 4][channel] = static_cast<uint8_t>(value);
+	}
+}
+
+static void encodeBlock(BlockEncoding encoding, const Block& block, uint8_t* out) {
+	switch (encoding) {
+	case BlockEncoding::BC1:
+		encodeBc1(block, out);
+		break;
+	case BlockEncoding::BC3:
+		encodeBc4(block, 3, out);
+		encodeBc1(block, out + 8);
+		break;
+	case BlockEncoding::BC4:
+		encodeBc4(block, 0, out);
+		break;
+	case BlockEncoding::BC5:
+		encodeBc4(block, 0, out);
+		encodeBc4(block, 1, out + 8);
+		break;
+	case BlockEncoding::ETC2RGB:
+		encodeEtc2Rgb(block, out);
+		break;
+	case BlockEncoding::ETC2RGBA:
+		encodeEac(block, 3, out);
+		encodeEtc2Rgb(block, out + 8);
+		break;
+	case BlockEncoding::EACR:
+		encodeEac(block, 0, out);
+		break;
+	case BlockEncoding::EACRG:
+		encodeEac(block, 0, out);
+		encodeEac(block, 1, out + 8);
+		break;
+	case BlockEncoding::None:
+		assert(false);
+		break;
+	}
+}
+
+static void decodeBlock(BlockEncoding encoding, const uint8_t* in, Block& block) {
+	for (auto& texel : block.texels) {
+		texel[0] = texel[1] = texel[2] = 0;
+		texel[3] = 255;
+	}
+	switch (encoding) {
+	case BlockEncoding::BC1:
+		decodeBc1(in, block, false);
+		break;
+	case BlockEncoding::BC3:
+		decodeBc1(in + 8, block, true);
+		decodeBc4(in, block, 3);
+		break;
+	case BlockEncoding::BC4:
+		decodeBc4(in, block, 0);
+		break;
+	case BlockEncoding::BC5:
+		decodeBc4(in, block, 0);
+		decodeBc4(in + 8, block, 1);
+		break;
+	case BlockEncoding::ETC2RGB:
+		decodeEtc2Rgb(in, block);
+		break;
+	case BlockEncoding::ETC2RGBA:
+		decodeEtc2Rgb(in + 8, block);
+		decodeEac(in, block, 3, false);
+		break;
+	case BlockEncoding::EACR:
+		decodeEac(in, block, 0, true);
+		break;
+	case BlockEncoding::EACRG:
+		decodeEac(in, block, 0, true);
+		decodeEac(in + 8, block, 1, true);
+		break;
+	case BlockEncoding::None:
+		assert(false);
+		break;
+	}
+}
+
+// Blocks on the right and bottom edges of levels that are not a multiple of
+// 4 repeat their last texels
+static void loadBlock(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block) {
+	for (uint32_t y = 0; y < 4; ++y) {
+		uint32_t sourceY = std::min(4 * blockY + y, height - 1);
+		for (uint32_t x = 0; x < 4; ++x) {
+			uint32_t sourceX = std::min(4 * blockX + x, width - 1);
+			std::memcpy(block.texels[4 * y + x], rgba + 4 * (static_cast<size_t>(sourceY) * width + sourceX), 4);
+		}
+	}
+}
+
+static float srgbToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c) {
+	return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// Average 2x2 texels, in linear space for the color channels of sRGB images
+static std::vector<uint8_t> downsample(const uint8_t* rgba, uint32_t width, uint32_t height, bool srgb, ThreadPool* threadPool) {
+	static const auto tables = []() {
+		struct {
+			float toLinear[256];
+			// Indexed by linear values quantized to 12 bits
+			uint8_t toSrgb[4096];
+		} t;
+		for (int i = 0; i < 256; ++i) {
+			t.toLinear[i] = srgbToLinear(i / 255.0f);
+		}
+		for (int i = 0; i < 4096; ++i) {
+			t.toSrgb[i] = static_cast<uint8_t>(std::clamp(linearToSrgb(i / 4095.0f), 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+		return t;
+	}();
+
+	uint32_t levelWidth = std::max(width / 2, 1u);
+	uint32_t levelHeight = std::max(height / 2, 1u);
+	std::vector<uint8_t> level(4 * static_cast<size_t>(levelWidth) * levelHeight);
+	auto downsampleRows = [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t y = begin; y < end; ++y) {
+			const uint8_t* row0 = rgba + 4 * static_cast<size_t>(std::min(2 * y, height - 1)) * width;
+			const uint8_t* row1 = rgba + 4 * static_cast<size_t>(std::min(2 * y + 1, height - 1)) * width;
+			for (uint32_t x = 0; x < levelWidth; ++x) {
+				uint32_t x0 = 4 * std::min(2 * x, width - 1);
+				uint32_t x1 = 4 * std::min(2 * x + 1, width - 1);
+				uint8_t* texel = &level[4 * (static_cast<size_t>(y) * levelWidth + x)];
+				for (uint32_t c = 0; c < 4; ++c) {
+					if (srgb && c < 3) {
+						float sum = tables.toLinear[row0[x0 + c]] + tables.toLinear[row0[x1 + c]] + tables.toLinear[row1[x0 + c]] + tables.toLinear[row1[x1 + c]];
+						texel[c] = tables.toSrgb[static_cast<int>(sum * (4095.0f / 4.0f) + 0.5f)];
+					}
+					else {
+						texel[c] = static_cast<uint8_t>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+					}
+				}
+			}
+		}
+	};
+	if (threadPool) {
+		threadPool->parallelFor(levelHeight, MIN_MIP_ROWS_PER_THREAD, downsampleRows);
+	}
+	else {
+		downsampleRows(0, levelHeight, 0);
+	}
+	return level;
+}
+
+std::vector<FeatureName> TextureCompressor::optionalFeatures() {
+	return { FeatureName::TextureCompressionBC, FeatureName::TextureCompressionETC2, FeatureName::TextureCompressionASTC };
+}
+
+TextureFormat TextureCompressor::chooseFormat(Device device, TextureContent content, bool srgb) {
+	if (device.hasFeature(FeatureName::TextureCompressionBC)) {
+		switch (content) {
+		case TextureContent::Color: return srgb ? TextureFormat::BC1RGBAUnormSrgb : TextureFormat::BC1RGBAUnorm;
+		case TextureContent::ColorAlpha: return srgb ? TextureFormat::BC3RGBAUnormSrgb : TextureFormat::BC3RGBAUnorm;
+		case TextureContent::R: return TextureFormat::BC4RUnorm;
+		case TextureContent::RG: return TextureFormat::BC5RGUnorm;
+		}
+	}
+	if (device.hasFeature(FeatureName::TextureCompressionETC2)) {
+		switch (content) {
+		case TextureContent::Color: return srgb ? TextureFormat::ETC2RGB8UnormSrgb : TextureFormat::ETC2RGB8Unorm;
+		case TextureContent::ColorAlpha: return srgb ? TextureFormat::ETC2RGBA8UnormSrgb : TextureFormat::ETC2RGBA8Unorm;
+		case TextureContent::R: return TextureFormat::EACR11Unorm;
+		case TextureContent::RG: return TextureFormat::EACRG11Unorm;
+		}
+	}
+	// Devices with only TextureCompressionASTC keep uncompressed textures
+	return TextureFormat::Undefined;
+}
+
+bool TextureCompressor::canEncode(TextureFormat format) {
+	return blockEncoding(format) != BlockEncoding::None;
+}
+
+uint32_t TextureCompressor::blockBytes(TextureFormat format) {
+	switch (blockEncoding(format)) {
+	case BlockEncoding::BC1:
+	case BlockEncoding::BC4:
+	case BlockEncoding::ETC2RGB:
+	case BlockEncoding::EACR:
+		return 8;
+	case BlockEncoding::BC3:
+	case BlockEncoding::BC5:
+	case BlockEncoding::ETC2RGBA:
+	case BlockEncoding::EACRG:
+		return 16;
+	case BlockEncoding::None:
+		break;
+	}
+	return 0;
+}
+
+const char* TextureCompressor::simdName() {
+#if defined(TEXTURE_COMPRESSION_SSE2)
+	return "SSE2";
+#elif defined(TEXTURE_COMPRESSION_NEON)
+	return "NEON";
+#else
+	return "none";
+#endif
+}
+
+std::vector<uint8_t> TextureCompressor::decompress(TextureFormat format, const CompressedTexture::Level& level) {
+	BlockEncoding encoding = blockEncoding(format);
+	assert(encoding != BlockEncoding::None);
+	uint32_t bytes = blockBytes(format);
+	std::vector<uint8_t> rgba(4 * static_cast<size_t>(level.width) * level.height);
+	Block block;
+	for (uint32_t blockY = 0; blockY < level.rowsPerImage; ++blockY) {
+		for (uint32_t blockX = 0; blockX * bytes < level.bytesPerRow; ++blockX) {
+			decodeBlock(encoding, &level.data[static_cast<size_t>(blockY) * level.bytesPerRow + blockX * bytes], block);
+			for (uint32_t y = 0; y < 4 && 4 * blockY + y < level.height; ++y) {
+				for (uint32_t x = 0; x < 4 && 4 * blockX + x < level.width; ++x) {
+					size_t texel = static_cast<size_t>(4 * blockY + y) * level.width + 4 * blockX + x;
+					std::memcpy(&rgba[4 * texel], block.texels[4 * y + x], 4);
+				}
+			}
+		}
+	}
+	return rgba;
+}
+
+Texture TextureCompressor::upload(Device device, Queue queue, const CompressedTexture& texture, const char* label) {
+	TextureDescriptor textureDesc;
+	textureDesc.label = label;
+	textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::CopyDst;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { texture.width, texture.height, 1 };
+	textureDesc.format = texture.format;
+	textureDesc.mipLevelCount = static_cast<uint32_t>(texture.levels.size());
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	Texture gpuTexture = device.createTexture(textureDesc);
+
+	for (uint32_t mipLevel = 0; mipLevel < texture.levels.size(); ++mipLevel) {
+		const CompressedTexture::Level& level = texture.levels[mipLevel];
+		ImageCopyTexture destination;
+		destination.texture = gpuTexture;
+		destination.mipLevel = mipLevel;
+		destination.origin = { 0, 0, 0 };
+		destination.aspect = TextureAspect::All;
+		TextureDataLayout source;
+		source.offset = 0;
+		source.bytesPerRow = level.bytesPerRow;
+		source.rowsPerImage = level.rowsPerImage;
+		// Copies cover whole blocks, which the levels smaller than a block
+		// have in video memory too
+		uint32_t bytesPerBlock = blockBytes(texture.format);
+		Extent3D writeSize = { 4 * (level.bytesPerRow / bytesPerBlock), 4 * level.rowsPerImage, 1 };
+		queue.writeTexture(destination, level.data.data(), level.data.size(), source, writeSize);
+	}
+	return gpuTexture;
+}
+
+TextureCompressor::TextureCompressor(ThreadPool* threadPool)
+	: m_threadPool(threadPool)
+{}
+
+CompressedTexture TextureCompressor::compress(const uint8_t* rgba, uint32_t width, uint32_t height, TextureFormat format, bool mipmaps) const {
+	assert(canEncode(format));
+	assert(width > 0 && height > 0 && width % 4 == 0 && height % 4 == 0);
+	CompressedTexture texture;
+	texture.format = format;
+	texture.width = width;
+	texture.height = height;
+
+	bool srgb = isSrgb(format);
+	std::vector<uint8_t> mip;
+	const uint8_t* levelTexels = rgba;
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+	while (true) {
+		texture.levels.emplace_back();
+		compressLevel(levelTexels, levelWidth, levelHeight, format, texture.levels.back());
+		if (!mipmaps || (levelWidth == 1 && levelHeight == 1)) break;
+		mip = downsample(levelTexels, levelWidth, levelHeight, srgb, m_threadPool);
+		levelTexels = mip.data();
+		levelWidth = std::max(levelWidth / 2, 1u);
+		levelHeight = std::max(levelHeight / 2, 1u);
+	}
+	return texture;
+}
+
+void TextureCompressor::compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, TextureFormat format, CompressedTexture::Level& level) const {
+	BlockEncoding encoding = blockEncoding(format);
+	uint32_t bytes = blockBytes(format);
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	level.width = width;
+	level.height = height;
+	level.bytesPerRow = blocksX * bytes;
+	level.rowsPerImage = blocksY;
+	level.data.resize(static_cast<size_t>(level.bytesPerRow) * blocksY);
+
+	auto encodeRows = [&](uint32_t begin, uint32_t end, uint32_t) {
+		Block block;
+		for (uint32_t blockY = begin; blockY < end; ++blockY) {
+			for (uint32_t blockX = 0; blockX < blocksX; ++blockX) {
+				loadBlock(rgba, width, height, blockX, blockY, block);
+				encodeBlock(encoding, block, &level.data[static_cast<size_t>(blockY) * level.bytesPerRow + blockX * bytes]);
+			}
+		}
+	};
+	if (m_threadPool) {
+		m_threadPool->parallelFor(blocksY, MIN_BLOCK_ROWS_PER_THREAD, encodeRows);
+	}
+	else {
+		encodeRows(0, blocksY, 0);
+	}
+}
+
+// Files
+// A 4 byte tag and a version, then the format, size and level count, then
+// for each level its size, layout and data. Integers are 32-bit little
+// endian.
+
+static const char fileTag[4] = { 'L', 'W', 'T', 'C' };
+constexpr uint32_t FILE_VERSION = 1;
+// Bounds the sizes read from a file, so that corrupt files fail to load
+// rather than allocate huge levels
+constexpr uint32_t MAX_FILE_TEXTURE_SIZE = 1 << 16;
+
+static void writeU32(std::ofstream& file, uint32_t value) {
+	uint8_t bytes[4] = {
+		static_cast<uint8_t>(value),
+		static_cast<uint8_t>(value >> 8),
+		static_cast<uint8_t>(value >> 16),
+		static_cast<uint8_t>(value >> 24),
+	};
+	file.write(reinterpret_cast<const char*>(bytes), 4);
+}
+
+static bool readU32(std::ifstream& file, uint32_t& value) {
+	uint8_t bytes[4];
+	if (!file.read(reinterpret_cast<char*>(bytes), 4)) return false;
+	value = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+	return true;
+}
+
+bool CompressedTexture::save(const char* path) const {
+	uint32_t formatCode = 0;
+	while (formatCode < ENCODABLE_FORMAT_COUNT && encodableFormats[formatCode] != format) {
+		++formatCode;
+	}
+	if (formatCode == ENCODABLE_FORMAT_COUNT) return false;
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	file.write(fileTag, sizeof(fileTag));
+	writeU32(file, FILE_VERSION);
+	writeU32(file, formatCode);
+	writeU32(file, width);
+	writeU32(file, height);
+	writeU32(file, static_cast<uint32_t>(levels.size()));
+	for (const Level& level : levels) {
+		writeU32(file, level.width);
+		writeU32(file, level.height);
+		writeU32(file, level.bytesPerRow);
+		writeU32(file, level.rowsPerImage);
+		file.write(reinterpret_cast<const char*>(level.data.data()), static_cast<std::streamsize>(level.data.size()));
+	}
+	return static_cast<bool>(file);
+}
+
+bool CompressedTexture::load(const char* path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open()) return false;
+	char tag[4];
+	uint32_t version, formatCode, levelCount;
+	if (!file.read(tag, sizeof(tag)) || std::memcmp(tag, fileTag, sizeof(tag)) != 0) return false;
+	if (!readU32(file, version) || version != FILE_VERSION) return false;
+	if (!readU32(file, formatCode) || formatCode >= ENCODABLE_FORMAT_COUNT) return false;
+	if (!readU32(file, width) || !readU32(file, height) || !readU32(file, levelCount)) return false;
+	if (width == 0 || height == 0 || width > MAX_FILE_TEXTURE_SIZE || height > MAX_FILE_TEXTURE_SIZE || levelCount > 32) return false;
+	format = encodableFormats[formatCode];
+	uint32_t bytes = TextureCompressor::blockBytes(format);
+
+	levels.resize(levelCount);
+	for (Level& level : levels) {
+		if (!readU32(file, level.width) || !readU32(file, level.height)) return false;
+		if (!readU32(file, level.bytesPerRow) || !readU32(file, level.rowsPerImage)) return false;
+		if (level.width == 0 || level.height == 0 || level.width > width || level.height > height) return false;
+		if (level.bytesPerRow != (level.width + 3) / 4 * bytes || level.rowsPerImage != (level.height + 3) / 4) return false;
+		level.data.resize(static_cast<size_t>(level.bytesPerRow) * level.rowsPerImage);
+		if (!file.read(reinterpret_cast<char*>(level.data.data()), static_cast<std::streamsize>(level.data.size()))) return false;
+	}
+	return true;
+}
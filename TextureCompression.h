@@ -0,0 +1,130 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * What the texels of an image represent, which decides the block format it
+ * gets compressed to.
+ */
+enum class TextureContent {
+	// Opaque color, alpha is ignored
+	Color,
+	// Color with an alpha channel
+	ColorAlpha,
+	// Single channel stored in red, e.g. roughness or height maps
+	R,
+	// Two channels stored in red and green, e.g. tangent space normal maps
+	RG,
+};
+
+/**
+ * A block-compressed texture with its mip levels, each one laid out as
+ * expected by Queue::writeTexture: rows of 4x4 blocks, tightly packed.
+ */
+struct CompressedTexture {
+	struct Level {
+		uint32_t width;
+		uint32_t height;
+		// Size of a row of blocks
+		uint32_t bytesPerRow;
+		// Number of rows of blocks
+		uint32_t rowsPerImage;
+		std::vector<uint8_t> data;
+	};
+
+	wgpu::TextureFormat format = wgpu::TextureFormat::Undefined;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<Level> levels;
+
+	/**
+	 * Write the texture to a file, or read it back, so that textures can be
+	 * compressed offline once and loaded straight into video memory. Return
+	 * false on failure.
+	 */
+	bool save(const char* path) const;
+	bool load(const char* path);
+};
+
+/**
+ * Compresses RGBA8 images to the block formats that the device can sample,
+ * to cut their size in video memory and the bandwidth used to sample them
+ * by 4 (RGBA) to 8 (RGB, single channel).
+ *
+ * The encoder writes BC1, BC3, BC4 and BC5 when the device has the
+ * TextureCompressionBC feature (desktop GPUs), and otherwise ETC2 RGB8,
+ * ETC2 RGBA8 and EAC R11/RG11 when it has TextureCompressionETC2 (mobile
+ * GPUs). Blocks are encoded in parallel on a thread pool, and the palette
+ * index search uses SSE2 or NEON.
+ *
+ * The ETC2 encoder only uses the individual and differential modes that
+ * ETC2 inherits from ETC1: it never writes the T, H or planar modes, so
+ * smooth gradients and blocks with two distant colors compress worse than
+ * with a full ETC2 encoder, and decompress() only decodes ETC1 modes. Other
+ * formats are not produced at all: ASTC support is detected but there is
+ * no ASTC encoder, so on devices that only have TextureCompressionASTC
+ * textures stay uncompressed, and colors with alpha use BC3, not BC7.
+ */
+class TextureCompressor {
+public:
+	/**
+	 * Compression features to enable on the device when the adapter has them.
+	 */
+	static std::vector<wgpu::FeatureName> optionalFeatures();
+
+	/**
+	 * Block format for images of this content among the ones that the
+	 * device can sample and that this encoder writes, or Undefined if there
+	 * is none, in which case the texture should stay RGBA8.
+	 */
+	static wgpu::TextureFormat chooseFormat(wgpu::Device device, TextureContent content, bool srgb);
+
+	/**
+	 * Whether compress() can encode to this format.
+	 */
+	static bool canEncode(wgpu::TextureFormat format);
+
+	/**
+	 * Size in bytes of a 4x4 block of this format.
+	 */
+	static uint32_t blockBytes(wgpu::TextureFormat format);
+
+	/**
+	 * Name of the instruction set used by the encoder.
+	 */
+	static const char* simdName();
+
+	/**
+	 * Decode a level back to tightly packed RGBA8 texels, to upload it to a
+	 * device that lacks the feature of the format, or to measure the quality
+	 * of the compression. Missing channels are 0, and alpha is 255.
+	 */
+	static std::vector<uint8_t> decompress(wgpu::TextureFormat format, const CompressedTexture::Level& level);
+
+	/**
+	 * Create a texture with the TextureBinding and CopyDst usages and write
+	 * all the levels of `texture` to it. The device must have the feature
+	 * that the format belongs to.
+	 */
+	static wgpu::Texture upload(wgpu::Device device, wgpu::Queue queue, const CompressedTexture& texture, const char* label);
+
+	explicit TextureCompressor(ThreadPool* threadPool = nullptr);
+
+	/**
+	 * Compress a tightly packed RGBA8 image, whose width and height must be
+	 * multiples of 4, and its full mip chain when `mipmaps` is true. Mips are
+	 * averaged in linear space when the format is sRGB.
+	 */
+	CompressedTexture compress(const uint8_t* rgba, uint32_t width, uint32_t height, wgpu::TextureFormat format, bool mipmaps) const;
+
+private:
+	void compressLevel(const uint8_t* rgba, uint32_t width, uint32_t height, wgpu::TextureFormat format, CompressedTexture::Level& level) const;
+
+private:
+	ThreadPool* m_threadPool;
+};
@@ -0,0 +1,439 @@
+#include "TextureStreamer.h"
+#include "BindGroupCache.h"
+#include "MipmapGenerator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+
+using namespace wgpu;
+
+static uint32_t mipSize(uint32_t size, uint32_t level) {
+	return std::max(size >> level, 1u);
+}
+
+static uint64_t levelBytes(uint32_t width, uint32_t height, uint32_t level) {
+	return 4ull * mipSize(width, level) * mipSize(height, level);
+}
+
+// Size of levels [firstLevel, levelCount)
+static uint64_t rangeBytes(uint32_t width, uint32_t height, uint32_t levelCount, uint32_t firstLevel) {
+	uint64_t bytes = 0;
+	for (uint32_t level = firstLevel; level < levelCount; ++level) {
+		bytes += levelBytes(width, height, level);
+	}
+	return bytes;
+}
+
+void TextureStreamer::requireLimits(WGPULimits& limits, uint32_t maxTextureSize) {
+	limits.maxTextureDimension2D = std::max(limits.maxTextureDimension2D, maxTextureSize);
+	limits.maxTextureArrayLayers = std::max(limits.maxTextureArrayLayers, 1u);
+	limits.maxSampledTexturesPerShaderStage = std::max(limits.maxSampledTexturesPerShaderStage, 1u);
+	limits.maxSamplersPerShaderStage = std::max(limits.maxSamplersPerShaderStage, 1u);
+}
+
+TextureStreamer::TextureStreamer(
+	Device device,
+	const Budgets& budgets,
+	BindGroupCache* bindGroupCache,
+	MipmapGenerator* mipmapGenerator,
+	uint32_t decodeThreadCount
+)
+	: m_device(device)
+	, m_budgets(budgets)
+	, m_bindGroupCache(bindGroupCache)
+	, m_mipmapGenerator(mipmapGenerator)
+{
+	assert(budgets.mipTailSize > 0);
+
+	// Shown until the mip tail of a texture is resident
+	TextureDescriptor textureDesc;
+	textureDesc.label = "Streamed texture placeholder";
+	textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::CopyDst;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { 1, 1, 1 };
+	textureDesc.format = TextureFormat::RGBA8Unorm;
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	m_placeholder = m_device.createTexture(textureDesc);
+	m_placeholderView = m_placeholder.createView();
+
+	const uint8_t grey[4] = { 128, 128, 128, 255 };
+	ImageCopyTexture destination;
+	destination.texture = m_placeholder;
+	destination.mipLevel = 0;
+	destination.origin = { 0, 0, 0 };
+	destination.aspect = TextureAspect::All;
+	TextureDataLayout source;
+	source.offset = 0;
+	source.bytesPerRow = 4;
+	source.rowsPerImage = 1;
+	Queue queue = m_device.getQueue();
+	queue.writeTexture(destination, grey, sizeof(grey), source, { 1, 1, 1 });
+	queue.release();
+
+	for (uint32_t i = 0; i < std::max(decodeThreadCount, 1u); ++i) {
+		m_decodeThreads.emplace_back(&TextureStreamer::decodeLoop, this);
+	}
+}
+
+TextureStreamer::~TextureStreamer() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobCondition.notify_all();
+	for (std::thread& thread : m_decodeThreads) {
+		thread.join();
+	}
+
+	for (Texture& texture : m_textures) {
+		if (!texture.gpuTexture) continue;
+		if (m_bindGroupCache) m_bindGroupCache->evict(texture.gpuView);
+		texture.gpuView.release();
+		texture.gpuTexture.destroy();
+		texture.gpuTexture.release();
+	}
+	if (m_bindGroupCache) m_bindGroupCache->evict(m_placeholderView);
+	m_placeholderView.release();
+	m_placeholder.destroy();
+	m_placeholder.release();
+}
+
+TextureStreamer::TextureId TextureStreamer::addTexture(const char* label, uint32_t width, uint32_t height, MipDecoder decoder) {
+	assert(width > 0 && height > 0);
+	Texture texture;
+	texture.label = label;
+	texture.width = width;
+	texture.height = height;
+	texture.mipLevelCount = 1;
+	while (mipSize(width, texture.mipLevelCount - 1) > 1 || mipSize(height, texture.mipLevelCount - 1) > 1) {
+		++texture.mipLevelCount;
+	}
+	texture.tailMip = 0;
+	while (mipSize(width, texture.tailMip) > m_budgets.mipTailSize || mipSize(height, texture.tailMip) > m_budgets.mipTailSize) {
+		++texture.tailMip;
+	}
+	texture.residentMip = texture.mipLevelCount;
+	texture.targetMip = texture.tailMip;
+	texture.decoded.resize(texture.mipLevelCount);
+	texture.decoder = std::make_shared<const MipDecoder>(std::move(decoder));
+
+	TextureId id = static_cast<TextureId>(m_textures.size());
+	m_textures.push_back(std::move(texture));
+	scheduleDecodes(id);
+	return id;
+}
+
+void TextureStreamer::requestScreenSize(TextureId texture, float screenSize) {
+	float& requested = m_textures[texture].requestedSize;
+	requested = std::max(requested, screenSize);
+}
+
+TextureView TextureStreamer::view(TextureId texture) const {
+	const Texture& t = m_textures[texture];
+	return t.gpuView ? t.gpuView : m_placeholderView;
+}
+
+void TextureStreamer::update(Queue queue) {
+	++m_frame;
+	m_stats.uploadedBytes = 0;
+	collectDecodedLevels();
+
+	// Pick the level each texture needs: the finest one that is still
+	// larger than what it covers on screen, so that it is never minified
+	// by more than 2x.
+	for (TextureId id = 0; id < m_textures.size(); ++id) {
+		Texture& texture = m_textures[id];
+		uint32_t targetMip = texture.tailMip;
+		if (texture.requestedSize > 0.0f) {
+			texture.lastRequestFrame = m_frame;
+			float largest = static_cast<float>(std::max(texture.width, texture.height));
+			float level = std::floor(std::log2(largest / texture.requestedSize));
+			targetMip = static_cast<uint32_t>(std::clamp(level, 0.0f, static_cast<float>(texture.tailMip)));
+		}
+		texture.targetMip = std::max(targetMip, std::min(texture.finestMip, texture.tailMip));
+		texture.requestedSize = 0.0f;
+
+		// Forget decoded levels that are not wanted anymore
+		for (uint32_t level = 0; level < texture.targetMip; ++level) {
+			texture.decoded[level] = std::vector<uint8_t>();
+		}
+	}
+
+	// Cancel the decodes that are not wanted anymore, and schedule the
+	// new ones
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto cancelled = std::remove_if(m_pendingJobs.begin(), m_pendingJobs.end(), [this](const DecodeJob& job) {
+			Texture& texture = m_textures[job.texture];
+			if (job.mipLevel >= texture.targetMip) return false;
+			texture.decodingMask &= ~(1u << job.mipLevel);
+			return true;
+		});
+		m_pendingJobs.erase(cancelled, m_pendingJobs.end());
+	}
+	for (TextureId id = 0; id < m_textures.size(); ++id) {
+		scheduleDecodes(id);
+	}
+
+	// Upload candidates: textures whose next level to load has been decoded
+	std::vector<TextureId> candidates;
+	for (TextureId id = 0; id < m_textures.size(); ++id) {
+		const Texture& texture = m_textures[id];
+		uint32_t next = std::min(texture.residentMip, texture.tailMip + 1) - 1;
+		if (texture.residentMip > texture.targetMip && !texture.decoded[next].empty()) {
+			candidates.push_back(id);
+		}
+	}
+	// Missing mip tails first, then the coarsest levels, so that all
+	// textures get a rough version before any gets a sharp one
+	auto nextLevel = [this](TextureId id) {
+		const Texture& texture = m_textures[id];
+		return texture.gpuTexture ? texture.residentMip - 1 : ~0u;
+	};
+	std::stable_sort(candidates.begin(), candidates.end(), [&](TextureId a, TextureId b) {
+		return nextLevel(a) > nextLevel(b);
+	});
+
+	if (candidates.empty()) {
+		updatePendingDecodes();
+		return;
+	}
+
+	CommandEncoderDescriptor encoderDesc{};
+	encoderDesc.label = "Texture streaming";
+	CommandEncoder encoder = m_device.createCommandEncoder(encoderDesc);
+	for (TextureId id : candidates) {
+		Texture& texture = m_textures[id];
+		bool hasTail = static_cast<bool>(texture.gpuTexture);
+		uint32_t newResidentMip = texture.residentMip;
+		uint64_t uploadBytes = 0;
+		if (!hasTail) {
+			// The mip tail goes in as a whole, and is small enough to
+			// ignore the upload budget
+			bool complete = true;
+			for (uint32_t level = texture.tailMip; level < tailDecodeEnd(texture); ++level) {
+				complete = complete && !texture.decoded[level].empty();
+			}
+			if (!complete) continue;
+			newResidentMip = texture.tailMip;
+			uploadBytes = rangeBytes(texture.width, texture.height, texture.mipLevelCount, texture.tailMip);
+		}
+		// Then as many finer levels as the upload budget allows. A level
+		// larger than the whole budget still gets uploaded, alone.
+		while (newResidentMip > texture.targetMip && !texture.decoded[newResidentMip - 1].empty()) {
+			uint64_t bytes = levelBytes(texture.width, texture.height, newResidentMip - 1);
+			uint64_t total = m_stats.uploadedBytes + uploadBytes + bytes;
+			if (total > m_budgets.uploadBytesPerFrame && m_stats.uploadedBytes + uploadBytes > 0) break;
+			uploadBytes += bytes;
+			--newResidentMip;
+		}
+		if (newResidentMip == texture.residentMip) continue;
+
+		// Stay under the memory budget, first by evicting other textures,
+		// then by loading fewer levels.
+		uint64_t currentBytes = rangeBytes(texture.width, texture.height, texture.mipLevelCount, texture.residentMip);
+		uint64_t newBytes = rangeBytes(texture.width, texture.height, texture.mipLevelCount, newResidentMip);
+		while (newResidentMip < std::min(texture.residentMip, texture.tailMip) && !makeRoom(queue, encoder, newBytes - currentBytes, id)) {
+			++newResidentMip;
+			newBytes = rangeBytes(texture.width, texture.height, texture.mipLevelCount, newResidentMip);
+		}
+		if (newResidentMip < texture.residentMip) {
+			setResidency(queue, encoder, id, newResidentMip);
+		}
+	}
+
+	CommandBufferDescriptor commandBufferDesc{};
+	commandBufferDesc.label = "Texture streaming";
+	CommandBuffer commands = encoder.finish(commandBufferDesc);
+	encoder.release();
+	queue.submit(1, &commands);
+	commands.release();
+
+	for (TextureView view : m_retiredViews) {
+		view.release();
+	}
+	for (wgpu::Texture texture : m_retiredTextures) {
+		texture.release();
+	}
+	m_retiredViews.clear();
+	m_retiredTextures.clear();
+	updatePendingDecodes();
+}
+
+void TextureStreamer::updatePendingDecodes() {
+	m_stats.pendingDecodes = 0;
+	for (const Texture& texture : m_textures) {
+		for (uint32_t mask = texture.decodingMask; mask != 0; mask &= mask - 1) {
+			++m_stats.pendingDecodes;
+		}
+	}
+}
+
+uint32_t TextureStreamer::tailDecodeEnd(const Texture& texture) const {
+	return m_mipmapGenerator ? texture.tailMip + 1 : texture.mipLevelCount;
+}
+
+void TextureStreamer::collectDecodedLevels() {
+	std::vector<DecodeJob> finished;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		finished.swap(m_finishedJobs);
+		for (const DecodeJob& job : finished) {
+			m_textures[job.texture].decodingMask &= ~(1u << job.mipLevel);
+		}
+	}
+	for (DecodeJob& job : finished) {
+		Texture& texture = m_textures[job.texture];
+		if (!job.success || job.pixels.size() != 4ull * job.width * job.height) {
+			std::cerr << "Could not decode level " << job.mipLevel << " of texture '" << texture.label << "'" << std::endl;
+			texture.finestMip = std::max(texture.finestMip, job.mipLevel + 1);
+			continue;
+		}
+		// The level may have been cancelled in the meantime, or be resident
+		if (job.mipLevel < texture.targetMip || job.mipLevel >= texture.residentMip) continue;
+		texture.decoded[job.mipLevel] = std::move(job.pixels);
+	}
+}
+
+void TextureStreamer::scheduleDecodes(TextureId id) {
+	Texture& texture = m_textures[id];
+	std::lock_guard<std::mutex> lock(m_mutex);
+	bool added = false;
+	uint32_t firstMissing = texture.gpuTexture ? texture.residentMip : tailDecodeEnd(texture);
+	for (uint32_t level = firstMissing; level-- > std::max(texture.targetMip, texture.finestMip);) {
+		if (!texture.decoded[level].empty() || (texture.decodingMask & (1u << level))) continue;
+		texture.decodingMask |= 1u << level;
+		DecodeJob job;
+		job.texture = id;
+		job.mipLevel = level;
+		job.width = mipSize(texture.width, level);
+		job.height = mipSize(texture.height, level);
+		job.decoder = texture.decoder;
+		m_pendingJobs.push_back(std::move(job));
+		added = true;
+	}
+	if (added) m_jobCondition.notify_all();
+}
+
+bool TextureStreamer::makeRoom(Queue queue, CommandEncoder encoder, uint64_t neededBytes, TextureId requester) {
+	if (m_stats.residentBytes + neededBytes <= m_budgets.residentBytes) return true;
+
+	// Textures with more levels than they need, least recently drawn first
+	std::vector<TextureId> evictable;
+	for (TextureId id = 0; id < m_textures.size(); ++id) {
+		const Texture& texture = m_textures[id];
+		if (id != requester && texture.gpuTexture && texture.residentMip < texture.targetMip) {
+			evictable.push_back(id);
+		}
+	}
+	std::sort(evictable.begin(), evictable.end(), [this](TextureId a, TextureId b) {
+		return m_textures[a].lastRequestFrame < m_textures[b].lastRequestFrame;
+	});
+	for (TextureId id : evictable) {
+		Texture& texture = m_textures[id];
+		m_stats.evictedLevels += texture.targetMip - texture.residentMip;
+		setResidency(queue, encoder, id, texture.targetMip);
+		if (m_stats.residentBytes + neededBytes <= m_budgets.residentBytes) return true;
+	}
+	return false;
+}
+
+void TextureStreamer::setResidency(Queue queue, CommandEncoder encoder, TextureId id, uint32_t newResidentMip) {
+	Texture& texture = m_textures[id];
+	uint32_t oldResidentMip = texture.residentMip;
+	assert(newResidentMip < texture.mipLevelCount && newResidentMip != oldResidentMip);
+
+	TextureDescriptor textureDesc;
+	textureDesc.label = texture.label.c_str();
+	// Copy source usage to move the levels over at the next residency change
+	textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::CopyDst | TextureUsage::CopySrc;
+	if (m_mipmapGenerator) {
+		textureDesc.usage |= TextureUsage::StorageBinding;
+	}
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.size = { mipSize(texture.width, newResidentMip), mipSize(texture.height, newResidentMip), 1 };
+	textureDesc.format = TextureFormat::RGBA8Unorm;
+	textureDesc.mipLevelCount = texture.mipLevelCount - newResidentMip;
+	textureDesc.sampleCount = 1;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	wgpu::Texture gpuTexture = m_device.createTexture(textureDesc);
+
+	// Levels that stay resident are copied on the GPU
+	for (uint32_t level = std::max(newResidentMip, oldResidentMip); level < texture.mipLevelCount; ++level) {
+		ImageCopyTexture source;
+		source.texture = texture.gpuTexture;
+		source.mipLevel = level - oldResidentMip;
+		source.origin = { 0, 0, 0 };
+		source.aspect = TextureAspect::All;
+		ImageCopyTexture destination = source;
+		destination.texture = gpuTexture;
+		destination.mipLevel = level - newResidentMip;
+		encoder.copyTextureToTexture(source, destination, { mipSize(texture.width, level), mipSize(texture.height, level), 1 });
+	}
+
+	// New levels are uploaded from their decoded texels
+	for (uint32_t level = newResidentMip; level < std::min(oldResidentMip, texture.mipLevelCount); ++level) {
+		std::vector<uint8_t>& pixels = texture.decoded[level];
+		if (pixels.empty()) {
+			// Generated below
+			assert(m_mipmapGenerator && !texture.gpuTexture && level > texture.tailMip);
+			continue;
+		}
+		uint32_t width = mipSize(texture.width, level);
+		uint32_t height = mipSize(texture.height, level);
+		ImageCopyTexture destination;
+		destination.texture = gpuTexture;
+		destination.mipLevel = level - newResidentMip;
+		destination.origin = { 0, 0, 0 };
+		destination.aspect = TextureAspect::All;
+		TextureDataLayout source;
+		source.offset = 0;
+		source.bytesPerRow = 4 * width;
+		source.rowsPerImage = height;
+		queue.writeTexture(destination, pixels.data(), pixels.size(), source, { width, height, 1 });
+		m_stats.uploadedBytes += pixels.size();
+		pixels = std::vector<uint8_t>();
+	}
+	if (m_mipmapGenerator && !texture.gpuTexture) {
+		m_mipmapGenerator->generate(queue, encoder, gpuTexture, false, texture.tailMip - newResidentMip);
+	}
+
+	if (texture.gpuTexture) {
+		if (m_bindGroupCache) m_bindGroupCache->evict(texture.gpuView);
+		m_retiredViews.push_back(texture.gpuView);
+		m_retiredTextures.push_back(texture.gpuTexture);
+		m_stats.residentBytes -= rangeBytes(texture.width, texture.height, texture.mipLevelCount, oldResidentMip);
+	}
+	texture.gpuTexture = gpuTexture;
+	texture.gpuView = gpuTexture.createView();
+	texture.residentMip = newResidentMip;
+	m_stats.residentBytes += rangeBytes(texture.width, texture.height, texture.mipLevelCount, newResidentMip);
+}
+
+void TextureStreamer::decodeLoop() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_jobCondition.wait(lock, [this] { return m_stopping || !m_pendingJobs.empty(); });
+		if (m_stopping) return;
+
+		// Coarsest level first, in the order they were requested otherwise
+		auto next = std::max_element(m_pendingJobs.begin(), m_pendingJobs.end(), [](const DecodeJob& a, const DecodeJob& b) {
+			return a.mipLevel < b.mipLevel;
+		});
+		DecodeJob job = std::move(*next);
+		m_pendingJobs.erase(next);
+
+		lock.unlock();
+		job.pixels.clear();
+		job.success = (*job.decoder)(job.mipLevel, job.width, job.height, job.pixels);
+		lock.lock();
+
+		m_finishedJobs.push_back(std::move(job));
+	}
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class BindGroupCache;
+class MipmapGenerator;
+
+/**
+ * Streams mip-mapped RGBA8 textures in and out of video memory.
+ *
+ * Every texture always keeps its mip tail (the levels no larger than
+ * Budgets::mipTailSize) resident, and finer levels are loaded on demand
+ * depending on the size the texture covers on screen, coarsest first.
+ * Levels are decoded on background threads, and uploaded from update()
+ * without exceeding a number of bytes per frame, so that large texture
+ * sets stream in without frame time spikes. When the total size of the
+ * resident levels would exceed the memory budget, the least recently
+ * requested textures drop their unneeded fine levels.
+ *
+ * WebGPU has no sparse textures, so a texture holds exactly its resident
+ * levels: changing the residency creates a new texture, into which the
+ * levels already resident are copied on the GPU. Its view thus changes,
+ * so call view() again every frame. Views that are replaced get evicted
+ * from the bind group cache given to the constructor, if any.
+ *
+ * When given a mipmap generator, only the first level of the mip tail is
+ * decoded, and the rest of the tail is generated from it on the GPU.
+ */
+class TextureStreamer {
+public:
+	using TextureId = uint32_t;
+
+	/**
+	 * Write level `mipLevel` of a texture, whose size is `width` x
+	 * `height`, into `pixels` as tightly packed RGBA8 texels. Called on a
+	 * decode thread, so it must not touch WebGPU. Returns false on failure.
+	 */
+	using MipDecoder = std::function<bool(uint32_t mipLevel, uint32_t width, uint32_t height, std::vector<uint8_t>& pixels)>;
+
+	struct Budgets {
+		// Bytes of texel data uploaded per call to update()
+		uint64_t uploadBytesPerFrame = 4 * 1024 * 1024;
+		// Total size of the resident levels of all textures
+		uint64_t residentBytes = 256 * 1024 * 1024;
+		// Levels whose width and height are both no larger than this are
+		// always resident
+		uint32_t mipTailSize = 64;
+	};
+
+	struct Stats {
+		uint64_t residentBytes = 0;
+		// Bytes uploaded by the last update()
+		uint64_t uploadedBytes = 0;
+		uint32_t pendingDecodes = 0;
+		uint64_t evictedLevels = 0;
+	};
+
+	/**
+	 * Raise the device limits needed to sample textures of up to
+	 * `maxTextureSize` texels wide and high.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t maxTextureSize);
+
+	TextureStreamer(
+		wgpu::Device device,
+		const Budgets& budgets,
+		BindGroupCache* bindGroupCache = nullptr,
+		MipmapGenerator* mipmapGenerator = nullptr,
+		uint32_t decodeThreadCount = 2
+	);
+	~TextureStreamer();
+
+	TextureStreamer(const TextureStreamer&) = delete;
+	TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+	/**
+	 * Register a texture with a full mip chain. Its mip tail starts
+	 * decoding right away, and until it is resident view() returns a
+	 * 1x1 placeholder.
+	 */
+	TextureId addTexture(const char* label, uint32_t width, uint32_t height, MipDecoder decoder);
+
+	/**
+	 * Report that the texture is drawn this frame over `screenSize` pixels
+	 * (along its largest dimension). The largest size reported between two
+	 * calls to update() determines the level to stream in.
+	 */
+	void requestScreenSize(TextureId texture, float screenSize);
+
+	/**
+	 * Schedule decodes, apply evictions and upload the decoded levels that
+	 * fit in the budgets. Call once per frame, before encoding the draws
+	 * that sample the textures.
+	 */
+	void update(wgpu::Queue queue);
+
+	/**
+	 * View of the resident levels of the texture, valid until the next
+	 * update().
+	 */
+	wgpu::TextureView view(TextureId texture) const;
+
+	/**
+	 * Finest resident level, or the level count when the texture only has
+	 * its placeholder.
+	 */
+	uint32_t residentMip(TextureId texture) const { return m_textures[texture].residentMip; }
+	uint32_t mipLevelCount(TextureId texture) const { return m_textures[texture].mipLevelCount; }
+
+	const Stats& stats() const { return m_stats; }
+
+private:
+	struct Texture {
+		std::string label;
+		uint32_t width;
+		uint32_t height;
+		uint32_t mipLevelCount;
+		// First level of the mip tail
+		uint32_t tailMip;
+		// The GPU texture holds levels [residentMip, mipLevelCount)
+		uint32_t residentMip;
+		// Level wanted given the requested screen size
+		uint32_t targetMip;
+		// Finer levels failed to decode
+		uint32_t finestMip = 0;
+		float requestedSize = 0.0f;
+		uint64_t lastRequestFrame = 0;
+		// Levels being decoded, one bit per level
+		uint32_t decodingMask = 0;
+		// Levels decoded and not uploaded yet
+		std::vector<std::vector<uint8_t>> decoded;
+		std::shared_ptr<const MipDecoder> decoder;
+		wgpu::Texture gpuTexture = nullptr;
+		wgpu::TextureView gpuView = nullptr;
+	};
+
+	struct DecodeJob {
+		TextureId texture;
+		uint32_t mipLevel;
+		uint32_t width;
+		uint32_t height;
+		std::shared_ptr<const MipDecoder> decoder;
+		std::vector<uint8_t> pixels;
+		bool success = false;
+	};
+
+	// End of the range of mip tail levels that are decoded rather than generated
+	uint32_t tailDecodeEnd(const Texture& texture) const;
+	void collectDecodedLevels();
+	void scheduleDecodes(TextureId id);
+	bool makeRoom(wgpu::Queue queue, wgpu::CommandEncoder encoder, uint64_t neededBytes, TextureId requester);
+	void setResidency(wgpu::Queue queue, wgpu::CommandEncoder encoder, TextureId id, uint32_t newResidentMip);
+	void updatePendingDecodes();
+	void decodeLoop();
+
+private:
+	wgpu::Device m_device;
+	Budgets m_budgets;
+	BindGroupCache* m_bindGroupCache;
+	MipmapGenerator* m_mipmapGenerator;
+	std::vector<Texture> m_textures;
+	uint64_t m_frame = 0;
+	Stats m_stats;
+	wgpu::Texture m_placeholder = nullptr;
+	wgpu::TextureView m_placeholderView = nullptr;
+	// Textures and views replaced during update(), released once the copies
+	// from them are submitted
+	std::vector<wgpu::Texture> m_retiredTextures;
+	std::vector<wgpu::TextureView> m_retiredViews;
+
+	// Shared with the decode threads
+	std::vector<std::thread> m_decodeThreads;
+	std::mutex m_mutex;
+	std::condition_variable m_jobCondition;
+	std::vector<DecodeJob> m_pendingJobs;
+	std::vector<DecodeJob> m_finishedJobs;
+	bool m_stopping = false;
+};
@@ -0,0 +1,78 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	// The calling thread is worker 0, so we only spawn the other ones
+	for (uint32_t i = 1; i < threadCount; ++i) {
+		m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wakeCondition.notify_all();
+	for (std::thread& worker : m_workers) {
+		worker.join();
+	}
+}
+
+void ThreadPool::parallelFor(uint32_t count, uint32_t minRangeSize, const Task& task) {
+	if (count == 0) return;
+
+	// Not worth waking up the workers
+	if (m_workers.empty() || count / threadCount() < minRangeSize) {
+		task(0, count, 0);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_task = &task;
+		m_count = count;
+		m_pending = static_cast<uint32_t>(m_workers.size());
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	// The calling thread takes its share of the work rather than idling
+	runRange(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_pending == 0; });
+	m_task = nullptr;
+}
+
+void ThreadPool::runRange(uint32_t workerIndex) {
+	uint64_t n = threadCount();
+	uint32_t begin = static_cast<uint32_t>(m_count * workerIndex / n);
+	uint32_t end = static_cast<uint32_t>(m_count * (workerIndex + 1) / n);
+	if (begin < end) {
+		(*m_task)(begin, end, workerIndex);
+	}
+}
+
+void ThreadPool::workerLoop(uint32_t workerIndex) {
+	uint64_t seenGeneration = 0;
+	std::unique_lock<std::mutex> lock(m_mutex);
+	for (;;) {
+		m_wakeCondition.wait(lock, [&]() { return m_stopping || m_generation != seenGeneration; });
+		if (m_stopping) return;
+		seenGeneration = m_generation;
+
+		// m_task and m_count do not change until all workers are done
+		lock.unlock();
+		runRange(workerIndex);
+		lock.lock();
+
+		if (--m_pending == 0) {
+			m_doneCondition.notify_one();
+		}
+	}
+}
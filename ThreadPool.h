@@ -0,0 +1,61 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * A minimal pool of persistent worker threads used to split data-parallel
+ * loops (culling, transform updates, sorting...) across all CPU cores
+ * without spawning new threads every frame.
+ */
+class ThreadPool {
+public:
+	/**
+	 * A task processes the range [begin, end) of a parallel loop. The worker
+	 * index is in [0, threadCount()) and can be used to address per-thread
+	 * scratch memory without locking.
+	 */
+	using Task = std::function<void(uint32_t begin, uint32_t end, uint32_t workerIndex)>;
+
+	/**
+	 * Create a pool running tasks on `threadCount` threads in total, the
+	 * calling thread included. 0 means one thread per hardware core.
+	 */
+	explicit ThreadPool(uint32_t threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 * Number of threads that take part in a parallelFor, calling thread included.
+	 */
+	uint32_t threadCount() const { return static_cast<uint32_t>(m_workers.size()) + 1; }
+
+	/**
+	 * Split [0, count) into threadCount() contiguous ranges, ordered by
+	 * worker index, and block until all of them have been processed. When
+	 * there are fewer than `minRangeSize` items per thread, everything runs
+	 * on the calling thread.
+	 */
+	void parallelFor(uint32_t count, uint32_t minRangeSize, const Task& task);
+
+private:
+	void workerLoop(uint32_t workerIndex);
+	void runRange(uint32_t workerIndex);
+
+private:
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	const Task* m_task = nullptr;
+	uint32_t m_count = 0;
+	uint32_t m_pending = 0;
+	uint64_t m_generation = 0;
+	bool m_stopping = false;
+};
@@ -0,0 +1,186 @@
+#include "TransformHierarchy.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// Below this many nodes per thread, a level is faster to update alone
+constexpr uint32_t MIN_NODES_PER_THREAD = 4096;
+
+TransformHierarchy::TransformHierarchy(ThreadPool* threadPool)
+	: m_threadPool(threadPool)
+{}
+
+TransformHierarchy::NodeId TransformHierarchy::createNode(NodeId parent, const Transform& local, uint32_t instanceIndex) {
+	NodeId node = nodeCount();
+	uint32_t slot = node;
+	uint32_t parentSlot = NO_PARENT;
+	uint32_t depth = 0;
+	if (parent != NO_PARENT) {
+		assert(parent < node);
+		parentSlot = m_slotOfNode[parent];
+		depth = m_depth[parentSlot] + 1;
+	}
+
+	// Nodes created in breadth-first order, which is the common case when
+	// loading a scene, keep the arrays sorted for free.
+	if (!m_needsSort && (m_depth.empty() || depth >= m_depth.back())) {
+		while (depthCount() <= depth) {
+			m_levelStart.push_back(m_levelStart.back());
+		}
+		m_levelStart.back() = slot + 1;
+	}
+	else {
+		m_needsSort = true;
+	}
+
+	m_parent.push_back(parentSlot);
+	m_translation.push_back(local.translation);
+	m_rotation.push_back(local.rotation);
+	m_scale.push_back(local.scale);
+	m_world.push_back(mat4Identity());
+	m_dirty.push_back(1);
+	m_instanceIndex.push_back(instanceIndex);
+	m_depth.push_back(depth);
+	m_nodeOfSlot.push_back(node);
+	m_slotOfNode.push_back(slot);
+	m_firstDirtySlot = std::min(m_firstDirtySlot, slot);
+	return node;
+}
+
+void TransformHierarchy::setLocal(NodeId node, const Transform& local) {
+	uint32_t slot = m_slotOfNode[node];
+	m_translation[slot] = local.translation;
+	m_rotation[slot] = local.rotation;
+	m_scale[slot] = local.scale;
+	m_dirty[slot] = 1;
+	m_firstDirtySlot = std::min(m_firstDirtySlot, slot);
+}
+
+TransformHierarchy::Transform TransformHierarchy::local(NodeId node) const {
+	uint32_t slot = m_slotOfNode[node];
+	Transform t;
+	t.translation = m_translation[slot];
+	t.rotation = m_rotation[slot];
+	t.scale = m_scale[slot];
+	return t;
+}
+
+void TransformHierarchy::setInstanceOutput(void* instances, uint32_t stride) {
+	assert(stride >= sizeof(Mat4));
+	m_instanceOutput = static_cast<uint8_t*>(instances);
+	m_instanceStride = stride;
+}
+
+template <typename T>
+static void permute(std::vector<T>& values, const std::vector<uint32_t>& newSlot) {
+	std::vector<T> sorted(values.size());
+	for (size_t i = 0; i < values.size(); ++i) {
+		sorted[newSlot[i]] = values[i];
+	}
+	values.swap(sorted);
+}
+
+void TransformHierarchy::sortByDepth() {
+	// Counting sort, stable so that siblings stay in creation order
+	uint32_t levelCount = 1 + *std::max_element(m_depth.begin(), m_depth.end());
+	m_levelStart.assign(levelCount + 1, 0);
+	for (uint32_t depth : m_depth) {
+		++m_levelStart[depth + 1];
+	}
+	for (uint32_t d = 0; d < levelCount; ++d) {
+		m_levelStart[d + 1] += m_levelStart[d];
+	}
+	std::vector<uint32_t> cursor(m_levelStart.begin(), m_levelStart.end() - 1);
+	std::vector<uint32_t> newSlot(nodeCount());
+	for (uint32_t slot = 0; slot < nodeCount(); ++slot) {
+		newSlot[slot] = cursor[m_depth[slot]]++;
+	}
+
+	for (uint32_t& parent : m_parent) {
+		if (parent != NO_PARENT) parent = newSlot[parent];
+	}
+	permute(m_parent, newSlot);
+	permute(m_translation, newSlot);
+	permute(m_rotation, newSlot);
+	permute(m_scale, newSlot);
+	permute(m_world, newSlot);
+	permute(m_dirty, newSlot);
+	permute(m_instanceIndex, newSlot);
+	permute(m_depth, newSlot);
+	permute(m_nodeOfSlot, newSlot);
+	for (uint32_t slot = 0; slot < nodeCount(); ++slot) {
+		m_slotOfNode[m_nodeOfSlot[slot]] = slot;
+	}
+
+	auto firstDirty = std::find(m_dirty.begin(), m_dirty.end(), 1);
+	m_firstDirtySlot = firstDirty == m_dirty.end() ? ~0u : static_cast<uint32_t>(firstDirty - m_dirty.begin());
+	m_needsSort = false;
+}
+
+TransformHierarchy::UpdateResult TransformHierarchy::update() {
+	UpdateResult result;
+	if (m_needsSort) {
+		sortByDepth();
+	}
+	if (m_firstDirtySlot >= nodeCount()) return result;
+
+	uint32_t workerCount = m_threadPool ? m_threadPool->threadCount() : 1;
+	m_workerStats.assign(workerCount, WorkerStats{ ~0u, 0, 0 });
+
+	// Levels above the first dirty node are left untouched. Within a level,
+	// nodes only read the world matrix and dirty flag of their parent, which
+	// the previous level finalized.
+	uint32_t level = static_cast<uint32_t>(
+		std::upper_bound(m_levelStart.begin(), m_levelStart.end(), m_firstDirtySlot) - m_levelStart.begin()
+	) - 1;
+	for (; level < depthCount(); ++level) {
+		uint32_t begin = std::max(m_levelStart[level], m_firstDirtySlot);
+		uint32_t end = m_levelStart[level + 1];
+		if (m_threadPool) {
+			m_threadPool->parallelFor(end - begin, MIN_NODES_PER_THREAD, [&](uint32_t first, uint32_t last, uint32_t workerIndex) {
+				updateRange(begin + first, begin + last, workerIndex);
+			});
+		}
+		else {
+			updateRange(begin, end, 0);
+		}
+	}
+	std::fill(m_dirty.begin() + m_firstDirtySlot, m_dirty.end(), 0);
+	m_firstDirtySlot = ~0u;
+
+	uint32_t firstInstance = ~0u, endInstance = 0;
+	for (const WorkerStats& stats : m_workerStats) {
+		result.updatedNodeCount += stats.updatedNodeCount;
+		firstInstance = std::min(firstInstance, stats.firstInstance);
+		endInstance = std::max(endInstance, stats.endInstance);
+	}
+	if (firstInstance < endInstance) {
+		result.firstInstance = firstInstance;
+		result.instanceCount = endInstance - firstInstance;
+	}
+	return result;
+}
+
+void TransformHierarchy::updateRange(uint32_t begin, uint32_t end, uint32_t workerIndex) {
+	WorkerStats& stats = m_workerStats[workerIndex];
+	for (uint32_t slot = begin; slot < end; ++slot) {
+		uint32_t parent = m_parent[slot];
+		if (parent != NO_PARENT) {
+			m_dirty[slot] |= m_dirty[parent];
+		}
+		if (!m_dirty[slot]) continue;
+
+		Mat4 local = mat4Compose(m_translation[slot], m_rotation[slot], m_scale[slot]);
+		m_world[slot] = parent == NO_PARENT ? local : mat4Mul(m_world[parent], local);
+		++stats.updatedNodeCount;
+
+		uint32_t instance = m_instanceIndex[slot];
+		if (instance != NO_INSTANCE && m_instanceOutput) {
+			std::memcpy(m_instanceOutput + (size_t)instance * m_instanceStride, &m_world[slot], sizeof(Mat4));
+			stats.firstInstance = std::min(stats.firstInstance, instance);
+			stats.endInstance = std::max(stats.endInstance, instance + 1);
+		}
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "SimdMath.h"
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * Scene graph of transforms, stored as structure-of-arrays sorted by depth
+ * rather than as a tree of nodes. All nodes of a given depth are contiguous
+ * and come after their parents, so world matrices are updated one level at a
+ * time with a linear sweep over memory, each level being split across
+ * threads. Only the subtrees of nodes whose local transform changed since
+ * the last update are recomputed.
+ *
+ * Nodes that are drawn have an instance index, and their world matrix is
+ * written directly at that index in the instance data of the renderer
+ * during the update, so that uploading the dirty instance range is all
+ * that is left to do.
+ */
+class TransformHierarchy {
+public:
+	using NodeId = uint32_t;
+	static constexpr NodeId NO_PARENT = ~0u;
+	static constexpr uint32_t NO_INSTANCE = ~0u;
+
+	struct Transform {
+		Vec4 translation = { 0.0f, 0.0f, 0.0f, 1.0f };
+		Quat rotation = { 0.0f, 0.0f, 0.0f, 1.0f };
+		Vec4 scale = { 1.0f, 1.0f, 1.0f, 0.0f };
+	};
+
+	// What changed during an update
+	struct UpdateResult {
+		uint32_t updatedNodeCount = 0;
+		// Range of instances whose world matrix was rewritten
+		uint32_t firstInstance = 0;
+		uint32_t instanceCount = 0;
+	};
+
+	/**
+	 * If `threadPool` is null, updates run on the calling thread only.
+	 */
+	explicit TransformHierarchy(ThreadPool* threadPool = nullptr);
+
+	/**
+	 * Add a node below `parent` (which must already exist) or at the root.
+	 * The node is dirty until the next update.
+	 */
+	NodeId createNode(NodeId parent, const Transform& local, uint32_t instanceIndex = NO_INSTANCE);
+
+	void setLocal(NodeId node, const Transform& local);
+	Transform local(NodeId node) const;
+
+	/**
+	 * World matrix of the node as of the last update.
+	 */
+	const Mat4& world(NodeId node) const { return m_world[m_slotOfNode[node]]; }
+
+	uint32_t nodeCount() const { return static_cast<uint32_t>(m_parent.size()); }
+	uint32_t depthCount() const { return static_cast<uint32_t>(m_levelStart.size()) - 1; }
+
+	/**
+	 * Where update() writes the world matrices of the nodes that have an
+	 * instance index: at `instances + instanceIndex * stride`. The matrix is
+	 * the first member of the instance data.
+	 */
+	void setInstanceOutput(void* instances, uint32_t stride);
+
+	/**
+	 * Recompute the world matrices of the dirty subtrees.
+	 */
+	UpdateResult update();
+
+private:
+	void sortByDepth();
+	void updateRange(uint32_t begin, uint32_t end, uint32_t workerIndex);
+
+private:
+	ThreadPool* m_threadPool;
+
+	// Indexed by slot, i.e. in depth order. Parents are slots too.
+	std::vector<uint32_t> m_parent;
+	std::vector<Vec4> m_translation;
+	std::vector<Quat> m_rotation;
+	std::vector<Vec4> m_scale;
+	std::vector<Mat4> m_world;
+	std::vector<uint8_t> m_dirty;
+	std::vector<uint32_t> m_instanceIndex;
+	std::vector<uint32_t> m_depth;
+	std::vector<NodeId> m_nodeOfSlot;
+
+	// Indexed by node id
+	std::vector<uint32_t> m_slotOfNode;
+
+	// Slots of depth d are [m_levelStart[d], m_levelStart[d + 1])
+	std::vector<uint32_t> m_levelStart = { 0 };
+	// Nodes created since the last update were appended out of depth order
+	bool m_needsSort = false;
+	// Nothing before this slot is dirty
+	uint32_t m_firstDirtySlot = ~0u;
+
+	uint8_t* m_instanceOutput = nullptr;
+	uint32_t m_instanceStride = 0;
+
+	// Per worker dirty instance range and updated node count, each on its
+	// own cache line.
+	struct alignas(64) WorkerStats {
+		uint32_t firstInstance;
+		uint32_t endInstance;
+		uint32_t updatedNodeCount;
+	};
+	std::vector<WorkerStats> m_workerStats;
+};
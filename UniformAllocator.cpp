@@ -0,0 +1,79 @@
+#include "UniformAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+using namespace wgpu;
+
+void UniformAllocator::requireLimits(WGPULimits& limits, uint32_t bindingSize) {
+	limits.maxBindGroups = std::max(limits.maxBindGroups, 1u);
+	limits.maxUniformBuffersPerShaderStage = std::max(limits.maxUniformBuffersPerShaderStage, 1u);
+	limits.maxDynamicUniformBuffersPerPipelineLayout = std::max(limits.maxDynamicUniformBuffersPerPipelineLayout, 1u);
+	limits.maxUniformBufferBindingSize = std::max<uint64_t>(limits.maxUniformBufferBindingSize, bindingSize);
+}
+
+BindGroupLayoutEntry UniformAllocator::layoutEntry(uint32_t binding, WGPUShaderStageFlags visibility, uint32_t bindingSize) {
+	BindGroupLayoutEntry entry = Default;
+	entry.binding = binding;
+	entry.visibility = visibility;
+	entry.buffer.type = BufferBindingType::Uniform;
+	entry.buffer.hasDynamicOffset = true;
+	entry.buffer.minBindingSize = bindingSize;
+	return entry;
+}
+
+UniformAllocator::UniformAllocator(Device device, uint32_t capacity, uint32_t maxBindingSize)
+	: m_device(device)
+	, m_capacity(capacity)
+	, m_maxBindingSize(maxBindingSize)
+{
+	SupportedLimits supportedLimits;
+	if (m_device.getLimits(&supportedLimits)) {
+		m_alignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	}
+
+	// A binding read at the last allocated offset must not overflow the
+	// buffer, hence the extra room after the capacity.
+	uint64_t size = ((uint64_t)capacity + maxBindingSize + 3) & ~(uint64_t)3;
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Uniform allocator";
+	bufferDesc.size = size;
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+	bufferDesc.mappedAtCreation = false;
+	m_buffer = m_device.createBuffer(bufferDesc);
+	m_staging.resize(size);
+}
+
+UniformAllocator::~UniformAllocator() {
+	m_buffer.destroy();
+	m_buffer.release();
+}
+
+BindGroupEntry UniformAllocator::bindGroupEntry(uint32_t binding, uint32_t bindingSize) const {
+	assert(bindingSize <= m_maxBindingSize);
+	BindGroupEntry entry{};
+	entry.binding = binding;
+	entry.buffer = m_buffer;
+	// The actual start of the data is given by the dynamic offset
+	entry.offset = 0;
+	entry.size = bindingSize;
+	return entry;
+}
+
+uint32_t UniformAllocator::allocate(const void* data, uint32_t size) {
+	uint32_t offset = (m_used + m_alignment - 1) / m_alignment * m_alignment;
+	if (offset > m_capacity || size > m_maxBindingSize) {
+		return OutOfSpace;
+	}
+	std::memcpy(m_staging.data() + offset, data, size);
+	m_used = offset + size;
+	return offset;
+}
+
+void UniformAllocator::upload(Queue queue) {
+	if (m_used == 0) return;
+	// Writes must be a multiple of 4 bytes
+	uint32_t size = (m_used + 3) & ~3u;
+	queue.writeBuffer(m_buffer, 0, m_staging.data(), size);
+}
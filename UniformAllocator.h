@@ -0,0 +1,95 @@
+#pragma once
+
+#include "webgpu/webgpu.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Per-frame linear allocator for uniform data. All the uniforms of a frame
+ * (per-view, per-material, per-draw...) are packed in one large uniform
+ * buffer, each allocation starting at a multiple of the device's
+ * minUniformBufferOffsetAlignment, and uploaded with a single writeBuffer.
+ *
+ * The buffer is bound through one bind group whose binding has a dynamic
+ * offset, so switching from one draw's data to the next only changes the
+ * offset passed to setBindGroup: no buffer or bind group is ever created
+ * in the frame loop.
+ *
+ * Since queue writes are ordered with respect to submissions, the same
+ * range of the buffer can be reused every frame without waiting for the
+ * GPU to be done with the previous frame.
+ */
+class UniformAllocator {
+public:
+	// Returned by allocate() when the frame's uniforms do not fit
+	static constexpr uint32_t OutOfSpace = UINT32_MAX;
+
+	/**
+	 * Raise the device limits needed to bind `bindingSize` bytes of uniforms
+	 * with a dynamic offset.
+	 */
+	static void requireLimits(WGPULimits& limits, uint32_t bindingSize);
+
+	/**
+	 * Layout entry of a uniform binding with a dynamic offset, for the
+	 * bind group layout of the pipelines that read from this allocator.
+	 */
+	static wgpu::BindGroupLayoutEntry layoutEntry(uint32_t binding, WGPUShaderStageFlags visibility, uint32_t bindingSize);
+
+	/**
+	 * Room for `capacity` bytes of uniforms per frame, alignment padding
+	 * included. `maxBindingSize` is the largest binding size of the bind
+	 * groups created with bindGroupEntry().
+	 */
+	UniformAllocator(wgpu::Device device, uint32_t capacity, uint32_t maxBindingSize);
+	~UniformAllocator();
+
+	UniformAllocator(const UniformAllocator&) = delete;
+	UniformAllocator& operator=(const UniformAllocator&) = delete;
+
+	/**
+	 * Bind group entry through which the allocations are read, to create
+	 * the bind group with (once, not per draw).
+	 */
+	wgpu::BindGroupEntry bindGroupEntry(uint32_t binding, uint32_t bindingSize) const;
+
+	/**
+	 * Forget the allocations of the previous frame.
+	 */
+	void reset() { m_used = 0; }
+
+	/**
+	 * Copy `size` bytes of uniforms and return the dynamic offset to pass to
+	 * setBindGroup() to read them, or OutOfSpace, allocating nothing, when
+	 * the capacity is used up or `size` is larger than the largest binding.
+	 * The buffer cannot grow, as bind groups created from bindGroupEntry()
+	 * refer to it.
+	 */
+	uint32_t allocate(const void* data, uint32_t size);
+
+	template <typename T>
+	uint32_t allocate(const T& value) {
+		return allocate(&value, static_cast<uint32_t>(sizeof(T)));
+	}
+
+	/**
+	 * Upload everything allocated since reset() in one write. Must be called
+	 * before submitting the commands that use the allocations.
+	 */
+	void upload(wgpu::Queue queue);
+
+	uint32_t alignment() const { return m_alignment; }
+	uint32_t usedSize() const { return m_used; }
+	wgpu::Buffer buffer() const { return m_buffer; }
+
+private:
+	wgpu::Device m_device;
+	wgpu::Buffer m_buffer = nullptr;
+	uint32_t m_alignment = 256;
+	uint32_t m_capacity = 0;
+	uint32_t m_maxBindingSize = 0;
+	uint32_t m_used = 0;
+	// CPU copy of the frame's uniforms
+	std::vector<uint8_t> m_staging;
+};
@@ -0,0 +1,281 @@
+// Compare the frame time and render target memory of no anti-aliasing,
+// 4x MSAA and FXAA, on a 1080p frame full of thin triangles, whose edges
+// are where anti-aliasing matters. MSAA is measured both with the samples
+// discarded after the resolve and with them stored, to show what the
+// discard saves. Needs a GPU.
+
+#include "AntiAliasing.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr uint32_t WIDTH = 1920;
+constexpr uint32_t HEIGHT = 1080;
+// Triangles drawn per frame
+constexpr uint32_t TRIANGLE_COUNT = 20000;
+constexpr int ITERATIONS = 50;
+const TextureFormat TARGET_FORMAT = TextureFormat::BGRA8Unorm;
+
+// Long thin triangles in all directions, placed pseudo-randomly from the
+// instance index
+static const char* sceneShaderSource = R"(
+struct VertexOutput {
+    @builtin(position) position: vec4f,
+    @location(0) color: vec3f,
+}
+
+fn hash(x: u32) -> f32 {
+    var h = x * 747796405u + 2891336453u;
+    h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+    return f32((h >> 22u) ^ h) / 4294967295.0;
+}
+
+@vertex
+fn vs_main(@builtin(vertex_index) vertexIndex: u32, @builtin(instance_index) instanceIndex: u32) -> VertexOutput {
+    var out: VertexOutput;
+    let center = vec2f(hash(3u * instanceIndex), hash(3u * instanceIndex + 1u)) * 2.0 - 1.0;
+    let angle = 6.2831853 * hash(3u * instanceIndex + 2u);
+    let along = vec2f(cos(angle), sin(angle)) * 0.08;
+    let across = vec2f(-along.y, along.x) * 0.05;
+    var offset = along;
+    if (vertexIndex == 1u) {
+        offset = -along + across;
+    } else if (vertexIndex == 2u) {
+        offset = -along - across;
+    }
+    out.position = vec4f(center + offset, 0.0, 1.0);
+    out.color = vec3f(hash(instanceIndex), 0.5, 1.0 - hash(instanceIndex));
+    return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    return vec4f(in.color, 1.0);
+}
+)";
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+static RenderPipeline createScenePipeline(Device device, uint32_t sampleCount) {
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = sceneShaderSource;
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = device.createShaderModule(shaderDesc);
+
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.bindGroupLayoutCount = 0;
+	pipelineLayoutDesc.bindGroupLayouts = nullptr;
+	PipelineLayout pipelineLayout = device.createPipelineLayout(pipelineLayoutDesc);
+
+	RenderPipelineDescriptor pipelineDesc{};
+	pipelineDesc.layout = pipelineLayout;
+	pipelineDesc.vertex.bufferCount = 0;
+	pipelineDesc.vertex.buffers = nullptr;
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.constantCount = 0;
+	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	pipelineDesc.primitive.frontFace = FrontFace::CCW;
+	pipelineDesc.primitive.cullMode = CullMode::None;
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	ColorTargetState colorTarget;
+	colorTarget.format = TARGET_FORMAT;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+	pipelineDesc.depthStencil = nullptr;
+	pipelineDesc.multisample.count = sampleCount;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+	RenderPipeline pipeline = device.createRenderPipeline(pipelineDesc);
+	pipelineLayout.release();
+	shaderModule.release();
+	return pipeline;
+}
+
+struct Timings {
+	double bestMs = 1e30;
+	double medianMs = 0.0;
+};
+
+// Time ITERATIONS frames, each waited for, that record their passes with `encode`
+template <typename F>
+static Timings timeFrames(Device device, Queue queue, F&& encode) {
+	std::vector<double> frameMs;
+	// One extra frame to warm up
+	for (int iteration = 0; iteration <= ITERATIONS; ++iteration) {
+		auto start = std::chrono::steady_clock::now();
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+		encode(encoder);
+		CommandBufferDescriptor commandBufferDesc{};
+		CommandBuffer command = encoder.finish(commandBufferDesc);
+		encoder.release();
+		queue.submit(1, &command);
+		command.release();
+		waitForGpu(device, queue);
+		if (iteration == 0) continue;
+		frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(frameMs.begin(), frameMs.end());
+	return Timings{ frameMs.front(), frameMs[frameMs.size() / 2] };
+}
+
+static void drawScene(CommandEncoder encoder, const RenderPassColorAttachment& colorAttachment, RenderPipeline pipeline) {
+	RenderPassDescriptor renderPassDesc{};
+	renderPassDesc.colorAttachmentCount = 1;
+	renderPassDesc.colorAttachments = &colorAttachment;
+	renderPassDesc.depthStencilAttachment = nullptr;
+	renderPassDesc.timestampWriteCount = 0;
+	renderPassDesc.timestampWrites = nullptr;
+	RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+	renderPass.setPipeline(pipeline);
+	renderPass.draw(3, TRIANGLE_COUNT, 0, 0);
+	renderPass.end();
+	renderPass.release();
+}
+
+static void report(const std::string& name, const Timings& timings, uint64_t memoryBytes) {
+	std::cout
+		<< std::left << std::setw(24) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(3) << timings.bestMs << " ms best"
+		<< std::setw(10) << timings.medianMs << " ms median"
+		<< std::setw(10) << std::setprecision(1) << memoryBytes / (1024.0 * 1024.0) << " MiB extra" << std::endl;
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+
+	// No surface, everything is rendered offscreen
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	RequiredLimits requiredLimits = Default;
+	requiredLimits.limits.maxTextureDimension2D = std::max(WIDTH, HEIGHT);
+	requiredLimits.limits.maxInterStageShaderComponents = 3;
+	FxaaPass::requireLimits(requiredLimits.limits);
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredFeatures = nullptr;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+	// Stands for the swap chain
+	TextureDescriptor targetDesc;
+	targetDesc.label = "Offscreen target";
+	targetDesc.usage = TextureUsage::RenderAttachment;
+	targetDesc.dimension = TextureDimension::_2D;
+	targetDesc.size = { WIDTH, HEIGHT, 1 };
+	targetDesc.format = TARGET_FORMAT;
+	targetDesc.mipLevelCount = 1;
+	targetDesc.sampleCount = 1;
+	targetDesc.viewFormatCount = 0;
+	targetDesc.viewFormats = nullptr;
+	Texture target = device.createTexture(targetDesc);
+	TextureView targetView = target.createView();
+
+	std::cout << TRIANGLE_COUNT << " thin triangles at " << WIDTH << "x" << HEIGHT << ", " << ITERATIONS << " frames each" << std::endl;
+
+	const Color clearValue{ 0.1, 0.1, 0.1, 1.0 };
+	RenderPipeline singleSamplePipeline = createScenePipeline(device, 1);
+	RenderPipeline multisamplePipeline = createScenePipeline(device, 4);
+
+	MultisampleTarget singleSample(device, TARGET_FORMAT, 1);
+	singleSample.resize(WIDTH, HEIGHT);
+	report("none", timeFrames(device, queue, [&](CommandEncoder encoder) {
+		drawScene(encoder, singleSample.colorAttachment(targetView, clearValue), singleSamplePipeline);
+	}), singleSample.memoryBytes());
+
+	MultisampleTarget multisample(device, TARGET_FORMAT, 4);
+	multisample.resize(WIDTH, HEIGHT);
+	report("4x MSAA", timeFrames(device, queue, [&](CommandEncoder encoder) {
+		drawScene(encoder, multisample.colorAttachment(targetView, clearValue), multisamplePipeline);
+	}), multisample.memoryBytes());
+	report("4x MSAA, samples stored", timeFrames(device, queue, [&](CommandEncoder encoder) {
+		RenderPassColorAttachment colorAttachment = multisample.colorAttachment(targetView, clearValue);
+		colorAttachment.storeOp = StoreOp::Store;
+		drawScene(encoder, colorAttachment, multisamplePipeline);
+	}), multisample.memoryBytes());
+
+	FxaaPass fxaa(device, TARGET_FORMAT);
+	fxaa.resize(WIDTH, HEIGHT);
+	report("FXAA", timeFrames(device, queue, [&](CommandEncoder encoder) {
+		drawScene(encoder, singleSample.colorAttachment(fxaa.inputView(), clearValue), singleSamplePipeline);
+		fxaa.apply(encoder, targetView);
+	}), fxaa.memoryBytes());
+
+	multisamplePipeline.release();
+	singleSamplePipeline.release();
+	targetView.release();
+	target.destroy();
+	target.release();
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return 0;
+}
@@ -0,0 +1,201 @@
+// Measure the sustained frame rate of video capture at 1080p and 4K, in
+// both formats, when every frame is rendered on the GPU, read back and
+// written to a file. The frames are written next to the executable unless
+// a directory is given as argument, so that the disk being measured can be
+// chosen. Needs a GPU.
+
+#include "FrameCapture.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+// About 4 seconds of 60 FPS video
+constexpr uint32_t FRAME_COUNT = 240;
+const TextureFormat TARGET_FORMAT = TextureFormat::BGRA8Unorm;
+
+struct Resolution {
+	const char* name;
+	uint32_t width;
+	uint32_t height;
+};
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+// Clear the target with a color that changes every frame, so that frames
+// differ, and capture it if a capture is given
+static void renderFrame(Device device, Queue queue, Texture target, TextureView targetView, uint32_t frame, FrameCapture* capture) {
+	CommandEncoderDescriptor encoderDesc{};
+	CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+
+	double t = static_cast<double>(frame % 60) / 60.0;
+	RenderPassColorAttachment colorAttachment = {};
+	colorAttachment.view = targetView;
+	colorAttachment.resolveTarget = nullptr;
+	colorAttachment.loadOp = LoadOp::Clear;
+	colorAttachment.storeOp = StoreOp::Store;
+	colorAttachment.clearValue = Color{ t, 1.0 - t, 0.5, 1.0 };
+	RenderPassDescriptor renderPassDesc{};
+	renderPassDesc.colorAttachmentCount = 1;
+	renderPassDesc.colorAttachments = &colorAttachment;
+	renderPassDesc.depthStencilAttachment = nullptr;
+	renderPassDesc.timestampWriteCount = 0;
+	renderPassDesc.timestampWrites = nullptr;
+	RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+	renderPass.end();
+	renderPass.release();
+
+	if (capture) capture->capture(encoder, target);
+
+	CommandBufferDescriptor commandBufferDesc{};
+	CommandBuffer command = encoder.finish(commandBufferDesc);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+	if (capture) capture->submitted();
+}
+
+int main(int argc, char** argv) {
+	std::string directory = argc > 1 ? std::string(argv[1]) + "/" : std::string();
+
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+
+	// No surface, everything is rendered offscreen
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	const std::vector<Resolution> resolutions = {
+		{ "1080p", 1920, 1080 },
+		{ "4K", 3840, 2160 },
+	};
+	RequiredLimits requiredLimits = Default;
+	for (const Resolution& resolution : resolutions) {
+		FrameCapture::requireLimits(requiredLimits.limits, resolution.width, resolution.height);
+	}
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredFeatures = nullptr;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+	std::cout << FRAME_COUNT << " frames per run, written to " << (directory.empty() ? "./" : directory) << std::endl;
+
+	bool allWritten = true;
+	for (const Resolution& resolution : resolutions) {
+		TextureDescriptor targetDesc;
+		targetDesc.label = "Offscreen target";
+		targetDesc.usage = TextureUsage::RenderAttachment | TextureUsage::CopySrc;
+		targetDesc.dimension = TextureDimension::_2D;
+		targetDesc.size = { resolution.width, resolution.height, 1 };
+		targetDesc.format = TARGET_FORMAT;
+		targetDesc.mipLevelCount = 1;
+		targetDesc.sampleCount = 1;
+		targetDesc.viewFormatCount = 0;
+		targetDesc.viewFormats = nullptr;
+		Texture target = device.createTexture(targetDesc);
+		TextureView targetView = target.createView();
+
+		// What the renderer alone achieves, as a reference
+		auto renderStart = std::chrono::steady_clock::now();
+		for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame) {
+			renderFrame(device, queue, target, targetView, frame, nullptr);
+		}
+		waitForGpu(device, queue);
+		double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+		std::cout
+			<< std::left << std::setw(8) << resolution.name << std::setw(8) << "none"
+			<< std::right << std::setw(10) << std::fixed << std::setprecision(1) << 1000.0 * FRAME_COUNT / renderMs << " FPS" << std::endl;
+
+		for (FrameCapture::Format format : { FrameCapture::Format::Raw, FrameCapture::Format::Y4m }) {
+			bool y4m = format == FrameCapture::Format::Y4m;
+			std::string path = directory + "bench_capture" + (y4m ? ".y4m" : ".raw");
+			FrameCapture::Settings settings;
+			settings.format = format;
+			FrameCapture capture(device, TARGET_FORMAT, resolution.width, resolution.height, settings);
+			if (!capture.open(path.c_str())) {
+				std::cerr << "Could not create " << path << std::endl;
+				return 1;
+			}
+
+			// Until the last frame is on disk
+			auto start = std::chrono::steady_clock::now();
+			for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame) {
+				renderFrame(device, queue, target, targetView, frame, &capture);
+			}
+			capture.close();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::remove(path.c_str());
+
+			FrameCapture::Stats stats = capture.stats();
+			std::cout
+				<< std::left << std::setw(8) << resolution.name << std::setw(8) << (y4m ? "Y4M" : "raw")
+				<< std::right << std::setw(10) << std::fixed << std::setprecision(1) << 1000.0 * stats.framesWritten / ms << " FPS"
+				<< std::setw(10) << stats.bytesWritten / ms / 1000.0 << " MB/s"
+				<< std::setw(8) << 100.0 * stats.stallMs / ms << "% stalled"
+				<< std::setw(8) << stats.writeMs / std::max<uint64_t>(stats.framesWritten, 1) << " ms/frame written" << std::endl;
+			if (stats.framesWritten != FRAME_COUNT || !capture.good()) {
+				std::cerr << "Only " << stats.framesWritten << " of " << FRAME_COUNT << " frames were written" << std::endl;
+				allWritten = false;
+			}
+		}
+
+		targetView.release();
+		target.destroy();
+		target.release();
+	}
+
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return allWritten ? 0 : 1;
+}
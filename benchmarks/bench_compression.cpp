@@ -0,0 +1,137 @@
+// Measure the throughput and quality of the block compressor for every
+// format it writes, on one and on all cores, and check that compressed
+// textures survive a round trip through a file. Runs on the CPU only.
+
+#include "TextureCompression.h"
+#include "ThreadPool.h"
+
+#include "webgpu/webgpu.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr uint32_t IMAGE_SIZE = 2048;
+constexpr int ITERATIONS = 3;
+
+template <typename F>
+static double bestOfMs(F&& f) {
+	double best = 1e30;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+// Peak signal to noise ratio over the first `channelCount` channels
+static double psnr(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int channelCount) {
+	double squaredError = 0.0;
+	size_t count = 0;
+	for (size_t i = 0; i < a.size(); i += 4) {
+		for (int c = 0; c < channelCount; ++c) {
+			double difference = double(a[i + c]) - double(b[i + c]);
+			squaredError += difference * difference;
+			++count;
+		}
+	}
+	if (squaredError == 0.0) return 99.0;
+	return 10.0 * std::log10(255.0 * 255.0 * count / squaredError);
+}
+
+int main(int, char**) {
+	// Smooth color gradients with soft noise, hard edges every 64 texels
+	// and an alpha ramp, closer to real textures than pure noise
+	std::mt19937 rng(42);
+	std::normal_distribution<float> noise(0.0f, 6.0f);
+	std::vector<uint8_t> image(4 * IMAGE_SIZE * IMAGE_SIZE);
+	for (uint32_t y = 0; y < IMAGE_SIZE; ++y) {
+		for (uint32_t x = 0; x < IMAGE_SIZE; ++x) {
+			float u = float(x) / IMAGE_SIZE, v = float(y) / IMAGE_SIZE;
+			bool tile = ((x / 64) + (y / 64)) % 2 == 0;
+			float color[4] = {
+				255.0f * (0.5f + 0.5f * std::sin(6.0f * u + 2.0f * v)),
+				tile ? 200.0f * v : 40.0f + 100.0f * u,
+				255.0f * (0.5f + 0.5f * std::cos(9.0f * v)),
+				255.0f * u,
+			};
+			uint8_t* texel = &image[4 * (y * IMAGE_SIZE + x)];
+			for (int c = 0; c < 4; ++c) {
+				texel[c] = static_cast<uint8_t>(std::clamp(color[c] + (c < 3 ? noise(rng) : 0.0f), 0.0f, 255.0f));
+			}
+		}
+	}
+
+	ThreadPool pool;
+	std::cout << "Compressing a " << IMAGE_SIZE << "x" << IMAGE_SIZE << " image, SIMD: " << TextureCompressor::simdName()
+		<< ", threads: " << pool.threadCount() << std::endl;
+
+	struct Config {
+		std::string name;
+		TextureFormat format;
+		int channelCount;
+	};
+	const std::vector<Config> configs = {
+		{ "BC1", TextureFormat::BC1RGBAUnorm, 3 },
+		{ "BC3", TextureFormat::BC3RGBAUnorm, 4 },
+		{ "BC4", TextureFormat::BC4RUnorm, 1 },
+		{ "BC5", TextureFormat::BC5RGUnorm, 2 },
+		{ "ETC2 RGB8", TextureFormat::ETC2RGB8Unorm, 3 },
+		{ "ETC2 RGBA8", TextureFormat::ETC2RGBA8Unorm, 4 },
+		{ "EAC R11", TextureFormat::EACR11Unorm, 1 },
+		{ "EAC RG11", TextureFormat::EACRG11Unorm, 2 },
+	};
+
+	TextureCompressor singleThreaded(nullptr);
+	TextureCompressor multiThreaded(&pool);
+	double megapixels = double(IMAGE_SIZE) * IMAGE_SIZE / 1e6;
+	bool allPassed = true;
+	for (const Config& config : configs) {
+		CompressedTexture texture;
+		double singleMs = bestOfMs([&]() { texture = singleThreaded.compress(image.data(), IMAGE_SIZE, IMAGE_SIZE, config.format, false); });
+		double multiMs = bestOfMs([&]() { texture = multiThreaded.compress(image.data(), IMAGE_SIZE, IMAGE_SIZE, config.format, false); });
+		double quality = psnr(image, TextureCompressor::decompress(config.format, texture.levels[0]), config.channelCount);
+		std::cout
+			<< std::left << std::setw(12) << config.name
+			<< std::right << std::setw(9) << std::fixed << std::setprecision(1) << megapixels / singleMs * 1000.0 << " Mpx/s"
+			<< std::setw(9) << megapixels / multiMs * 1000.0 << " Mpx/s (" << pool.threadCount() << " threads)"
+			<< std::setw(8) << std::setprecision(2) << quality << " dB"
+			<< std::setw(6) << std::setprecision(0) << 4.0 * IMAGE_SIZE * IMAGE_SIZE / texture.levels[0].data.size() << ":1" << std::endl;
+		// Below this the encoder is broken rather than lossy
+		if (quality < 30.0) {
+			std::cerr << "Unexpectedly low quality for " << config.name << std::endl;
+			allPassed = false;
+		}
+	}
+
+	// Full mip chain, written to a file and read back
+	CompressedTexture texture;
+	double mipsMs = bestOfMs([&]() { texture = multiThreaded.compress(image.data(), IMAGE_SIZE, IMAGE_SIZE, TextureFormat::BC1RGBAUnormSrgb, true); });
+	std::cout << std::left << std::setw(12) << "BC1 sRGB, " << texture.levels.size() << " mips"
+		<< std::right << std::setw(9) << std::setprecision(3) << mipsMs << " ms" << std::endl;
+	const char* path = "bench_compression.lwtc";
+	CompressedTexture loaded;
+	bool roundTrip = texture.save(path) && loaded.load(path)
+		&& loaded.format == texture.format
+		&& loaded.levels.size() == texture.levels.size();
+	for (size_t i = 0; roundTrip && i < texture.levels.size(); ++i) {
+		roundTrip = loaded.levels[i].data == texture.levels[i].data;
+	}
+	std::remove(path);
+	if (!roundTrip) {
+		std::cerr << "The texture read back from " << path << " differs from the one written" << std::endl;
+		allPassed = false;
+	}
+
+	return allPassed ? 0 : 1;
+}
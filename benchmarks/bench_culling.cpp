@@ -0,0 +1,128 @@
+// Compare the scalar and SIMD frustum culling, on one and on all cores, and
+// measure the cost of the Hi-Z occlusion pass on the frustum culling output.
+
+#include "Culling.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr uint32_t OBJECT_COUNT = 1000000;
+constexpr int ITERATIONS = 20;
+
+// Column-major perspective projection with WebGPU depth range [0, 1]
+static void perspective(float out[16], float fovY, float aspect, float near, float far) {
+	float f = 1.0f / std::tan(fovY / 2);
+	std::fill(out, out + 16, 0.0f);
+	out[0] = f / aspect;
+	out[5] = f;
+	out[10] = far / (near - far);
+	out[11] = -1.0f;
+	out[14] = near * far / (near - far);
+}
+
+// Camera at (0, 0, distance) looking towards -Z, so the view matrix is a
+// mere translation that we fold into the projection.
+static void viewProjection(float out[16], float distance) {
+	perspective(out, 1.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+	for (int r = 0; r < 4; ++r) {
+		out[12 + r] += -distance * out[8 + r];
+	}
+}
+
+template <typename F>
+static double bestOfMs(F&& f) {
+	double best = 1e30;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+static void report(const std::string& name, double ms, size_t visibleCount) {
+	std::cout
+		<< std::left << std::setw(28) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms"
+		<< std::setw(10) << std::setprecision(1) << OBJECT_COUNT / ms / 1000.0 << " Mobj/s"
+		<< std::setw(10) << visibleCount << " visible" << std::endl;
+}
+
+int main(int, char**) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> extent(0.2f, 2.0f);
+
+	BoundsSoA bounds;
+	bounds.resize(OBJECT_COUNT);
+	for (uint32_t i = 0; i < OBJECT_COUNT; ++i) {
+		bounds.set(i, position(rng), position(rng), position(rng), extent(rng), extent(rng), extent(rng));
+	}
+
+	float viewProj[16];
+	viewProjection(viewProj, 150.0f);
+	Frustum frustum = Frustum::fromViewProjection(viewProj);
+
+	ThreadPool pool;
+	std::cout << "Culling " << OBJECT_COUNT << " objects, SIMD: " << cullingSimdName()
+		<< ", threads: " << pool.threadCount() << std::endl;
+
+	FrustumCuller reference(nullptr, CullingImpl::Scalar);
+	const std::vector<uint32_t> expected = reference.cull(frustum, bounds);
+
+	struct Config {
+		std::string name;
+		ThreadPool* pool;
+		CullingImpl impl;
+	};
+	std::vector<Config> configs = {
+		{ "scalar, 1 thread", nullptr, CullingImpl::Scalar },
+		{ std::string(cullingSimdName()) + ", 1 thread", nullptr, CullingImpl::Simd },
+		{ "scalar, " + std::to_string(pool.threadCount()) + " threads", &pool, CullingImpl::Scalar },
+		{ std::string(cullingSimdName()) + ", " + std::to_string(pool.threadCount()) + " threads", &pool, CullingImpl::Simd },
+	};
+
+	bool allMatch = true;
+	for (const Config& config : configs) {
+		FrustumCuller culler(config.pool, config.impl);
+		size_t visibleCount = 0;
+		double ms = bestOfMs([&]() { visibleCount = culler.cull(frustum, bounds).size(); });
+		if (culler.cull(frustum, bounds) != expected) {
+			std::cerr << "Mismatch with the scalar reference for '" << config.name << "'" << std::endl;
+			allMatch = false;
+		}
+		report(config.name, ms, visibleCount);
+	}
+
+	// Occlusion: a synthetic occluder covering the left half of the screen
+	// at mid distance, in a 512x288 depth buffer.
+	const uint32_t width = 512, height = 288;
+	std::vector<float> depth(width * height, 1.0f);
+	for (uint32_t y = 0; y < height; ++y) {
+		std::fill_n(depth.begin() + y * width, width / 2, 0.995f);
+	}
+	HiZBuffer hiz;
+	double buildMs = bestOfMs([&]() { hiz.build(depth.data(), width, height); });
+
+	std::vector<uint32_t> visible;
+	double occlusionMs = bestOfMs([&]() {
+		visible = expected;
+		cullOcclusion(hiz, viewProj, bounds, visible);
+	});
+	std::cout << std::left << std::setw(28) << "Hi-Z build"
+		<< std::right << std::setw(10) << std::setprecision(3) << buildMs << " ms" << std::endl;
+	std::cout << std::left << std::setw(28) << "Hi-Z occlusion test"
+		<< std::right << std::setw(10) << std::setprecision(3) << occlusionMs << " ms"
+		<< std::setw(10) << std::setprecision(1) << expected.size() / occlusionMs / 1000.0 << " Mobj/s"
+		<< std::setw(10) << visible.size() << " visible" << std::endl;
+
+	return allMatch ? 0 : 1;
+}
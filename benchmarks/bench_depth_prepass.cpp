@@ -0,0 +1,534 @@
+// Compare the cost of shading a 1080p frame with heavy overdraw, namely
+// large overlapping quads at random depths with an expensive fragment
+// shader, without depth buffer, with depth testing in various draw orders,
+// and with a depth prepass followed by an Equal depth test. Reports the
+// GPU time of the passes when timestamp queries are supported, and the
+// number of fragment shader invocations when pipeline statistics queries
+// are. Needs a GPU.
+
+#include "DepthBuffer.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr uint32_t WIDTH = 1920;
+constexpr uint32_t HEIGHT = 1080;
+// Each quad covers about a sixth of the screen, so each pixel is covered
+// by about 50 of them
+constexpr uint32_t QUAD_COUNT = 300;
+constexpr int ITERATIONS = 20;
+const TextureFormat TARGET_FORMAT = TextureFormat::BGRA8Unorm;
+// Begin and end timestamps of up to 2 passes
+constexpr uint32_t MAX_PASS_COUNT = 2;
+// Query resolve offsets must be aligned to 256 bytes
+constexpr uint64_t STATISTICS_OFFSET = 256;
+constexpr uint64_t QUERY_BUFFER_SIZE = 512;
+
+// Quads are given as (center x, center y, half size, depth) in clip space.
+// The main and prepass vertex shaders share the position computation, and
+// mark it invariant so that the Equal depth test passes after the prepass.
+static const char* shaderSource = R"(
+struct VertexOutput {
+    @builtin(position) @invariant position: vec4f,
+    @location(0) uv: vec2f,
+    @location(1) @interpolate(flat) seed: f32,
+}
+
+fn corner(vertexIndex: u32) -> vec2f {
+    var corners = array<vec2f, 6>(
+        vec2f(-1.0, -1.0), vec2f(1.0, -1.0), vec2f(1.0, 1.0),
+        vec2f(-1.0, -1.0), vec2f(1.0, 1.0), vec2f(-1.0, 1.0),
+    );
+    return corners[vertexIndex];
+}
+
+fn quadPosition(quad: vec4f, vertexIndex: u32) -> vec4f {
+    return vec4f(quad.xy + corner(vertexIndex) * quad.z, quad.w, 1.0);
+}
+
+@vertex
+fn vs_main(@builtin(vertex_index) vertexIndex: u32, @location(0) quad: vec4f) -> VertexOutput {
+    var out: VertexOutput;
+    out.position = quadPosition(quad, vertexIndex);
+    out.uv = corner(vertexIndex) * 0.5 + 0.5;
+    out.seed = quad.w * 100.0;
+    return out;
+}
+
+@vertex
+fn vs_depth(@builtin(vertex_index) vertexIndex: u32, @location(0) quad: vec4f) -> @builtin(position) @invariant vec4f {
+    return quadPosition(quad, vertexIndex);
+}
+
+// Stands for expensive lighting: a chain of dependent transcendentals
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    var p = in.uv * 8.0 + in.seed;
+    var color = vec3f(0.0);
+    for (var i = 0; i < 48; i++) {
+        p = vec2f(sin(p.y * 1.3 + color.x), cos(p.x * 1.7 - color.y));
+        color += vec3f(p * 0.5 + 0.5, 0.5) / 48.0;
+    }
+    return vec4f(color, 1.0);
+}
+)";
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+static uint32_t hash(uint32_t x) {
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static float random01(uint32_t x) {
+	return static_cast<float>(hash(x) >> 8) / static_cast<float>(1 << 24);
+}
+
+// Where the passes record their timestamps and statistics, when supported
+struct Queries {
+	QuerySet timestamps = nullptr;
+	QuerySet statistics = nullptr;
+	Buffer resolveBuffer = nullptr;
+	Buffer readbackBuffer = nullptr;
+	uint32_t passCount = 0;
+};
+
+struct Measurement {
+	double medianMs = 0.0;
+	// Negative when not measured
+	double gpuMs = -1.0;
+	int64_t fragmentInvocations = -1;
+};
+
+static RenderPassEncoder beginPass(CommandEncoder encoder, Queries& queries, const RenderPassColorAttachment* colorAttachment, const RenderPassDepthStencilAttachment* depthAttachment) {
+	assert(queries.passCount < MAX_PASS_COUNT);
+	uint32_t pass = queries.passCount++;
+	std::vector<RenderPassTimestampWrite> timestampWrites;
+	if (queries.timestamps) {
+		timestampWrites.resize(2);
+		timestampWrites[0].querySet = queries.timestamps;
+		timestampWrites[0].queryIndex = 2 * pass;
+		timestampWrites[0].location = RenderPassTimestampLocation::Beginning;
+		timestampWrites[1].querySet = queries.timestamps;
+		timestampWrites[1].queryIndex = 2 * pass + 1;
+		timestampWrites[1].location = RenderPassTimestampLocation::End;
+	}
+	RenderPassDescriptor renderPassDesc{};
+	renderPassDesc.colorAttachmentCount = colorAttachment ? 1 : 0;
+	renderPassDesc.colorAttachments = colorAttachment;
+	renderPassDesc.depthStencilAttachment = depthAttachment;
+	renderPassDesc.timestampWriteCount = (uint32_t)timestampWrites.size();
+	renderPassDesc.timestampWrites = timestampWrites.data();
+	RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+	if (queries.statistics) {
+		renderPass.beginPipelineStatisticsQuery(queries.statistics, pass);
+	}
+	return renderPass;
+}
+
+static void endPass(RenderPassEncoder renderPass, const Queries& queries) {
+	if (queries.statistics) {
+		renderPass.endPipelineStatisticsQuery();
+	}
+	renderPass.end();
+	renderPass.release();
+}
+
+// Time ITERATIONS frames, each waited for, that record their passes with
+// `encode`, and read the queries of each frame back
+template <typename F>
+static Measurement measure(Device device, Queue queue, Queries& queries, F&& encode) {
+	std::vector<double> frameMs;
+	std::vector<double> gpuMs;
+	int64_t fragmentInvocations = -1;
+	// One extra frame to warm up
+	for (int iteration = 0; iteration <= ITERATIONS; ++iteration) {
+		auto start = std::chrono::steady_clock::now();
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+		queries.passCount = 0;
+		encode(encoder);
+		if (queries.timestamps) {
+			encoder.resolveQuerySet(queries.timestamps, 0, 2 * queries.passCount, queries.resolveBuffer, 0);
+		}
+		if (queries.statistics) {
+			encoder.resolveQuerySet(queries.statistics, 0, queries.passCount, queries.resolveBuffer, STATISTICS_OFFSET);
+		}
+		if (queries.timestamps || queries.statistics) {
+			encoder.copyBufferToBuffer(queries.resolveBuffer, 0, queries.readbackBuffer, 0, QUERY_BUFFER_SIZE);
+		}
+		CommandBufferDescriptor commandBufferDesc{};
+		CommandBuffer command = encoder.finish(commandBufferDesc);
+		encoder.release();
+		queue.submit(1, &command);
+		command.release();
+		waitForGpu(device, queue);
+		if (iteration == 0) continue;
+		frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+		if (!queries.timestamps && !queries.statistics) continue;
+		bool mapped = false;
+		auto mapCallback = queries.readbackBuffer.mapAsync(MapMode::Read, 0, QUERY_BUFFER_SIZE, [&mapped](BufferMapAsyncStatus) { mapped = true; });
+		while (!mapped) {
+#ifdef WEBGPU_BACKEND_WGPU
+			wgpuDevicePoll(device, true, nullptr);
+#else
+			device.tick();
+#endif
+		}
+		const uint8_t* data = static_cast<const uint8_t*>(queries.readbackBuffer.getConstMappedRange(0, QUERY_BUFFER_SIZE));
+		if (queries.timestamps) {
+			uint64_t ticks[2 * MAX_PASS_COUNT];
+			std::memcpy(ticks, data, sizeof(ticks));
+			uint64_t total = 0;
+			for (uint32_t pass = 0; pass < queries.passCount; ++pass) {
+				total += ticks[2 * pass + 1] - ticks[2 * pass];
+			}
+			// wgpu-native v0.17 does not expose the timestamp period, so
+			// ticks are taken as nanoseconds, which is what Dawn returns
+			// and what most desktop drivers count in
+			gpuMs.push_back(total / 1e6);
+		}
+		if (queries.statistics) {
+			uint64_t invocations[MAX_PASS_COUNT];
+			std::memcpy(invocations, data + STATISTICS_OFFSET, sizeof(invocations));
+			// Only the main pass runs a fragment shader, and every frame
+			// shades the same fragments
+			fragmentInvocations = static_cast<int64_t>(invocations[queries.passCount - 1]);
+		}
+		queries.readbackBuffer.unmap();
+	}
+
+	Measurement measurement;
+	std::sort(frameMs.begin(), frameMs.end());
+	measurement.medianMs = frameMs[frameMs.size() / 2];
+	if (!gpuMs.empty()) {
+		std::sort(gpuMs.begin(), gpuMs.end());
+		measurement.gpuMs = gpuMs[gpuMs.size() / 2];
+	}
+	measurement.fragmentInvocations = fragmentInvocations;
+	return measurement;
+}
+
+static void report(const std::string& name, const Measurement& measurement) {
+	std::cout
+		<< std::left << std::setw(28) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(3) << measurement.medianMs << " ms median";
+	if (measurement.gpuMs >= 0.0) {
+		std::cout << std::setw(10) << measurement.gpuMs << " ms GPU";
+	} else {
+		std::cout << std::setw(17) << "n/a GPU";
+	}
+	if (measurement.fragmentInvocations >= 0) {
+		std::cout << std::setw(8) << std::setprecision(1) << measurement.fragmentInvocations / static_cast<double>(WIDTH * HEIGHT) << " shaded/pixel";
+	} else {
+		std::cout << std::setw(17) << "n/a shaded/pixel";
+	}
+	std::cout << std::endl;
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+
+	// No surface, everything is rendered offscreen
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	// Both queries are optional, the benchmark falls back to wall time and
+	// does not count invocations without them
+	std::vector<FeatureName> features;
+	for (FeatureName feature : { FeatureName::TimestampQuery, FeatureName::PipelineStatisticsQuery }) {
+		if (adapter.hasFeature(feature)) {
+			features.push_back(feature);
+		}
+	}
+	bool hasTimestamps = std::find(features.begin(), features.end(), FeatureName::TimestampQuery) != features.end();
+	bool hasStatistics = std::find(features.begin(), features.end(), FeatureName::PipelineStatisticsQuery) != features.end();
+
+	RequiredLimits requiredLimits = Default;
+	requiredLimits.limits.maxTextureDimension2D = std::max(WIDTH, HEIGHT);
+	requiredLimits.limits.maxVertexBuffers = 1;
+	requiredLimits.limits.maxVertexAttributes = 1;
+	requiredLimits.limits.maxVertexBufferArrayStride = 4 * sizeof(float);
+	requiredLimits.limits.maxBufferSize = std::max<uint64_t>(QUAD_COUNT * 4 * sizeof(float), QUERY_BUFFER_SIZE);
+	requiredLimits.limits.maxInterStageShaderComponents = 3;
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = (uint32_t)features.size();
+	deviceDesc.requiredFeatures = (const WGPUFeatureName*)features.data();
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+	Queries queries;
+	if (hasTimestamps) {
+		QuerySetDescriptor querySetDesc;
+		querySetDesc.label = "Pass timestamps";
+		querySetDesc.type = QueryType::Timestamp;
+		querySetDesc.count = 2 * MAX_PASS_COUNT;
+		querySetDesc.pipelineStatistics = nullptr;
+		querySetDesc.pipelineStatisticsCount = 0;
+		queries.timestamps = device.createQuerySet(querySetDesc);
+	}
+	if (hasStatistics) {
+		const PipelineStatisticName statistic = PipelineStatisticName::FragmentShaderInvocations;
+		QuerySetDescriptor querySetDesc;
+		querySetDesc.label = "Pass statistics";
+		querySetDesc.type = QueryType::PipelineStatistics;
+		querySetDesc.count = MAX_PASS_COUNT;
+		querySetDesc.pipelineStatistics = (const WGPUPipelineStatisticName*)&statistic;
+		querySetDesc.pipelineStatisticsCount = 1;
+		queries.statistics = device.createQuerySet(querySetDesc);
+	}
+	if (hasTimestamps || hasStatistics) {
+		BufferDescriptor bufferDesc;
+		bufferDesc.label = "Query resolve";
+		bufferDesc.size = QUERY_BUFFER_SIZE;
+		bufferDesc.usage = BufferUsage::QueryResolve | BufferUsage::CopySrc;
+		bufferDesc.mappedAtCreation = false;
+		queries.resolveBuffer = device.createBuffer(bufferDesc);
+		bufferDesc.label = "Query readback";
+		bufferDesc.usage = BufferUsage::MapRead | BufferUsage::CopyDst;
+		queries.readbackBuffer = device.createBuffer(bufferDesc);
+	}
+
+	// Quads in a random order, and the same quads sorted both ways. Smaller
+	// depths are closer.
+	std::vector<float> quads(4 * QUAD_COUNT);
+	for (uint32_t i = 0; i < QUAD_COUNT; ++i) {
+		quads[4 * i] = 2.0f * random01(4 * i) - 1.0f;
+		quads[4 * i + 1] = 2.0f * random01(4 * i + 1) - 1.0f;
+		quads[4 * i + 2] = 0.35f + 0.2f * random01(4 * i + 2);
+		quads[4 * i + 3] = 0.05f + 0.9f * random01(4 * i + 3);
+	}
+	std::vector<uint32_t> order(QUAD_COUNT);
+	for (uint32_t i = 0; i < QUAD_COUNT; ++i) order[i] = i;
+	std::sort(order.begin(), order.end(), [&quads](uint32_t a, uint32_t b) { return quads[4 * a + 3] < quads[4 * b + 3]; });
+	std::vector<float> frontToBack(4 * QUAD_COUNT);
+	std::vector<float> backToFront(4 * QUAD_COUNT);
+	for (uint32_t i = 0; i < QUAD_COUNT; ++i) {
+		std::copy_n(&quads[4 * order[i]], 4, &frontToBack[4 * i]);
+		std::copy_n(&quads[4 * order[i]], 4, &backToFront[4 * (QUAD_COUNT - 1 - i)]);
+	}
+	auto createQuadBuffer = [&](const std::vector<float>& data) {
+		BufferDescriptor bufferDesc;
+		bufferDesc.label = "Quads";
+		bufferDesc.size = data.size() * sizeof(float);
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
+		bufferDesc.mappedAtCreation = false;
+		Buffer buffer = device.createBuffer(bufferDesc);
+		queue.writeBuffer(buffer, 0, data.data(), bufferDesc.size);
+		return buffer;
+	};
+	Buffer unsortedBuffer = createQuadBuffer(quads);
+	Buffer frontToBackBuffer = createQuadBuffer(frontToBack);
+	Buffer backToFrontBuffer = createQuadBuffer(backToFront);
+	const uint64_t quadBufferSize = quads.size() * sizeof(float);
+
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = shaderSource;
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = device.createShaderModule(shaderDesc);
+
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.bindGroupLayoutCount = 0;
+	pipelineLayoutDesc.bindGroupLayouts = nullptr;
+	PipelineLayout pipelineLayout = device.createPipelineLayout(pipelineLayoutDesc);
+
+	VertexAttribute quadAttrib;
+	quadAttrib.shaderLocation = 0;
+	quadAttrib.format = VertexFormat::Float32x4;
+	quadAttrib.offset = 0;
+	VertexBufferLayout quadBufferLayout;
+	quadBufferLayout.attributeCount = 1;
+	quadBufferLayout.attributes = &quadAttrib;
+	quadBufferLayout.arrayStride = 4 * sizeof(float);
+	quadBufferLayout.stepMode = VertexStepMode::Instance;
+
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	ColorTargetState colorTarget;
+	colorTarget.format = TARGET_FORMAT;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+
+	// One pipeline per depth state, plus the prepass
+	auto createPipeline = [&](const char* entryPoint, const DepthStencilState* depthStencil, bool withFragment) {
+		RenderPipelineDescriptor pipelineDesc{};
+		pipelineDesc.layout = pipelineLayout;
+		pipelineDesc.vertex.bufferCount = 1;
+		pipelineDesc.vertex.buffers = &quadBufferLayout;
+		pipelineDesc.vertex.module = shaderModule;
+		pipelineDesc.vertex.entryPoint = entryPoint;
+		pipelineDesc.vertex.constantCount = 0;
+		pipelineDesc.vertex.constants = nullptr;
+		pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+		pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+		pipelineDesc.primitive.frontFace = FrontFace::CCW;
+		pipelineDesc.primitive.cullMode = CullMode::None;
+		pipelineDesc.fragment = withFragment ? &fragmentState : nullptr;
+		pipelineDesc.depthStencil = depthStencil;
+		pipelineDesc.multisample.count = 1;
+		pipelineDesc.multisample.mask = ~0u;
+		pipelineDesc.multisample.alphaToCoverageEnabled = false;
+		return device.createRenderPipeline(pipelineDesc);
+	};
+	DepthBuffer depthBuffer(device, 1, false);
+	depthBuffer.resize(WIDTH, HEIGHT);
+	DepthBuffer prepassDepthBuffer(device, 1, true);
+	prepassDepthBuffer.resize(WIDTH, HEIGHT);
+	DepthStencilState depthState = depthBuffer.mainPassDepthState();
+	DepthStencilState prepassState = prepassDepthBuffer.prepassDepthState();
+	DepthStencilState equalState = prepassDepthBuffer.mainPassDepthState();
+	RenderPipeline noDepthPipeline = createPipeline("vs_main", nullptr, true);
+	RenderPipeline depthPipeline = createPipeline("vs_main", &depthState, true);
+	RenderPipeline prepassPipeline = createPipeline("vs_depth", &prepassState, false);
+	RenderPipeline equalPipeline = createPipeline("vs_main", &equalState, true);
+
+	// Stands for the swap chain
+	TextureDescriptor targetDesc;
+	targetDesc.label = "Offscreen target";
+	targetDesc.usage = TextureUsage::RenderAttachment;
+	targetDesc.dimension = TextureDimension::_2D;
+	targetDesc.size = { WIDTH, HEIGHT, 1 };
+	targetDesc.format = TARGET_FORMAT;
+	targetDesc.mipLevelCount = 1;
+	targetDesc.sampleCount = 1;
+	targetDesc.viewFormatCount = 0;
+	targetDesc.viewFormats = nullptr;
+	Texture target = device.createTexture(targetDesc);
+	TextureView targetView = target.createView();
+
+	RenderPassColorAttachment colorAttachment = {};
+	colorAttachment.view = targetView;
+	colorAttachment.resolveTarget = nullptr;
+	colorAttachment.loadOp = LoadOp::Clear;
+	colorAttachment.storeOp = StoreOp::Store;
+	colorAttachment.clearValue = Color{ 0.1, 0.1, 0.1, 1.0 };
+
+	std::cout << QUAD_COUNT << " overlapping quads at " << WIDTH << "x" << HEIGHT << ", " << ITERATIONS << " frames each" << std::endl;
+	if (!hasTimestamps) std::cout << "No timestamp queries, GPU time is not measured" << std::endl;
+	if (!hasStatistics) std::cout << "No pipeline statistics queries, fragment shader invocations are not counted" << std::endl;
+
+	auto drawQuads = [&](RenderPassEncoder renderPass, RenderPipeline pipeline, Buffer quadBuffer) {
+		renderPass.setPipeline(pipeline);
+		renderPass.setVertexBuffer(0, quadBuffer, 0, quadBufferSize);
+		renderPass.draw(6, QUAD_COUNT, 0, 0);
+	};
+	auto mainPass = [&](CommandEncoder encoder, const DepthBuffer* depth, RenderPipeline pipeline, Buffer quadBuffer) {
+		RenderPassDepthStencilAttachment depthAttachment;
+		if (depth) depthAttachment = depth->mainPassAttachment();
+		RenderPassEncoder renderPass = beginPass(encoder, queries, &colorAttachment, depth ? &depthAttachment : nullptr);
+		drawQuads(renderPass, pipeline, quadBuffer);
+		endPass(renderPass, queries);
+	};
+
+	report("no depth, back to front", measure(device, queue, queries, [&](CommandEncoder encoder) {
+		mainPass(encoder, nullptr, noDepthPipeline, backToFrontBuffer);
+	}));
+	report("depth, back to front", measure(device, queue, queries, [&](CommandEncoder encoder) {
+		mainPass(encoder, &depthBuffer, depthPipeline, backToFrontBuffer);
+	}));
+	report("depth, unsorted", measure(device, queue, queries, [&](CommandEncoder encoder) {
+		mainPass(encoder, &depthBuffer, depthPipeline, unsortedBuffer);
+	}));
+	report("depth, front to back", measure(device, queue, queries, [&](CommandEncoder encoder) {
+		mainPass(encoder, &depthBuffer, depthPipeline, frontToBackBuffer);
+	}));
+	report("prepass + equal, unsorted", measure(device, queue, queries, [&](CommandEncoder encoder) {
+		RenderPassDepthStencilAttachment depthAttachment = prepassDepthBuffer.prepassAttachment();
+		RenderPassEncoder prepass = beginPass(encoder, queries, nullptr, &depthAttachment);
+		drawQuads(prepass, prepassPipeline, unsortedBuffer);
+		endPass(prepass, queries);
+		mainPass(encoder, &prepassDepthBuffer, equalPipeline, unsortedBuffer);
+	}));
+
+	equalPipeline.release();
+	prepassPipeline.release();
+	depthPipeline.release();
+	noDepthPipeline.release();
+	pipelineLayout.release();
+	shaderModule.release();
+	backToFrontBuffer.release();
+	frontToBackBuffer.release();
+	unsortedBuffer.release();
+	if (queries.readbackBuffer) {
+		queries.readbackBuffer.release();
+		queries.resolveBuffer.release();
+	}
+	if (queries.statistics) queries.statistics.release();
+	if (queries.timestamps) queries.timestamps.release();
+	targetView.release();
+	target.destroy();
+	target.release();
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return 0;
+}
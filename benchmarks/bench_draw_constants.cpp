@@ -0,0 +1,295 @@
+// Compare the cost of changing small per-draw parameters with push
+// constants and with a uniform buffer bound at a dynamic offset, on many
+// tiny draw calls rendered to an offscreen target. Needs a GPU.
+
+#include "BindGroupCache.h"
+#include "DrawConstants.h"
+#include "UniformAllocator.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr uint32_t DRAW_COUNT = 10000;
+constexpr int ITERATIONS = 20;
+constexpr uint32_t TARGET_SIZE = 256;
+const TextureFormat TARGET_FORMAT = TextureFormat::RGBA8Unorm;
+
+// Matches the DrawParams struct of the shader
+struct DrawParams {
+	float offset[4];
+	float color[4];
+};
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+static RenderPipeline createPipeline(Device device, DrawConstants& drawConstants, PipelineLayout& pipelineLayout) {
+	std::string shaderSource = R"(
+struct DrawParams {
+    offset: vec4f,
+    color: vec4f,
+}
+)" + drawConstants.wgslDeclaration("uDraw", "DrawParams") + R"(
+struct VertexOutput {
+    @builtin(position) position: vec4f,
+    @location(0) color: vec4f,
+}
+
+@vertex
+fn vs_main(@builtin(vertex_index) index: u32) -> VertexOutput {
+    var out: VertexOutput;
+    let corner = vec2f(f32(index & 1u), f32(index >> 1u)) * 0.05;
+    out.position = vec4f(uDraw.offset.xy + corner, 0.0, 1.0);
+    out.color = uDraw.color;
+    return out;
+}
+
+@fragment
+fn fs_main(in: VertexOutput) -> @location(0) vec4f {
+    return in.color;
+}
+)";
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = shaderSource.c_str();
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = device.createShaderModule(shaderDesc);
+
+	pipelineLayout = drawConstants.createPipelineLayout({});
+
+	RenderPipelineDescriptor pipelineDesc{};
+	pipelineDesc.layout = pipelineLayout;
+	pipelineDesc.vertex.bufferCount = 0;
+	pipelineDesc.vertex.buffers = nullptr;
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.constantCount = 0;
+	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	pipelineDesc.primitive.frontFace = FrontFace::CCW;
+	pipelineDesc.primitive.cullMode = CullMode::None;
+
+	ColorTargetState colorTarget;
+	colorTarget.format = TARGET_FORMAT;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+
+	pipelineDesc.depthStencil = nullptr;
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+
+	RenderPipeline pipeline = device.createRenderPipeline(pipelineDesc);
+	shaderModule.release();
+	return pipeline;
+}
+
+struct Timings {
+	double encodeMs = 1e30;
+	double frameMs = 1e30;
+};
+
+// Best of ITERATIONS frames of DRAW_COUNT draws, each with its own parameters
+static Timings run(Device device, Queue queue, TextureView target, DrawConstants& drawConstants, UniformAllocator& uniforms) {
+	PipelineLayout pipelineLayout = nullptr;
+	RenderPipeline pipeline = createPipeline(device, drawConstants, pipelineLayout);
+
+	std::vector<DrawParams> params(DRAW_COUNT);
+	for (uint32_t i = 0; i < DRAW_COUNT; ++i) {
+		float x = static_cast<float>(i % 100) / 50.0f - 1.0f;
+		float y = static_cast<float>(i / 100 % 100) / 50.0f - 1.0f;
+		params[i] = DrawParams{ { x, y, 0.0f, 0.0f }, { x * 0.5f + 0.5f, y * 0.5f + 0.5f, 0.5f, 1.0f } };
+	}
+
+	Timings timings;
+	// One extra frame to warm up
+	for (int iteration = 0; iteration <= ITERATIONS; ++iteration) {
+		auto start = std::chrono::steady_clock::now();
+		uniforms.reset();
+
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+
+		RenderPassColorAttachment colorAttachment = {};
+		colorAttachment.view = target;
+		colorAttachment.resolveTarget = nullptr;
+		colorAttachment.loadOp = LoadOp::Clear;
+		colorAttachment.storeOp = StoreOp::Store;
+		colorAttachment.clearValue = Color{ 0.0, 0.0, 0.0, 1.0 };
+		RenderPassDescriptor renderPassDesc{};
+		renderPassDesc.colorAttachmentCount = 1;
+		renderPassDesc.colorAttachments = &colorAttachment;
+		renderPassDesc.depthStencilAttachment = nullptr;
+		renderPassDesc.timestampWriteCount = 0;
+		renderPassDesc.timestampWrites = nullptr;
+		RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+		renderPass.setPipeline(pipeline);
+		for (uint32_t i = 0; i < DRAW_COUNT; ++i) {
+			// The allocator is sized for all the draws, so none is skipped
+			if (!drawConstants.set(renderPass, params[i])) continue;
+			renderPass.draw(3, 1, 0, 0);
+		}
+		renderPass.end();
+		renderPass.release();
+
+		CommandBufferDescriptor commandBufferDesc{};
+		CommandBuffer command = encoder.finish(commandBufferDesc);
+		encoder.release();
+		uniforms.upload(queue);
+		auto encoded = std::chrono::steady_clock::now();
+
+		queue.submit(1, &command);
+		command.release();
+		waitForGpu(device, queue);
+		auto end = std::chrono::steady_clock::now();
+
+		if (iteration == 0) continue;
+		timings.encodeMs = std::min(timings.encodeMs, std::chrono::duration<double, std::milli>(encoded - start).count());
+		timings.frameMs = std::min(timings.frameMs, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	pipeline.release();
+	pipelineLayout.release();
+	return timings;
+}
+
+static void report(const std::string& name, const Timings& timings) {
+	std::cout
+		<< std::left << std::setw(24) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(3) << timings.encodeMs << " ms encode"
+		<< std::setw(10) << timings.frameMs << " ms frame"
+		<< std::setw(10) << std::setprecision(1) << 1e6 * timings.encodeMs / DRAW_COUNT << " ns/draw" << std::endl;
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+
+	// No surface, everything is rendered offscreen
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+	bool pushConstants = DrawConstants::pushConstantsSupported(adapter);
+
+	// One device supports both paths
+	uint32_t alignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	uint32_t uniformCapacity = DRAW_COUNT * alignment;
+	RequiredLimits requiredLimits = Default;
+	requiredLimits.limits.maxTextureDimension2D = TARGET_SIZE;
+	requiredLimits.limits.maxInterStageShaderComponents = 4;
+	requiredLimits.limits.maxBufferSize = uniformCapacity + alignment;
+	requiredLimits.limits.minUniformBufferOffsetAlignment = alignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DrawConstants::LimitsExtras limitsExtras;
+	DrawConstants::requireLimits(requiredLimits, limitsExtras, false, sizeof(DrawParams), 0);
+	if (pushConstants) {
+		DrawConstants::requireLimits(requiredLimits, limitsExtras, true, sizeof(DrawParams), 0);
+	}
+
+	std::vector<WGPUFeatureName> requiredFeatures;
+	for (FeatureName feature : DrawConstants::requiredFeatures(pushConstants)) {
+		requiredFeatures.push_back(feature);
+	}
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = (uint32_t)requiredFeatures.size();
+	deviceDesc.requiredFeatures = requiredFeatures.data();
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+	TextureDescriptor targetDesc;
+	targetDesc.label = "Offscreen target";
+	targetDesc.usage = TextureUsage::RenderAttachment;
+	targetDesc.dimension = TextureDimension::_2D;
+	targetDesc.size = { TARGET_SIZE, TARGET_SIZE, 1 };
+	targetDesc.format = TARGET_FORMAT;
+	targetDesc.mipLevelCount = 1;
+	targetDesc.sampleCount = 1;
+	targetDesc.viewFormatCount = 0;
+	targetDesc.viewFormats = nullptr;
+	Texture target = device.createTexture(targetDesc);
+	TextureView targetView = target.createView();
+
+	BindGroupCache bindGroupCache(device);
+	UniformAllocator uniforms(device, uniformCapacity, sizeof(DrawParams));
+
+	std::cout << DRAW_COUNT << " draws of " << sizeof(DrawParams) << " bytes of parameters, best of " << ITERATIONS << " frames" << std::endl;
+
+	DrawConstants uniformConstants(device, false, sizeof(DrawParams), ShaderStage::Vertex, 0, uniforms, bindGroupCache);
+	report("dynamic offset", run(device, queue, targetView, uniformConstants, uniforms));
+
+	if (pushConstants) {
+		DrawConstants pushConstantsPath(device, true, sizeof(DrawParams), ShaderStage::Vertex, 0, uniforms, bindGroupCache);
+		report("push constants", run(device, queue, targetView, pushConstantsPath, uniforms));
+	} else {
+		std::cout << "Push constants are not supported by this adapter" << std::endl;
+	}
+
+	targetView.release();
+	target.destroy();
+	target.release();
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return 0;
+}
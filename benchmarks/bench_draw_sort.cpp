@@ -0,0 +1,422 @@
+// Measure what sorting draws by key saves, on many small draws that use
+// a few pipelines, many materials (one bind group each) and a few meshes
+// (one vertex buffer each), added in random order. Compares encoding them
+// as they come with every state set, as they come with the redundant
+// state changes skipped, and sorted by DrawQueue. Also compares the radix
+// sort of DrawQueue with std::sort, on one thread and on all of them.
+// Needs a GPU.
+
+#include "DrawQueue.h"
+#include "ThreadPool.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr uint32_t DRAW_COUNT = 20000;
+constexpr uint32_t PIPELINE_COUNT = 8;
+constexpr uint32_t MATERIAL_COUNT = 64;
+constexpr uint32_t MESH_COUNT = 16;
+constexpr int ITERATIONS = 20;
+constexpr uint32_t TARGET_SIZE = 256;
+const TextureFormat TARGET_FORMAT = TextureFormat::RGBA8Unorm;
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+// Pipelines differ by the way they shade the material color, so that
+// they are really different pipelines
+static RenderPipeline createPipeline(Device device, PipelineLayout pipelineLayout, uint32_t variant) {
+	std::string shaderSource = R"(
+@group(0) @binding(0) var<uniform> uColor: vec4f;
+
+fn hash(x: u32) -> f32 {
+    var h = x * 747796405u + 2891336453u;
+    h = ((h >> ((h >> 28u) + 4u)) ^ h) * 277803737u;
+    return f32((h >> 22u) ^ h) / 4294967295.0;
+}
+
+@vertex
+fn vs_main(@location(0) position: vec2f, @builtin(instance_index) instanceIndex: u32) -> @builtin(position) vec4f {
+    let center = vec2f(hash(2u * instanceIndex), hash(2u * instanceIndex + 1u)) * 2.0 - 1.0;
+    return vec4f(center + position, 0.0, 1.0);
+}
+
+@fragment
+fn fs_main() -> @location(0) vec4f {
+    return vec4f(uColor.rgb * )" + std::to_string(0.5f + 0.5f * variant / PIPELINE_COUNT) + R"(, 1.0);
+}
+)";
+	ShaderModuleDescriptor shaderDesc;
+#ifdef WEBGPU_BACKEND_WGPU
+	shaderDesc.hintCount = 0;
+	shaderDesc.hints = nullptr;
+#endif
+	ShaderModuleWGSLDescriptor shaderCodeDesc;
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = shaderSource.c_str();
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule shaderModule = device.createShaderModule(shaderDesc);
+
+	VertexAttribute positionAttrib;
+	positionAttrib.shaderLocation = 0;
+	positionAttrib.format = VertexFormat::Float32x2;
+	positionAttrib.offset = 0;
+	VertexBufferLayout vertexBufferLayout;
+	vertexBufferLayout.attributeCount = 1;
+	vertexBufferLayout.attributes = &positionAttrib;
+	vertexBufferLayout.arrayStride = 2 * sizeof(float);
+	vertexBufferLayout.stepMode = VertexStepMode::Vertex;
+
+	RenderPipelineDescriptor pipelineDesc{};
+	pipelineDesc.layout = pipelineLayout;
+	pipelineDesc.vertex.bufferCount = 1;
+	pipelineDesc.vertex.buffers = &vertexBufferLayout;
+	pipelineDesc.vertex.module = shaderModule;
+	pipelineDesc.vertex.entryPoint = "vs_main";
+	pipelineDesc.vertex.constantCount = 0;
+	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
+	pipelineDesc.primitive.stripIndexFormat = IndexFormat::Undefined;
+	pipelineDesc.primitive.frontFace = FrontFace::CCW;
+	pipelineDesc.primitive.cullMode = CullMode::None;
+	FragmentState fragmentState;
+	fragmentState.module = shaderModule;
+	fragmentState.entryPoint = "fs_main";
+	fragmentState.constantCount = 0;
+	fragmentState.constants = nullptr;
+	ColorTargetState colorTarget;
+	colorTarget.format = TARGET_FORMAT;
+	colorTarget.blend = nullptr;
+	colorTarget.writeMask = ColorWriteMask::All;
+	fragmentState.targetCount = 1;
+	fragmentState.targets = &colorTarget;
+	pipelineDesc.fragment = &fragmentState;
+	pipelineDesc.depthStencil = nullptr;
+	pipelineDesc.multisample.count = 1;
+	pipelineDesc.multisample.mask = ~0u;
+	pipelineDesc.multisample.alphaToCoverageEnabled = false;
+	RenderPipeline pipeline = device.createRenderPipeline(pipelineDesc);
+	shaderModule.release();
+	return pipeline;
+}
+
+struct Timings {
+	double encodeMs = 1e30;
+	double frameMs = 0.0;
+	RenderPassState::Stats stats;
+};
+
+// Time ITERATIONS frames, each waited for, whose single render pass is
+// recorded by `encode`. Encoding is timed on its own, and the frame until
+// the GPU is done.
+template <typename F>
+static Timings timeFrames(Device device, Queue queue, TextureView targetView, F&& encode) {
+	std::vector<double> encodeMs;
+	std::vector<double> frameMs;
+	RenderPassState::Stats stats;
+	// One extra frame to warm up
+	for (int iteration = 0; iteration <= ITERATIONS; ++iteration) {
+		auto start = std::chrono::steady_clock::now();
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+		RenderPassColorAttachment colorAttachment = {};
+		colorAttachment.view = targetView;
+		colorAttachment.resolveTarget = nullptr;
+		colorAttachment.loadOp = LoadOp::Clear;
+		colorAttachment.storeOp = StoreOp::Store;
+		colorAttachment.clearValue = Color{ 0.0, 0.0, 0.0, 1.0 };
+		RenderPassDescriptor renderPassDesc{};
+		renderPassDesc.colorAttachmentCount = 1;
+		renderPassDesc.colorAttachments = &colorAttachment;
+		renderPassDesc.depthStencilAttachment = nullptr;
+		renderPassDesc.timestampWriteCount = 0;
+		renderPassDesc.timestampWrites = nullptr;
+		RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+		stats = encode(renderPass);
+		renderPass.end();
+		renderPass.release();
+		CommandBufferDescriptor commandBufferDesc{};
+		CommandBuffer command = encoder.finish(commandBufferDesc);
+		encoder.release();
+		double encoded = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		queue.submit(1, &command);
+		command.release();
+		waitForGpu(device, queue);
+		if (iteration == 0) continue;
+		encodeMs.push_back(encoded);
+		frameMs.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(encodeMs.begin(), encodeMs.end());
+	std::sort(frameMs.begin(), frameMs.end());
+	return Timings{ encodeMs[encodeMs.size() / 2], frameMs[frameMs.size() / 2], stats };
+}
+
+static void report(const std::string& name, const Timings& timings) {
+	const RenderPassState::Stats& stats = timings.stats;
+	std::cout
+		<< std::left << std::setw(24) << name
+		<< std::right << std::setw(9) << std::fixed << std::setprecision(3) << timings.encodeMs << " ms encode"
+		<< std::setw(9) << timings.frameMs << " ms frame"
+		<< std::setw(7) << stats.pipelineChanges << " pipelines"
+		<< std::setw(7) << stats.bindGroupChanges << " bind groups"
+		<< std::setw(7) << stats.vertexBufferChanges << " vertex buffers"
+		<< std::setw(8) << stats.pipelineChangesElided + stats.bindGroupChangesElided + stats.vertexBufferChangesElided << " elided" << std::endl;
+}
+
+// Median of the times returned by `sort`, which sorts fresh unsorted keys
+// each time and times the sort alone
+template <typename F>
+static double timeSort(F&& sort) {
+	std::vector<double> sortMs;
+	for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
+		sortMs.push_back(sort());
+	}
+	std::sort(sortMs.begin(), sortMs.end());
+	return sortMs[sortMs.size() / 2];
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+
+	// No surface, everything is rendered offscreen
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	RequiredLimits requiredLimits = Default;
+	requiredLimits.limits.maxTextureDimension2D = TARGET_SIZE;
+	requiredLimits.limits.maxBindGroups = 1;
+	requiredLimits.limits.maxUniformBuffersPerShaderStage = 1;
+	requiredLimits.limits.maxUniformBufferBindingSize = 4 * sizeof(float);
+	requiredLimits.limits.maxVertexBuffers = 1;
+	requiredLimits.limits.maxVertexAttributes = 1;
+	requiredLimits.limits.maxVertexBufferArrayStride = 2 * sizeof(float);
+	requiredLimits.limits.maxBufferSize = 1024;
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredFeatures = nullptr;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+	BindGroupLayoutEntry colorBindingLayout = Default;
+	colorBindingLayout.binding = 0;
+	colorBindingLayout.visibility = ShaderStage::Fragment;
+	colorBindingLayout.buffer.type = BufferBindingType::Uniform;
+	colorBindingLayout.buffer.minBindingSize = 4 * sizeof(float);
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = 1;
+	bindGroupLayoutDesc.entries = &colorBindingLayout;
+	BindGroupLayout bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
+	PipelineLayoutDescriptor pipelineLayoutDesc{};
+	pipelineLayoutDesc.bindGroupLayoutCount = 1;
+	pipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
+	PipelineLayout pipelineLayout = device.createPipelineLayout(pipelineLayoutDesc);
+
+	std::vector<RenderPipeline> pipelines;
+	for (uint32_t i = 0; i < PIPELINE_COUNT; ++i) {
+		pipelines.push_back(createPipeline(device, pipelineLayout, i));
+	}
+
+	// One uniform buffer and one bind group per material
+	std::vector<Buffer> materialBuffers;
+	std::vector<BindGroup> materials;
+	for (uint32_t i = 0; i < MATERIAL_COUNT; ++i) {
+		BufferDescriptor bufferDesc;
+		bufferDesc.label = "Material";
+		bufferDesc.size = 4 * sizeof(float);
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+		bufferDesc.mappedAtCreation = false;
+		Buffer buffer = device.createBuffer(bufferDesc);
+		float color[4] = { (i % 4) / 3.0f, (i / 4 % 4) / 3.0f, (i / 16) / 3.0f, 1.0f };
+		queue.writeBuffer(buffer, 0, color, sizeof(color));
+		materialBuffers.push_back(buffer);
+
+		BindGroupEntry binding = Default;
+		binding.binding = 0;
+		binding.buffer = buffer;
+		binding.offset = 0;
+		binding.size = 4 * sizeof(float);
+		BindGroupDescriptor bindGroupDesc{};
+		bindGroupDesc.layout = bindGroupLayout;
+		bindGroupDesc.entryCount = 1;
+		bindGroupDesc.entries = &binding;
+		materials.push_back(device.createBindGroup(bindGroupDesc));
+	}
+
+	// Small triangles of different sizes
+	std::vector<Buffer> meshes;
+	for (uint32_t i = 0; i < MESH_COUNT; ++i) {
+		float size = 0.01f + 0.002f * i;
+		float positions[6] = { -size, -size, size, -size, 0.0f, size };
+		BufferDescriptor bufferDesc;
+		bufferDesc.label = "Mesh";
+		bufferDesc.size = sizeof(positions);
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
+		bufferDesc.mappedAtCreation = false;
+		Buffer buffer = device.createBuffer(bufferDesc);
+		queue.writeBuffer(buffer, 0, positions, sizeof(positions));
+		meshes.push_back(buffer);
+	}
+
+	// The draws, in the order a scene traversal would produce them. The
+	// mesh goes with the material, as a real object would have both.
+	std::mt19937 rng(42);
+	std::vector<DrawQueue::Draw> draws(DRAW_COUNT);
+	std::vector<uint64_t> keys(DRAW_COUNT);
+	for (uint32_t i = 0; i < DRAW_COUNT; ++i) {
+		uint32_t pipeline = rng() % PIPELINE_COUNT;
+		uint32_t material = rng() % MATERIAL_COUNT;
+		DrawQueue::Draw& draw = draws[i];
+		draw.pipeline = pipelines[pipeline];
+		draw.bindGroups[0].group = materials[material];
+		draw.vertexBuffers[0].buffer = meshes[material % MESH_COUNT];
+		draw.vertexBuffers[0].size = 6 * sizeof(float);
+		draw.vertexCount = 3;
+		draw.firstInstance = i;
+		keys[i] = DrawQueue::makeKey(0, pipeline, material, std::uniform_real_distribution<float>(0.0f, 1.0f)(rng));
+	}
+
+	TextureDescriptor targetDesc;
+	targetDesc.label = "Offscreen target";
+	targetDesc.usage = TextureUsage::RenderAttachment;
+	targetDesc.dimension = TextureDimension::_2D;
+	targetDesc.size = { TARGET_SIZE, TARGET_SIZE, 1 };
+	targetDesc.format = TARGET_FORMAT;
+	targetDesc.mipLevelCount = 1;
+	targetDesc.sampleCount = 1;
+	targetDesc.viewFormatCount = 0;
+	targetDesc.viewFormats = nullptr;
+	Texture target = device.createTexture(targetDesc);
+	TextureView targetView = target.createView();
+
+	ThreadPool pool;
+	std::cout << DRAW_COUNT << " draws, " << PIPELINE_COUNT << " pipelines, " << MATERIAL_COUNT << " materials, "
+		<< MESH_COUNT << " meshes, " << ITERATIONS << " frames each, threads: " << pool.threadCount() << std::endl;
+
+	report("unsorted, every state", timeFrames(device, queue, targetView, [&](RenderPassEncoder renderPass) {
+		RenderPassState::Stats stats;
+		for (const DrawQueue::Draw& draw : draws) {
+			renderPass.setPipeline(draw.pipeline);
+			renderPass.setBindGroup(0, draw.bindGroups[0].group, 0, nullptr);
+			renderPass.setVertexBuffer(0, draw.vertexBuffers[0].buffer, 0, draw.vertexBuffers[0].size);
+			renderPass.draw(draw.vertexCount, 1, 0, draw.firstInstance);
+		}
+		stats.draws = DRAW_COUNT;
+		stats.pipelineChanges = DRAW_COUNT;
+		stats.bindGroupChanges = DRAW_COUNT;
+		stats.vertexBufferChanges = DRAW_COUNT;
+		return stats;
+	}));
+	report("unsorted, elided", timeFrames(device, queue, targetView, [&](RenderPassEncoder renderPass) {
+		RenderPassState state(renderPass);
+		for (const DrawQueue::Draw& draw : draws) {
+			state.setPipeline(draw.pipeline);
+			state.setBindGroup(0, draw.bindGroups[0].group, 0, nullptr);
+			state.setVertexBuffer(0, draw.vertexBuffers[0].buffer, 0, draw.vertexBuffers[0].size);
+			state.draw(draw.vertexCount, 1, 0, draw.firstInstance);
+		}
+		return state.stats();
+	}));
+	// Adding and sorting the draws is part of the encoding time
+	DrawQueue drawQueue(&pool);
+	report("sorted, elided", timeFrames(device, queue, targetView, [&](RenderPassEncoder renderPass) {
+		drawQueue.clear();
+		for (uint32_t i = 0; i < DRAW_COUNT; ++i) {
+			drawQueue.add(keys[i], draws[i]);
+		}
+		drawQueue.sort();
+		drawQueue.submit(renderPass, 0);
+		return drawQueue.stats();
+	}));
+
+	// Sorting alone, on more draws than a frame typically has
+	for (uint32_t count : { DRAW_COUNT, 10 * DRAW_COUNT }) {
+		std::vector<uint64_t> sortKeys(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			sortKeys[i] = keys[i % DRAW_COUNT] ^ (uint64_t(rng()) & 0xFFFFFFFFu);
+		}
+		std::cout << std::left << std::setw(10) << count << std::right;
+		std::vector<std::pair<uint64_t, uint32_t>> pairs(count);
+		std::cout << std::setw(9) << std::setprecision(3) << timeSort([&]() {
+			for (uint32_t i = 0; i < count; ++i) pairs[i] = { sortKeys[i], i };
+			auto start = std::chrono::steady_clock::now();
+			std::sort(pairs.begin(), pairs.end());
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}) << " ms std::sort";
+		for (ThreadPool* sortPool : { (ThreadPool*)nullptr, &pool }) {
+			DrawQueue sortQueue(sortPool);
+			std::cout << std::setw(9) << timeSort([&]() {
+				sortQueue.clear();
+				for (uint32_t i = 0; i < count; ++i) sortQueue.add(sortKeys[i], draws[i % DRAW_COUNT]);
+				auto start = std::chrono::steady_clock::now();
+				sortQueue.sort();
+				return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			}) << " ms radix, " << (sortPool ? pool.threadCount() : 1) << " threads";
+		}
+		std::cout << std::endl;
+	}
+
+	targetView.release();
+	target.destroy();
+	target.release();
+	for (Buffer mesh : meshes) mesh.release();
+	for (BindGroup material : materials) material.release();
+	for (Buffer buffer : materialBuffers) buffer.release();
+	for (RenderPipeline pipeline : pipelines) pipeline.release();
+	pipelineLayout.release();
+	bindGroupLayout.release();
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return 0;
+}
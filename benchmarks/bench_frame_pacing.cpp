@@ -0,0 +1,185 @@
+// Compare the input-to-present latency and the CPU use of the main loop
+// with each present mode, with frames started as soon as possible and
+// paced by FramePacer. Each frame simulates some CPU work before clearing
+// the swap chain texture. Needs a GPU and a display, and present modes the
+// surface does not support are reported by the device as errors.
+
+#include "FramePacer.h"
+
+#include "webgpu/webgpu.hpp"
+
+#include <glfw3webgpu.h>
+#include <GLFW/glfw3.h>
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+using namespace wgpu;
+
+constexpr uint32_t WIDTH = 640;
+constexpr uint32_t HEIGHT = 480;
+// About 4 seconds at 60 Hz
+constexpr uint32_t FRAME_COUNT = 240;
+// CPU time spent by each frame between the input sample and the present
+constexpr double WORK_MS = 3.0;
+
+static void simulateWork() {
+	auto end = std::chrono::steady_clock::now() + std::chrono::duration<double, std::milli>(WORK_MS);
+	while (std::chrono::steady_clock::now() < end) {
+	}
+}
+
+static FramePacer::Stats runFrames(Device device, Queue queue, Surface surface, TextureFormat format, PresentMode mode, bool sleep) {
+	SwapChainDescriptor swapChainDesc = {};
+	swapChainDesc.width = WIDTH;
+	swapChainDesc.height = HEIGHT;
+	swapChainDesc.format = format;
+	swapChainDesc.usage = TextureUsage::RenderAttachment;
+	swapChainDesc.presentMode = mode;
+	SwapChain swapChain = device.createSwapChain(surface, swapChainDesc);
+
+	FramePacer::Settings settings;
+	settings.presentMode = mode;
+	settings.sleep = sleep;
+	settings.targetInterval = mode == PresentMode::Immediate ? 0.0 : FramePacer::displayInterval();
+	FramePacer pacer(settings);
+
+	for (uint32_t frame = 0; frame < FRAME_COUNT; ++frame) {
+		pacer.waitForNextFrame();
+		simulateWork();
+
+		TextureView view = swapChain.getCurrentTextureView();
+		if (!view) {
+			break;
+		}
+		RenderPassColorAttachment colorAttachment = {};
+		colorAttachment.view = view;
+		colorAttachment.resolveTarget = nullptr;
+		colorAttachment.loadOp = LoadOp::Clear;
+		colorAttachment.storeOp = StoreOp::Store;
+		// Flashes, to see that frames are presented
+		colorAttachment.clearValue = (frame / 30) % 2 ? Color{ 0.9, 0.9, 0.9, 1.0 } : Color{ 0.1, 0.1, 0.1, 1.0 };
+		RenderPassDescriptor renderPassDesc = {};
+		renderPassDesc.colorAttachmentCount = 1;
+		renderPassDesc.colorAttachments = &colorAttachment;
+		renderPassDesc.depthStencilAttachment = nullptr;
+		renderPassDesc.timestampWriteCount = 0;
+		renderPassDesc.timestampWrites = nullptr;
+
+		CommandEncoder encoder = device.createCommandEncoder(CommandEncoderDescriptor{});
+		RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+		renderPass.end();
+		renderPass.release();
+		CommandBuffer command = encoder.finish(CommandBufferDescriptor{});
+		queue.submit(1, &command);
+		command.release();
+		encoder.release();
+		view.release();
+
+		pacer.present(swapChain);
+#ifdef WEBGPU_BACKEND_DAWN
+		device.tick();
+#endif
+	}
+
+	FramePacer::Stats stats = pacer.stats();
+	swapChain.release();
+	return stats;
+}
+
+static void report(PresentMode mode, bool sleep, const FramePacer::Stats& stats) {
+	std::cout
+		<< std::left << std::setw(10) << FramePacer::presentModeName(mode)
+		<< std::setw(10) << (sleep ? "paced" : "not paced")
+		<< std::right << std::fixed << std::setprecision(2)
+		<< std::setw(8) << stats.averageIntervalMs << " ms/frame"
+		<< std::setw(8) << stats.averageLatencyMs << " ms avg"
+		<< std::setw(8) << stats.maxLatencyMs << " ms max"
+		<< std::setprecision(0)
+		<< std::setw(6) << stats.cpuBusyPercent << "% busy"
+		<< std::setw(6) << stats.idlePercent << "% idle" << std::endl;
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+
+	if (!glfwInit()) {
+		std::cerr << "Could not initialize GLFW!" << std::endl;
+		return 1;
+	}
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	GLFWwindow* window = glfwCreateWindow(WIDTH, HEIGHT, "Frame pacing", NULL, NULL);
+	if (!window) {
+		std::cerr << "Could not open window!" << std::endl;
+		glfwTerminate();
+		return 1;
+	}
+	Surface surface = glfwGetWGPUSurface(instance, window);
+	if (!surface) {
+		std::cerr << "No surface, a display is needed" << std::endl;
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		return 1;
+	}
+
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = surface;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredFeatures = nullptr;
+	deviceDesc.requiredLimits = nullptr;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+#if WEBGPU_BACKEND_DAWN
+	TextureFormat format = WGPUTextureFormat_BGRA8Unorm;
+#else
+	TextureFormat format = surface.getPreferredFormat(adapter);
+#endif
+
+	std::cout << FRAME_COUNT << " frames per run, " << WORK_MS << " ms of CPU work each, display refresh every "
+		<< std::setprecision(2) << 1000.0 * FramePacer::displayInterval() << " ms" << std::endl;
+	for (PresentMode mode : { PresentMode::Fifo, PresentMode::Mailbox, PresentMode::Immediate }) {
+		for (bool sleep : { false, true }) {
+			report(mode, sleep, runFrames(device, queue, surface, format, mode, sleep));
+		}
+	}
+
+	queue.release();
+	device.release();
+	adapter.release();
+	surface.release();
+	glfwDestroyWindow(window);
+	glfwTerminate();
+	instance.release();
+	return 0;
+}
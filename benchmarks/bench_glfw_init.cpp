@@ -0,0 +1,76 @@
+// Time glfwInit() and glfwTerminate(), which are on the cold start path of
+// the application, and glfwUpdateGamepadMappings() with the whole mapping
+// database that GLFW ships.
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The database of all platforms, as the application would load it from a
+// gamecontrollerdb.txt file
+#define GLFW_BUILD_WIN32_MAPPINGS
+#define GLFW_BUILD_COCOA_MAPPINGS
+#define GLFW_BUILD_LINUX_MAPPINGS
+#include "glfw/src/mappings.h"
+
+constexpr int ITERATIONS = 200;
+
+static double elapsedUs(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const std::string& name, std::vector<double>& us) {
+	std::sort(us.begin(), us.end());
+	std::cout
+		<< std::left << std::setw(28) << name
+		<< std::right << std::fixed << std::setprecision(1)
+		<< std::setw(10) << us[us.size() / 2] << " us"
+		<< std::setw(10) << us.front() << " us" << std::endl;
+}
+
+int main(int, char**) {
+	std::string database;
+	for (const char* mapping : _glfwDefaultMappings) {
+		database += mapping;
+		database += '\n';
+	}
+
+	// The first call also pays for loading the platform libraries
+	auto start = std::chrono::steady_clock::now();
+	if (!glfwInit()) {
+		std::cerr << "Could not initialize GLFW!" << std::endl;
+		return 1;
+	}
+	double firstInitUs = elapsedUs(start);
+	glfwTerminate();
+
+	std::vector<double> initUs, terminateUs, updateUs;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		start = std::chrono::steady_clock::now();
+		glfwInit();
+		initUs.push_back(elapsedUs(start));
+
+		start = std::chrono::steady_clock::now();
+		glfwUpdateGamepadMappings(database.c_str());
+		updateUs.push_back(elapsedUs(start));
+
+		start = std::chrono::steady_clock::now();
+		glfwTerminate();
+		terminateUs.push_back(elapsedUs(start));
+	}
+
+	std::cout << "First glfwInit: " << std::fixed << std::setprecision(1) << firstInitUs << " us" << std::endl;
+	std::cout << std::left << std::setw(28) << ""
+		<< std::right << std::setw(13) << "median" << std::setw(13) << "best" << std::endl;
+	report("glfwInit", initUs);
+	report("glfwUpdateGamepadMappings", updateUs);
+	report("glfwTerminate", terminateUs);
+	std::cout << "(" << std::size(_glfwDefaultMappings) << " mappings)" << std::endl;
+
+	return 0;
+}
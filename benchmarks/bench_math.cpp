@@ -0,0 +1,156 @@
+// Compare linmath.h's scalar matrix and quaternion functions with the SIMD
+// kernels of SimdMath.h on a million transforms, and check that both agree.
+
+#include "linmath_simd.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr size_t TRANSFORM_COUNT = 1000000;
+constexpr int ITERATIONS = 10;
+
+template <typename F>
+static double bestOfMs(F&& f) {
+	double best = 1e30;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+static vec4* asLinmath(Mat4& m) {
+	return reinterpret_cast<vec4*>(m.data());
+}
+
+// Largest difference relative to the magnitude of the expected values
+static float maxError(const float* a, const float* b, size_t count) {
+	float error = 0.0f;
+	for (size_t i = 0; i < count; ++i) {
+		error = std::max(error, std::abs(a[i] - b[i]) / std::max(1.0f, std::abs(b[i])));
+	}
+	return error;
+}
+
+static bool report(const std::string& name, double scalarMs, double simdMs, float error) {
+	bool ok = error < 1e-4f;
+	std::cout
+		<< std::left << std::setw(20) << name
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(10) << scalarMs << " ms"
+		<< std::setw(10) << simdMs << " ms"
+		<< std::setw(8) << std::setprecision(2) << scalarMs / simdMs << "x"
+		<< (ok ? "" : "   MISMATCH") << std::endl;
+	return ok;
+}
+
+int main(int, char**) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+
+	// Random, well conditioned TRS matrices and unit quaternions
+	std::vector<Mat4> local(TRANSFORM_COUNT);
+	std::vector<Quat> rotations(TRANSFORM_COUNT);
+	std::vector<Vec4> points(TRANSFORM_COUNT);
+	for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+		rotations[i] = quatNormalize(Quat{ unit(rng), unit(rng), unit(rng), unit(rng) });
+		Vec4 t = { 10 * unit(rng), 10 * unit(rng), 10 * unit(rng), 1.0f };
+		local[i] = mat4Compose(t, rotations[i], Vec4{ scale(rng), scale(rng), scale(rng), 0.0f });
+		points[i] = Vec4{ unit(rng), unit(rng), unit(rng), 1.0f };
+	}
+	Mat4 parent = mat4Compose(Vec4{ 1.0f, 2.0f, 3.0f, 1.0f }, quatFromAxisAngle(0.0f, 1.0f, 0.0f, 0.5f), Vec4{ 2.0f, 2.0f, 2.0f, 0.0f });
+
+	std::vector<Mat4> expected(TRANSFORM_COUNT), actual(TRANSFORM_COUNT);
+	std::vector<Vec4> expectedPoints(TRANSFORM_COUNT), actualPoints(TRANSFORM_COUNT);
+	std::vector<Quat> expectedQuats(TRANSFORM_COUNT), actualQuats(TRANSFORM_COUNT);
+	const size_t floatCount = 16 * TRANSFORM_COUNT;
+	bool allMatch = true;
+
+	std::cout << "Transforming " << TRANSFORM_COUNT << " matrices, SIMD: " << simdMathName() << std::endl;
+	std::cout << std::left << std::setw(20) << ""
+		<< std::right << std::setw(13) << "linmath" << std::setw(13) << "SIMD" << std::endl;
+
+	double scalarMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			linmath_scalar_mat4x4_mul(asLinmath(expected[i]), asLinmath(parent), asLinmath(local[i]));
+		}
+	});
+	double simdMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			actual[i] = mat4Mul(parent, local[i]);
+		}
+	});
+	allMatch &= report("mat4 mul", scalarMs, simdMs, maxError(actual[0].data(), expected[0].data(), floatCount));
+
+	scalarMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			linmath_scalar_mat4x4_invert(asLinmath(expected[i]), asLinmath(local[i]));
+		}
+	});
+	simdMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			mat4Inverse(local[i], actual[i]);
+		}
+	});
+	allMatch &= report("mat4 inverse", scalarMs, simdMs, maxError(actual[0].data(), expected[0].data(), floatCount));
+
+	scalarMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			linmath_scalar_mat4x4_mul_vec4(&expectedPoints[i].x, asLinmath(parent), &points[i].x);
+		}
+	});
+	simdMs = bestOfMs([&]() {
+		mat4TransformBatch(parent, points.data(), actualPoints.data(), TRANSFORM_COUNT);
+	});
+	allMatch &= report("point transform", scalarMs, simdMs, maxError(&actualPoints[0].x, &expectedPoints[0].x, 4 * TRANSFORM_COUNT));
+
+	Quat spin = quatFromAxisAngle(1.0f, 1.0f, 0.0f, 0.1f);
+	scalarMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			linmath_scalar_quat_mul(&expectedQuats[i].x, &spin.x, &rotations[i].x);
+		}
+	});
+	simdMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			actualQuats[i] = quatMul(spin, rotations[i]);
+		}
+	});
+	allMatch &= report("quat mul", scalarMs, simdMs, maxError(&actualQuats[0].x, &expectedQuats[0].x, 4 * TRANSFORM_COUNT));
+
+	scalarMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			linmath_scalar_quat_mul_vec3(&expectedPoints[i].x, &rotations[i].x, &points[i].x);
+		}
+	});
+	simdMs = bestOfMs([&]() {
+		for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+			quatRotateRaw(&actualPoints[i].x, &rotations[i].x, &points[i].x);
+		}
+	});
+	// linmath's quat_mul_vec3 computes cross products in place, which reads
+	// already overwritten components, so check against the rotation matrix.
+	for (size_t i = 0; i < TRANSFORM_COUNT; ++i) {
+		expectedPoints[i] = mat4MulVec4(quatToMat4(rotations[i]), points[i]);
+	}
+	allMatch &= report("quat rotate", scalarMs, simdMs, maxError(&actualPoints[0].x, &expectedPoints[0].x, 4 * TRANSFORM_COUNT));
+
+	// The shim must route linmath calls to the SIMD kernels with the same results
+	mat4x4 shimResult;
+	mat4x4_mul(shimResult, asLinmath(parent), asLinmath(local[0]));
+	linmath_scalar_mat4x4_mul(asLinmath(expected[0]), asLinmath(parent), asLinmath(local[0]));
+	if (maxError(shimResult[0], expected[0].data(), 16) >= 1e-4f) {
+		std::cerr << "The linmath shim does not match the scalar linmath" << std::endl;
+		allMatch = false;
+	}
+
+	return allMatch ? 0 : 1;
+}
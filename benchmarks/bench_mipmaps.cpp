@@ -0,0 +1,257 @@
+// Compare building the sRGB-correct mip chains of a set of textures level
+// by level on the CPU with generating them on the GPU, and check that both
+// give the same texels. Needs a GPU.
+
+#include "MipmapGenerator.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr uint32_t TEXTURE_COUNT = 8;
+constexpr uint32_t TEXTURE_SIZE = 2048;
+// Level read back to compare the GPU and CPU results
+constexpr uint32_t CHECKED_LEVEL = 3;
+
+using Image = std::vector<uint8_t>;
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+static float srgbToLinear(float c) {
+	return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linearToSrgb8(float c) {
+	float s = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+	return static_cast<uint8_t>(std::clamp(s, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// What the GPU path replaces: each level is computed from the previous
+// one, in linear space, then stored back as sRGB
+static std::vector<Image> cpuMipChain(const Image& level0, uint32_t size) {
+	float toLinear[256];
+	for (int i = 0; i < 256; ++i) {
+		toLinear[i] = srgbToLinear(i / 255.0f);
+	}
+	std::vector<Image> levels = { level0 };
+	for (uint32_t sourceSize = size; sourceSize > 1; sourceSize /= 2) {
+		const Image& source = levels.back();
+		uint32_t levelSize = sourceSize / 2;
+		Image level(4 * levelSize * levelSize);
+		for (uint32_t y = 0; y < levelSize; ++y) {
+			for (uint32_t x = 0; x < levelSize; ++x) {
+				const uint8_t* s = &source[4 * (2 * y * sourceSize + 2 * x)];
+				const uint8_t* below = s + 4 * sourceSize;
+				uint8_t* d = &level[4 * (y * levelSize + x)];
+				for (int c = 0; c < 3; ++c) {
+					d[c] = linearToSrgb8(0.25f * (toLinear[s[c]] + toLinear[s[4 + c]] + toLinear[below[c]] + toLinear[below[4 + c]]));
+				}
+				d[3] = static_cast<uint8_t>((s[3] + s[7] + below[3] + below[7] + 2) / 4);
+			}
+		}
+		levels.push_back(std::move(level));
+	}
+	return levels;
+}
+
+int main(int, char**) {
+	// Noise over gradients, so that every level differs
+	std::mt19937 rng(42);
+	std::vector<Image> images(TEXTURE_COUNT, Image(4 * TEXTURE_SIZE * TEXTURE_SIZE));
+	for (uint32_t t = 0; t < TEXTURE_COUNT; ++t) {
+		for (uint32_t y = 0; y < TEXTURE_SIZE; ++y) {
+			for (uint32_t x = 0; x < TEXTURE_SIZE; ++x) {
+				uint8_t* texel = &images[t][4 * (y * TEXTURE_SIZE + x)];
+				texel[0] = static_cast<uint8_t>((x * 255 / TEXTURE_SIZE + rng() % 32) & 0xff);
+				texel[1] = static_cast<uint8_t>((y * 255 / TEXTURE_SIZE + rng() % 32) & 0xff);
+				texel[2] = static_cast<uint8_t>(rng() & 0xff);
+				texel[3] = 255;
+			}
+		}
+	}
+
+	std::cout << TEXTURE_COUNT << " textures of " << TEXTURE_SIZE << "x" << TEXTURE_SIZE << ", sRGB" << std::endl;
+
+	auto cpuStart = std::chrono::steady_clock::now();
+	std::vector<std::vector<Image>> cpuChains;
+	for (const Image& image : images) {
+		cpuChains.push_back(cpuMipChain(image, TEXTURE_SIZE));
+	}
+	double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cpuStart).count();
+	std::cout << std::left << std::setw(24) << "CPU, level by level"
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(3) << cpuMs << " ms" << std::endl;
+
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	uint32_t checkedSize = TEXTURE_SIZE >> CHECKED_LEVEL;
+	uint64_t readbackSize = 4ull * checkedSize * checkedSize;
+	RequiredLimits requiredLimits = Default;
+	MipmapGenerator::requireLimits(requiredLimits.limits, TEXTURE_SIZE);
+	requiredLimits.limits.maxBufferSize = readbackSize;
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+	MipmapGenerator generator(device);
+
+	// Only level 0 is uploaded
+	std::vector<Texture> textures;
+	for (const Image& image : images) {
+		TextureDescriptor textureDesc;
+		textureDesc.label = "Benchmark texture";
+		textureDesc.usage = TextureUsage::TextureBinding | TextureUsage::StorageBinding | TextureUsage::CopyDst | TextureUsage::CopySrc;
+		textureDesc.dimension = TextureDimension::_2D;
+		textureDesc.size = { TEXTURE_SIZE, TEXTURE_SIZE, 1 };
+		textureDesc.format = TextureFormat::RGBA8Unorm;
+		textureDesc.mipLevelCount = MipmapGenerator::mipLevelCount(TEXTURE_SIZE, TEXTURE_SIZE);
+		textureDesc.sampleCount = 1;
+		textureDesc.viewFormatCount = 0;
+		textureDesc.viewFormats = nullptr;
+		Texture texture = device.createTexture(textureDesc);
+
+		ImageCopyTexture destination;
+		destination.texture = texture;
+		destination.mipLevel = 0;
+		destination.origin = { 0, 0, 0 };
+		destination.aspect = TextureAspect::All;
+		TextureDataLayout source;
+		source.offset = 0;
+		source.bytesPerRow = 4 * TEXTURE_SIZE;
+		source.rowsPerImage = TEXTURE_SIZE;
+		queue.writeTexture(destination, image.data(), image.size(), source, { TEXTURE_SIZE, TEXTURE_SIZE, 1 });
+		textures.push_back(texture);
+	}
+	waitForGpu(device, queue);
+
+	// The first generation also creates the pipeline, so measure the second
+	double gpuMs = 0.0;
+	for (int run = 0; run < 2; ++run) {
+		auto gpuStart = std::chrono::steady_clock::now();
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+		for (Texture texture : textures) {
+			generator.generate(queue, encoder, texture, true);
+		}
+		CommandBufferDescriptor commandBufferDesc{};
+		CommandBuffer command = encoder.finish(commandBufferDesc);
+		encoder.release();
+		queue.submit(1, &command);
+		command.release();
+		waitForGpu(device, queue);
+		gpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - gpuStart).count();
+	}
+	std::cout << std::left << std::setw(24) << "GPU, compute"
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(3) << gpuMs << " ms"
+		<< std::setw(10) << std::setprecision(1) << cpuMs / gpuMs << "x" << std::endl;
+
+	// Read back a level of the first texture
+	BufferDescriptor readbackDesc;
+	readbackDesc.label = "Readback";
+	readbackDesc.size = readbackSize;
+	readbackDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+	readbackDesc.mappedAtCreation = false;
+	Buffer readback = device.createBuffer(readbackDesc);
+	CommandEncoderDescriptor encoderDesc{};
+	CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+	ImageCopyTexture source;
+	source.texture = textures[0];
+	source.mipLevel = CHECKED_LEVEL;
+	source.origin = { 0, 0, 0 };
+	source.aspect = TextureAspect::All;
+	ImageCopyBuffer destination;
+	destination.buffer = readback;
+	destination.layout.offset = 0;
+	destination.layout.bytesPerRow = 4 * checkedSize;
+	destination.layout.rowsPerImage = checkedSize;
+	encoder.copyTextureToBuffer(source, destination, { checkedSize, checkedSize, 1 });
+	CommandBufferDescriptor commandBufferDesc{};
+	CommandBuffer command = encoder.finish(commandBufferDesc);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+
+	bool mapped = false;
+	auto mapCallback = readback.mapAsync(MapMode::Read, 0, readbackSize, [&mapped](BufferMapAsyncStatus) { mapped = true; });
+	while (!mapped) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+	const uint8_t* gpuTexels = static_cast<const uint8_t*>(readback.getConstMappedRange(0, readbackSize));
+	const Image& cpuTexels = cpuChains[0][CHECKED_LEVEL];
+	int maxDifference = 0;
+	for (uint64_t i = 0; i < readbackSize; ++i) {
+		maxDifference = std::max(maxDifference, std::abs(int(gpuTexels[i]) - int(cpuTexels[i])));
+	}
+	readback.unmap();
+	// The GPU keeps the intermediate levels of a dispatch in floating
+	// point, so it may differ from the CPU by a few units of rounding.
+	std::cout << "Level " << CHECKED_LEVEL << ": max difference with the CPU " << maxDifference << "/255"
+		<< (maxDifference <= 3 ? "" : " (MISMATCH)") << std::endl;
+
+	readback.destroy();
+	readback.release();
+	for (Texture texture : textures) {
+		texture.destroy();
+		texture.release();
+	}
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return maxDifference <= 3 ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+// Time the frames of the GPU particle system, once the pool of 256K to 4M
+// particles has filled: the compute update alone, then the update and the
+// indirect draw of the particles into a 1280x720 target. Checks that every
+// particle is either alive or free, as counted by the GPU. Capacities the
+// adapter does not allow are skipped. Needs a GPU.
+
+#include "ParticleSystem.h"
+#include "UniformAllocator.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr int ITERATIONS = 30;
+constexpr uint32_t CAPACITIES[] = { 256 * 1024, 1024 * 1024, 4 * 1024 * 1024 };
+constexpr uint32_t WIDTH = 1280;
+constexpr uint32_t HEIGHT = 720;
+constexpr float DELTA_TIME = 1.0f / 60.0f;
+// Frames simulated before timing, the lifetime of a particle at 60 fps,
+// after which the pool is about full
+constexpr int WARMUP_FRAMES = 120;
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+static Buffer createBuffer(Device device, const char* label, uint64_t size, WGPUBufferUsageFlags usage) {
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = label;
+	bufferDesc.size = size;
+	bufferDesc.usage = usage;
+	bufferDesc.mappedAtCreation = false;
+	return device.createBuffer(bufferDesc);
+}
+
+static Texture createTarget(Device device, TextureFormat format) {
+	TextureDescriptor textureDesc;
+	textureDesc.dimension = TextureDimension::_2D;
+	textureDesc.format = format;
+	textureDesc.size = { WIDTH, HEIGHT, 1 };
+	textureDesc.mipLevelCount = 1;
+	textureDesc.sampleCount = 1;
+	textureDesc.usage = TextureUsage::RenderAttachment;
+	textureDesc.viewFormatCount = 0;
+	textureDesc.viewFormats = nullptr;
+	return device.createTexture(textureDesc);
+}
+
+static void submit(Queue queue, CommandEncoder encoder) {
+	CommandBufferDescriptor commandBufferDesc{};
+	CommandBuffer command = encoder.finish(commandBufferDesc);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+}
+
+static std::vector<uint32_t> readBuffer(Device device, Queue queue, Buffer buffer, uint32_t count) {
+	uint64_t size = count * sizeof(uint32_t);
+	Buffer readback = createBuffer(device, "Readback", size, BufferUsage::CopyDst | BufferUsage::MapRead);
+	CommandEncoderDescriptor encoderDesc{};
+	CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+	encoder.copyBufferToBuffer(buffer, 0, readback, 0, size);
+	submit(queue, encoder);
+
+	bool mapped = false;
+	auto mapCallback = readback.mapAsync(MapMode::Read, 0, size, [&mapped](BufferMapAsyncStatus) { mapped = true; });
+	while (!mapped) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+	std::vector<uint32_t> data(count);
+	std::memcpy(data.data(), readback.getConstMappedRange(0, size), size);
+	readback.unmap();
+	readback.destroy();
+	readback.release();
+	return data;
+}
+
+// Median time of ITERATIONS frames of what `encode` records, each waited
+// for before the next
+template <typename F>
+static double timeFrames(Device device, Queue queue, F&& encode) {
+	std::vector<double> ms;
+	for (int iteration = 0; iteration < ITERATIONS; ++iteration) {
+		auto start = std::chrono::steady_clock::now();
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+		encode(encoder);
+		submit(queue, encoder);
+		waitForGpu(device, queue);
+		ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(ms.begin(), ms.end());
+	return ms[ms.size() / 2];
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	// The largest capacity whose buffers the adapter allows
+	uint64_t maxBytes = std::min(supportedLimits.limits.maxStorageBufferBindingSize, supportedLimits.limits.maxBufferSize);
+	uint32_t maxCapacity = 0;
+	for (uint32_t capacity : CAPACITIES) {
+		if (capacity * 32ull <= maxBytes) maxCapacity = capacity;
+	}
+	RequiredLimits requiredLimits = Default;
+	ParticleSystem::requireLimits(requiredLimits.limits, maxCapacity);
+	UniformAllocator::requireLimits(requiredLimits.limits, 16 * sizeof(float));
+	requiredLimits.limits.maxTextureDimension2D = std::max(WIDTH, HEIGHT);
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+
+	// Offscreen targets, as the app would render into
+	TextureFormat colorFormat = TextureFormat::RGBA8Unorm;
+	TextureFormat depthFormat = TextureFormat::Depth24Plus;
+	Texture colorTarget = createTarget(device, colorFormat);
+	Texture depthTarget = createTarget(device, depthFormat);
+	TextureView colorView = colorTarget.createView();
+	TextureView depthView = depthTarget.createView();
+
+	// The camera sees the region of [-4, 4] vertically around the emitter,
+	// which sits at the origin
+	BindGroupLayoutEntry cameraEntry = UniformAllocator::layoutEntry(0, ShaderStage::Vertex, 16 * sizeof(float));
+	BindGroupLayoutDescriptor cameraLayoutDesc{};
+	cameraLayoutDesc.entryCount = 1;
+	cameraLayoutDesc.entries = &cameraEntry;
+	BindGroupLayout cameraLayout = device.createBindGroupLayout(cameraLayoutDesc);
+	float viewProj[16] = {};
+	viewProj[0] = 0.25f * HEIGHT / WIDTH;
+	viewProj[5] = 0.25f;
+	viewProj[10] = -0.5f;
+	viewProj[14] = 0.5f;
+	viewProj[15] = 1.0f;
+	Buffer cameraBuffer = createBuffer(device, "Camera", sizeof(viewProj), BufferUsage::CopyDst | BufferUsage::Uniform);
+	queue.writeBuffer(cameraBuffer, 0, viewProj, sizeof(viewProj));
+	BindGroupEntry cameraBinding{};
+	cameraBinding.binding = 0;
+	cameraBinding.buffer = cameraBuffer;
+	cameraBinding.offset = 0;
+	cameraBinding.size = sizeof(viewProj);
+	BindGroupDescriptor cameraBindGroupDesc{};
+	cameraBindGroupDesc.layout = cameraLayout;
+	cameraBindGroupDesc.entryCount = 1;
+	cameraBindGroupDesc.entries = &cameraBinding;
+	BindGroup cameraBindGroup = device.createBindGroup(cameraBindGroupDesc);
+
+	auto draw = [&](CommandEncoder encoder, ParticleSystem& particles) {
+		RenderPassColorAttachment colorAttachment{};
+		colorAttachment.view = colorView;
+		colorAttachment.resolveTarget = nullptr;
+		colorAttachment.loadOp = LoadOp::Clear;
+		colorAttachment.storeOp = StoreOp::Store;
+		colorAttachment.clearValue = Color{ 0.0, 0.0, 0.0, 1.0 };
+		RenderPassDepthStencilAttachment depthAttachment{};
+		depthAttachment.view = depthView;
+		depthAttachment.depthClearValue = 1.0f;
+		depthAttachment.depthLoadOp = LoadOp::Clear;
+		depthAttachment.depthStoreOp = StoreOp::Store;
+		depthAttachment.depthReadOnly = false;
+#ifdef WEBGPU_BACKEND_WGPU
+		depthAttachment.stencilLoadOp = LoadOp::Clear;
+		depthAttachment.stencilStoreOp = StoreOp::Store;
+#else
+		depthAttachment.stencilLoadOp = LoadOp::Undefined;
+		depthAttachment.stencilStoreOp = StoreOp::Undefined;
+#endif
+		depthAttachment.stencilReadOnly = true;
+		RenderPassDescriptor renderPassDesc{};
+		renderPassDesc.colorAttachmentCount = 1;
+		renderPassDesc.colorAttachments = &colorAttachment;
+		renderPassDesc.depthStencilAttachment = &depthAttachment;
+		RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+		uint32_t cameraOffset = 0;
+		renderPass.setBindGroup(0, cameraBindGroup, 1, &cameraOffset);
+		particles.draw(renderPass);
+		renderPass.end();
+		renderPass.release();
+	};
+
+	std::cout << std::left << std::setw(12) << "particles"
+		<< std::right << std::setw(12) << "alive"
+		<< std::setw(12) << "update ms"
+		<< std::setw(12) << "+draw ms"
+		<< std::setw(14) << "Mparticles/s" << std::endl;
+
+	bool allCorrect = true;
+	for (uint32_t capacity : CAPACITIES) {
+		if (capacity > maxCapacity) {
+			std::cout << std::left << std::setw(24) << capacity << "skipped, larger than the adapter allows" << std::endl;
+			continue;
+		}
+		ParticleSystem::Settings settings;
+		settings.capacity = capacity;
+		settings.emitRate = capacity / settings.lifetime;
+		ParticleSystem particles(device, settings, colorFormat, 1, depthFormat, cameraLayout);
+
+		for (int frame = 0; frame < WARMUP_FRAMES; ++frame) {
+			CommandEncoderDescriptor encoderDesc{};
+			CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+			particles.update(queue, encoder, DELTA_TIME);
+			submit(queue, encoder);
+		}
+		waitForGpu(device, queue);
+
+		double updateMs = timeFrames(device, queue, [&](CommandEncoder encoder) {
+			particles.update(queue, encoder, DELTA_TIME);
+		});
+		double frameMs = timeFrames(device, queue, [&](CommandEncoder encoder) {
+			particles.update(queue, encoder, DELTA_TIME);
+			draw(encoder, particles);
+		});
+
+		// Particles are never lost nor duplicated
+		uint32_t alive = readBuffer(device, queue, particles.drawArgsBuffer(), 4)[1];
+		int32_t free = static_cast<int32_t>(readBuffer(device, queue, particles.counterBuffer(), 1)[0]);
+		bool correct = free >= 0 && alive + static_cast<uint32_t>(free) == capacity;
+		allCorrect = allCorrect && correct;
+
+		std::cout << std::left << std::setw(12) << capacity
+			<< std::right << std::setw(12) << alive
+			<< std::setw(12) << std::fixed << std::setprecision(3) << updateMs
+			<< std::setw(12) << frameMs
+			<< std::setw(14) << std::setprecision(1) << alive / (frameMs * 1e3)
+			<< "  " << (correct ? "ok" : "MISMATCH") << std::endl;
+	}
+
+	cameraBindGroup.release();
+	cameraBuffer.destroy();
+	cameraBuffer.release();
+	cameraLayout.release();
+	colorView.release();
+	depthView.release();
+	colorTarget.destroy();
+	colorTarget.release();
+	depthTarget.destroy();
+	depthTarget.release();
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+// Compare the PNG encoding throughput of stb_image_write with PngWriter at
+// each compression level, on one and on all cores, for a 4K RGBA frame.
+
+#include "PngWriter.h"
+#include "ThreadPool.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+constexpr int WIDTH = 3840;
+constexpr int HEIGHT = 2160;
+constexpr int ITERATIONS = 3;
+
+template <typename F>
+static double bestOfMs(F&& f) {
+	double best = 1e30;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+static void report(const std::string& name, double ms, size_t size) {
+	double rawSize = 4.0 * WIDTH * HEIGHT;
+	std::cout
+		<< std::left << std::setw(28) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(1) << ms << " ms"
+		<< std::setw(10) << rawSize / ms / 1000.0 << " MB/s"
+		<< std::setw(10) << std::setprecision(2) << size / 1e6 << " MB"
+		<< std::setw(8) << std::setprecision(1) << 100.0 * size / rawSize << "%" << std::endl;
+}
+
+int main(int, char**) {
+	// Something like a rendered frame: shaded shapes over a gradient, with a
+	// little dithering noise
+	std::mt19937 rng(42);
+	std::vector<uint8_t> frame(4 * WIDTH * HEIGHT);
+	for (int y = 0; y < HEIGHT; ++y) {
+		for (int x = 0; x < WIDTH; ++x) {
+			float u = float(x) / WIDTH, v = float(y) / HEIGHT;
+			float shade = 0.5f + 0.5f * std::sin(20.0f * u) * std::cos(14.0f * v);
+			bool inShape = ((x / 240) + (y / 180)) % 3 == 0;
+			int noise = static_cast<int>(rng() % 3) - 1;
+			uint8_t* pixel = &frame[4 * (y * WIDTH + x)];
+			pixel[0] = static_cast<uint8_t>(std::clamp(int(inShape ? 220.0f * shade : 60.0f + 80.0f * u) + noise, 0, 255));
+			pixel[1] = static_cast<uint8_t>(std::clamp(int(inShape ? 120.0f * shade : 80.0f + 60.0f * v) + noise, 0, 255));
+			pixel[2] = static_cast<uint8_t>(std::clamp(int(inShape ? 40.0f : 160.0f - 100.0f * v) + noise, 0, 255));
+			pixel[3] = 255;
+		}
+	}
+
+	ThreadPool pool;
+	std::cout << "Encoding a " << WIDTH << "x" << HEIGHT << " RGBA frame, SIMD: " << PngWriter::simdName()
+		<< ", threads: " << pool.threadCount() << std::endl;
+
+	size_t stbSize = 0;
+	double stbMs = bestOfMs([&]() {
+		int length = 0;
+		unsigned char* png = stbi_write_png_to_mem(frame.data(), 4 * WIDTH, WIDTH, HEIGHT, 4, &length);
+		stbSize = static_cast<size_t>(length);
+		STBIW_FREE(png);
+	});
+	report("stb_image_write", stbMs, stbSize);
+
+	struct Config {
+		std::string name;
+		PngWriter::Compression compression;
+	};
+	const std::vector<Config> configs = {
+		{ "none", PngWriter::Compression::None },
+		{ "fast", PngWriter::Compression::Fast },
+		{ "default", PngWriter::Compression::Default },
+	};
+	for (const Config& config : configs) {
+		for (ThreadPool* threadPool : { static_cast<ThreadPool*>(nullptr), &pool }) {
+			PngWriter writer(threadPool, config.compression);
+			size_t size = 0;
+			double ms = bestOfMs([&]() { size = writer.encode(WIDTH, HEIGHT, 4, frame.data(), 0).size(); });
+			uint32_t threadCount = threadPool ? threadPool->threadCount() : 1;
+			report("PngWriter " + config.name + ", " + std::to_string(threadCount) + (threadCount > 1 ? " threads" : " thread"), ms, size);
+		}
+	}
+	return 0;
+}
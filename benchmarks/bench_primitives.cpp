@@ -0,0 +1,285 @@
+// Time the GPU primitives (scan, reduce, key/value radix sort and stream
+// compaction) on arrays of 1K to 100M elements, reporting the bandwidth
+// they reach and the elements they process per second, and check their
+// results against a CPU reference. Sizes whose buffers the adapter does not
+// allow are skipped. Needs a GPU.
+
+#include "GpuPrimitives.h"
+
+#include "webgpu/webgpu.hpp"
+
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace wgpu;
+
+constexpr int ITERATIONS = 10;
+constexpr uint32_t SIZES[] = { 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+
+static void waitForGpu(Device device, Queue queue) {
+	bool done = false;
+	auto callback = queue.onSubmittedWorkDone([&done](QueueWorkDoneStatus) { done = true; });
+	while (!done) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+}
+
+static Buffer createBuffer(Device device, const char* label, uint64_t size, WGPUBufferUsageFlags usage) {
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = label;
+	bufferDesc.size = size;
+	bufferDesc.usage = usage;
+	bufferDesc.mappedAtCreation = false;
+	return device.createBuffer(bufferDesc);
+}
+
+static void submit(Queue queue, CommandEncoder encoder) {
+	CommandBufferDescriptor commandBufferDesc{};
+	CommandBuffer command = encoder.finish(commandBufferDesc);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+}
+
+static std::vector<uint32_t> readBuffer(Device device, Queue queue, Buffer buffer, uint32_t count) {
+	uint64_t size = count * sizeof(uint32_t);
+	Buffer readback = createBuffer(device, "Readback", size, BufferUsage::CopyDst | BufferUsage::MapRead);
+	CommandEncoderDescriptor encoderDesc{};
+	CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+	encoder.copyBufferToBuffer(buffer, 0, readback, 0, size);
+	submit(queue, encoder);
+
+	bool mapped = false;
+	auto mapCallback = readback.mapAsync(MapMode::Read, 0, size, [&mapped](BufferMapAsyncStatus) { mapped = true; });
+	while (!mapped) {
+#ifdef WEBGPU_BACKEND_WGPU
+		wgpuDevicePoll(device, true, nullptr);
+#else
+		device.tick();
+#endif
+	}
+	std::vector<uint32_t> data(count);
+	std::memcpy(data.data(), readback.getConstMappedRange(0, size), size);
+	readback.unmap();
+	readback.destroy();
+	readback.release();
+	return data;
+}
+
+// Median time of ITERATIONS submissions of what `encode` records, after
+// one to warm up
+template <typename F>
+static double timeGpu(Device device, Queue queue, F&& encode) {
+	std::vector<double> ms;
+	for (int iteration = 0; iteration <= ITERATIONS; ++iteration) {
+		auto start = std::chrono::steady_clock::now();
+		CommandEncoderDescriptor encoderDesc{};
+		CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+		encode(encoder);
+		submit(queue, encoder);
+		waitForGpu(device, queue);
+		if (iteration == 0) continue;
+		ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::sort(ms.begin(), ms.end());
+	return ms[ms.size() / 2];
+}
+
+// `bytes` is the least traffic the primitive needs, i.e. reading its input
+// and writing its output once
+static void report(const char* name, uint32_t count, double ms, double bytes, bool correct) {
+	std::cout << std::left << std::setw(12) << name
+		<< std::right << std::setw(12) << count
+		<< std::setw(10) << std::fixed << std::setprecision(3) << ms;
+	if (bytes > 0) {
+		std::cout << std::setw(10) << std::setprecision(1) << bytes / (ms * 1e6);
+	} else {
+		std::cout << std::setw(10) << "-";
+	}
+	std::cout << std::setw(12) << std::setprecision(1) << count / (ms * 1e3)
+		<< "  " << (correct ? "ok" : "MISMATCH") << std::endl;
+}
+
+int main(int, char**) {
+	InstanceDescriptor instanceDesc{};
+	Instance instance = createInstance(instanceDesc);
+	if (!instance) {
+		std::cerr << "Could not initialize WebGPU!" << std::endl;
+		return 1;
+	}
+	RequestAdapterOptions adapterOpts{};
+	adapterOpts.compatibleSurface = nullptr;
+	Adapter adapter = instance.requestAdapter(adapterOpts);
+	if (!adapter) {
+		std::cerr << "No adapter available" << std::endl;
+		return 1;
+	}
+	SupportedLimits supportedLimits;
+	adapter.getLimits(&supportedLimits);
+
+	// The largest size whose arrays the adapter allows
+	uint64_t maxBytes = std::min(supportedLimits.limits.maxStorageBufferBindingSize, supportedLimits.limits.maxBufferSize);
+	uint32_t maxCount = 0;
+	for (uint32_t count : SIZES) {
+		if (count * sizeof(uint32_t) <= maxBytes) maxCount = count;
+	}
+	RequiredLimits requiredLimits = Default;
+	GpuPrimitives::requireLimits(requiredLimits.limits, maxCount);
+	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
+	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
+	DeviceDescriptor deviceDesc{};
+	deviceDesc.label = "Benchmark device";
+	deviceDesc.requiredFeaturesCount = 0;
+	deviceDesc.requiredLimits = &requiredLimits;
+	deviceDesc.defaultQueue.label = "Benchmark queue";
+	Device device = adapter.requestDevice(deviceDesc);
+	if (!device) {
+		std::cerr << "Could not create the device" << std::endl;
+		return 1;
+	}
+	auto onDeviceError = [](ErrorType type, char const* message) {
+		std::cerr << "Uncaptured device error: type " << type;
+		if (message) std::cerr << " (" << message << ")";
+		std::cerr << std::endl;
+	};
+	device.setUncapturedErrorCallback(onDeviceError);
+	Queue queue = device.getQueue();
+	GpuPrimitives primitives(device);
+
+	std::cout << std::left << std::setw(12) << "primitive"
+		<< std::right << std::setw(12) << "elements"
+		<< std::setw(10) << "ms"
+		<< std::setw(10) << "GB/s"
+		<< std::setw(12) << "Melem/s" << std::endl;
+
+	bool allCorrect = true;
+	std::mt19937 rng(42);
+	for (uint32_t count : SIZES) {
+		if (count > maxCount) {
+			std::cout << std::left << std::setw(24) << count << "skipped, larger than the adapter allows" << std::endl;
+			continue;
+		}
+		uint64_t size = count * sizeof(uint32_t);
+		std::vector<uint32_t> data(count), keys(count), flags(count), indices(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			data[i] = rng();
+			keys[i] = rng();
+			flags[i] = rng() & 1;
+		}
+		std::iota(indices.begin(), indices.end(), 0);
+
+		WGPUBufferUsageFlags usage = BufferUsage::Storage | BufferUsage::CopySrc | BufferUsage::CopyDst;
+		Buffer dataBuffer = createBuffer(device, "Data", size, usage);
+		Buffer outputBuffer = createBuffer(device, "Output", size, usage);
+		Buffer flagsBuffer = createBuffer(device, "Flags", size, usage);
+		Buffer keysBuffer = createBuffer(device, "Keys", size, usage);
+		Buffer valuesBuffer = createBuffer(device, "Values", size, usage);
+		// Sorting is in place, so each run starts again from these
+		Buffer unsortedKeysBuffer = createBuffer(device, "Unsorted keys", size, usage);
+		Buffer unsortedValuesBuffer = createBuffer(device, "Unsorted values", size, usage);
+		Buffer resultsBuffer = createBuffer(device, "Results", 4 * sizeof(uint32_t), usage);
+		queue.writeBuffer(dataBuffer, 0, data.data(), size);
+		queue.writeBuffer(flagsBuffer, 0, flags.data(), size);
+		queue.writeBuffer(unsortedKeysBuffer, 0, keys.data(), size);
+		queue.writeBuffer(unsortedValuesBuffer, 0, indices.data(), size);
+		waitForGpu(device, queue);
+
+		// Scan
+		double ms = timeGpu(device, queue, [&](CommandEncoder encoder) {
+			primitives.exclusiveScan(encoder, dataBuffer, outputBuffer, count);
+		});
+		std::vector<uint32_t> expected(count);
+		uint32_t sum = 0;
+		for (uint32_t i = 0; i < count; ++i) {
+			expected[i] = sum;
+			sum += data[i];
+		}
+		bool correct = readBuffer(device, queue, outputBuffer, count) == expected;
+		report("scan", count, ms, 2.0 * size, correct);
+		allCorrect = allCorrect && correct;
+
+		// Reduce, timing the sum only
+		ms = timeGpu(device, queue, [&](CommandEncoder encoder) {
+			primitives.reduce(encoder, GpuPrimitives::ReduceOp::Sum, dataBuffer, count, resultsBuffer, 0);
+		});
+		{
+			CommandEncoderDescriptor encoderDesc{};
+			CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+			primitives.reduce(encoder, GpuPrimitives::ReduceOp::Min, dataBuffer, count, resultsBuffer, sizeof(uint32_t));
+			primitives.reduce(encoder, GpuPrimitives::ReduceOp::Max, dataBuffer, count, resultsBuffer, 2 * sizeof(uint32_t));
+			submit(queue, encoder);
+		}
+		std::vector<uint32_t> results = readBuffer(device, queue, resultsBuffer, 3);
+		correct = results[0] == sum
+			&& results[1] == *std::min_element(data.begin(), data.end())
+			&& results[2] == *std::max_element(data.begin(), data.end());
+		report("reduce", count, ms, size, correct);
+		allCorrect = allCorrect && correct;
+
+		// Sort pairs. Restoring the unsorted data is timed on its own and
+		// taken out.
+		auto restore = [&](CommandEncoder encoder) {
+			encoder.copyBufferToBuffer(unsortedKeysBuffer, 0, keysBuffer, 0, size);
+			encoder.copyBufferToBuffer(unsortedValuesBuffer, 0, valuesBuffer, 0, size);
+		};
+		double restoreMs = timeGpu(device, queue, restore);
+		ms = timeGpu(device, queue, [&](CommandEncoder encoder) {
+			restore(encoder);
+			primitives.sort(encoder, keysBuffer, valuesBuffer, count);
+		});
+		ms = std::max(ms - restoreMs, 1e-3);
+		std::vector<uint32_t> order = indices;
+		std::stable_sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+		std::vector<uint32_t> sortedKeys(count);
+		for (uint32_t i = 0; i < count; ++i) {
+			sortedKeys[i] = keys[order[i]];
+		}
+		correct = readBuffer(device, queue, keysBuffer, count) == sortedKeys
+			&& readBuffer(device, queue, valuesBuffer, count) == order;
+		report("sort pairs", count, ms, 0.0, correct);
+		allCorrect = allCorrect && correct;
+
+		// Compaction of the data whose flag is set
+		ms = timeGpu(device, queue, [&](CommandEncoder encoder) {
+			primitives.compact(encoder, dataBuffer, flagsBuffer, count, outputBuffer, resultsBuffer, 0);
+		});
+		std::vector<uint32_t> kept;
+		for (uint32_t i = 0; i < count; ++i) {
+			if (flags[i]) kept.push_back(data[i]);
+		}
+		uint32_t keptCount = readBuffer(device, queue, resultsBuffer, 1)[0];
+		correct = keptCount == kept.size();
+		if (correct && keptCount > 0) {
+			correct = readBuffer(device, queue, outputBuffer, keptCount) == kept;
+		}
+		report("compact", count, ms, 2.0 * size + kept.size() * sizeof(uint32_t), correct);
+		allCorrect = allCorrect && correct;
+
+		for (Buffer buffer : { dataBuffer, outputBuffer, flagsBuffer, keysBuffer, valuesBuffer, unsortedKeysBuffer, unsortedValuesBuffer, resultsBuffer }) {
+			primitives.evict(buffer);
+			buffer.destroy();
+			buffer.release();
+		}
+	}
+
+	queue.release();
+	device.release();
+	adapter.release();
+	instance.release();
+	return allCorrect ? 0 : 1;
+}
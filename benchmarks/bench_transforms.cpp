@@ -0,0 +1,169 @@
+// Compare the depth-sorted transform hierarchy with a naive recursive update
+// of a pointer-based tree, for full and partial updates, and report the time
+// per 100k nodes.
+
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// 8 children per node over 7 levels, about 300k nodes
+constexpr uint32_t BRANCHING = 8;
+constexpr uint32_t DEPTH = 7;
+constexpr int ITERATIONS = 10;
+
+using Transform = TransformHierarchy::Transform;
+
+// The classic scene graph node, each one allocated on its own
+struct TreeNode {
+	Transform local;
+	Mat4 world;
+	uint32_t instanceIndex;
+	std::vector<std::unique_ptr<TreeNode>> children;
+};
+
+static void updateRecursive(TreeNode& node, const Mat4* parentWorld, Mat4* instances) {
+	Mat4 local = mat4Compose(node.local.translation, node.local.rotation, node.local.scale);
+	node.world = parentWorld ? mat4Mul(*parentWorld, local) : local;
+	instances[node.instanceIndex] = node.world;
+	for (auto& child : node.children) {
+		updateRecursive(*child, &node.world, instances);
+	}
+}
+
+template <typename F>
+static double bestOfMs(F&& f) {
+	double best = 1e30;
+	for (int i = 0; i < ITERATIONS; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		f();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
+
+static void report(const std::string& name, double ms, uint32_t updatedCount) {
+	std::cout
+		<< std::left << std::setw(32) << name
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(10) << ms << " ms"
+		<< std::setw(10) << updatedCount << " nodes"
+		<< std::setw(10) << (updatedCount ? 100000.0 * ms / updatedCount : 0.0) << " ms/100k" << std::endl;
+}
+
+static bool sameMatrices(const std::vector<Mat4>& a, const std::vector<Mat4>& b) {
+	for (size_t i = 0; i < a.size(); ++i) {
+		for (int k = 0; k < 16; ++k) {
+			float x = a[i].data()[k], y = b[i].data()[k];
+			if (std::abs(x - y) > 1e-4f * std::max(1.0f, std::abs(y))) return false;
+		}
+	}
+	return true;
+}
+
+int main(int, char**) {
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto randomTransform = [&]() {
+		Transform t;
+		t.translation = Vec4{ unit(rng), unit(rng), unit(rng), 1.0f };
+		t.rotation = quatNormalize(Quat{ unit(rng), unit(rng), unit(rng), unit(rng) });
+		float s = 1.0f + 0.05f * unit(rng);
+		t.scale = Vec4{ s, s, s, 0.0f };
+		return t;
+	};
+
+	ThreadPool pool;
+	TransformHierarchy single(nullptr);
+	TransformHierarchy parallel(&pool);
+	TreeNode root;
+	root.local = randomTransform();
+	root.instanceIndex = 0;
+
+	// Build all three breadth-first, with the same transforms, and give
+	// every node an instance.
+	std::vector<TreeNode*> treeLevel = { &root };
+	std::vector<TransformHierarchy::NodeId> level = { 0 };
+	single.createNode(TransformHierarchy::NO_PARENT, root.local, 0);
+	parallel.createNode(TransformHierarchy::NO_PARENT, root.local, 0);
+	std::vector<TransformHierarchy::NodeId> levelStarts = { 0 };
+	uint32_t nodeCount = 1;
+	for (uint32_t depth = 1; depth < DEPTH; ++depth) {
+		std::vector<TreeNode*> nextTreeLevel;
+		std::vector<TransformHierarchy::NodeId> nextLevel;
+		levelStarts.push_back(nodeCount);
+		for (size_t i = 0; i < level.size(); ++i) {
+			for (uint32_t c = 0; c < BRANCHING; ++c) {
+				Transform t = randomTransform();
+				auto child = std::make_unique<TreeNode>();
+				child->local = t;
+				child->instanceIndex = nodeCount;
+				nextTreeLevel.push_back(child.get());
+				treeLevel[i]->children.push_back(std::move(child));
+				nextLevel.push_back(single.createNode(level[i], t, nodeCount));
+				parallel.createNode(level[i], t, nodeCount);
+				++nodeCount;
+			}
+		}
+		treeLevel.swap(nextTreeLevel);
+		level.swap(nextLevel);
+	}
+
+	std::vector<Mat4> expected(nodeCount), actual(nodeCount);
+	single.setInstanceOutput(actual.data(), sizeof(Mat4));
+	parallel.setInstanceOutput(actual.data(), sizeof(Mat4));
+
+	std::cout << "Updating " << nodeCount << " nodes over " << DEPTH << " levels, SIMD: " << simdMathName()
+		<< ", threads: " << pool.threadCount() << std::endl;
+	bool allMatch = true;
+
+	double ms = bestOfMs([&]() { updateRecursive(root, nullptr, expected.data()); });
+	report("recursive, all dirty", ms, nodeCount);
+
+	// Touch the given nodes before each update so that their subtrees are dirty
+	auto measure = [&](const std::string& name, TransformHierarchy& hierarchy, const std::vector<TransformHierarchy::NodeId>& touched) {
+		uint32_t updatedCount = 0;
+		double best = 1e30;
+		for (int i = 0; i < ITERATIONS; ++i) {
+			for (TransformHierarchy::NodeId node : touched) {
+				hierarchy.setLocal(node, hierarchy.local(node));
+			}
+			auto start = std::chrono::steady_clock::now();
+			updatedCount = hierarchy.update().updatedNodeCount;
+			auto end = std::chrono::steady_clock::now();
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		report(name, best, updatedCount);
+	};
+
+	std::string threads = std::to_string(pool.threadCount()) + " threads";
+	measure("hierarchy, all dirty, 1 thread", single, { 0 });
+	allMatch &= sameMatrices(actual, expected);
+	measure("hierarchy, all dirty, " + threads, parallel, { 0 });
+	allMatch &= sameMatrices(actual, expected);
+
+	// About 10% of the tree: 6 of the 64 subtrees rooted at depth 2
+	std::vector<TransformHierarchy::NodeId> subtrees;
+	for (uint32_t i = 0; i < 6; ++i) {
+		subtrees.push_back(levelStarts[2] + i * 10);
+	}
+	measure("hierarchy, 10% dirty, 1 thread", single, subtrees);
+	measure("hierarchy, 10% dirty, " + threads, parallel, subtrees);
+	allMatch &= sameMatrices(actual, expected);
+
+	measure("hierarchy, nothing dirty", single, {});
+
+	if (!allMatch) {
+		std::cerr << "The hierarchy does not match the recursive update" << std::endl;
+	}
+	return allMatch ? 0 : 1;
+}
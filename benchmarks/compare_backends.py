@@ -0,0 +1,117 @@
+# Run the GPU benchmarks of two builds, one against wgpu-native and one
+# against Dawn, and print their results in one report. Lines that read the
+# same in both outputs but for their numbers are merged, the numbers that
+# differ being shown as "wgpu | dawn". Other lines are shown for each
+# backend in turn.
+#
+# The builds are the ones build.py makes, or the wgpu/ and dawn/ folders of
+# a build configured with -DLEARNWEBGPU_BOTH_BACKENDS=ON.
+import argparse
+import difflib
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+BENCHMARKS_DIR = os.path.dirname(os.path.abspath(__file__))
+
+parser = argparse.ArgumentParser()
+parser.add_argument("wgpu_build", nargs="?", default="build-wgpu",
+    help="Build folder of the wgpu-native backend"
+)
+parser.add_argument("dawn_build", nargs="?", default="build-dawn",
+    help="Build folder of the Dawn backend"
+)
+parser.add_argument("--only", type=str, action="append", default=[],
+    help="Only run this benchmark, can be repeated"
+)
+parser.add_argument("--output", type=str, default=None,
+    help="Also write the report to this file"
+)
+parser.add_argument("--timeout", type=int, default=600,
+    help="Seconds after which a benchmark is stopped"
+)
+args = parser.parse_args()
+
+NUMBER = re.compile(r"^[-+]?(\d+\.?\d*|\.\d+)([eE][-+]?\d+)?[%x]?$")
+
+def gpuBenchmarks():
+    """Benchmarks that link the WebGPU wrapper, as listed in CMakeLists.txt"""
+    with open(os.path.join(BENCHMARKS_DIR, "CMakeLists.txt")) as f:
+        cmake = f.read()
+    return re.findall(r"target_link_libraries\((bench_\w+) PRIVATE [^)]*\bwebgpu_cpp\)", cmake)
+
+def findExecutable(buildFolder, name):
+    """Benchmarks are in benchmarks/, or in a folder per configuration below it"""
+    for root, _, files in os.walk(os.path.join(buildFolder, "benchmarks")):
+        for file in files:
+            if file == name or file == name + ".exe":
+                return os.path.join(root, file)
+    return None
+
+def run(executable):
+    """Output lines of a benchmark, run in a folder of its own"""
+    if executable is None:
+        return ["(not built)"]
+    with tempfile.TemporaryDirectory() as workDir:
+        try:
+            result = subprocess.run([os.path.abspath(executable)], cwd=workDir,
+                capture_output=True, text=True, timeout=args.timeout)
+        except subprocess.TimeoutExpired:
+            return [f"(stopped after {args.timeout} s)"]
+    lines = result.stdout.splitlines()
+    if result.returncode != 0:
+        lines += result.stderr.splitlines()
+        lines.append(f"(exit code {result.returncode})")
+    return lines
+
+def shape(line):
+    """What is left of a line once its numbers are taken out"""
+    return tuple("#" if NUMBER.match(token) else token for token in line.split())
+
+def align(rows):
+    """Lines of rows of cells, aligned in columns"""
+    widths = [max(len(row[i]) for row in rows) for i in range(len(rows[0]))]
+    return ["  ".join(cell.ljust(width) for cell, width in zip(row, widths)).rstrip() for row in rows]
+
+def merge(wgpuLines, dawnLines):
+    """Report lines of one benchmark"""
+    lines = []
+    matcher = difflib.SequenceMatcher(None, [shape(l) for l in wgpuLines], [shape(l) for l in dawnLines], autojunk=False)
+    for tag, i1, i2, j1, j2 in matcher.get_opcodes():
+        if tag != "equal":
+            lines += ["wgpu: " + l for l in wgpuLines[i1:i2]]
+            lines += ["dawn: " + l for l in dawnLines[j1:j2]]
+            continue
+        # Consecutive rows of as many cells are the rows of a table
+        table = []
+        for wgpuLine, dawnLine in zip(wgpuLines[i1:i2], dawnLines[j1:j2]):
+            row = [a if a == b else f"{a} | {b}" for a, b in zip(wgpuLine.split(), dawnLine.split())]
+            if table and len(row) != len(table[-1]):
+                lines += align(table)
+                table = []
+            table.append(row)
+        if table:
+            lines += align(table)
+    return lines
+
+benchmarks = [b for b in gpuBenchmarks() if not args.only or b in args.only]
+if not benchmarks:
+    print("⚠️  No benchmark to run")
+    sys.exit(1)
+
+report = [
+    f"Backend comparison: wgpu-native ({args.wgpu_build}) vs Dawn ({args.dawn_build})",
+    "Numbers that differ are shown as wgpu | dawn",
+]
+for name in benchmarks:
+    print(f"⏱️ Running {name}", file=sys.stderr)
+    wgpuLines = run(findExecutable(args.wgpu_build, name))
+    dawnLines = run(findExecutable(args.dawn_build, name))
+    report += ["", f"== {name}"] + merge(wgpuLines, dawnLines)
+
+print("\n".join(report))
+if args.output:
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write("\n".join(report) + "\n")
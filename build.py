@@ -6,10 +6,10 @@ import subprocess
 
 parser = argparse.ArgumentParser()
 
-backendOptions = ["wgpu", "dawn"]
+backendOptions = ["wgpu", "dawn", "both"]
 parser.add_argument("--backend", type=str,
     default=backendOptions[0],
-    help="WebGPU backend to use (wgpu or dawn)"
+    help="WebGPU backend to use (wgpu, dawn, or both to build against each side by side)"
 )
 
 parser.add_argument("--clean", action="store_true",
@@ -17,6 +17,16 @@ parser.add_argument("--clean", action="store_true",
     help="If true, clean the build folder before building"
 )
 
+parser.add_argument("--headless", action="store_true",
+    default=False,
+    help="If true, build GLFW's null platform and render offscreen, without a display server"
+)
+
+parser.add_argument("--compare", action="store_true",
+    default=False,
+    help="With --backend both, run the GPU benchmarks against each backend and report them together instead of running the app"
+)
+
 args = parser.parse_args()
 
 backend = args.backend
@@ -31,12 +41,24 @@ if (args.clean):
     subprocess.run(["rm", "-rf", buildFolder])
 
 print(f"🏭 Create build files with {backend} backend")
-subprocess.run(["cmake", ".", "-B", buildFolder, "-D", f"WEBGPU_BACKEND={backend.upper()}"])
+if backend == "both":
+    backendArgs = ["-D", "LEARNWEBGPU_BOTH_BACKENDS=ON"]
+else:
+    backendArgs = ["-D", f"WEBGPU_BACKEND={backend.upper()}"]
+subprocess.run(["cmake", ".", "-B", buildFolder] + backendArgs +
+    ["-D", f"LEARNWEBGPU_HEADLESS={'ON' if args.headless else 'OFF'}"])
 
 print(f"🏗️ Building app for {platform.system()}")
 subprocess.run(["cmake", "--build", buildFolder])
 
-if platform.system() == "Windows":
+if backend == "both":
+    # Each backend has its own build, in a folder of this one
+    if args.compare:
+        print(f"⏱️ Comparing backends")
+        subprocess.run(["cmake", "--build", buildFolder, "--target", "compare_backends"])
+    else:
+        print(f"✅ Built in {os.path.join(buildFolder, 'wgpu')} and {os.path.join(buildFolder, 'dawn')}")
+elif platform.system() == "Windows":
     subprocess.run(os.path.join(buildFolder, "Debug", "LearnWebGPU.exe"))
 else:
     subprocess.run(os.path.join(buildFolder, "LearnWebGPU"))
\ No newline at end of file
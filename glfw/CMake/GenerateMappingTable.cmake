@@ -0,0 +1,219 @@
+# Usage:
+# cmake -P GenerateMappingTable.cmake <path/to/mappings.h> <path/to/mapping_table.h>
+#
+# Parses the gamepad mappings of mappings.h the way parseMapping in input.c
+# does, so that glfwInit does not have to.  Each platform section becomes an
+# array of _GLFWmapping sorted by the FNV-1a hash of the GUID, and then by
+# GUID, along with the array of the hashes for binary search.  Only the first
+# valid mapping of each GUID is kept, as it is the one findMapping used to
+# return.
+
+cmake_policy(SET CMP0007 NEW)
+
+set(source_path "${CMAKE_ARGV3}")
+set(target_path "${CMAKE_ARGV4}")
+
+if (NOT EXISTS "${source_path}")
+    message(FATAL_ERROR "Failed to find mappings file ${source_path}")
+endif()
+
+# In the order of the GLFW_GAMEPAD_BUTTON_* and GLFW_GAMEPAD_AXIS_* indices
+set(button_fields a b x y leftshoulder rightshoulder back start guide
+                  leftstick rightstick dpup dpright dpdown dpleft)
+set(axis_fields leftx lefty rightx righty lefttrigger righttrigger)
+set(GUID_REGEX "^[0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f]")
+set(GUID_REGEX "${GUID_REGEX}[0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f]")
+set(GUID_REGEX "${GUID_REGEX}[0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f]")
+set(GUID_REGEX "${GUID_REGEX}[0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f]$")
+
+# FNV-1a, matching hashGUID in input.c
+function(hash_guid guid output)
+    set(hash 2166136261)
+    foreach(i RANGE 31)
+        string(SUBSTRING "${guid}" ${i} 1 char)
+        string(FIND "0123456789abcdef" "${char}" digit)
+        if (digit LESS 10)
+            math(EXPR code "48 + ${digit}")
+        else()
+            math(EXPR code "87 + ${digit}")
+        endif()
+        math(EXPR hash "((${hash} ^ ${code}) * 16777619) & 4294967295")
+    endforeach()
+    set(${output} ${hash} PARENT_SCOPE)
+endfunction()
+
+# Parses one mapping into a C initializer, or an empty string if parseMapping
+# would reject it
+function(parse_mapping line platform_name section output)
+    set(${output} "" PARENT_SCOPE)
+
+    string(REPLACE "," ";" fields "${line}")
+    list(LENGTH fields field_count)
+    if (field_count LESS 2)
+        return()
+    endif()
+    list(GET fields 0 guid)
+    list(GET fields 1 name)
+    list(REMOVE_AT fields 0 1)
+
+    string(LENGTH "${guid}" guid_length)
+    string(LENGTH "${name}" name_length)
+    if (NOT guid_length EQUAL 32 OR NOT name_length LESS 128)
+        message(WARNING "Skipping invalid gamepad mapping: ${line}")
+        return()
+    endif()
+
+    foreach(field ${button_fields} ${axis_fields})
+        set(element_${field} "0,0,0,0")
+    endforeach()
+
+    foreach(field ${fields})
+        # TODO: Implement output modifiers
+        if (field MATCHES "^[+-]")
+            return()
+        endif()
+        if (NOT field MATCHES "^([a-z]+):(.*)$")
+            continue()
+        endif()
+        set(key "${CMAKE_MATCH_1}")
+        set(value "${CMAKE_MATCH_2}")
+
+        if (key STREQUAL "platform")
+            string(LENGTH "${platform_name}" platform_length)
+            string(SUBSTRING "${value}" 0 ${platform_length} value_platform)
+            if (NOT value_platform STREQUAL platform_name)
+                return()
+            endif()
+            continue()
+        endif()
+
+        list(FIND button_fields "${key}" button_index)
+        list(FIND axis_fields "${key}" axis_index)
+        if (button_index EQUAL -1 AND axis_index EQUAL -1)
+            continue()
+        endif()
+
+        if (NOT value MATCHES "^([+-]?)([abh])([0-9]*)(\\.([0-9]*))?(~?)")
+            continue()
+        endif()
+        set(range "${CMAKE_MATCH_1}")
+        set(type "${CMAKE_MATCH_2}")
+        set(index "${CMAKE_MATCH_3}")
+        set(bit "${CMAKE_MATCH_5}")
+        set(invert "${CMAKE_MATCH_6}")
+        if (index STREQUAL "")
+            set(index 0)
+        endif()
+        if (bit STREQUAL "")
+            set(bit 0)
+        endif()
+
+        set(scale 0)
+        set(offset 0)
+        if (type STREQUAL "a")
+            set(type 1)
+            if (range STREQUAL "+")
+                set(scale 2)
+                set(offset -1)
+            elseif (range STREQUAL "-")
+                set(scale 2)
+                set(offset 1)
+            else()
+                set(scale 1)
+                set(offset 0)
+            endif()
+            if (invert STREQUAL "~")
+                math(EXPR scale "-(${scale})")
+                math(EXPR offset "-(${offset})")
+            endif()
+            math(EXPR index "${index} & 255")
+        elseif (type STREQUAL "b")
+            set(type 2)
+            math(EXPR index "${index} & 255")
+        else()
+            set(type 3)
+            math(EXPR index "((${index} << 4) | ${bit}) & 255")
+        endif()
+        set(element_${key} "${type},${index},${scale},${offset}")
+    endforeach()
+
+    string(TOLOWER "${guid}" guid)
+    # Matches _glfwPlatformUpdateGamepadGUID in win32_joystick.c and
+    # cocoa_joystick.m
+    if (section STREQUAL "WIN32" AND guid MATCHES "^(....)(....)............504944564944$")
+        set(guid "03000000${CMAKE_MATCH_1}0000${CMAKE_MATCH_2}000000000000")
+    elseif (section STREQUAL "COCOA" AND guid MATCHES "^(....)000000000000(....)000000000000$")
+        set(guid "03000000${CMAKE_MATCH_1}0000${CMAKE_MATCH_2}000000000000")
+    endif()
+    if (NOT guid MATCHES "${GUID_REGEX}")
+        return()
+    endif()
+
+    set(buttons "")
+    foreach(field ${button_fields})
+        set(buttons "${buttons}{${element_${field}}},")
+    endforeach()
+    set(axes "")
+    foreach(field ${axis_fields})
+        set(axes "${axes}{${element_${field}}},")
+    endforeach()
+
+    set(${output} "${guid}|{\"${name}\",\"${guid}\",{${buttons}},{${axes}}}" PARENT_SCOPE)
+endfunction()
+
+file(STRINGS "${source_path}" lines)
+
+set(section "")
+set(table "")
+foreach(line ${lines})
+    if (line MATCHES "^#if defined\\(GLFW_BUILD_([A-Z0-9]+)_MAPPINGS\\)")
+        set(section "${CMAKE_MATCH_1}")
+        if (section STREQUAL "WIN32")
+            set(platform_name "Windows")
+        elseif (section STREQUAL "COCOA")
+            set(platform_name "Mac OS X")
+        else()
+            set(platform_name "Linux")
+        endif()
+        set(entries "")
+        set(guids "")
+    elseif (line MATCHES "^#endif" AND NOT section STREQUAL "")
+        # Zero-padded hashes sort numerically as strings
+        list(SORT entries)
+        set(hashes "")
+        set(mappings "")
+        foreach(entry ${entries})
+            string(REGEX REPLACE "^[0-9]+ ([0-9]+) .*$" "\\1" hash "${entry}")
+            string(REGEX REPLACE "^[0-9]+ [0-9]+ [0-9a-f]+\\|(.*)$" "\\1" mapping "${entry}")
+            set(hashes "${hashes}${hash}u,\n")
+            set(mappings "${mappings}${mapping},\n")
+        endforeach()
+        list(LENGTH entries count)
+        set(table "${table}#if defined(GLFW_BUILD_${section}_MAPPINGS)\n")
+        set(table "${table}#define _GLFW_DEFAULT_MAPPING_COUNT ${count}\n")
+        set(table "${table}static const uint32_t _glfwDefaultMappingHashes[] =\n{\n${hashes}};\n")
+        set(table "${table}static const _GLFWmapping _glfwDefaultMappings[] =\n{\n${mappings}};\n")
+        set(table "${table}#endif // GLFW_BUILD_${section}_MAPPINGS\n\n")
+        set(section "")
+    elseif (NOT section STREQUAL "" AND line MATCHES "^\"(.*)\",$")
+        parse_mapping("${CMAKE_MATCH_1}" "${platform_name}" "${section}" entry)
+        if (NOT entry STREQUAL "")
+            string(REGEX REPLACE "\\|.*$" "" guid "${entry}")
+            list(FIND guids "${guid}" previous)
+            if (previous EQUAL -1)
+                list(APPEND guids "${guid}")
+                hash_guid("${guid}" hash)
+                set(sort_key "${hash}")
+                string(LENGTH "${sort_key}" sort_key_length)
+                while (sort_key_length LESS 10)
+                    set(sort_key "0${sort_key}")
+                    math(EXPR sort_key_length "${sort_key_length} + 1")
+                endwhile()
+                list(APPEND entries "${sort_key} ${hash} ${entry}")
+            endif()
+        endif()
+    endif()
+endforeach()
+
+file(WRITE "${target_path}"
+"// Generated from mappings.h by GenerateMappingTable.cmake, do not edit.\n\n${table}")
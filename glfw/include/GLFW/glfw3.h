@@ -5442,6 +5442,106 @@ GLFWAPI uint64_t glfwGetTimerValue(void);
  */
 GLFWAPI uint64_t glfwGetTimerFrequency(void);
 
+/*! @brief Starts recording input events to a file.
+ *
+ *  This function starts recording the key, mouse button, cursor position and
+ *  scroll events of all windows to the specified file, in a compact binary
+ *  format.  Each event is stamped with the [timer](@ref time), and a frame
+ *  marker is written each time @ref glfwPollEvents has processed events.  The
+ *  events processed by @ref glfwWaitEvents and @ref glfwWaitEventsTimeout
+ *  belong to the frame of the next call to @ref glfwPollEvents, so that
+ *  applications can wait for events between frames without changing the
+ *  frame they are replayed at.  Recording stops with @ref glfwStopInputLog or
+ *  when the library is terminated.
+ *
+ *  The file is written in the native byte order and is meant to be replayed
+ *  with @ref glfwStartInputReplay on the same kind of machine.
+ *
+ *  @param[in] path The path of the file to create.
+ *  @return `GLFW_TRUE` if successful, or `GLFW_FALSE` if an
+ *  [error](@ref error_handling) occurred.
+ *
+ *  @errors Possible errors include @ref GLFW_NOT_INITIALIZED and @ref
+ *  GLFW_PLATFORM_ERROR.
+ *
+ *  @thread_safety This function must only be called from the main thread.
+ *
+ *  @sa @ref glfwStartInputReplay
+ *  @sa @ref glfwStopInputLog
+ *
+ *  @ingroup input
+ */
+GLFWAPI int glfwStartInputRecording(const char* path);
+
+/*! @brief Starts replaying input events from a file.
+ *
+ *  This function starts replaying a file written by @ref
+ *  glfwStartInputRecording into the specified window.  The events recorded
+ *  up to each frame marker are injected by the matching call to @ref
+ *  glfwPollEvents, so that they arrive at the same frame index as when they
+ *  were recorded.
+ *  Key, mouse button, cursor position and scroll events coming from the
+ *  platform are ignored while replaying.
+ *
+ *  While replaying, @ref glfwGetTime returns the time at which the current
+ *  frame was recorded, so that an application driven by input and time
+ *  renders the same frames in every run.  This is best used with the null
+ *  platform, which processes frames as fast as the application renders
+ *  them.
+ *
+ *  @param[in] window The window to inject the events into.
+ *  @param[in] path The path of the file to replay.
+ *  @return `GLFW_TRUE` if successful, or `GLFW_FALSE` if an
+ *  [error](@ref error_handling) occurred.
+ *
+ *  @errors Possible errors include @ref GLFW_NOT_INITIALIZED, @ref
+ *  GLFW_INVALID_VALUE and @ref GLFW_PLATFORM_ERROR.
+ *
+ *  @thread_safety This function must only be called from the main thread.
+ *
+ *  @sa @ref glfwInputReplayEnded
+ *  @sa @ref glfwStopInputLog
+ *
+ *  @ingroup input
+ */
+GLFWAPI int glfwStartInputReplay(GLFWwindow* window, const char* path);
+
+/*! @brief Returns whether the replayed input file has been played entirely.
+ *
+ *  This function returns whether all events and frames of the file given to
+ *  @ref glfwStartInputReplay have been replayed.  Time then advances as usual
+ *  again.
+ *
+ *  @return `GLFW_TRUE` if replay has ended or was never started, or
+ *  `GLFW_FALSE` otherwise.
+ *
+ *  @errors Possible errors include @ref GLFW_NOT_INITIALIZED.
+ *
+ *  @thread_safety This function must only be called from the main thread.
+ *
+ *  @sa @ref glfwStartInputReplay
+ *
+ *  @ingroup input
+ */
+GLFWAPI int glfwInputReplayEnded(void);
+
+/*! @brief Stops recording and replaying input events.
+ *
+ *  This function stops any recording or replay started with @ref
+ *  glfwStartInputRecording or @ref glfwStartInputReplay and closes their
+ *  files.
+ *
+ *  @errors Possible errors include @ref GLFW_NOT_INITIALIZED.
+ *
+ *  @thread_safety This function must only be called from the main thread.
+ *
+ *  @sa @ref glfwStartInputRecording
+ *  @sa @ref glfwStartInputReplay
+ *
+ *  @ingroup input
+ */
+GLFWAPI void glfwStopInputLog(void);
+
 /*! @brief Makes the context of the specified window current for the calling
  *  thread.
  *
@@ -65,6 +65,8 @@ static void terminate(void)
 
     memset(&_glfw.callbacks, 0, sizeof(_glfw.callbacks));
 
+    _glfwTerminateInputLog();
+
     while (_glfw.windowListHead)
         glfwDestroyWindow((GLFWwindow*) _glfw.windowListHead);
 
@@ -83,10 +85,16 @@ static void terminate(void)
     _glfw.monitors = NULL;
     _glfw.monitorCount = 0;
 
+    for (i = 0;  i < _glfw.mappingCount;  i++)
+        free(_glfw.mappings[i].string);
     free(_glfw.mappings);
     _glfw.mappings = NULL;
     _glfw.mappingCount = 0;
 
+    free(_glfw.mappingTable);
+    _glfw.mappingTable = NULL;
+    _glfw.mappingTableSize = 0;
+
     _glfwTerminateVulkan();
     _glfwPlatformTerminate();
 
@@ -28,7 +28,7 @@
 //========================================================================
 
 #include "internal.h"
-#include "mappings.h"
+#include "mapping_table.h"
 
 #include <assert.h>
 #include <float.h>
@@ -44,17 +44,126 @@
 #define _GLFW_JOYSTICK_BUTTON   2
 #define _GLFW_JOYSTICK_HATBIT   3
 
-// Finds a mapping based on joystick GUID
+// Internal states of gamepad mapping sources
+#define _GLFW_MAPPING_UNPARSED  0
+#define _GLFW_MAPPING_VALID     1
+#define _GLFW_MAPPING_INVALID   2
+
+static GLFWbool parseMapping(_GLFWmapping* mapping, const char* string);
+
+// Hashes a joystick GUID with 32-bit FNV-1a, as GenerateMappingTable.cmake does
+//
+static uint32_t hashGUID(const char* guid)
+{
+    uint32_t hash = 2166136261u;
+
+    while (*guid)
+    {
+        hash ^= (unsigned char) *guid++;
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+// Returns the mapping table slot of the latest source with the specified GUID,
+// or the empty slot where it would go
+//
+static int findMappingSlot(const char* guid, uint32_t hash)
+{
+    const int mask = _glfw.mappingTableSize - 1;
+    int slot = (int) (hash & mask);
+
+    while (_glfw.mappingTable[slot] != -1)
+    {
+        const _GLFWmappingsource* source = _glfw.mappings + _glfw.mappingTable[slot];
+        if (source->hash == hash && strcmp(source->guid, guid) == 0)
+            break;
+
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+// Doubles the size of the mapping table and adds all sources to it again
 //
-static _GLFWmapping* findMapping(const char* guid)
+static void growMappingTable(void)
 {
     int i;
 
+    free(_glfw.mappingTable);
+    _glfw.mappingTableSize = _glfw.mappingTableSize ? _glfw.mappingTableSize * 2 : 64;
+    _glfw.mappingTable = malloc(_glfw.mappingTableSize * sizeof(int));
+
+    for (i = 0;  i < _glfw.mappingTableSize;  i++)
+        _glfw.mappingTable[i] = -1;
+
+    // Later sources replace earlier ones with the same GUID
     for (i = 0;  i < _glfw.mappingCount;  i++)
     {
-        if (strcmp(_glfw.mappings[i].guid, guid) == 0)
-            return _glfw.mappings + i;
+        const _GLFWmappingsource* source = _glfw.mappings + i;
+        _glfw.mappingTable[findMappingSlot(source->guid, source->hash)] = i;
     }
+}
+
+// Finds a mapping based on joystick GUID
+//
+static const _GLFWmapping* findMapping(const char* guid)
+{
+    const uint32_t hash = hashGUID(guid);
+
+    // Mappings added by the application replace the built-in ones, the latest
+    // valid one first
+    if (_glfw.mappingCount)
+    {
+        int index = _glfw.mappingTable[findMappingSlot(guid, hash)];
+
+        while (index != -1)
+        {
+            _GLFWmappingsource* source = _glfw.mappings + index;
+
+            if (source->state == _GLFW_MAPPING_UNPARSED)
+            {
+                if (parseMapping(&source->mapping, source->string))
+                    source->state = _GLFW_MAPPING_VALID;
+                else
+                    source->state = _GLFW_MAPPING_INVALID;
+
+                free(source->string);
+                source->string = NULL;
+            }
+
+            if (source->state == _GLFW_MAPPING_VALID)
+                return &source->mapping;
+
+            index = source->previous;
+        }
+    }
+
+#if defined(_GLFW_DEFAULT_MAPPING_COUNT)
+    {
+        // The built-in mappings are sorted by GUID hash
+        size_t first = 0, last = _GLFW_DEFAULT_MAPPING_COUNT;
+
+        while (first < last)
+        {
+            const size_t middle = first + (last - first) / 2;
+            if (_glfwDefaultMappingHashes[middle] < hash)
+                first = middle + 1;
+            else
+                last = middle;
+        }
+
+        for (;  first < _GLFW_DEFAULT_MAPPING_COUNT;  first++)
+        {
+            if (_glfwDefaultMappingHashes[first] != hash)
+                break;
+            if (strcmp(_glfwDefaultMappings[first].guid, guid) == 0)
+                return _glfwDefaultMappings + first;
+        }
+    }
+#endif // _GLFW_DEFAULT_MAPPING_COUNT
 
     return NULL;
 }
@@ -76,9 +185,9 @@ static GLFWbool isValidElementForJoystick(const _GLFWmapelement* e,
 
 // Finds a mapping based on joystick GUID and verifies element indices
 //
-static _GLFWmapping* findValidMapping(const _GLFWjoystick* js)
+static const _GLFWmapping* findValidMapping(const _GLFWjoystick* js)
 {
-    _GLFWmapping* mapping = findMapping(js->guid);
+    const _GLFWmapping* mapping = findMapping(js->guid);
     if (mapping)
     {
         int i;
@@ -99,12 +208,50 @@ static _GLFWmapping* findValidMapping(const _GLFWjoystick* js)
     return mapping;
 }
 
-// Parses an SDL_GameControllerDB line and adds it to the mapping list
+// Parses the GUID and name of an SDL_GameControllerDB line and returns the
+// remaining fields
 //
-static GLFWbool parseMapping(_GLFWmapping* mapping, const char* string)
+static const char* parseMappingHeader(_GLFWmapping* mapping, const char* string)
 {
     const char* c = string;
     size_t i, length;
+
+    length = strcspn(c, ",");
+    if (length != 32 || c[length] != ',')
+    {
+        _glfwInputError(GLFW_INVALID_VALUE, NULL);
+        return NULL;
+    }
+
+    memcpy(mapping->guid, c, length);
+    c += length + 1;
+
+    length = strcspn(c, ",");
+    if (length >= sizeof(mapping->name) || c[length] != ',')
+    {
+        _glfwInputError(GLFW_INVALID_VALUE, NULL);
+        return NULL;
+    }
+
+    memcpy(mapping->name, c, length);
+    c += length + 1;
+
+    for (i = 0;  i < 32;  i++)
+    {
+        if (mapping->guid[i] >= 'A' && mapping->guid[i] <= 'F')
+            mapping->guid[i] += 'a' - 'A';
+    }
+
+    _glfwPlatformUpdateGamepadGUID(mapping->guid);
+    return c;
+}
+
+// Parses an SDL_GameControllerDB line into a mapping
+//
+static GLFWbool parseMapping(_GLFWmapping* mapping, const char* string)
+{
+    const char* c;
+    size_t i, length;
     struct
     {
         const char* name;
@@ -135,25 +282,9 @@ static GLFWbool parseMapping(_GLFWmapping* mapping, const char* string)
         { "righty",        mapping->axes + GLFW_GAMEPAD_AXIS_RIGHT_Y }
     };
 
-    length = strcspn(c, ",");
-    if (length != 32 || c[length] != ',')
-    {
-        _glfwInputError(GLFW_INVALID_VALUE, NULL);
-        return GLFW_FALSE;
-    }
-
-    memcpy(mapping->guid, c, length);
-    c += length + 1;
-
-    length = strcspn(c, ",");
-    if (length >= sizeof(mapping->name) || c[length] != ',')
-    {
-        _glfwInputError(GLFW_INVALID_VALUE, NULL);
+    c = parseMappingHeader(mapping, string);
+    if (!c)
         return GLFW_FALSE;
-    }
-
-    memcpy(mapping->name, c, length);
-    c += length + 1;
 
     while (*c)
     {
@@ -230,16 +361,40 @@ static GLFWbool parseMapping(_GLFWmapping* mapping, const char* string)
         c += strspn(c, ",");
     }
 
-    for (i = 0;  i < 32;  i++)
-    {
-        if (mapping->guid[i] >= 'A' && mapping->guid[i] <= 'F')
-            mapping->guid[i] += 'a' - 'A';
-    }
-
-    _glfwPlatformUpdateGamepadGUID(mapping->guid);
     return GLFW_TRUE;
 }
 
+// Adds an SDL_GameControllerDB line to the mapping sources, to be parsed when
+// its GUID is first looked up
+//
+static void addMappingSource(const char* string)
+{
+    _GLFWmappingsource* source;
+    int slot;
+
+    if ((_glfw.mappingCount + 1) * 2 > _glfw.mappingTableSize)
+        growMappingTable();
+
+    _glfw.mappings = realloc(_glfw.mappings,
+                             sizeof(_GLFWmappingsource) * (_glfw.mappingCount + 1));
+
+    source = _glfw.mappings + _glfw.mappingCount;
+    memset(source, 0, sizeof(_GLFWmappingsource));
+
+    // Malformed GUIDs and names are reported now, like before parsing was lazy
+    if (!parseMappingHeader(&source->mapping, string))
+        return;
+
+    strcpy(source->guid, source->mapping.guid);
+    source->hash = hashGUID(source->guid);
+    source->string = _glfw_strdup(string);
+    source->state = _GLFW_MAPPING_UNPARSED;
+
+    slot = findMappingSlot(source->guid, source->hash);
+    source->previous = _glfw.mappingTable[slot];
+    _glfw.mappingTable[slot] = _glfw.mappingCount++;
+}
+
 
 //////////////////////////////////////////////////////////////////////////
 //////                         GLFW event API                       //////
@@ -249,6 +404,11 @@ static GLFWbool parseMapping(_GLFWmapping* mapping, const char* string)
 //
 void _glfwInputKey(_GLFWwindow* window, int key, int scancode, int action, int mods)
 {
+    if (_glfwInputLogIgnoresPlatform())
+        return;
+    if (_glfw.inputLog.recordFile)
+        _glfwInputLogKey(key, scancode, action, mods);
+
     if (key >= 0 && key <= GLFW_KEY_LAST)
     {
         GLFWbool repeated = GLFW_FALSE;
@@ -300,6 +460,11 @@ void _glfwInputChar(_GLFWwindow* window, uint32_t codepoint, int mods, GLFWbool
 //
 void _glfwInputScroll(_GLFWwindow* window, double xoffset, double yoffset)
 {
+    if (_glfwInputLogIgnoresPlatform())
+        return;
+    if (_glfw.inputLog.recordFile)
+        _glfwInputLogScroll(xoffset, yoffset);
+
     if (window->callbacks.scroll)
         window->callbacks.scroll((GLFWwindow*) window, xoffset, yoffset);
 }
@@ -308,6 +473,11 @@ void _glfwInputScroll(_GLFWwindow* window, double xoffset, double yoffset)
 //
 void _glfwInputMouseClick(_GLFWwindow* window, int button, int action, int mods)
 {
+    if (_glfwInputLogIgnoresPlatform())
+        return;
+    if (_glfw.inputLog.recordFile)
+        _glfwInputLogMouseClick(button, action, mods);
+
     if (button < 0 || button > GLFW_MOUSE_BUTTON_LAST)
         return;
 
@@ -328,6 +498,11 @@ void _glfwInputMouseClick(_GLFWwindow* window, int button, int action, int mods)
 //
 void _glfwInputCursorPos(_GLFWwindow* window, double xpos, double ypos)
 {
+    if (_glfwInputLogIgnoresPlatform())
+        return;
+    if (_glfw.inputLog.recordFile)
+        _glfwInputLogCursorPos(xpos, ypos);
+
     if (window->virtualCursorPosX == xpos && window->virtualCursorPosY == ypos)
         return;
 
@@ -402,21 +577,13 @@ void _glfwInputJoystickHat(_GLFWjoystick* js, int hat, char value)
 //////                       GLFW internal API                      //////
 //////////////////////////////////////////////////////////////////////////
 
-// Adds the built-in set of gamepad mappings
+// Finds the mappings of the joysticks connected during platform initialization
 //
 void _glfwInitGamepadMappings(void)
 {
     int jid;
-    size_t i;
-    const size_t count = sizeof(_glfwDefaultMappings) / sizeof(char*);
-    _glfw.mappings = calloc(count, sizeof(_GLFWmapping));
-
-    for (i = 0;  i < count;  i++)
-    {
-        if (parseMapping(&_glfw.mappings[_glfw.mappingCount], _glfwDefaultMappings[i]))
-            _glfw.mappingCount++;
-    }
 
+    // The built-in mappings are parsed at build time into mapping_table.h
     for (jid = 0;  jid <= GLFW_JOYSTICK_LAST;  jid++)
     {
         _GLFWjoystick* js = _glfw.joysticks + jid;
@@ -1155,25 +1322,10 @@ GLFWAPI int glfwUpdateGamepadMappings(const char* string)
             const size_t length = strcspn(c, "\r\n");
             if (length < sizeof(line))
             {
-                _GLFWmapping mapping = {{0}};
-
                 memcpy(line, c, length);
                 line[length] = '\0';
 
-                if (parseMapping(&mapping, line))
-                {
-                    _GLFWmapping* previous = findMapping(mapping.guid);
-                    if (previous)
-                        *previous = mapping;
-                    else
-                    {
-                        _glfw.mappingCount++;
-                        _glfw.mappings =
-                            realloc(_glfw.mappings,
-                                    sizeof(_GLFWmapping) * _glfw.mappingCount);
-                        _glfw.mappings[_glfw.mappingCount - 1] = mapping;
-                    }
-                }
+                addMappingSource(line);
             }
 
             c += length;
@@ -1348,6 +1500,14 @@ GLFWAPI const char* glfwGetClipboardString(GLFWwindow* handle)
 GLFWAPI double glfwGetTime(void)
 {
     _GLFW_REQUIRE_INIT_OR_RETURN(0.0);
+
+    // Replayed frames see the time at which they were recorded
+    if (_glfw.inputLog.replayFile)
+    {
+        return (double) _glfw.inputLog.replayTime /
+            _glfw.inputLog.replayFrequency;
+    }
+
     return (double) (_glfwPlatformGetTimerValue() - _glfw.timer.offset) /
         _glfwPlatformGetTimerFrequency();
 }
@@ -0,0 +1,347 @@
+//========================================================================
+// GLFW 3.3 - www.glfw.org
+//------------------------------------------------------------------------
+//
+// This software is provided 'as-is', without any express or implied
+// warranty. In no event will the authors be held liable for any damages
+// arising from the use of this software.
+//
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would
+//    be appreciated but is not required.
+//
+// 2. Altered source versions must be plainly marked as such, and must not
+//    be misrepresented as being the original software.
+//
+// 3. This notice may not be removed or altered from any source
+//    distribution.
+//
+//========================================================================
+// Please use C89 style variable declarations in this file because VS 2010
+//========================================================================
+
+#include "internal.h"
+
+#include <assert.h>
+#include <string.h>
+
+// An input log starts with this magic and the timer frequency, followed by
+// records made of a type byte, a timer value relative to the offset of
+// glfwGetTime and a payload whose size depends on the type.  All values are
+// in the native byte order.
+//
+static const char magic[8] = { 'G', 'L', 'F', 'W', 'I', 'N', 'P', '1' };
+
+// Internal input log record types
+#define _GLFW_RECORD_FRAME          0
+#define _GLFW_RECORD_KEY            1
+#define _GLFW_RECORD_MOUSE_BUTTON   2
+#define _GLFW_RECORD_CURSOR_POS     3
+#define _GLFW_RECORD_SCROLL         4
+
+#define _GLFW_RECORD_HEADER_SIZE    9
+
+static const size_t payloadSizes[] =
+{
+    0,  // Frame
+    10, // Key, scancode, action and mods
+    3,  // Button, action and mods
+    16, // Cursor position
+    16  // Scroll offset
+};
+
+// Writes a record stamped with the current time and stops recording on error
+//
+static void writeRecord(int type, const unsigned char* payload)
+{
+    unsigned char record[_GLFW_RECORD_HEADER_SIZE + _GLFW_INPUT_LOG_PAYLOAD_MAX];
+    const uint64_t time = _glfwPlatformGetTimerValue() - _glfw.timer.offset;
+    const size_t size = _GLFW_RECORD_HEADER_SIZE + payloadSizes[type];
+
+    record[0] = (unsigned char) type;
+    memcpy(record + 1, &time, sizeof(time));
+    if (payloadSizes[type])
+        memcpy(record + _GLFW_RECORD_HEADER_SIZE, payload, payloadSizes[type]);
+
+    if (fwrite(record, 1, size, _glfw.inputLog.recordFile) != size)
+    {
+        _glfwInputError(GLFW_PLATFORM_ERROR, "Failed to write input log");
+        fclose(_glfw.inputLog.recordFile);
+        _glfw.inputLog.recordFile = NULL;
+    }
+}
+
+// Reads the next record ahead, its type being -1 at the end of the file
+//
+static void readRecord(void)
+{
+    unsigned char header[_GLFW_RECORD_HEADER_SIZE];
+    _GLFWinputrecord* next = &_glfw.inputLog.next;
+
+    next->type = -1;
+
+    if (fread(header, 1, sizeof(header), _glfw.inputLog.replayFile) != sizeof(header))
+        return;
+
+    if (header[0] > _GLFW_RECORD_SCROLL)
+    {
+        _glfwInputError(GLFW_INVALID_VALUE,
+                        "Invalid input log record type %i", header[0]);
+        return;
+    }
+
+    if (fread(next->payload, 1, payloadSizes[header[0]],
+              _glfw.inputLog.replayFile) != payloadSizes[header[0]])
+    {
+        _glfwInputError(GLFW_INVALID_VALUE, "Truncated input log");
+        return;
+    }
+
+    next->type = header[0];
+    memcpy(&next->time, header + 1, sizeof(next->time));
+}
+
+// Injects the event of a replayed record into the replay window
+//
+static void injectRecord(const _GLFWinputrecord* record)
+{
+    _GLFWwindow* window = _glfw.inputLog.replayWindow;
+    const unsigned char* p = record->payload;
+
+    if (!window)
+        return;
+
+    _glfw.inputLog.injecting = GLFW_TRUE;
+
+    switch (record->type)
+    {
+        case _GLFW_RECORD_KEY:
+        {
+            int32_t key, scancode;
+            memcpy(&key, p, sizeof(key));
+            memcpy(&scancode, p + 4, sizeof(scancode));
+            _glfwInputKey(window, key, scancode, p[8], p[9]);
+            break;
+        }
+
+        case _GLFW_RECORD_MOUSE_BUTTON:
+            _glfwInputMouseClick(window, p[0], p[1], p[2]);
+            break;
+
+        case _GLFW_RECORD_CURSOR_POS:
+        case _GLFW_RECORD_SCROLL:
+        {
+            double x, y;
+            memcpy(&x, p, sizeof(x));
+            memcpy(&y, p + 8, sizeof(y));
+
+            if (record->type == _GLFW_RECORD_CURSOR_POS)
+                _glfwInputCursorPos(window, x, y);
+            else
+                _glfwInputScroll(window, x, y);
+
+            break;
+        }
+    }
+
+    _glfw.inputLog.injecting = GLFW_FALSE;
+}
+
+// Stops replaying and lets time resume from the last replayed frame
+//
+static void endReplay(void)
+{
+    const double time = (double) _glfw.inputLog.replayTime /
+                        _glfw.inputLog.replayFrequency;
+
+    _glfw.timer.offset = _glfwPlatformGetTimerValue() -
+        (uint64_t) (time * _glfwPlatformGetTimerFrequency());
+
+    fclose(_glfw.inputLog.replayFile);
+    _glfw.inputLog.replayFile = NULL;
+    _glfw.inputLog.replayWindow = NULL;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//////                       GLFW internal API                      //////
+//////////////////////////////////////////////////////////////////////////
+
+// Marks the end of a frame's event processing, the events logged since the
+// previous marker being those the application sees in this frame
+//
+void _glfwInputLogFrame(void)
+{
+    if (_glfw.inputLog.recordFile)
+        writeRecord(_GLFW_RECORD_FRAME, NULL);
+
+    // Inject the events recorded up to the next marker.  The last frame keeps
+    // its recorded time until the next one finds the end of the file.
+    while (_glfw.inputLog.replayFile)
+    {
+        const _GLFWinputrecord* next = &_glfw.inputLog.next;
+
+        if (next->type == -1)
+        {
+            endReplay();
+            break;
+        }
+
+        if (next->type == _GLFW_RECORD_FRAME)
+        {
+            _glfw.inputLog.replayTime = next->time;
+            readRecord();
+            break;
+        }
+
+        injectRecord(next);
+        readRecord();
+    }
+}
+
+// Returns whether the input events from the platform are ignored because
+// recorded events are replayed instead
+//
+GLFWbool _glfwInputLogIgnoresPlatform(void)
+{
+    return _glfw.inputLog.replayFile && !_glfw.inputLog.injecting;
+}
+
+void _glfwInputLogKey(int key, int scancode, int action, int mods)
+{
+    unsigned char payload[10];
+    const int32_t values[2] = { key, scancode };
+
+    memcpy(payload, values, sizeof(values));
+    payload[8] = (unsigned char) action;
+    payload[9] = (unsigned char) mods;
+    writeRecord(_GLFW_RECORD_KEY, payload);
+}
+
+void _glfwInputLogMouseClick(int button, int action, int mods)
+{
+    const unsigned char payload[3] =
+    {
+        (unsigned char) button, (unsigned char) action, (unsigned char) mods
+    };
+
+    writeRecord(_GLFW_RECORD_MOUSE_BUTTON, payload);
+}
+
+void _glfwInputLogCursorPos(double xpos, double ypos)
+{
+    const double values[2] = { xpos, ypos };
+    writeRecord(_GLFW_RECORD_CURSOR_POS, (const unsigned char*) values);
+}
+
+void _glfwInputLogScroll(double xoffset, double yoffset)
+{
+    const double values[2] = { xoffset, yoffset };
+    writeRecord(_GLFW_RECORD_SCROLL, (const unsigned char*) values);
+}
+
+// Closes the files of the input log
+//
+void _glfwTerminateInputLog(void)
+{
+    if (_glfw.inputLog.recordFile)
+    {
+        fclose(_glfw.inputLog.recordFile);
+        _glfw.inputLog.recordFile = NULL;
+    }
+
+    if (_glfw.inputLog.replayFile)
+        endReplay();
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//////                        GLFW public API                       //////
+//////////////////////////////////////////////////////////////////////////
+
+GLFWAPI int glfwStartInputRecording(const char* path)
+{
+    uint64_t frequency;
+
+    assert(path != NULL);
+
+    _GLFW_REQUIRE_INIT_OR_RETURN(GLFW_FALSE);
+
+    if (_glfw.inputLog.recordFile)
+        fclose(_glfw.inputLog.recordFile);
+
+    _glfw.inputLog.recordFile = fopen(path, "wb");
+    if (!_glfw.inputLog.recordFile)
+    {
+        _glfwInputError(GLFW_PLATFORM_ERROR, "Failed to create input log %s", path);
+        return GLFW_FALSE;
+    }
+
+    frequency = _glfwPlatformGetTimerFrequency();
+    if (fwrite(magic, 1, sizeof(magic), _glfw.inputLog.recordFile) != sizeof(magic) ||
+        fwrite(&frequency, 1, sizeof(frequency), _glfw.inputLog.recordFile) != sizeof(frequency))
+    {
+        _glfwInputError(GLFW_PLATFORM_ERROR, "Failed to write input log %s", path);
+        fclose(_glfw.inputLog.recordFile);
+        _glfw.inputLog.recordFile = NULL;
+        return GLFW_FALSE;
+    }
+
+    return GLFW_TRUE;
+}
+
+GLFWAPI int glfwStartInputReplay(GLFWwindow* handle, const char* path)
+{
+    char header[sizeof(magic)];
+    uint64_t frequency;
+    FILE* file;
+
+    assert(handle != NULL);
+    assert(path != NULL);
+
+    _GLFW_REQUIRE_INIT_OR_RETURN(GLFW_FALSE);
+
+    file = fopen(path, "rb");
+    if (!file)
+    {
+        _glfwInputError(GLFW_PLATFORM_ERROR, "Failed to open input log %s", path);
+        return GLFW_FALSE;
+    }
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, magic, sizeof(magic)) != 0 ||
+        fread(&frequency, 1, sizeof(frequency), file) != sizeof(frequency) ||
+        frequency == 0)
+    {
+        _glfwInputError(GLFW_INVALID_VALUE, "Invalid input log %s", path);
+        fclose(file);
+        return GLFW_FALSE;
+    }
+
+    if (_glfw.inputLog.replayFile)
+        endReplay();
+
+    _glfw.inputLog.replayFile = file;
+    _glfw.inputLog.replayWindow = (_GLFWwindow*) handle;
+    _glfw.inputLog.replayFrequency = frequency;
+    _glfw.inputLog.replayTime = 0;
+    readRecord();
+    return GLFW_TRUE;
+}
+
+GLFWAPI int glfwInputReplayEnded(void)
+{
+    _GLFW_REQUIRE_INIT_OR_RETURN(GLFW_TRUE);
+    return _glfw.inputLog.replayFile == NULL;
+}
+
+GLFWAPI void glfwStopInputLog(void)
+{
+    _GLFW_REQUIRE_INIT();
+    _glfwTerminateInputLog();
+}
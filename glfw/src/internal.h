@@ -48,6 +48,10 @@
 #define GLFW_INCLUDE_NONE
 #include "../include/GLFW/glfw3.h"
 
+#include <stdio.h>
+
+#define _GLFW_INPUT_LOG_PAYLOAD_MAX 16
+
 #define _GLFW_INSERT_FIRST      0
 #define _GLFW_INSERT_LAST       1
 
@@ -72,6 +76,8 @@ typedef struct _GLFWmonitor     _GLFWmonitor;
 typedef struct _GLFWcursor      _GLFWcursor;
 typedef struct _GLFWmapelement  _GLFWmapelement;
 typedef struct _GLFWmapping     _GLFWmapping;
+typedef struct _GLFWmappingsource _GLFWmappingsource;
+typedef struct _GLFWinputrecord _GLFWinputrecord;
 typedef struct _GLFWjoystick    _GLFWjoystick;
 typedef struct _GLFWtls         _GLFWtls;
 typedef struct _GLFWmutex       _GLFWmutex;
@@ -474,6 +480,29 @@ struct _GLFWmapping
     _GLFWmapelement axes[6];
 };
 
+// Gamepad mapping added with glfwUpdateGamepadMappings, parsed on first use
+//
+struct _GLFWmappingsource
+{
+    char*           string;
+    char            guid[33];
+    uint32_t        hash;
+    // One of the _GLFW_MAPPING_* source states in input.c
+    int             state;
+    // Index of the previously added source with the same GUID, or -1
+    int             previous;
+    _GLFWmapping    mapping;
+};
+
+// Input log record read ahead while replaying
+//
+struct _GLFWinputrecord
+{
+    int             type;
+    uint64_t        time;
+    unsigned char   payload[_GLFW_INPUT_LOG_PAYLOAD_MAX];
+};
+
 // Joystick structure
 //
 struct _GLFWjoystick
@@ -489,7 +518,7 @@ struct _GLFWjoystick
     char            name[128];
     void*           userPointer;
     char            guid[33];
-    _GLFWmapping*   mapping;
+    const _GLFWmapping* mapping;
 
     // This is defined in the joystick API's joystick.h
     _GLFW_PLATFORM_JOYSTICK_STATE;
@@ -533,8 +562,11 @@ struct _GLFWlibrary
     int                 monitorCount;
 
     _GLFWjoystick       joysticks[GLFW_JOYSTICK_LAST + 1];
-    _GLFWmapping*       mappings;
+    _GLFWmappingsource* mappings;
     int                 mappingCount;
+    // Open addressing table of the latest source index per GUID, -1 if empty
+    int*                mappingTable;
+    int                 mappingTableSize;
 
     _GLFWtls            errorSlot;
     _GLFWtls            contextSlot;
@@ -546,6 +578,18 @@ struct _GLFWlibrary
         _GLFW_PLATFORM_LIBRARY_TIMER_STATE;
     } timer;
 
+    struct {
+        FILE*           recordFile;
+        FILE*           replayFile;
+        _GLFWwindow*    replayWindow;
+        // Set while replayed events are injected
+        GLFWbool        injecting;
+        uint64_t        replayFrequency;
+        // Timer value at which the current replayed frame was recorded
+        uint64_t        replayTime;
+        _GLFWinputrecord next;
+    } inputLog;
+
     struct {
         GLFWbool        available;
         void*           handle;
@@ -762,6 +806,14 @@ void _glfwAllocGammaArrays(GLFWgammaramp* ramp, unsigned int size);
 void _glfwFreeGammaArrays(GLFWgammaramp* ramp);
 void _glfwSplitBPP(int bpp, int* red, int* green, int* blue);
 
+void _glfwInputLogFrame(void);
+GLFWbool _glfwInputLogIgnoresPlatform(void);
+void _glfwInputLogKey(int key, int scancode, int action, int mods);
+void _glfwInputLogMouseClick(int button, int action, int mods);
+void _glfwInputLogCursorPos(double xpos, double ypos);
+void _glfwInputLogScroll(double xoffset, double yoffset);
+void _glfwTerminateInputLog(void);
+
 void _glfwInitGamepadMappings(void);
 _GLFWjoystick* _glfwAllocJoystick(const char* name,
                                   const char* guid,
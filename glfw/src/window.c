@@ -434,6 +434,9 @@ GLFWAPI void glfwDestroyWindow(GLFWwindow* handle)
     if (window == _glfwPlatformGetTls(&_glfw.contextSlot))
         glfwMakeContextCurrent(NULL);
 
+    if (window == _glfw.inputLog.replayWindow)
+        _glfw.inputLog.replayWindow = NULL;
+
     _glfwPlatformDestroyWindow(window);
 
     // Unlink window from global linked list
@@ -1069,6 +1072,7 @@ GLFWAPI void glfwPollEvents(void)
 {
     _GLFW_REQUIRE_INIT();
     _glfwPlatformPollEvents();
+    _glfwInputLogFrame();
 }
 
 GLFWAPI void glfwWaitEvents(void)
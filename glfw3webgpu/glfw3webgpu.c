@@ -38,8 +38,11 @@
 #define WGPU_TARGET_LINUX_X11 2
 #define WGPU_TARGET_WINDOWS 3
 #define WGPU_TARGET_LINUX_WAYLAND 4
+#define WGPU_TARGET_NULL 5
 
-#if defined(_WIN32)
+#if defined(GLFW3WEBGPU_NULL_PLATFORM)
+#define WGPU_TARGET WGPU_TARGET_NULL
+#elif defined(_WIN32)
 #define WGPU_TARGET WGPU_TARGET_WINDOWS
 #elif defined(__APPLE__)
 #define WGPU_TARGET WGPU_TARGET_MACOS
@@ -62,7 +65,9 @@
 #elif WGPU_TARGET == WGPU_TARGET_WINDOWS
 #define GLFW_EXPOSE_NATIVE_WIN32
 #endif
+#if WGPU_TARGET != WGPU_TARGET_NULL
 #include <GLFW/glfw3native.h>
+#endif
 
 WGPUSurface glfwGetWGPUSurface(WGPUInstance instance, GLFWwindow* window) {
 #if WGPU_TARGET == WGPU_TARGET_MACOS
@@ -152,6 +157,13 @@ WGPUSurface glfwGetWGPUSurface(WGPUInstance instance, GLFWwindow* window) {
         },
     });
   }
+#elif WGPU_TARGET == WGPU_TARGET_NULL
+    {
+        // Windows of the null platform are not displayed anywhere
+        (void)instance;
+        (void)window;
+        return NULL;
+    }
 #else
 #error "Unsupported WGPU_TARGET"
 #endif
@@ -38,7 +38,8 @@ extern "C" {
 #endif
 
 /**
- * Get a WGPUSurface from a GLFW window.
+ * Get a WGPUSurface from a GLFW window. Returns NULL when GLFW was built with
+ * its null platform, whose windows are not displayed.
  */
 WGPUSurface glfwGetWGPUSurface(WGPUInstance instance, GLFWwindow* window);
 
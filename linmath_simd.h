@@ -0,0 +1,62 @@
+#pragma once
+
+/**
+ * Drop-in replacement for glfw/deps/linmath.h: include this instead and the
+ * matrix product, matrix inverse, matrix-vector product and quaternion
+ * product/rotation/conversion run on the SIMD kernels of SimdMath.h, while
+ * the rest of linmath is left untouched.
+ *
+ * The scalar originals remain available with a linmath_scalar_ prefix. The
+ * other linmath functions that call them internally (mat4x4_rotate_X,
+ * mat4x4_orthonormalize, ...) keep using these scalar versions.
+ */
+
+#include "SimdMath.h"
+
+#define mat4x4_mul linmath_scalar_mat4x4_mul
+#define mat4x4_mul_vec4 linmath_scalar_mat4x4_mul_vec4
+#define mat4x4_invert linmath_scalar_mat4x4_invert
+#define quat_mul linmath_scalar_quat_mul
+#define quat_mul_vec3 linmath_scalar_quat_mul_vec3
+#define mat4x4_from_quat linmath_scalar_mat4x4_from_quat
+
+#include "glfw/deps/linmath.h"
+
+#undef mat4x4_mul
+#undef mat4x4_mul_vec4
+#undef mat4x4_invert
+#undef quat_mul
+#undef quat_mul_vec3
+#undef mat4x4_from_quat
+
+static inline void mat4x4_mul(mat4x4 M, mat4x4 a, mat4x4 b) {
+	mat4MulRaw(M[0], a[0], b[0]);
+}
+
+static inline void mat4x4_mul_vec4(vec4 r, mat4x4 M, vec4 v) {
+	mat4MulVec4Raw(r, M[0], v);
+}
+
+// Unlike the scalar version, leaves T untouched if M is not invertible
+static inline void mat4x4_invert(mat4x4 T, mat4x4 M) {
+	mat4InverseRaw(T[0], M[0]);
+}
+
+static inline void quat_mul(quat r, quat p, quat q) {
+	quatMulRaw(r, p, q);
+}
+
+static inline void quat_mul_vec3(vec3 r, quat q, vec3 v) {
+	quatRotateRaw(r, q, v);
+}
+
+static inline void mat4x4_from_quat(mat4x4 M, quat q) {
+	Quat rotation = { q[0], q[1], q[2], q[3] };
+	Mat4 m = quatToMat4(rotation);
+	for (int c = 0; c < 4; ++c) {
+		M[c][0] = m.columns[c].x;
+		M[c][1] = m.columns[c].y;
+		M[c][2] = m.columns[c].z;
+		M[c][3] = m.columns[c].w;
+	}
+}
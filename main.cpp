@@ -1,21 +1,183 @@
 #include <iostream>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+
+#include "AntiAliasing.h"
+#include "BindGroupCache.h"
+#include "Culling.h"
+#include "DepthBuffer.h"
+#include "DrawConstants.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "GpuCulling.h"
+#include "MipmapGenerator.h"
+#include "ParticleSystem.h"
+#include "ResizableSwapChain.h"
+#include "SimdMath.h"
+#include "TextureCompression.h"
+#include "TextureStreamer.h"
+#include "ThreadPool.h"
+#include "TransformHierarchy.h"
+#include "UniformAllocator.h"
 
-#define WEBGPU_CPP_IMPLEMENTATION
 #include "webgpu/webgpu.hpp"
 
 #include <glfw3webgpu.h>
 #include <GLFW/glfw3.h>
 
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif
+
 using namespace wgpu;
 
 const int SCREEN_WIDTH = 640;
 const int SCREEN_HEIGHT = 480;
 const char* SCREEN_TITLE = "Learn WebGPU";
 
-int main (int, char**) {
+// The scene is a grid of copies of our geometry that is much larger than
+// what the camera sees at once, so that most of the objects get culled.
+const uint32_t GRID_SIZE = 200;
+const uint32_t OBJECT_COUNT = GRID_SIZE * GRID_SIZE;
+const float GRID_SPACING = 1.5f;
+// Half of the height of the world region seen by the camera
+const float VIEW_HALF_HEIGHT = 8.0f;
+// Uniform data allocated per frame
+const uint32_t UNIFORM_CAPACITY = 64 * 1024;
+// Size of the texture applied on all objects, streamed in as needed
+const uint32_t TEXTURE_SIZE = 2048;
+// How much closer the camera gets when zooming in
+const float ZOOM_FACTOR = 8.0f;
+// Frame rate of the videos captured with --capture
+const uint32_t CAPTURE_FPS = 60;
+// Samples per pixel when anti-aliasing with MSAA
+const uint32_t MSAA_SAMPLE_COUNT = 4;
+
+// How the edges of the objects are anti-aliased, chosen with --aa
+enum class AntiAliasing {
+	None,
+	Msaa,
+	Fxaa,
+};
+
+// Per-instance data, fed to the vertex shader through a second vertex buffer
+struct InstanceData {
+	Mat4 model;
+};
+
+// Matches the CameraUniforms struct of the shader
+struct CameraUniforms {
+	Mat4 viewProj;
+};
+
+// Parameters set before each draw call, matches the DrawParams struct of the shader
+struct DrawParams {
+	Vec4 tint;
+};
+
+int main (int argc, char** argv) {
     std::cout << "Starting application... 🚀" << std::endl;
 
+    // Run with --capture <file> to record the frames into a video file,
+    // in the YUV4MPEG2 format if its extension is .y4m and as raw texels
+    // otherwise
+    const char* capturePath = nullptr;
+    // Run with --aa none, msaa or fxaa to choose the anti-aliasing
+    AntiAliasing antiAliasing = AntiAliasing::Msaa;
+    // Run with --depth-prepass to render the depth of the scene in a first
+    // pass, so that the main pass shades each pixel once
+    bool depthPrepass = false;
+    // Run with --headless to render offscreen even when the window could be
+    // displayed. Builds with LEARNWEBGPU_HEADLESS always do, as their windows
+    // have no surface.
+    bool headless = false;
+    // Run with --frames <count> to quit after rendering that many frames,
+    // which headless runs need since their window cannot be closed
+    uint64_t maxFrameCount = 0;
+    // Run with --record <file> to save the input of the session, and with
+    // --replay <file> to play it back at the same frames, with the time of
+    // each frame as recorded, so that runs render the exact same frames.
+    // Replay quits at the end of the file.
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    // Run with --present-mode fifo, mailbox or immediate to choose how
+    // frames reach the display, which the surface must support
+    PresentMode presentMode = PresentMode::Fifo;
+    // Run with --no-pacing to poll events and render frames back to back,
+    // instead of sleeping until just before each frame is due
+    bool framePacing = true;
+    // Run with --particles <count> to add a fountain of up to that many
+    // particles, simulated and drawn on the GPU
+    uint32_t particleCapacity = 0;
+    // Options followed by a value
+    const std::vector<std::string> valueOptions = { "--frames", "--record", "--replay", "--capture", "--particles", "--aa", "--present-mode" };
+    const char* usage = "Usage: LearnWebGPU [--aa none|msaa|fxaa] [--present-mode fifo|mailbox|immediate] "
+        "[--depth-prepass] [--no-pacing] [--headless] [--frames <count>] [--record <file>] [--replay <file>] "
+        "[--capture <file>] [--particles <count>]";
+    // Counts are whole numbers up to maxCount. std::stoul would throw on
+    // anything else, and wrap "-1" around.
+    auto parseCount = [](const std::string& text, uint64_t maxCount, uint64_t& count) {
+        if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+            return false;
+        }
+        errno = 0;
+        count = std::strtoull(text.c_str(), nullptr, 10);
+        return errno != ERANGE && count <= maxCount;
+    };
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        bool hasValue = std::find(valueOptions.begin(), valueOptions.end(), option) != valueOptions.end();
+        if (hasValue && i + 1 >= argc) {
+            std::cerr << "Missing value after " << option << std::endl << usage << std::endl;
+            return 1;
+        }
+        // Past this, argv[i] is the value of the option, if it has one
+        std::string value = hasValue ? argv[++i] : "";
+        uint64_t count = 0;
+        bool isCount = option == "--frames" || option == "--particles";
+        if (isCount && !parseCount(value, option == "--particles" ? UINT32_MAX : UINT64_MAX, count)) {
+            std::cerr << "Invalid count '" << value << "' after " << option << std::endl << usage << std::endl;
+            return 1;
+        }
+        if (option == "--depth-prepass") {
+            depthPrepass = true;
+        } else if (option == "--no-pacing") {
+            framePacing = false;
+        } else if (option == "--headless") {
+            headless = true;
+        } else if (option == "--frames") {
+            maxFrameCount = count;
+        } else if (option == "--record") {
+            recordPath = argv[i];
+        } else if (option == "--replay") {
+            replayPath = argv[i];
+        } else if (option == "--capture") {
+            capturePath = argv[i];
+        } else if (option == "--particles") {
+            particleCapacity = static_cast<uint32_t>(count);
+        } else if (option == "--aa") {
+            if (value == "none") antiAliasing = AntiAliasing::None;
+            else if (value == "msaa") antiAliasing = AntiAliasing::Msaa;
+            else if (value == "fxaa") antiAliasing = AntiAliasing::Fxaa;
+            else std::cerr << "Unknown anti-aliasing '" << value << "', using MSAA" << std::endl;
+        } else if (option == "--present-mode") {
+            if (value == "fifo") presentMode = PresentMode::Fifo;
+            else if (value == "mailbox") presentMode = PresentMode::Mailbox;
+            else if (value == "immediate") presentMode = PresentMode::Immediate;
+            else std::cerr << "Unknown present mode '" << value << "', using Fifo" << std::endl;
+        } else {
+            std::cerr << "Unknown option " << option << std::endl << usage << std::endl;
+            return 1;
+        }
+    }
+
 	InstanceDescriptor instanceDesc{};
 	Instance instance = createInstance(instanceDesc);
 
@@ -33,8 +195,9 @@ int main (int, char**) {
     
     // Don't initialize any particular graphics API by default. We do that manually.
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API); 
-    // Don't allow the window to be resized
-    glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+    // Captured frames keep the size of the video, and headless windows have
+    // no border to drag, so only windows we present to can be resized
+    glfwWindowHint(GLFW_RESIZABLE, capturePath || headless ? GLFW_FALSE : GLFW_TRUE);
     // Create window
     GLFWwindow* window = glfwCreateWindow(SCREEN_WIDTH, SCREEN_HEIGHT, SCREEN_TITLE, NULL, NULL);
     if (!window) {
@@ -44,7 +207,10 @@ int main (int, char**) {
     }
 
     std::cout << "🚚 Requesting adapter..." << std::endl;
-    Surface surface = glfwGetWGPUSurface(instance, window);
+    Surface surface = headless ? nullptr : glfwGetWGPUSurface(instance, window);
+    if (!surface) {
+        std::cout << "ℹ️ No surface, rendering offscreen" << std::endl;
+    }
 	RequestAdapterOptions adapterOpts{};
     adapterOpts.compatibleSurface = surface;
     Adapter adapter = instance.requestAdapter(adapterOpts);
@@ -54,27 +220,83 @@ int main (int, char**) {
 	SupportedLimits supportedLimits;
 	adapter.getLimits(&supportedLimits);
 
+	// Per-draw parameters are sent as push constants when the adapter
+	// supports them, and as uniforms with a dynamic offset otherwise
+	bool usePushConstants = DrawConstants::pushConstantsSupported(adapter);
+
     std::cout << "🚚 Requesting device..." << std::endl;
     // Create required limits
     RequiredLimits requiredLimits = Default;
-	// We use at most 1 vertex attribute for now
-	requiredLimits.limits.maxVertexAttributes = 2;
-	// We should also tell that we use 1 vertex buffers
-	requiredLimits.limits.maxVertexBuffers = 1;
-	// Maximum size of a buffer is 6 vertices of 2 float each
-	requiredLimits.limits.maxBufferSize = 6 * 5 * sizeof(float);
-	// Maximum stride between 2 consecutive vertices in the vertex buffer
-	requiredLimits.limits.maxVertexBufferArrayStride = 5 * sizeof(float);
+	// 2 attributes per vertex, plus 4 per instance for the model matrix
+	requiredLimits.limits.maxVertexAttributes = 6;
+	// One buffer for vertices and one for instances
+	requiredLimits.limits.maxVertexBuffers = 2;
+	// The largest buffer is the instance buffer, when all objects are visible
+	requiredLimits.limits.maxBufferSize = OBJECT_COUNT * sizeof(InstanceData);
+	// Maximum stride between 2 consecutive elements of a vertex buffer
+	requiredLimits.limits.maxVertexBufferArrayStride = sizeof(InstanceData);
+	// The camera is exposed to the vertex shader through a uniform buffer
+	// bound with a dynamic offset
+	UniformAllocator::requireLimits(requiredLimits.limits, sizeof(CameraUniforms));
+	// The streamed texture and its sampler are bound at group 1
+	TextureStreamer::requireLimits(requiredLimits.limits, TEXTURE_SIZE);
+	// Mip tails of the streamed textures are generated on the GPU
+	MipmapGenerator::requireLimits(requiredLimits.limits, TEXTURE_SIZE);
+	requiredLimits.limits.maxBindGroups = std::max(requiredLimits.limits.maxBindGroups, 2u);
+	// Per-draw parameters, at group 2 when they are uniforms
+	DrawConstants::LimitsExtras drawConstantsLimits;
+	DrawConstants::requireLimits(requiredLimits, drawConstantsLimits, usePushConstants, sizeof(DrawParams), 2);
+	if (!usePushConstants) {
+		// The camera and the draw parameters are two dynamic uniform buffers
+		// of the same pipeline layout, both visible to the vertex shader
+		requiredLimits.limits.maxUniformBuffersPerShaderStage = std::max(requiredLimits.limits.maxUniformBuffersPerShaderStage, 2u);
+		requiredLimits.limits.maxDynamicUniformBuffersPerPipelineLayout = std::max(requiredLimits.limits.maxDynamicUniformBuffersPerPipelineLayout, 2u);
+	}
+	// Storage buffers and compute limits used by GPU-driven culling
+	GpuCuller::requireLimits(requiredLimits.limits, OBJECT_COUNT, sizeof(InstanceData));
+	// FXAA samples the rendered frame in a second pass
+	if (antiAliasing == AntiAliasing::Fxaa) {
+		FxaaPass::requireLimits(requiredLimits.limits);
+	}
+	// Captured frames are read back into buffers of a whole frame
+	if (capturePath) {
+		FrameCapture::requireLimits(requiredLimits.limits, SCREEN_WIDTH, SCREEN_HEIGHT);
+	}
+	// Particles are simulated in compute passes and drawn from storage
+	if (particleCapacity > 0) {
+		ParticleSystem::requireLimits(requiredLimits.limits, particleCapacity);
+	}
 	// This must be set even if we do not use storage buffers for now
 	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
-	// This must be set even if we do not use uniform buffers for now
+	// The uniform allocator aligns its allocations on this
 	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
-    requiredLimits.limits.maxInterStageShaderComponents = 3;
+	// The swap chain and the render targets follow the size of the window,
+	// which may grow past the default 2D texture limit when it is resized
+	requiredLimits.limits.maxTextureDimension2D = std::max(requiredLimits.limits.maxTextureDimension2D, supportedLimits.limits.maxTextureDimension2D);
+    // Color and texture coordinates
+    requiredLimits.limits.maxInterStageShaderComponents = std::max(requiredLimits.limits.maxInterStageShaderComponents, 5u);
 
     // Setup device
     DeviceDescriptor deviceDesc{};
     deviceDesc.label = "My device";
-    deviceDesc.requiredFeaturesCount = 0;
+    // Enable the features that speed up GPU-driven culling, when available
+    std::vector<WGPUFeatureName> requiredFeatures;
+    for (FeatureName feature : GpuCuller::optionalFeatures()) {
+        if (adapter.hasFeature(feature)) {
+            requiredFeatures.push_back(feature);
+        }
+    }
+    // Block-compressed textures use the formats the adapter can sample
+    for (FeatureName feature : TextureCompressor::optionalFeatures()) {
+        if (adapter.hasFeature(feature)) {
+            requiredFeatures.push_back(feature);
+        }
+    }
+    for (FeatureName feature : DrawConstants::requiredFeatures(usePushConstants)) {
+        requiredFeatures.push_back(feature);
+    }
+    deviceDesc.requiredFeaturesCount = (uint32_t)requiredFeatures.size();
+    deviceDesc.requiredFeatures = requiredFeatures.data();
     deviceDesc.requiredLimits = &requiredLimits;
     deviceDesc.defaultQueue.label = "My default queue";
 
@@ -95,52 +317,134 @@ int main (int, char**) {
     };
     device.setUncapturedErrorCallback(onDeviceError);
 
+    // Bind group layouts and bind groups are looked up in this cache rather
+    // than created directly, so that identical ones are shared.
+    BindGroupCache bindGroupCache(device);
+
     Queue queue = device.getQueue();
 
-    std::cout << "🚚 Creating swapchain..." << std::endl;
-    SwapChainDescriptor swapChainDesc = {};
-    swapChainDesc.width = SCREEN_WIDTH;
-    swapChainDesc.height = SCREEN_HEIGHT;
+    // All uniforms of a frame go in one buffer, read through a single
+    // bind group at different dynamic offsets.
+    UniformAllocator uniforms(device, UNIFORM_CAPACITY, std::max<uint32_t>(sizeof(CameraUniforms), sizeof(DrawParams)));
+    DrawConstants drawConstants(device, usePushConstants, sizeof(DrawParams), ShaderStage::Vertex | ShaderStage::Fragment, 2, uniforms, bindGroupCache);
+    std::cout << "ℹ️ Per-draw parameters use " << (usePushConstants ? "push constants" : "dynamic uniform offsets") << std::endl;
+
 #if WEBGPU_BACKEND_DAWN
     TextureFormat swapChainFormat = WGPUTextureFormat_BGRA8Unorm; // getPreferredFormat is not implemented in Dawn yet
 #else
-    TextureFormat swapChainFormat = surface.getPreferredFormat(adapter);
+    // Offscreen targets use the format most surfaces prefer
+    TextureFormat swapChainFormat = TextureFormat::BGRA8Unorm;
+    if (surface) {
+        swapChainFormat = surface.getPreferredFormat(adapter);
+    }
 #endif
-    swapChainDesc.format = swapChainFormat;
-    // Like buffers, textures are allocated for a specific usage. In our case,
-	// we will use them as the target of a Render Pass so it needs to be created
-	// with the `RenderAttachment` usage flag.
-    swapChainDesc.usage = TextureUsage::RenderAttachment;
-    // FIFO stands for "first in, first out", meaning that the presented
-	// texture is always the oldest one, like a regular queue.
-    swapChainDesc.presentMode = PresentMode::Fifo;
-    SwapChain swapChain = device.createSwapChain(surface, swapChainDesc);
-    std::cout << "✅ Swapchain: " << swapChain << std::endl;
+    std::unique_ptr<ResizableSwapChain> swapChain;
+    if (surface) {
+        std::cout << "🚚 Creating swapchain..." << std::endl;
+        // Sized after the framebuffer of the window, which may have more
+        // pixels than the size of the window on high DPI displays
+        SwapChainDescriptor swapChainDesc = {};
+        swapChainDesc.width = SCREEN_WIDTH;
+        swapChainDesc.height = SCREEN_HEIGHT;
+        swapChainDesc.format = swapChainFormat;
+        // Like buffers, textures are allocated for a specific usage. In our case,
+        // we will use them as the target of a Render Pass so it needs to be created
+        // with the `RenderAttachment` usage flag.
+        swapChainDesc.usage = TextureUsage::RenderAttachment;
+        // FIFO stands for "first in, first out", meaning that the presented
+        // texture is always the oldest one, like a regular queue. Mailbox
+        // replaces the queued texture with the latest one, and Immediate
+        // presents right away, at the cost of tearing.
+        swapChainDesc.presentMode = presentMode;
+        swapChain = std::make_unique<ResizableSwapChain>(window, device, surface, swapChainDesc);
+        std::cout << "✅ Swapchain: " << swapChain->swapChain() << " (" << FramePacer::presentModeName(presentMode) << ", "
+            << swapChain->width() << "x" << swapChain->height() << ")" << std::endl;
+    }
+
+    // Size of the rendered frames, which follows the swap chain when
+    // frames are presented, and stays that of the offscreen target otherwise
+    uint32_t frameWidth = SCREEN_WIDTH;
+    uint32_t frameHeight = SCREEN_HEIGHT;
+    if (swapChain && !capturePath) {
+        frameWidth = swapChain->width();
+        frameHeight = swapChain->height();
+    }
+
+    // The main pass draws into a multisampled texture that gets resolved
+    // into the swap chain, or directly into the swap chain with 1 sample.
+    // FXAA instead draws into an intermediate texture that it then filters
+    // into the swap chain.
+    uint32_t sampleCount = antiAliasing == AntiAliasing::Msaa ? MSAA_SAMPLE_COUNT : 1;
+    MultisampleTarget multisampleTarget(device, swapChainFormat, sampleCount);
+    multisampleTarget.resize(frameWidth, frameHeight);
+    std::unique_ptr<FxaaPass> fxaaPass;
+    if (antiAliasing == AntiAliasing::Fxaa) {
+        fxaaPass = std::make_unique<FxaaPass>(device, swapChainFormat);
+        fxaaPass->resize(frameWidth, frameHeight);
+    }
+    std::cout << "ℹ️ Anti-aliasing: " << (fxaaPass ? "FXAA" : sampleCount > 1 ? "MSAA" : "none")
+        << ", " << (multisampleTarget.memoryBytes() + (fxaaPass ? fxaaPass->memoryBytes() : 0)) / 1024 << " KiB of extra render targets" << std::endl;
+
+    // The depth buffer has as many samples as the color target
+    DepthBuffer depthBuffer(device, sampleCount, depthPrepass);
+    depthBuffer.resize(frameWidth, frameHeight);
+    std::cout << "ℹ️ Depth prepass: " << (depthBuffer.hasPrepass() ? "on" : "off") << std::endl;
 
 	std::cout << "🚚 Creating shader module..." << std::endl;
-	const char* shaderSource = R"(
+	std::string shaderSource = R"(
+struct CameraUniforms {
+    viewProj: mat4x4f,
+}
+
+struct DrawParams {
+    tint: vec4f,
+}
+
+@group(0) @binding(0) var<uniform> uCamera: CameraUniforms;
+@group(1) @binding(0) var uTexture: texture_2d<f32>;
+@group(1) @binding(1) var uSampler: sampler;
+)" + drawConstants.wgslDeclaration("uDraw", "DrawParams") + R"(
+
 struct VertexInput {
     @location(0) position: vec2f,
     @location(1) color: vec3f,
 }
 
+struct InstanceInput {
+    @location(2) model0: vec4f,
+    @location(3) model1: vec4f,
+    @location(4) model2: vec4f,
+    @location(5) model3: vec4f,
+}
+
+// Both vertex shaders must compute the exact same depth for the main
+// pass' Equal depth test to pass after the prepass
 struct VertexOutput {
-    @builtin(position) position: vec4f,
+    @builtin(position) @invariant position: vec4f,
     @location(0) color: vec3f,
+    @location(1) uv: vec2f,
 }
 
 @vertex
-fn vs_main(in: VertexInput) -> VertexOutput {
+fn vs_main(in: VertexInput, instance: InstanceInput) -> VertexOutput {
     var out: VertexOutput;
-    out.position = vec4f(in.position, 0.0, 1.0);
+    let model = mat4x4f(instance.model0, instance.model1, instance.model2, instance.model3);
+    out.position = uCamera.viewProj * model * vec4f(in.position, 0.0, 1.0);
     out.color = in.color;
+    out.uv = in.position + 0.5;
 	return out;
 }
 
+@vertex
+fn vs_depth(@location(0) position: vec2f, instance: InstanceInput) -> @builtin(position) @invariant vec4f {
+    let model = mat4x4f(instance.model0, instance.model1, instance.model2, instance.model3);
+    return uCamera.viewProj * model * vec4f(position, 0.0, 1.0);
+}
 
 @fragment
 fn fs_main(in: VertexOutput) -> @location(0) vec4f {
-    return vec4f(in.color, 1.0);
+    let texel = textureSample(uTexture, uSampler, in.uv).rgb;
+    return vec4f(in.color * texel * uDraw.tint.rgb, 1.0);
 }
 )";
     // Setup shader module
@@ -158,7 +462,7 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
 	shaderDesc.nextInChain = &shaderCodeDesc.chain;
 
 	// Setup the actual payload of the shader code descriptor
-	shaderCodeDesc.code = shaderSource;
+	shaderCodeDesc.code = shaderSource.c_str();
 
     ShaderModule shaderModule = device.createShaderModule(shaderDesc);
 	std::cout << "✅ Shader module: " << shaderModule << std::endl;
@@ -184,11 +488,57 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
 	vertexBufferLayout.arrayStride = 5 * sizeof(float);
 	vertexBufferLayout.stepMode = VertexStepMode::Vertex;
 
+	// Instance fetch: the model matrix is split into its 4 columns
+	std::vector<VertexAttribute> instanceAttribs(4);
+	for (uint32_t i = 0; i < 4; ++i) {
+		instanceAttribs[i].shaderLocation = 2 + i;
+		instanceAttribs[i].format = VertexFormat::Float32x4;
+		instanceAttribs[i].offset = 4 * i * sizeof(float);
+	}
+
+	VertexBufferLayout instanceBufferLayout;
+	instanceBufferLayout.attributeCount = (uint32_t)instanceAttribs.size();
+	instanceBufferLayout.attributes = instanceAttribs.data();
+	instanceBufferLayout.arrayStride = sizeof(InstanceData);
+	// Attributes of this buffer advance once per instance rather than per vertex
+	instanceBufferLayout.stepMode = VertexStepMode::Instance;
+
+	std::vector<VertexBufferLayout> bufferLayouts = { vertexBufferLayout, instanceBufferLayout };
+
+	// Describe the camera uniform binding, whose offset in the per-frame
+	// uniform buffer is given when binding it
+	BindGroupLayoutEntry bindingLayout = UniformAllocator::layoutEntry(0, ShaderStage::Vertex, sizeof(CameraUniforms));
+
+	BindGroupLayoutDescriptor bindGroupLayoutDesc{};
+	bindGroupLayoutDesc.entryCount = 1;
+	bindGroupLayoutDesc.entries = &bindingLayout;
+	BindGroupLayout bindGroupLayout = bindGroupCache.getLayout(bindGroupLayoutDesc);
+
+	// The texture binding and its sampler
+	std::vector<BindGroupLayoutEntry> textureBindingLayouts(2, Default);
+	textureBindingLayouts[0].binding = 0;
+	textureBindingLayouts[0].visibility = ShaderStage::Fragment;
+	textureBindingLayouts[0].texture.sampleType = TextureSampleType::Float;
+	textureBindingLayouts[0].texture.viewDimension = TextureViewDimension::_2D;
+	textureBindingLayouts[1].binding = 1;
+	textureBindingLayouts[1].visibility = ShaderStage::Fragment;
+	textureBindingLayouts[1].sampler.type = SamplerBindingType::Filtering;
+
+	BindGroupLayoutDescriptor textureBindGroupLayoutDesc{};
+	textureBindGroupLayoutDesc.entryCount = (uint32_t)textureBindingLayouts.size();
+	textureBindGroupLayoutDesc.entries = textureBindingLayouts.data();
+	BindGroupLayout textureBindGroupLayout = bindGroupCache.getLayout(textureBindGroupLayoutDesc);
+
+	// The per-draw parameters add either a push constant range or a third
+	// bind group layout
+	PipelineLayout pipelineLayout = drawConstants.createPipelineLayout({ bindGroupLayout, textureBindGroupLayout });
+
     // Setup render pipeline
     RenderPipelineDescriptor pipelineDesc{};
+    pipelineDesc.layout = pipelineLayout;
     // Setup vertex shader
-    pipelineDesc.vertex.bufferCount = 1;
-    pipelineDesc.vertex.buffers = &vertexBufferLayout;
+    pipelineDesc.vertex.bufferCount = (uint32_t)bufferLayouts.size();
+    pipelineDesc.vertex.buffers = bufferLayouts.data();
     pipelineDesc.vertex.module = shaderModule;
     pipelineDesc.vertex.entryPoint = "vs_main";
     pipelineDesc.vertex.constantCount = 0;
@@ -234,19 +584,55 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
     fragmentState.targetCount = 1;
     fragmentState.targets = &colorTarget;
 
-    pipelineDesc.depthStencil = nullptr;
+    // Opaque objects are depth tested, against the depth of the prepass
+    // if there is one
+    DepthStencilState depthStencilState = depthBuffer.mainPassDepthState();
+    pipelineDesc.depthStencil = &depthStencilState;
 
     // Multi-sampling
-	// Samples per pixel
-	pipelineDesc.multisample.count = 1;
+	// Samples per pixel, which must match the color target
+	pipelineDesc.multisample.count = multisampleTarget.sampleCount();
 	// Default value for the mask, meaning "all bits on"
 	pipelineDesc.multisample.mask = ~0u;
-	// Default value as well (irrelevant for count = 1 anyways)
+	// Default value as well
 	pipelineDesc.multisample.alphaToCoverageEnabled = false;
 
     RenderPipeline pipeline = device.createRenderPipeline(pipelineDesc);
     std::cout << "✅ Render pipeline: " << pipeline << std::endl;
 
+    // The depth prepass only reads positions, from a buffer of their own so
+    // that no other attribute gets fetched, and has no fragment shader.
+    // It only needs the camera.
+    VertexAttribute positionAttrib;
+    positionAttrib.shaderLocation = 0;
+    positionAttrib.format = VertexFormat::Float32x2;
+    positionAttrib.offset = 0;
+    VertexBufferLayout positionBufferLayout;
+    positionBufferLayout.attributeCount = 1;
+    positionBufferLayout.attributes = &positionAttrib;
+    positionBufferLayout.arrayStride = 2 * sizeof(float);
+    positionBufferLayout.stepMode = VertexStepMode::Vertex;
+    std::vector<VertexBufferLayout> prepassBufferLayouts = { positionBufferLayout, instanceBufferLayout };
+
+    PipelineLayout prepassPipelineLayout = nullptr;
+    RenderPipeline prepassPipeline = nullptr;
+    if (depthBuffer.hasPrepass()) {
+        PipelineLayoutDescriptor prepassPipelineLayoutDesc{};
+        prepassPipelineLayoutDesc.bindGroupLayoutCount = 1;
+        prepassPipelineLayoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
+        prepassPipelineLayout = device.createPipelineLayout(prepassPipelineLayoutDesc);
+
+        DepthStencilState prepassDepthStencilState = depthBuffer.prepassDepthState();
+        pipelineDesc.layout = prepassPipelineLayout;
+        pipelineDesc.vertex.bufferCount = (uint32_t)prepassBufferLayouts.size();
+        pipelineDesc.vertex.buffers = prepassBufferLayouts.data();
+        pipelineDesc.vertex.entryPoint = "vs_depth";
+        pipelineDesc.fragment = nullptr;
+        pipelineDesc.depthStencil = &prepassDepthStencilState;
+        prepassPipeline = device.createRenderPipeline(pipelineDesc);
+        std::cout << "✅ Depth prepass pipeline: " << prepassPipeline << std::endl;
+    }
+
     // Static vertex buffer
     std::vector<float> vertexData = {
         // x0,  y0,  r0,  g0,  b0
@@ -270,39 +656,403 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
 
     queue.writeBuffer(vertexBuffer, 0, vertexData.data(), bufferDesc.size);
 
+    std::vector<float> positionData(2 * vertexCount);
+    for (int i = 0; i < vertexCount; ++i) {
+        positionData[2 * i] = vertexData[5 * i];
+        positionData[2 * i + 1] = vertexData[5 * i + 1];
+    }
+    bufferDesc.size = positionData.size() * sizeof(float);
+    Buffer positionBuffer = device.createBuffer(bufferDesc);
+    queue.writeBuffer(positionBuffer, 0, positionData.data(), bufferDesc.size);
+
+    ThreadPool threadPool;
+
+    // Lay out the objects on a grid, as children of one node per row of the
+    // grid, and compute their bounding volumes in world space for culling.
+    // The geometry spans [-0.55, 0.5] x [-0.5, 0.5], so a box of half-size
+    // 0.75 around the origin of an object contains it whatever its rotation.
+    // Objects are spread in depth so that overlapping ones get depth tested.
+    std::vector<InstanceData> instances(OBJECT_COUNT);
+    BoundsSoA bounds;
+    bounds.resize(OBJECT_COUNT);
+    TransformHierarchy transforms(&threadPool);
+    // World matrices land directly in the instance data
+    transforms.setInstanceOutput(instances.data(), sizeof(InstanceData));
+    TransformHierarchy::NodeId gridNode = transforms.createNode(TransformHierarchy::NO_PARENT, TransformHierarchy::Transform{});
+    std::vector<TransformHierarchy::NodeId> rowNodes(GRID_SIZE);
+    for (uint32_t row = 0; row < GRID_SIZE; ++row) {
+        TransformHierarchy::Transform local;
+        local.translation.y = (static_cast<float>(row) - 0.5f * GRID_SIZE) * GRID_SPACING;
+        rowNodes[row] = transforms.createNode(gridNode, local);
+    }
+    std::vector<TransformHierarchy::NodeId> objectNodes(OBJECT_COUNT);
+    for (uint32_t i = 0; i < OBJECT_COUNT; ++i) {
+        float x = (static_cast<float>(i % GRID_SIZE) - 0.5f * GRID_SIZE) * GRID_SPACING;
+        float y = (static_cast<float>(i / GRID_SIZE) - 0.5f * GRID_SIZE) * GRID_SPACING;
+        float scale = 0.5f + 0.5f * static_cast<float>((i * 7919) % 100) / 100.0f;
+        float z = static_cast<float>((i * 104729) % 100) / 100.0f - 0.5f;
+
+        TransformHierarchy::Transform local;
+        local.translation.x = x;
+        local.translation.z = z;
+        local.scale = Vec4{ scale, scale, scale, 0.0f };
+        objectNodes[i] = transforms.createNode(rowNodes[i / GRID_SIZE], local, i);
+
+        bounds.set(i, x, y, z, 0.75f * scale, 0.75f * scale, 0.0f);
+    }
+    auto updateStart = std::chrono::steady_clock::now();
+    transforms.update();
+    double updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - updateStart).count();
+    std::cout << "ℹ️ Transform update: " << 100000.0 * updateMs / transforms.nodeCount() << " ms per 100k nodes" << std::endl;
+
+    // Only the visible instances are uploaded, compacted at the beginning
+    // of the instance buffer.
+    BufferDescriptor instanceBufferDesc;
+    instanceBufferDesc.size = OBJECT_COUNT * sizeof(InstanceData);
+    instanceBufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
+    instanceBufferDesc.mappedAtCreation = false;
+    Buffer instanceBuffer = device.createBuffer(instanceBufferDesc);
+    std::vector<InstanceData> visibleInstances(OBJECT_COUNT);
+    // Visible objects, sorted front to back
+    std::vector<std::pair<float, uint32_t>> drawOrder;
+    drawOrder.reserve(OBJECT_COUNT);
+
+    BindGroupEntry cameraBinding = uniforms.bindGroupEntry(0, sizeof(CameraUniforms));
+    BindGroupDescriptor bindGroupDesc{};
+    bindGroupDesc.layout = bindGroupLayout;
+    bindGroupDesc.entryCount = 1;
+    bindGroupDesc.entries = &cameraBinding;
+
+    FrustumCuller culler(&threadPool);
+    std::cout << "ℹ️ Culling " << OBJECT_COUNT << " objects with " << cullingSimdName()
+        << " on " << threadPool.threadCount() << " threads" << std::endl;
+
+    // GPU-driven alternative: all objects use the same mesh, namely the
+    // whole vertex buffer.
+    GpuCuller gpuCuller(device, { GpuCuller::Mesh{ (uint32_t)vertexCount, 0 } });
+    gpuCuller.setScene(queue, instances.data(), sizeof(InstanceData), bounds, std::vector<uint32_t>(OBJECT_COUNT, 0));
+    std::cout << "ℹ️ GPU culling draws with " << (gpuCuller.usesMultiDrawIndirect() ? "multiDrawIndirect" : "drawIndirect") << std::endl;
+    // A fountain that follows the camera, in front of the objects, at a
+    // rate that keeps the pool about full
+    std::unique_ptr<ParticleSystem> particles;
+    if (particleCapacity > 0) {
+        ParticleSystem::Settings particleSettings;
+        particleSettings.capacity = particleCapacity;
+        particleSettings.emitRate = particleCapacity / particleSettings.lifetime;
+        particleSettings.size = 0.05f;
+        particleSettings.gravity[1] = -4.0f;
+        particleSettings.velocity[1] = 4.0f;
+        particleSettings.spread[0] = 3.0f;
+        particleSettings.spread[1] = 2.0f;
+        particles = std::make_unique<ParticleSystem>(device, particleSettings, swapChainFormat, multisampleTarget.sampleCount(), depthBuffer.format(), bindGroupLayout);
+        std::cout << "ℹ️ Particles: up to " << particleCapacity << ", simulated and drawn on the GPU" << std::endl;
+    }
+    // All objects share one large texture, whose fine levels are only
+    // loaded when the camera zooms in enough to need them. Its levels are
+    // generated rather than decoded from a file, with a different color
+    // per level to show which one is resident.
+    MipmapGenerator mipmapGenerator(device);
+    TextureStreamer::Budgets textureBudgets;
+    TextureStreamer textureStreamer(device, textureBudgets, &bindGroupCache, &mipmapGenerator);
+    TextureStreamer::TextureId texture = textureStreamer.addTexture("Checkerboard", TEXTURE_SIZE, TEXTURE_SIZE,
+        [](uint32_t mipLevel, uint32_t width, uint32_t height, std::vector<uint8_t>& pixels) {
+            const uint8_t levelColors[4][3] = { { 255, 255, 255 }, { 255, 200, 200 }, { 200, 255, 200 }, { 200, 200, 255 } };
+            const uint8_t* color = levelColors[mipLevel % 4];
+            // 16 squares across, whatever the level
+            uint32_t square = std::max(width / 16, 1u);
+            pixels.resize(4 * width * height);
+            for (uint32_t y = 0; y < height; ++y) {
+                for (uint32_t x = 0; x < width; ++x) {
+                    bool dark = ((x / square) + (y / square)) % 2 == 1;
+                    uint8_t* texel = &pixels[4 * (y * width + x)];
+                    for (int c = 0; c < 3; ++c) {
+                        texel[c] = dark ? color[c] / 2 : color[c];
+                    }
+                    texel[3] = 255;
+                }
+            }
+            return true;
+        }
+    );
+    uint32_t residentMip = textureStreamer.mipLevelCount(texture);
+
+    SamplerDescriptor samplerDesc;
+    samplerDesc.addressModeU = AddressMode::Repeat;
+    samplerDesc.addressModeV = AddressMode::Repeat;
+    samplerDesc.addressModeW = AddressMode::Repeat;
+    samplerDesc.magFilter = FilterMode::Linear;
+    samplerDesc.minFilter = FilterMode::Linear;
+    samplerDesc.mipmapFilter = MipmapFilterMode::Linear;
+    samplerDesc.lodMinClamp = 0.0f;
+    samplerDesc.lodMaxClamp = 32.0f;
+    samplerDesc.compare = CompareFunction::Undefined;
+    samplerDesc.maxAnisotropy = 1;
+    Sampler sampler = device.createSampler(samplerDesc);
+
+    std::vector<BindGroupEntry> textureBindings(2);
+    textureBindings[0].binding = 0;
+    textureBindings[1].binding = 1;
+    textureBindings[1].sampler = sampler;
+    BindGroupDescriptor textureBindGroupDesc{};
+    textureBindGroupDesc.layout = textureBindGroupLayout;
+    textureBindGroupDesc.entryCount = (uint32_t)textureBindings.size();
+    textureBindGroupDesc.entries = textureBindings.data();
+
+    // When capturing, frames are rendered into a texture that gets copied
+    // to the video file rather than to the window, which is not updated,
+    // so that capture does not wait for the display. Time advances by one
+    // video frame per frame rendered, whatever time that takes.
+    std::unique_ptr<FrameCapture> frameCapture;
+    uint64_t capturedFrameCount = 0;
+    if (capturePath) {
+        std::string path = capturePath;
+        bool y4m = path.size() >= 4 && path.compare(path.size() - 4, 4, ".y4m") == 0;
+        FrameCapture::Settings captureSettings;
+        captureSettings.format = y4m ? FrameCapture::Format::Y4m : FrameCapture::Format::Raw;
+        captureSettings.framesPerSecond = CAPTURE_FPS;
+        if (!FrameCapture::supportsFormat(swapChainFormat)) {
+            std::cerr << "Cannot capture frames of this texture format" << std::endl;
+            return 1;
+        }
+        frameCapture = std::make_unique<FrameCapture>(device, swapChainFormat, SCREEN_WIDTH, SCREEN_HEIGHT, captureSettings);
+        if (!frameCapture->open(capturePath)) {
+            std::cerr << "Could not create " << capturePath << std::endl;
+            return 1;
+        }
+
+        std::cout << "🎥 Capturing to " << capturePath;
+        if (!y4m) std::cout << " (" << FrameCapture::pixelFormatName(swapChainFormat) << ", " << SCREEN_WIDTH << "x" << SCREEN_HEIGHT << ")";
+        std::cout << ", close the window to stop" << std::endl;
+    }
+
+    // Frames go to an offscreen texture instead of the swap chain when they
+    // are captured, or when there is no surface to present them to. Headless
+    // runs are then not paced by the display either.
+    Texture offscreenTarget = nullptr;
+    TextureView offscreenTargetView = nullptr;
+    if (frameCapture || !swapChain) {
+        TextureDescriptor offscreenTargetDesc;
+        offscreenTargetDesc.label = "Offscreen target";
+        offscreenTargetDesc.usage = TextureUsage::RenderAttachment | TextureUsage::CopySrc;
+        offscreenTargetDesc.dimension = TextureDimension::_2D;
+        offscreenTargetDesc.size = { SCREEN_WIDTH, SCREEN_HEIGHT, 1 };
+        offscreenTargetDesc.format = swapChainFormat;
+        offscreenTargetDesc.mipLevelCount = 1;
+        offscreenTargetDesc.sampleCount = 1;
+        offscreenTargetDesc.viewFormatCount = 0;
+        offscreenTargetDesc.viewFormats = nullptr;
+        offscreenTarget = device.createTexture(offscreenTargetDesc);
+        offscreenTargetView = offscreenTarget.createView();
+    }
+    uint64_t frameCount = 0;
+
+    // Captured and headless frames are not presented, so there is nothing
+    // to pace them against. Mailbox aims at the display refresh, and
+    // Immediate renders as fast as it can, only sampling input late. Without
+    // pacing, the pacer still measures the latency and CPU use to compare.
+    std::unique_ptr<FramePacer> framePacer;
+    if (swapChain && !frameCapture) {
+        FramePacer::Settings pacerSettings;
+        pacerSettings.presentMode = presentMode;
+        pacerSettings.sleep = framePacing;
+        pacerSettings.targetInterval = presentMode == PresentMode::Immediate ? 0.0 : FramePacer::displayInterval();
+        framePacer = std::make_unique<FramePacer>(pacerSettings);
+    }
+
+    // Press G to switch between CPU and GPU culling
+    bool useGpuCulling = true;
+    bool toggleKeyWasDown = false;
+    // Press T to make the objects spin on themselves
+    bool spinObjects = false;
+    bool spinKeyWasDown = false;
+    // Press Z to zoom in and out
+    bool zoomIn = false;
+    bool zoomKeyWasDown = false;
+
+    // Time of the previous frame, which the particles advance from
+    float previousTime = frameCapture ? 0.0f : static_cast<float>(glfwGetTime());
+
     std::cout << "🔄 Starting main loop" << pipeline << std::endl;
-    while (!glfwWindowShouldClose(window)) {
-        // Check whether the user clicked on the close button (and any other
-        // mouse/key event, which we don't use so far)
-        glfwPollEvents();
+    // Input is logged from the first frame, which replay starts at
+    if (recordPath && !glfwStartInputRecording(recordPath)) {
+        std::cerr << "Could not record input to " << recordPath << std::endl;
+        return 1;
+    }
+    if (replayPath) {
+        if (!glfwStartInputReplay(window, replayPath)) {
+            std::cerr << "Could not replay input from " << replayPath << std::endl;
+            return 1;
+        }
+        std::cout << "🔁 Replaying input from " << replayPath << std::endl;
+    }
+
+    while (!glfwWindowShouldClose(window) && (maxFrameCount == 0 || frameCount < maxFrameCount)) {
+        // Check whether the user clicked on the close button, and for the
+        // keys we react to. The pacer first sleeps until the frame is due, so
+        // that the input is as recent as possible when it gets presented.
+        if (framePacer) {
+            framePacer->waitForNextFrame();
+        } else {
+            glfwPollEvents();
+        }
+        if (replayPath && glfwInputReplayEnded()) {
+            break;
+        }
+
+        bool toggleKeyDown = glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS;
+        if (toggleKeyDown && !toggleKeyWasDown) {
+            useGpuCulling = !useGpuCulling;
+            std::cout << "ℹ️ Culling on the " << (useGpuCulling ? "GPU" : "CPU") << std::endl;
+        }
+        toggleKeyWasDown = toggleKeyDown;
+
+        bool spinKeyDown = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+        if (spinKeyDown && !spinKeyWasDown) {
+            spinObjects = !spinObjects;
+        }
+        spinKeyWasDown = spinKeyDown;
+
+        bool zoomKeyDown = glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS;
+        if (zoomKeyDown && !zoomKeyWasDown) {
+            zoomIn = !zoomIn;
+        }
+        zoomKeyWasDown = zoomKeyDown;
+
+        // Nothing is visible while the window is minimized, so wait for it
+        // to come back rather than spin
+        if (!offscreenTarget && swapChain->minimized()) {
+            glfwWaitEvents();
+            continue;
+        }
+        // Recreate the swap chain once the window is done being resized,
+        // along with the targets that have its size
+        if (!offscreenTarget && swapChain->update()) {
+            frameWidth = swapChain->width();
+            frameHeight = swapChain->height();
+            multisampleTarget.resize(frameWidth, frameHeight);
+            if (fxaaPass) {
+                fxaaPass->resize(frameWidth, frameHeight);
+            }
+            depthBuffer.resize(frameWidth, frameHeight);
+        }
 
         // Get the next available swap chain texture
-        TextureView nextTexture = swapChain.getCurrentTextureView();
+        TextureView nextTexture = offscreenTarget ? offscreenTargetView : swapChain->nextTexture();
 
         if (!nextTexture) {
-            // Texture might be null, if for example the window has been resized
-            break;
+            // The swap chain no longer matches the window, skip this frame
+            // while it gets recreated
+            continue;
         }
+
+        // The camera slowly orbits around the center of the grid, looking
+        // down the Z axis through an orthographic projection.
+        float time = frameCapture ? static_cast<float>(capturedFrameCount) / CAPTURE_FPS : static_cast<float>(glfwGetTime());
+        // Long stalls, e.g. while the window is moved, are not simulated
+        float deltaTime = std::clamp(time - previousTime, 0.0f, 0.1f);
+        previousTime = time;
+        float orbitRadius = 0.3f * GRID_SIZE * GRID_SPACING;
+        float cameraX = orbitRadius * std::cos(0.2f * time);
+        float cameraY = orbitRadius * std::sin(0.2f * time);
+        float halfHeight = zoomIn ? VIEW_HALF_HEIGHT / ZOOM_FACTOR : VIEW_HALF_HEIGHT;
+        float halfWidth = halfHeight * frameWidth / frameHeight;
+
+        CameraUniforms camera;
+        camera.viewProj = mat4Orthographic(
+            cameraX - halfWidth, cameraX + halfWidth,
+            cameraY - halfHeight, cameraY + halfHeight,
+            -1.0f, 1.0f
+        );
+        uniforms.reset();
+        // The first allocation of the frame, which always fits
+        static_assert(sizeof(CameraUniforms) <= UNIFORM_CAPACITY, "The camera must fit in the uniform allocator");
+        uint32_t cameraOffset = uniforms.allocate(camera);
+        Frustum frustum = Frustum::fromViewProjection(camera.viewProj.data());
+
+        // Only the objects are touched, so the grid and row nodes are not
+        // updated, and only the instances that moved are uploaded.
+        if (spinObjects) {
+            for (uint32_t i = 0; i < OBJECT_COUNT; ++i) {
+                TransformHierarchy::Transform local = transforms.local(objectNodes[i]);
+                local.rotation = quatFromAxisAngle(0.0f, 0.0f, 1.0f, (1.0f + (i % 7)) * time);
+                transforms.setLocal(objectNodes[i], local);
+            }
+        }
+        TransformHierarchy::UpdateResult transformUpdate = transforms.update();
+        gpuCuller.updateInstances(queue, transformUpdate.firstInstance, transformUpdate.instanceCount, &instances[transformUpdate.firstInstance]);
+
+        // The largest objects have a scale of 1 and are about as wide as a
+        // unit of the world, which covers this many pixels on screen.
+        textureStreamer.requestScreenSize(texture, frameHeight / (2.0f * halfHeight));
+        textureStreamer.update(queue);
+        if (textureStreamer.residentMip(texture) != residentMip) {
+            residentMip = textureStreamer.residentMip(texture);
+            std::cout << "ℹ️ Texture resident from mip level " << residentMip
+                << " (" << textureStreamer.stats().residentBytes / 1024 << " KiB)" << std::endl;
+        }
+
 		CommandEncoderDescriptor commandEncoderDesc{};
 		commandEncoderDesc.label = "Command Encoder";
 		CommandEncoder encoder = device.createCommandEncoder(commandEncoderDesc);
 
+        uint32_t visibleCount = 0;
+        if (useGpuCulling) {
+            // Culling and compaction happen in a compute pass that runs
+            // right before the render pass.
+            gpuCuller.cull(queue, encoder, frustum);
+        } else {
+            // Cull objects and gather the instance data of the visible ones,
+            // front to back so that early depth testing skips the fragments
+            // of the objects behind the ones already drawn. The GPU culling
+            // path draws them in the order compaction left them.
+            const std::vector<uint32_t>& visible = culler.cull(frustum, bounds);
+            visibleCount = static_cast<uint32_t>(visible.size());
+            drawOrder.resize(visibleCount);
+            for (uint32_t i = 0; i < visibleCount; ++i) {
+                drawOrder[i] = { mat4MulVec4(camera.viewProj, instances[visible[i]].model.columns[3]).z, visible[i] };
+            }
+            std::sort(drawOrder.begin(), drawOrder.end());
+            for (uint32_t i = 0; i < visibleCount; ++i) {
+                visibleInstances[i] = instances[drawOrder[i].second];
+            }
+            if (visibleCount > 0) {
+                queue.writeBuffer(instanceBuffer, 0, visibleInstances.data(), visibleCount * sizeof(InstanceData));
+            }
+        }
+        if (particles) {
+            particles->setEmitterPosition(cameraX, cameraY, 0.8f);
+            particles->update(queue, encoder, deltaTime);
+        }
+
+        // Always the same bind group, found in the cache
+        BindGroup bindGroup = bindGroupCache.getBindGroup(bindGroupDesc);
+
+        if (depthBuffer.hasPrepass()) {
+            RenderPassEncoder prepass = depthBuffer.beginPrepass(encoder);
+            prepass.setPipeline(prepassPipeline);
+            prepass.setBindGroup(0, bindGroup, 1, &cameraOffset);
+            prepass.setVertexBuffer(0, positionBuffer, 0, positionData.size() * sizeof(float));
+            if (useGpuCulling) {
+                gpuCuller.draw(prepass, 1);
+            } else if (visibleCount > 0) {
+                prepass.setVertexBuffer(1, instanceBuffer, 0, visibleCount * sizeof(InstanceData));
+                prepass.draw(vertexCount, visibleCount, 0, 0);
+            }
+            prepass.end();
+            prepass.release();
+        }
+
         // Describe a render pass, which targets the texture view
         RenderPassDescriptor renderPassDesc{};
 
-        RenderPassColorAttachment renderPassColorAttachment = {};
-        // The attachment is tighed to the view returned by the swap chain, so that
-		// the render pass draws directly on screen.
-        renderPassColorAttachment.view = nextTexture;
-        // Not relevant here because we do not use multi-sampling
-        renderPassColorAttachment.resolveTarget = nullptr;
-        renderPassColorAttachment.loadOp = LoadOp::Clear;
-        renderPassColorAttachment.storeOp = StoreOp::Store;
-        renderPassColorAttachment.clearValue = Color{ 0.1, 0.1, 0.1, 1.0 };
+        // The attachment ends up in the view returned by the swap chain, so
+        // that the render pass draws on screen, unless FXAA filters it first.
+        TextureView sceneView = fxaaPass ? fxaaPass->inputView() : nextTexture;
+        RenderPassColorAttachment renderPassColorAttachment = multisampleTarget.colorAttachment(sceneView, Color{ 0.1, 0.1, 0.1, 1.0 });
         renderPassDesc.colorAttachmentCount = 1;
         renderPassDesc.colorAttachments = &renderPassColorAttachment;
-        // No depth buffer for now
-        renderPassDesc.depthStencilAttachment = nullptr;
+        RenderPassDepthStencilAttachment depthStencilAttachment = depthBuffer.mainPassAttachment();
+        renderPassDesc.depthStencilAttachment = &depthStencilAttachment;
         // We do not use timers for now neither
         renderPassDesc.timestampWriteCount = 0;
         renderPassDesc.timestampWrites = nullptr;
@@ -315,25 +1065,80 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
         // In its overall outline, drawing a triangle is as simple as this:
 		// Select which render pipeline to use
 		renderPass.setPipeline(pipeline);
-		
-        // Set vertex buffer while encoding the render pass
+		renderPass.setBindGroup(0, bindGroup, 1, &cameraOffset);
+		// The texture view changes when its residency does, and only then
+		// does the cache create a new bind group
+		textureBindings[0].textureView = textureStreamer.view(texture);
+		renderPass.setBindGroup(1, bindGroupCache.getBindGroup(textureBindGroupDesc), 0, nullptr);
+
+		// Tint objects differently depending on where they were culled
+		DrawParams drawParams;
+		drawParams.tint = useGpuCulling ? Vec4{ 1.0f, 1.0f, 1.0f, 1.0f } : Vec4{ 1.0f, 0.8f, 0.6f, 1.0f };
+		// Without room left for them in the uniform allocator, the objects
+		// are skipped rather than drawn with stale parameters
+		bool drawParamsSet = drawConstants.set(renderPass, drawParams);
+
+		// Set vertex buffer while encoding the render pass
 		renderPass.setVertexBuffer(0, vertexBuffer, 0, vertexData.size() * sizeof(float));
 
-		// We use the `vertexCount` variable instead of hard-coding the vertex count
-		renderPass.draw(vertexCount, 1, 0, 0);
+		if (!drawParamsSet) {
+			std::cerr << "Uniform allocator full, objects not drawn" << std::endl;
+		} else if (useGpuCulling) {
+			// Instance counts come from the culling pass' output, so the CPU
+			// does not even know how many objects get drawn.
+			gpuCuller.draw(renderPass, 1);
+		} else if (visibleCount > 0) {
+			renderPass.setVertexBuffer(1, instanceBuffer, 0, visibleCount * sizeof(InstanceData));
+
+			// One instance per visible object
+			renderPass.draw(vertexCount, visibleCount, 0, 0);
+		}
+
+		// Blended over the objects, with the camera still bound at group 0
+		if (particles) {
+			particles->draw(renderPass);
+		}
 
         renderPass.end();
-        nextTexture.release();
+        if (fxaaPass) {
+            fxaaPass->apply(encoder, nextTexture);
+        }
+        if (frameCapture) {
+            frameCapture->capture(encoder, offscreenTarget);
+            ++capturedFrameCount;
+        }
+        if (!offscreenTarget) {
+            nextTexture.release();
+        }
 
         CommandBufferDescriptor cmdBufferDescriptor = {};
         cmdBufferDescriptor.nextInChain = nullptr;
         cmdBufferDescriptor.label = "Command buffer";
         CommandBuffer command = encoder.finish(cmdBufferDescriptor);
-        
+
+        // Everything allocated while encoding must be uploaded before submitting
+        uniforms.upload(queue);
         queue.submit(1, &command);
 
-        // We can tell the swap chain to present the next texture.
-        swapChain.present();
+        if (frameCapture) {
+            frameCapture->submitted();
+        } else if (framePacer) {
+            // We can tell the swap chain to present the next texture.
+            framePacer->present(swapChain->swapChain());
+        } else {
+            // Nothing paces headless frames, so wait for the GPU to keep
+            // submitted work from piling up
+#ifdef WEBGPU_BACKEND_WGPU
+            wgpuDevicePoll(device, true, nullptr);
+#else
+            bool workDone = false;
+            auto workDoneCallback = queue.onSubmittedWorkDone([&workDone](QueueWorkDoneStatus) { workDone = true; });
+            while (!workDone) {
+                device.tick();
+            }
+#endif
+        }
+        ++frameCount;
         // renderPass.release();
         // encoder.release();
 
@@ -343,11 +1148,59 @@ fn fs_main(in: VertexOutput) -> @location(0) vec4f {
 #endif
     }
 
+    // The swap chain unregisters its callbacks from the window, and the
+    // surface is created from it, so both go before the window
+    if (swapChain) {
+        std::cout << "ℹ️ Swap chain created " << swapChain->creationCount() << " times" << std::endl;
+        swapChain.reset();
+        surface.release();
+    }
+
     glfwDestroyWindow(window);
     glfwTerminate();
 
-    swapChain.release();
-    surface.release();
+    if (frameCapture) {
+        frameCapture->close();
+        FrameCapture::Stats captureStats = frameCapture->stats();
+        std::cout << "🎥 Captured " << captureStats.framesWritten << " frames (" << captureStats.bytesWritten / (1024 * 1024) << " MiB), "
+            << "waited " << captureStats.stallMs << " ms for the disk" << std::endl;
+        if (!frameCapture->good()) {
+            std::cerr << "Could not write all frames to " << capturePath << std::endl;
+        }
+        frameCapture.reset();
+    }
+    if (offscreenTarget) {
+        offscreenTargetView.release();
+        offscreenTarget.destroy();
+        offscreenTarget.release();
+    }
+    std::cout << "ℹ️ Rendered " << frameCount << " frames" << std::endl;
+    if (framePacer) {
+        FramePacer::Stats pacerStats = framePacer->stats();
+        std::cout << "⏱️ " << FramePacer::presentModeName(presentMode) << (framePacing ? ", paced: " : ", not paced: ")
+            << pacerStats.averageIntervalMs << " ms per frame, input to present "
+            << pacerStats.averageLatencyMs << " ms on average, " << pacerStats.maxLatencyMs << " ms at most, "
+            << "CPU busy " << pacerStats.cpuBusyPercent << "%, idle " << pacerStats.idlePercent << "% of the time" << std::endl;
+        framePacer.reset();
+    }
+
+    // Only the first lookups, at setup and on the first frame, and the ones
+    // following a texture residency change should have missed the cache
+    const BindGroupCache::Stats& cacheStats = bindGroupCache.stats();
+    std::cout << "ℹ️ Bind group cache: " << cacheStats.bindGroupHits << " hits, "
+        << cacheStats.bindGroupMisses << " misses" << std::endl;
+
+    particles.reset();
+    bindGroupCache.evict(sampler);
+    sampler.release();
+    instanceBuffer.release();
+    positionBuffer.release();
+    vertexBuffer.release();
+    if (prepassPipeline) {
+        prepassPipeline.release();
+        prepassPipelineLayout.release();
+    }
+    pipelineLayout.release();
     adapter.release();
     device.release();
     instance.release();
@@ -0,0 +1,9 @@
+// The implementation of the C++ wrapper, compiled once into the webgpu_cpp
+// library. Sources that use the wrapper only include its declarations, and
+// must not define WEBGPU_CPP_IMPLEMENTATION themselves.
+//
+// Nothing may be included before these lines: any header that includes
+// webgpu.hpp without the define would make the include below a no-op, due
+// to #pragma once, and leave the library without the wrapper's methods.
+#define WEBGPU_CPP_IMPLEMENTATION
+#include "webgpu/webgpu.hpp"